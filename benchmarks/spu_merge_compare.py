@@ -5,6 +5,7 @@ SPU merge comparison benchmark
 Compares Python and C++ implementations of the merge primitive.
 """
 
+import hashlib
 import json
 import sys
 import time
@@ -32,14 +33,14 @@ def benchmark_implementation(name, merge_func, glyph_class, iterations=50000):
 
     # Create test glyphs
     g1 = glyph_class()
-    g1.id = "id1_0000000000000000000000000000000000000000000000000000000000"
+    g1.id = hashlib.sha256(b"content1").hexdigest()
     g1.content = "content1"
     g1.energy = 2.0
     g1.activation_count = 0
     g1.last_update_time = 0
 
     g2 = glyph_class()
-    g2.id = "id2_0000000000000000000000000000000000000000000000000000000000"
+    g2.id = hashlib.sha256(b"content2").hexdigest()
     g2.content = "content2"
     g2.energy = 3.0
     g2.activation_count = 0
@@ -96,12 +97,64 @@ def benchmark_implementation(name, merge_func, glyph_class, iterations=50000):
     }
 
 
+def benchmark_glyph_array(iterations=50000, batch_size=1024):
+    """Benchmark GlyphArray batch merge (one boundary crossing per batch)"""
+    import numpy as np
+
+    print(f"Benchmarking cpp_glyph_array ({iterations} merges, batch {batch_size})...")
+
+    glyphs = []
+    for content, energy in (("content1", 2.0), ("content2", 3.0)):
+        g = spu_merge.Glyph()
+        g.id = hashlib.sha256(content.encode()).hexdigest()
+        g.content = content
+        g.energy = energy
+        glyphs.append(g)
+    array = spu_merge.GlyphArray(glyphs)
+    pairs = np.tile(np.array([[0, 1]], dtype=np.uint32), (batch_size, 1))
+
+    spu_merge.merge_batch(array, pairs)  # warmup
+
+    batches = max(1, iterations // batch_size)
+    latencies = []
+    start_total = time.perf_counter()
+    for _ in range(batches):
+        start = time.perf_counter()
+        spu_merge.merge_batch(array, pairs)
+        end = time.perf_counter()
+        latencies.append((end - start) * 1e6 / batch_size)  # µs per merge
+    end_total = time.perf_counter()
+
+    latencies.sort()
+    mean_lat = sum(latencies) / len(latencies)
+    ops_per_sec = batches * batch_size / (end_total - start_total)
+
+    print(f"  Mean latency: {mean_lat:.3f} µs per merge")
+    print(f"  Throughput: {ops_per_sec:,.0f} ops/sec")
+    print()
+
+    return {
+        "implementation": "cpp_glyph_array",
+        "iterations": batches * batch_size,
+        "batch_size": batch_size,
+        "latency_us": {
+            "min": latencies[0],
+            "max": latencies[-1],
+            "median": latencies[len(latencies) // 2],
+            "mean": mean_lat,
+        },
+        "throughput": {"ops_per_sec": int(ops_per_sec)},
+        "total_time_ms": (end_total - start_total) * 1000,
+    }
+
+
 def main():
     import argparse
 
     parser = argparse.ArgumentParser()
     parser.add_argument("--primitive", default="merge")
     parser.add_argument("--iterations", type=int, default=50000)
+    parser.add_argument("--batch-size", type=int, default=1024)
     parser.add_argument("--out", default="benchmarks/spu_merge_compare.json")
     args = parser.parse_args()
 
@@ -127,6 +180,14 @@ def main():
         print(f"Speedup (C++ vs Python): {speedup:.2f}x\n")
 
         cpp_result["speedup_vs_python"] = speedup
+
+        # Batch path: one call per batch instead of one per glyph
+        array_result = benchmark_glyph_array(args.iterations, args.batch_size)
+        array_result["speedup_vs_python"] = (
+            python_result["latency_us"]["mean"] / array_result["latency_us"]["mean"]
+        )
+        print(f"Speedup (GlyphArray vs Python): {array_result['speedup_vs_python']:.2f}x\n")
+        results.append(array_result)
     else:
         print("Note: C++ binding not available (pybind11 not installed)")
         print("To build: pip install pybind11 && cd runtime/spu && python3 setup.py build_ext --inplace")
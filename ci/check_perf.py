@@ -9,7 +9,11 @@ Usage:
   python3 ci/check_perf.py \
     --baseline ci/perf_baseline.json \
     --current benchmarks/spu_results_ci.json \
+    --current-native benchmarks/merge_bench_ci.json \
     --current-persistence benchmarks/persistence_ci.json
+
+--current-native takes the Google Benchmark JSON written by
+runtime/spu/merge_bench (--benchmark_out_format=json).
 """
 
 import argparse
@@ -40,49 +44,33 @@ def load_json(path):
         return None
 
 
-def check_spu_regression(baseline, current, thresholds):
+def compare_merge_metrics(label, baseline_latency, baseline_ops, current_latency,
+                          current_ops, thresholds):
     """
-    Check SPU benchmark for regressions
+    Compare latency / throughput against a baseline
 
     Returns: (passed, messages)
     """
     passed = True
     messages = []
 
-    # Extract metrics
-    baseline_latency = baseline["spu"]["merge"]["avg_latency_us"]
-    baseline_ops = baseline["spu"]["merge"]["ops_per_sec"]
-
-    # Current is a list, get merge primitive
-    current_merge = None
-    for prim in current:
-        if prim["primitive"] == "merge":
-            current_merge = prim
-            break
-
-    if not current_merge:
-        return False, ["Error: merge primitive not found in current results"]
-
-    current_latency = current_merge["avg_latency_us"]
-    current_ops = current_merge["ops_per_sec"]
-
     # Check latency regression
     latency_increase_pct = ((current_latency - baseline_latency) / baseline_latency) * 100
 
     if latency_increase_pct > thresholds["spu_latency_increase_pct"]:
         passed = False
         messages.append(
-            f"{Colors.RED}✗ SPU latency regression: {latency_increase_pct:.1f}% increase "
+            f"{Colors.RED}✗ {label} latency regression: {latency_increase_pct:.1f}% increase "
             f"({baseline_latency:.2f} → {current_latency:.2f} µs){Colors.RESET}"
         )
     elif latency_increase_pct > thresholds["spu_latency_increase_pct"] / 2:
         messages.append(
-            f"{Colors.YELLOW}⚠ SPU latency warning: {latency_increase_pct:.1f}% increase "
+            f"{Colors.YELLOW}⚠ {label} latency warning: {latency_increase_pct:.1f}% increase "
             f"({baseline_latency:.2f} → {current_latency:.2f} µs){Colors.RESET}"
         )
     else:
         messages.append(
-            f"{Colors.GREEN}✓ SPU latency OK: {latency_increase_pct:+.1f}% "
+            f"{Colors.GREEN}✓ {label} latency OK: {latency_increase_pct:+.1f}% "
             f"({baseline_latency:.2f} → {current_latency:.2f} µs){Colors.RESET}"
         )
 
@@ -92,23 +80,114 @@ def check_spu_regression(baseline, current, thresholds):
     if ops_decrease_pct > thresholds["spu_throughput_decrease_pct"]:
         passed = False
         messages.append(
-            f"{Colors.RED}✗ SPU throughput regression: {ops_decrease_pct:.1f}% decrease "
+            f"{Colors.RED}✗ {label} throughput regression: {ops_decrease_pct:.1f}% decrease "
             f"({baseline_ops:,} → {current_ops:,} ops/sec){Colors.RESET}"
         )
     elif ops_decrease_pct > thresholds["spu_throughput_decrease_pct"] / 2:
         messages.append(
-            f"{Colors.YELLOW}⚠ SPU throughput warning: {ops_decrease_pct:.1f}% decrease "
+            f"{Colors.YELLOW}⚠ {label} throughput warning: {ops_decrease_pct:.1f}% decrease "
             f"({baseline_ops:,} → {current_ops:,} ops/sec){Colors.RESET}"
         )
     else:
         messages.append(
-            f"{Colors.GREEN}✓ SPU throughput OK: {ops_decrease_pct:+.1f}% "
+            f"{Colors.GREEN}✓ {label} throughput OK: {ops_decrease_pct:+.1f}% "
             f"({baseline_ops:,} → {current_ops:,} ops/sec){Colors.RESET}"
         )
 
     return passed, messages
 
 
+def check_spu_regression(baseline, current, thresholds):
+    """
+    Check SPU benchmark for regressions
+
+    Returns: (passed, messages)
+    """
+    # Extract metrics
+    baseline_latency = baseline["spu"]["merge"]["avg_latency_us"]
+    baseline_ops = baseline["spu"]["merge"]["ops_per_sec"]
+
+    # Current is a list, get merge primitive
+    current_merge = None
+    for prim in current:
+        if prim["primitive"] == "merge":
+            current_merge = prim
+            break
+
+    if not current_merge:
+        return False, ["Error: merge primitive not found in current results"]
+
+    return compare_merge_metrics(
+        "SPU",
+        baseline_latency,
+        baseline_ops,
+        current_merge["avg_latency_us"],
+        current_merge["ops_per_sec"],
+        thresholds,
+    )
+
+
+def native_merge_metrics(current, benchmark_name):
+    """
+    Extract (avg_latency_us, ops_per_sec) for one Google Benchmark run
+
+    Uses the median aggregate when the run used --benchmark_repetitions,
+    otherwise the mean over the reported iterations.
+
+    Returns: None if the benchmark is missing
+    """
+    runs = [
+        b
+        for b in current.get("benchmarks", [])
+        if b.get("run_name", b["name"]) == benchmark_name and "items_per_second" in b
+    ]
+    medians = [b for b in runs if b.get("aggregate_name") == "median"]
+    if medians:
+        ops = medians[0]["items_per_second"]
+    else:
+        iterations = [b for b in runs if b.get("run_type") != "aggregate"]
+        if not iterations:
+            return None
+        ops = sum(b["items_per_second"] for b in iterations) / len(iterations)
+
+    return 1e6 / ops, int(ops)
+
+
+def check_native_regression(baseline, current, thresholds):
+    """
+    Check the native merge benchmark (merge_bench JSON) for regressions
+
+    Returns: (passed, messages)
+    """
+    native = baseline["spu"]["merge_native"]
+    name = native["benchmark"]
+
+    metrics = native_merge_metrics(current, name)
+    if metrics is None:
+        return False, [f"Error: {name} not found in native benchmark results"]
+
+    current_latency, current_ops = metrics
+    passed, messages = compare_merge_metrics(
+        "Native merge",
+        native["avg_latency_us"],
+        native["ops_per_sec"],
+        current_latency,
+        current_ops,
+        thresholds,
+    )
+
+    # The baseline is only comparable on the hash backend it was recorded with
+    baseline_backend = native.get("hash_backend")
+    current_backend = current.get("context", {}).get("hash_backend")
+    if baseline_backend and current_backend and current_backend != baseline_backend:
+        messages.insert(
+            0,
+            f"{Colors.YELLOW}⚠ Native merge ran on hash backend {current_backend}, "
+            f"baseline was recorded on {baseline_backend}{Colors.RESET}",
+        )
+    return passed, messages
+
+
 def check_persistence_regression(baseline, current, thresholds):
     """
     Check persistence benchmark for regressions
@@ -151,6 +230,9 @@ def main():
         "--baseline", required=True, help="Baseline performance JSON file"
     )
     parser.add_argument("--current", required=True, help="Current SPU results JSON")
+    parser.add_argument(
+        "--current-native", help="Current native merge_bench results (Google Benchmark JSON)"
+    )
     parser.add_argument(
         "--current-persistence", help="Current persistence results JSON"
     )
@@ -215,6 +297,21 @@ def main():
 
     all_passed = all_passed and spu_passed
 
+    # Check native merge (if provided)
+    if args.current_native:
+        current_native = load_json(args.current_native)
+        if not current_native:
+            return 1
+        print(f"{Colors.BOLD}Native Merge ({baseline['spu']['merge_native']['benchmark']}):{Colors.RESET}")
+        native_passed, native_messages = check_native_regression(
+            baseline, current_native, thresholds
+        )
+        for msg in native_messages:
+            print(f"  {msg}")
+        print()
+
+        all_passed = all_passed and native_passed
+
     # Check persistence (if provided)
     if args.current_persistence:
         current_persistence = load_json(args.current_persistence)
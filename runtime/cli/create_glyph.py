@@ -60,6 +60,9 @@ def save_glyph(glyph_id, glyph_data):
     Uses content-addressed directory structure:
     persistence/ab/cd/glyph_abcd...json
 
+    If $GLYPH_INDEX names an index file (glyph_index.py), the glyph is
+    also appended to that index's log.
+
     Args:
         glyph_id: The SHA256 hash ID
         glyph_data: The glyph dictionary
@@ -103,6 +106,12 @@ def save_glyph(glyph_id, glyph_data):
             pass
         raise
 
+    index_path = os.environ.get("GLYPH_INDEX")
+    if index_path:
+        import glyph_index
+        content = glyph_data.get("content", "")
+        glyph_index.append_delta(index_path, glyph_id, content if isinstance(content, str) else "")
+
     return str(file_path)
 
 
@@ -0,0 +1,484 @@
+#!/usr/bin/env python3
+"""
+glyph_index.py - Build and query glyph ID / content-token index files
+
+An index file maps glyph IDs and content tokens to glyphs without touching
+the glyph files: IDs are stored sorted (exact and prefix lookup by binary
+search) and each content token has a sorted posting list. Readers mmap the
+file, so a query reads a few pages instead of scanning the persistence
+directory. The native GlyphIndex (runtime/spu/glyph_index.h) writes and
+loads the same format.
+
+Layout (little-endian, version 1):
+
+    header: magic "SPUINDX\\0", u32 version, u32 flags, u64 ID count,
+            u64 token count, u64 offsets of ids / tokens / postings /
+            strings, u64 file size
+    ids:      count x 32 bytes, ascending
+    tokens:   per token: u64 FNV-1a hash, u64 postings start,
+              u32 postings count, u32 token length, u64 string offset;
+              sorted by (hash, token)
+    postings: u32 ranks into ids, ascending per token
+    strings:  token bytes
+
+Glyphs persisted after the last build are appended to "<index>.log" (one
+JSON line per glyph, see append_delta()) and merged into query results;
+`compact` folds the log into the file. The index holds only IDs and
+tokens, so it can always be rebuilt from the JSON files.
+
+Tokens are runs of ASCII letters and digits (lowercased) and of non-ASCII
+bytes, split every 64 bytes.
+
+Usage:
+    glyph_index.py build persistence/ -o glyphs.spui
+    glyph_index.py compact glyphs.spui
+    glyph_index.py info glyphs.spui
+"""
+
+import argparse
+import bisect
+import json
+import mmap
+import os
+import re
+import struct
+import sys
+import tempfile
+from pathlib import Path
+
+import glyph_snapshot
+
+MAGIC = b"SPUINDX\0"
+VERSION = 1
+MAX_TOKEN_LEN = 64
+
+HEADER = struct.Struct("<8sIIQQQQQQQ")
+TOKEN = struct.Struct("<QQIIQ")
+
+_TOKEN_RE = re.compile(rb"[0-9A-Za-z\x80-\xff]+")
+
+
+def tokenize(text):
+    """Distinct tokens (bytes) of a str or UTF-8 bytes, sorted"""
+    if isinstance(text, str):
+        text = text.encode("utf-8")
+    tokens = set()
+    for run in _TOKEN_RE.findall(text):
+        run = run.lower()
+        for i in range(0, len(run), MAX_TOKEN_LEN):
+            tokens.add(run[i:i + MAX_TOKEN_LEN])
+    return sorted(tokens)
+
+
+def token_hash(token):
+    """FNV-1a 64 of token bytes"""
+    h = 0xcbf29ce484222325
+    for b in token:
+        h = ((h ^ b) * 0x100000001b3) & 0xFFFFFFFFFFFFFFFF
+    return h
+
+
+def _align8(n):
+    return (n + 7) & ~7
+
+
+def delta_path(index_path):
+    return Path(str(index_path) + ".log")
+
+
+def append_delta(index_path, glyph_id, content):
+    """
+    Record a newly persisted glyph in the index's log
+
+    One write of one line with O_APPEND, so concurrent writers do not
+    interleave. Not fsynced: the index is derived data.
+    """
+    line = json.dumps({"id": glyph_id, "tokens": [t.decode("utf-8", "surrogateescape")
+                                                  for t in tokenize(content)]},
+                      separators=(",", ":")) + "\n"
+    fd = os.open(delta_path(index_path), os.O_WRONLY | os.O_CREAT | os.O_APPEND, 0o644)
+    try:
+        os.write(fd, line.encode("utf-8", "surrogateescape"))
+    finally:
+        os.close(fd)
+
+
+def write_index(postings, out_path, ids=()):
+    """
+    Write an index file
+
+    Args:
+        postings: dict token bytes -> iterable of binary IDs
+        out_path: Index path (written to a temp file, then renamed)
+        ids: Extra binary IDs to index (glyphs without tokens)
+
+    Returns:
+        int: Number of IDs written
+    """
+    all_ids = set(ids)
+    for members in postings.values():
+        all_ids.update(members)
+    sorted_ids = sorted(all_ids)
+    rank = {gid: i for i, gid in enumerate(sorted_ids)}
+
+    entries = sorted((token_hash(t), t) for t in postings)
+    table = bytearray()
+    posting_data = bytearray()
+    strings = bytearray()
+    count = 0
+    for h, token in entries:
+        ranks = sorted({rank[gid] for gid in postings[token]})
+        table += TOKEN.pack(h, count, len(ranks), len(token), len(strings))
+        posting_data += struct.pack(f"<{len(ranks)}I", *ranks)
+        count += len(ranks)
+        strings += token
+
+    ids_offset = _align8(HEADER.size)
+    tokens_offset = _align8(ids_offset + 32 * len(sorted_ids))
+    postings_offset = _align8(tokens_offset + len(table))
+    strings_offset = _align8(postings_offset + len(posting_data))
+    file_size = _align8(strings_offset + len(strings))
+
+    out_path = Path(out_path)
+    fd, tmp = tempfile.mkstemp(dir=out_path.parent or ".", prefix=".tmp_index_")
+    try:
+        with os.fdopen(fd, "wb") as f:
+            f.write(HEADER.pack(MAGIC, VERSION, 0, len(sorted_ids), len(entries), ids_offset,
+                                tokens_offset, postings_offset, strings_offset, file_size))
+            for offset, blob in ((ids_offset, b"".join(sorted_ids)), (tokens_offset, table),
+                                 (postings_offset, posting_data), (strings_offset, strings)):
+                f.seek(offset)
+                f.write(blob)
+            f.truncate(file_size)
+            f.flush()
+            os.fsync(f.fileno())
+        os.rename(tmp, out_path)
+    except Exception:
+        try:
+            os.unlink(tmp)
+        except OSError:
+            pass
+        raise
+    return len(sorted_ids)
+
+
+def build_index(inputs, out_path, log=None):
+    """
+    Index JSON glyph files, persistence directories and snapshots (.spus)
+
+    Replaces out_path and discards its log (the build covers it).
+
+    Returns:
+        int: Number of glyphs indexed
+    """
+    postings = {}
+    ids = set()
+
+    def add(gid, content):
+        ids.add(gid)
+        for t in tokenize(content):
+            postings.setdefault(t, []).append(gid)
+
+    seen = set()
+    json_inputs = []
+    for item in inputs:
+        if str(item).endswith(".spus"):
+            with glyph_snapshot.Snapshot(item) as snap:
+                for i in range(len(snap)):
+                    gid = bytes.fromhex(snap.id(i))
+                    if gid not in seen:
+                        seen.add(gid)
+                        add(gid, snap.record(i)["content"])
+        else:
+            json_inputs.append(item)
+
+    for f in glyph_snapshot.iter_json_files(json_inputs):
+        try:
+            with open(f, "r") as fh:
+                doc = json.load(fh)
+        except (OSError, ValueError) as e:
+            if log:
+                log(f"skipping {f}: {e}")
+            continue
+        gid = glyph_snapshot.parse_id(doc.get("id")) if isinstance(doc, dict) else None
+        if gid is None:
+            if log:
+                log(f"skipping {f}: no valid glyph id")
+            continue
+        if gid in seen:
+            continue
+        seen.add(gid)
+        content = doc.get("content", "")
+        add(gid, content if isinstance(content, str) else "")
+
+    n = write_index(postings, out_path, ids)
+    try:
+        os.unlink(delta_path(out_path))
+    except FileNotFoundError:
+        pass
+    return n
+
+
+def compact(index_path):
+    """Fold the log into the index file; returns the number of IDs"""
+    with GlyphIndex(index_path) as index:
+        postings = {}
+        for i in range(index.token_count):
+            token, ranks = index._token_entry(i)
+            postings[token] = [index._ids[r] for r in ranks]
+        for token, members in index._delta_postings.items():
+            postings.setdefault(token, []).extend(members)
+        ids = set(index._delta_ids)
+        ids.update(index._ids[i] for i in range(index.count))
+    n = write_index(postings, index_path, ids)
+    try:
+        os.unlink(delta_path(index_path))
+    except FileNotFoundError:
+        pass
+    return n
+
+
+class GlyphIndex:
+    """Read-only mmap view of an index file plus its log"""
+
+    def __init__(self, path):
+        self.path = str(path)
+        with open(self.path, "rb") as f:
+            self._mm = mmap.mmap(f.fileno(), 0, access=mmap.ACCESS_READ)
+        try:
+            self._parse_header()
+        except ValueError:
+            self._mm.close()
+            raise
+        self._ids = _Column(self._mm, self._ids_offset, 32, self.count)
+        self._hashes = _Column(self._mm, self._tokens_offset, TOKEN.size, self.token_count,
+                               lambda b: struct.unpack_from("<Q", b)[0])
+        self._load_delta()
+
+    def _parse_header(self):
+        mm = self._mm
+        if len(mm) < HEADER.size:
+            raise ValueError(f"{self.path}: truncated index")
+        (magic, version, _flags, count, token_count, ids_offset, tokens_offset,
+         postings_offset, strings_offset, file_size) = HEADER.unpack_from(mm, 0)
+        if magic != MAGIC:
+            raise ValueError(f"{self.path}: not a glyph index")
+        if version != VERSION:
+            raise ValueError(f"{self.path}: unsupported index version {version}")
+        if (file_size != len(mm) or ids_offset + 32 * count > file_size or
+                tokens_offset + TOKEN.size * token_count > file_size or
+                not postings_offset <= strings_offset <= file_size):
+            raise ValueError(f"{self.path}: invalid index header")
+        self.count = count
+        self.token_count = token_count
+        self._ids_offset = ids_offset
+        self._tokens_offset = tokens_offset
+        self._postings_offset = postings_offset
+        self._strings_offset = strings_offset
+
+    def _load_delta(self):
+        self._delta_ids = []
+        self._delta_postings = {}
+        try:
+            with open(delta_path(self.path), "rb") as f:
+                lines = f.read().splitlines()
+        except FileNotFoundError:
+            return
+        seen = set()
+        for line in lines:
+            try:
+                entry = json.loads(line)
+                gid = glyph_snapshot.parse_id(entry["id"])
+            except (ValueError, KeyError, TypeError):
+                continue  # Torn last line from a crashed writer
+            if gid is None or gid in seen or self._find_base(gid) is not None:
+                continue
+            seen.add(gid)
+            bisect.insort(self._delta_ids, gid)
+            for t in entry.get("tokens", []):
+                self._delta_postings.setdefault(t.encode("utf-8", "surrogateescape"), []).append(gid)
+
+    def close(self):
+        self._mm.close()
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *exc):
+        self.close()
+
+    def __len__(self):
+        return self.count + len(self._delta_ids)
+
+    def _find_base(self, key):
+        i = bisect.bisect_left(self._ids, key)
+        return i if i < self.count and self._ids[i] == key else None
+
+    def contains(self, glyph_id):
+        key = glyph_snapshot.parse_id(glyph_id)
+        if key is None:
+            return False
+        if self._find_base(key) is not None:
+            return True
+        i = bisect.bisect_left(self._delta_ids, key)
+        return i < len(self._delta_ids) and self._delta_ids[i] == key
+
+    def prefix(self, prefix, limit=100):
+        """IDs (hex) starting with a hex prefix, ascending, at most limit"""
+        prefix = prefix[len("glyph:"):] if prefix.startswith("glyph:") else prefix
+        try:
+            lo = bytes.fromhex((prefix + "0" * 64)[:64])
+            hi = bytes.fromhex((prefix + "f" * 64)[:64])
+        except ValueError:
+            raise ValueError(f"ID prefix must be 1-64 hex digits: '{prefix}'") from None
+        if not 1 <= len(prefix) <= 64:
+            raise ValueError(f"ID prefix must be 1-64 hex digits: '{prefix}'")
+
+        out = []
+        i = bisect.bisect_left(self._ids, lo)
+        while i < self.count and len(out) < limit:
+            gid = self._ids[i]
+            if gid > hi:
+                break
+            out.append(gid)
+            i += 1
+        j = bisect.bisect_left(self._delta_ids, lo)
+        while j < len(self._delta_ids) and self._delta_ids[j] <= hi:
+            out.append(self._delta_ids[j])
+            j += 1
+        return [gid.hex() for gid in sorted(out)[:limit]]
+
+    def _token_entry(self, i, view=False):
+        """
+        (token, ranks) of token table entry i
+
+        view=True returns the ranks as a memoryview on little-endian hosts
+        (bisect on it runs in C); it must be dropped before close().
+        """
+        _, start, n, length, offset = TOKEN.unpack_from(self._mm, self._tokens_offset + TOKEN.size * i)
+        token = self._mm[self._strings_offset + offset:self._strings_offset + offset + length]
+        begin = self._postings_offset + 4 * start
+        if view and sys.byteorder == "little":
+            return token, memoryview(self._mm)[begin:begin + 4 * n].cast("I")
+        return token, _Column(self._mm, begin, 4, n, lambda b: struct.unpack_from("<I", b)[0])
+
+    def _postings(self, token):
+        h = token_hash(token)
+        i = bisect.bisect_left(self._hashes, h)
+        while i < self.token_count and self._hashes[i] == h:
+            t, ranks = self._token_entry(i, view=True)
+            if t == token:
+                return ranks
+            i += 1
+        return None
+
+    def tokens(self, query, limit=100):
+        """
+        IDs (hex) of glyphs whose content contains every token of query
+
+        Args:
+            query: str or list of str, tokenized like content
+        """
+        if isinstance(query, str):
+            query = [query]
+        tokens = sorted({t for q in query for t in tokenize(q)})
+        if not tokens:
+            return []
+
+        out = []
+        lists = []
+        for t in tokens:
+            ranks = self._postings(t)
+            if ranks is None:
+                lists = None
+                break
+            lists.append(ranks)
+        if lists:
+            # Walk the shortest list; search forward in the others
+            lists.sort(key=len)
+            others = lists[1:]
+            cursor = [0] * len(others)
+            for r in lists[0]:
+                for k, other in enumerate(others):
+                    cursor[k] = bisect.bisect_left(other, r, cursor[k])
+                    if cursor[k] == len(other) or other[cursor[k]] != r:
+                        break
+                else:
+                    out.append(self._ids[r])
+                    if len(out) >= limit:
+                        break
+
+        delta = None
+        for t in tokens:
+            members = set(self._delta_postings.get(t, ()))
+            delta = members if delta is None else delta & members
+        out.extend(delta or ())
+        return [gid.hex() for gid in sorted(out)[:limit]]
+
+
+class _Column:
+    """Sequence view of fixed-size entries in the mapping (for bisect)"""
+
+    def __init__(self, mm, offset, size, count, decode=None):
+        self._mm = mm
+        self._offset = offset
+        self._size = size
+        self._count = count
+        self._decode = decode
+
+    def __len__(self):
+        return self._count
+
+    def __getitem__(self, i):
+        if isinstance(i, slice) or not 0 <= i < self._count:
+            raise IndexError(i)
+        start = self._offset + self._size * i
+        raw = self._mm[start:start + self._size]
+        return self._decode(raw) if self._decode else raw
+
+    def __iter__(self):
+        for i in range(self._count):
+            yield self[i]
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Build or inspect glyph index files")
+    sub = parser.add_subparsers(dest="command", required=True)
+
+    build = sub.add_parser("build", help="Index JSON glyphs and snapshots")
+    build.add_argument("inputs", nargs="+",
+                       help="Persistence directories, JSON files or snapshots (.spus)")
+    build.add_argument("-o", "--out", required=True, help="Index file")
+
+    comp = sub.add_parser("compact", help="Fold the log into the index file")
+    comp.add_argument("index")
+
+    info = sub.add_parser("info", help="Print index header")
+    info.add_argument("index")
+
+    args = parser.parse_args()
+
+    if args.command == "build":
+        n = build_index(args.inputs, args.out,
+                        log=lambda msg: print(f"Warning: {msg}", file=sys.stderr))
+        print(f"Indexed {n} glyphs into {args.out}")
+        return 0
+    if args.command == "compact":
+        n = compact(args.index)
+        print(f"Compacted {args.index}: {n} glyphs")
+        return 0
+
+    with GlyphIndex(args.index) as index:
+        print(json.dumps({
+            "path": index.path,
+            "version": VERSION,
+            "glyphs": index.count,
+            "tokens": index.token_count,
+            "log_glyphs": len(index._delta_ids),
+            "file_bytes": os.path.getsize(index.path),
+        }, indent=2))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
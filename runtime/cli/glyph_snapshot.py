@@ -0,0 +1,408 @@
+#!/usr/bin/env python3
+"""
+glyph_snapshot.py - Build and read memory-mapped glyph snapshots
+
+A snapshot is one binary file holding a whole glyph set as the columns of
+the native GlyphStore (runtime/spu/glyph_store.h), sorted by ID. Readers
+mmap it and binary-search the ID column, so a restart can serve queries
+immediately and only the pages a query touches are read from disk.
+
+Layout (little-endian, version 1, see runtime/spu/snapshot.h):
+
+    header (4096 bytes)
+        magic "SPUSNAP\\0", u32 version, u32 column count, u64 glyph count,
+        u64 flags, u64 file size, then per column:
+        u32 column id, u32 element size, u64 offset, u64 bytes
+    columns, each starting on a 4096-byte boundary:
+        ids, energy, activation_count, last_update_time, parent1_ids,
+        parent2_ids, content_offset, content_len, content,
+        document_offset, document_len, documents
+
+`documents` holds each glyph's original JSON (compact), so query_glyph
+can answer from a snapshot exactly as from the JSON files.
+
+Usage:
+    glyph_snapshot.py build persistence/ spec/examples/glyph_example.json -o glyphs.spus
+    glyph_snapshot.py info glyphs.spus
+"""
+
+import argparse
+import array
+import bisect
+import json
+import mmap
+import os
+import struct
+import sys
+import tempfile
+from datetime import datetime, timezone
+from pathlib import Path
+
+MAGIC = b"SPUSNAP\0"
+VERSION = 1
+ALIGN = 4096
+HEADER_SIZE = 4096
+FLAG_SORTED = 1
+
+HEADER = struct.Struct("<8sIIQQQ")
+COLUMN = struct.Struct("<IIQQ")
+
+# (name, element size); element size 1 = variable-length byte blob
+COLUMNS = [
+    ("ids", 32),
+    ("energy", 8),
+    ("activation_count", 4),
+    ("last_update_time", 8),
+    ("parent1_ids", 32),
+    ("parent2_ids", 32),
+    ("content_offset", 8),
+    ("content_len", 4),
+    ("content", 1),
+    ("document_offset", 8),
+    ("document_len", 4),
+    ("documents", 1),
+]
+COLUMN_IDS = {name: i for i, (name, _) in enumerate(COLUMNS)}
+
+ZERO_ID = bytes(32)
+
+
+def parse_id(value):
+    """Binary ID from "<64 hex>" or "glyph:<64 hex>", or None if invalid"""
+    if not isinstance(value, str):
+        return None
+    if value.startswith("glyph:"):
+        value = value[len("glyph:"):]
+    if len(value) != 64:
+        return None
+    try:
+        return bytes.fromhex(value)
+    except ValueError:
+        return None
+
+
+def parse_timestamp(value):
+    """ISO 8601 (spec state.last_updated) to microseconds since the epoch"""
+    try:
+        ts = datetime.fromisoformat(value.replace("Z", "+00:00"))
+    except (AttributeError, ValueError):
+        return 0
+    if ts.tzinfo is None:
+        ts = ts.replace(tzinfo=timezone.utc)
+    return int(ts.timestamp() * 1_000_000)
+
+
+def glyph_fields(doc):
+    """
+    Map a persisted glyph document to the native columns
+
+    Handles create_glyph.py records ({id, content, metadata}) and
+    spec/glyph_spec_v0.yaml documents ({id: "glyph:...", state, identity}).
+
+    Returns:
+        tuple: (id, energy, activation_count, last_update_time, parent1,
+                parent2, content bytes), or None if the ID is invalid
+    """
+    glyph_id = parse_id(doc.get("id"))
+    if glyph_id is None:
+        return None
+
+    content = doc.get("content", "")
+    content = content.encode("utf-8") if isinstance(content, str) else b""
+
+    metadata = doc.get("metadata") or {}
+    state = doc.get("state") or {}
+    energy = float(metadata.get("energy", state.get("energy", 0.0)))
+    activation_count = int(metadata.get("activation_count", 1 if state.get("activated") else 0))
+    if "last_update_time" in metadata:
+        last_update_time = int(metadata["last_update_time"])
+    else:
+        last_update_time = parse_timestamp(state.get("last_updated"))
+
+    # Spec lineage is chronological and ends with the glyph itself
+    parent1 = parse_id(metadata.get("parent1_id")) or ZERO_ID
+    parent2 = parse_id(metadata.get("parent2_id")) or ZERO_ID
+    lineage = (doc.get("identity") or {}).get("lineage") or []
+    ancestors = [parse_id(x) for x in lineage if parse_id(x) not in (None, glyph_id)]
+    if parent1 == ZERO_ID and ancestors:
+        parent1 = ancestors[-1]
+        if len(ancestors) > 1:
+            parent2 = ancestors[-2]
+
+    return (glyph_id, energy, activation_count & 0xFFFFFFFF,
+            last_update_time & 0xFFFFFFFFFFFFFFFF, parent1, parent2, content)
+
+
+def iter_json_files(inputs):
+    """Yield JSON files from files and persistence directories (recursive)"""
+    for item in inputs:
+        path = Path(item)
+        if path.is_dir():
+            for f in sorted(path.rglob("*.json")):
+                if not f.name.startswith(".tmp_"):
+                    yield f
+        else:
+            yield path
+
+
+def build_snapshot(inputs, out_path, log=None):
+    """
+    Convert JSON glyph files / persistence directories into a snapshot
+
+    Args:
+        inputs: Files and directories
+        out_path: Snapshot path (written to a temp file, then renamed)
+        log: Optional callable for warnings
+
+    Returns:
+        int: Number of glyphs written
+    """
+    glyphs = {}
+    for f in iter_json_files(inputs):
+        try:
+            with open(f, "r") as fh:
+                doc = json.load(fh)
+        except (OSError, ValueError) as e:
+            if log:
+                log(f"skipping {f}: {e}")
+            continue
+        try:
+            fields = glyph_fields(doc) if isinstance(doc, dict) else None
+        except (TypeError, ValueError):
+            fields = None
+        if fields is None:
+            if log:
+                log(f"skipping {f}: no valid glyph id")
+            continue
+        glyphs[fields[0]] = (fields, json.dumps(doc, separators=(",", ":")).encode("utf-8"))
+
+    write_snapshot([glyphs[k] for k in sorted(glyphs)], out_path)
+    return len(glyphs)
+
+
+def write_snapshot(records, out_path):
+    """Write (fields, document) records, already sorted by ID"""
+    n = len(records)
+    ids = bytearray()
+    energy = array.array("d")
+    activation = array.array("I")
+    last_update = array.array("Q")
+    parent1 = bytearray()
+    parent2 = bytearray()
+    content_offset = array.array("Q")
+    content_len = array.array("I")
+    content = bytearray()
+    doc_offset = array.array("Q")
+    doc_len = array.array("I")
+    documents = bytearray()
+
+    for (gid, e, act, lut, p1, p2, body), doc in records:
+        ids += gid
+        energy.append(e)
+        activation.append(act)
+        last_update.append(lut)
+        parent1 += p1
+        parent2 += p2
+        content_offset.append(len(content))
+        content_len.append(len(body))
+        content += body
+        doc_offset.append(len(documents))
+        doc_len.append(len(doc))
+        documents += doc
+
+    if sys.byteorder != "little":
+        for col in (energy, activation, last_update, content_offset, content_len,
+                    doc_offset, doc_len):
+            col.byteswap()
+
+    data = [ids, energy.tobytes(), activation.tobytes(), last_update.tobytes(), parent1,
+            parent2, content_offset.tobytes(), content_len.tobytes(), content,
+            doc_offset.tobytes(), doc_len.tobytes(), documents]
+
+    table = []
+    offset = HEADER_SIZE
+    for (name, elem), blob in zip(COLUMNS, data):
+        table.append((COLUMN_IDS[name], elem, offset, len(blob)))
+        offset += (len(blob) + ALIGN - 1) // ALIGN * ALIGN
+    file_size = offset
+
+    header = bytearray(HEADER_SIZE)
+    HEADER.pack_into(header, 0, MAGIC, VERSION, len(COLUMNS), n, FLAG_SORTED, file_size)
+    for i, entry in enumerate(table):
+        COLUMN.pack_into(header, HEADER.size + i * COLUMN.size, *entry)
+
+    out_path = Path(out_path)
+    fd, tmp = tempfile.mkstemp(dir=out_path.parent or ".", prefix=".tmp_snapshot_")
+    try:
+        with os.fdopen(fd, "wb") as f:
+            f.write(header)
+            for (_, _, col_offset, size), blob in zip(table, data):
+                f.seek(col_offset)
+                f.write(blob)
+            f.truncate(file_size)
+            f.flush()
+            os.fsync(f.fileno())
+        os.rename(tmp, out_path)
+    except Exception:
+        try:
+            os.unlink(tmp)
+        except OSError:
+            pass
+        raise
+
+
+class Snapshot:
+    """Read-only mmap view of a snapshot (pages load on first access)"""
+
+    def __init__(self, path):
+        self.path = str(path)
+        with open(self.path, "rb") as f:
+            self._mm = mmap.mmap(f.fileno(), 0, access=mmap.ACCESS_READ)
+        try:
+            self._parse_header()
+        except ValueError:
+            self._mm.close()
+            raise
+        self._ids = _IdColumn(self._mm, self._columns["ids"][0], self.count)
+
+    def _parse_header(self):
+        mm = self._mm
+        if len(mm) < HEADER_SIZE:
+            raise ValueError(f"{self.path}: truncated snapshot")
+        magic, version, ncols, count, flags, file_size = HEADER.unpack_from(mm, 0)
+        if magic != MAGIC:
+            raise ValueError(f"{self.path}: not a glyph snapshot")
+        if version != VERSION:
+            raise ValueError(f"{self.path}: unsupported snapshot version {version}")
+        if file_size != len(mm) or not flags & FLAG_SORTED or ncols != len(COLUMNS):
+            raise ValueError(f"{self.path}: invalid snapshot header")
+
+        self.count = count
+        self._columns = {}
+        for i in range(ncols):
+            cid, elem, offset, size = COLUMN.unpack_from(mm, HEADER.size + i * COLUMN.size)
+            name, expected_elem = COLUMNS[cid] if cid < len(COLUMNS) else (None, 0)
+            if (name is None or elem != expected_elem or offset % ALIGN or
+                    offset + size > file_size or (elem > 1 and size != elem * count)):
+                raise ValueError(f"{self.path}: invalid column {i}")
+            self._columns[name] = (offset, size)
+
+    def close(self):
+        self._mm.close()
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *exc):
+        self.close()
+
+    def __len__(self):
+        return self.count
+
+    def _scalar(self, column, fmt, i):
+        return struct.unpack_from(fmt, self._mm, self._columns[column][0] + i * struct.calcsize(fmt))[0]
+
+    def find(self, glyph_id):
+        """Index of glyph_id (hex, "glyph:" prefix optional), or None"""
+        key = parse_id(glyph_id)
+        if key is None:
+            return None
+        i = bisect.bisect_left(self._ids, key)
+        if i < self.count and self._ids[i] == key:
+            return i
+        return None
+
+    def id(self, i):
+        return self._ids[i].hex()
+
+    def record(self, i):
+        """Native columns of glyph i as a dict"""
+        p1 = self._columns["parent1_ids"][0] + 32 * i
+        p2 = self._columns["parent2_ids"][0] + 32 * i
+        off = self._scalar("content_offset", "<Q", i)
+        length = self._scalar("content_len", "<I", i)
+        base = self._columns["content"][0]
+        return {
+            "id": self.id(i),
+            "energy": self._scalar("energy", "<d", i),
+            "activation_count": self._scalar("activation_count", "<I", i),
+            "last_update_time": self._scalar("last_update_time", "<Q", i),
+            "parent1_id": self._mm[p1:p1 + 32].hex(),
+            "parent2_id": self._mm[p2:p2 + 32].hex(),
+            "content": self._mm[base + off:base + off + length].decode("utf-8", "replace"),
+        }
+
+    def document(self, i):
+        """
+        Original JSON document of glyph i
+
+        Snapshots written natively (spu::write_snapshot) carry no documents;
+        those glyphs are returned in create_glyph.py form.
+        """
+        off = self._scalar("document_offset", "<Q", i)
+        length = self._scalar("document_len", "<I", i)
+        if length == 0:
+            r = self.record(i)
+            return {
+                "content": r["content"],
+                "metadata": {k: r[k] for k in ("energy", "activation_count", "last_update_time")},
+                "id": r["id"],
+            }
+        base = self._columns["documents"][0]
+        return json.loads(self._mm[base + off:base + off + length])
+
+    def get(self, glyph_id):
+        """Original JSON document for glyph_id, or None"""
+        i = self.find(glyph_id)
+        return None if i is None else self.document(i)
+
+
+class _IdColumn:
+    """Sequence view of the sorted ID column for bisect"""
+
+    def __init__(self, mm, offset, count):
+        self._mm = mm
+        self._offset = offset
+        self._count = count
+
+    def __len__(self):
+        return self._count
+
+    def __getitem__(self, i):
+        start = self._offset + 32 * i
+        return self._mm[start:start + 32]
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Build or inspect glyph snapshots")
+    sub = parser.add_subparsers(dest="command", required=True)
+
+    build = sub.add_parser("build", help="Convert JSON glyphs into a snapshot")
+    build.add_argument("inputs", nargs="+", help="Persistence directories or JSON files")
+    build.add_argument("-o", "--out", required=True, help="Snapshot file")
+
+    info = sub.add_parser("info", help="Print snapshot header")
+    info.add_argument("snapshot")
+
+    args = parser.parse_args()
+
+    if args.command == "build":
+        n = build_snapshot(args.inputs, args.out,
+                           log=lambda msg: print(f"Warning: {msg}", file=sys.stderr))
+        print(f"Wrote {n} glyphs to {args.out}")
+        return 0
+
+    with Snapshot(args.snapshot) as snap:
+        print(json.dumps({
+            "path": snap.path,
+            "version": VERSION,
+            "glyphs": snap.count,
+            "file_bytes": os.path.getsize(snap.path),
+            "columns": {name: {"offset": off, "bytes": size}
+                        for name, (off, size) in snap._columns.items()},
+        }, indent=2))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
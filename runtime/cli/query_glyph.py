@@ -1,6 +1,6 @@
 #!/usr/bin/env python3
 """
-query_glyph.py - CLI tool to query a glyph by ID
+query_glyph.py - CLI tool to query a glyph by ID, ID prefix or content token
 """
 
 import argparse
@@ -27,16 +27,118 @@ def get_persistence_path():
     return persistence_dir.resolve()
 
 
-def query_glyph(glyph_id):
+_snapshots = {}
+_indexes = {}
+
+
+def open_snapshot(path):
+    """Open (once per process) the snapshot at path"""
+    import glyph_snapshot
+    path = str(path)
+    if path not in _snapshots:
+        _snapshots[path] = glyph_snapshot.Snapshot(path)
+    return _snapshots[path]
+
+
+def open_index(path):
+    """Open (once per process) the index file at path"""
+    import glyph_index
+    path = str(path)
+    if path not in _indexes:
+        _indexes[path] = glyph_index.GlyphIndex(path)
+    return _indexes[path]
+
+
+def _iter_glyph_files(hex_prefix=""):
+    """JSON files whose ID starts with hex_prefix (narrowed by the Merkle directories)"""
+    persistence_dir = get_persistence_path()
+    if len(hex_prefix) >= 4:
+        dirs = [persistence_dir / hex_prefix[:2] / hex_prefix[2:4]]
+    elif len(hex_prefix) >= 2:
+        dirs = [persistence_dir / hex_prefix[:2]]
+    else:
+        dirs = [persistence_dir]
+    for d in dirs:
+        if d.is_dir():
+            yield from sorted(d.rglob(f"glyph_{hex_prefix}*.json"))
+
+
+def find_prefix(prefix, index=None, limit=100):
+    """
+    Glyph IDs starting with a hex prefix (e.g. the 8 digits __repr__ shows)
+
+    Args:
+        prefix: 1-64 hex digits
+        index: Optional index file (glyph_index.py); defaults to
+            $GLYPH_INDEX. Without one the persistence directory is scanned.
+        limit: Maximum IDs returned
+
+    Returns:
+        list: Matching IDs, ascending
+    """
+    import os
+    index = index or os.environ.get("GLYPH_INDEX")
+    prefix = prefix.lower()
+    if index:
+        return open_index(index).prefix(prefix, limit)
+    ids = [f.stem[len("glyph_"):] for f in _iter_glyph_files(prefix)]
+    return sorted(ids)[:limit]
+
+
+def find_tokens(tokens, index=None, limit=100):
+    """
+    Glyph IDs whose content contains every token (case-insensitive words)
+
+    Args:
+        tokens: str or list of str
+        index: Optional index file; defaults to $GLYPH_INDEX. Without one
+            every glyph file is read.
+        limit: Maximum IDs returned
+
+    Returns:
+        list: Matching IDs, ascending
+    """
+    import os
+    import glyph_index
+    index = index or os.environ.get("GLYPH_INDEX")
+    if index:
+        return open_index(index).tokens(tokens, limit)
+
+    wanted = set(glyph_index.tokenize(" ".join([tokens] if isinstance(tokens, str) else tokens)))
+    if not wanted:
+        return []
+    ids = []
+    for f in _iter_glyph_files():
+        try:
+            with open(f, "r") as fh:
+                doc = json.load(fh)
+        except (OSError, ValueError):
+            continue
+        content = doc.get("content", "") if isinstance(doc, dict) else ""
+        if isinstance(content, str) and wanted <= set(glyph_index.tokenize(content)):
+            ids.append(f.stem[len("glyph_"):])
+    return sorted(ids)[:limit]
+
+
+def query_glyph(glyph_id, snapshot=None):
     """
     Query a glyph by ID from persistence directory using Merkle-style paths
 
     Args:
         glyph_id: The SHA256 hash ID of the glyph
+        snapshot: Optional snapshot file (glyph_snapshot.py) checked first;
+            defaults to $GLYPH_SNAPSHOT
 
     Returns:
         dict: The glyph data, or None if not found
     """
+    import os
+    snapshot = snapshot or os.environ.get("GLYPH_SNAPSHOT")
+    if snapshot:
+        glyph_data = open_snapshot(snapshot).get(glyph_id)
+        if glyph_data is not None:
+            return glyph_data
+
     persistence_dir = get_persistence_path()
 
     # Merkle-style directory organization
@@ -53,14 +155,43 @@ def query_glyph(glyph_id):
 
 
 def main():
-    parser = argparse.ArgumentParser(description="Query a glyph by ID")
-    parser.add_argument("id", help="SHA256 hash ID of the glyph")
+    parser = argparse.ArgumentParser(description="Query a glyph by ID, ID prefix or content token")
+    parser.add_argument("id", nargs="?", help="SHA256 hash ID of the glyph")
     parser.add_argument("--quiet", "-q", action="store_true", help="Only output the glyph data")
+    parser.add_argument("--snapshot", help="Snapshot file to query before the JSON files "
+                        "(default: $GLYPH_SNAPSHOT)")
+    parser.add_argument("--prefix", help="List IDs starting with this hex prefix")
+    parser.add_argument("--token", action="append",
+                        help="List IDs whose content contains this word (repeat for AND)")
+    parser.add_argument("--index", help="Index file from glyph_index.py (default: $GLYPH_INDEX)")
+    parser.add_argument("--limit", type=int, default=100, help="Maximum IDs listed (default: 100)")
 
     args = parser.parse_args()
 
+    if args.prefix or args.token:
+        try:
+            if args.prefix:
+                ids = find_prefix(args.prefix, index=args.index, limit=args.limit)
+                if args.token:
+                    ids = sorted(set(ids) & set(find_tokens(args.token, index=args.index,
+                                                            limit=sys.maxsize)))
+            else:
+                ids = find_tokens(args.token, index=args.index, limit=args.limit)
+        except ValueError as e:
+            print(f"Error: {e}", file=sys.stderr)
+            sys.exit(2)
+        if not ids:
+            if not args.quiet:
+                print("Error: no matching glyphs", file=sys.stderr)
+            sys.exit(1)
+        print(json.dumps(ids, indent=2))
+        return 0
+
+    if not args.id:
+        parser.error("an ID, --prefix or --token is required")
+
     # Query glyph
-    glyph_data = query_glyph(args.id)
+    glyph_data = query_glyph(args.id, snapshot=args.snapshot)
 
     if glyph_data is None:
         if not args.quiet:
@@ -0,0 +1,308 @@
+/**
+ * SPU Cluster Merge - merge_batch() over glyphs partitioned across nodes
+ */
+
+#include "cluster_merge.h"
+#include "telemetry.h"
+#include <algorithm>
+#include <exception>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+namespace spu {
+
+namespace {
+
+// Resolve step answer for one probe
+enum ProbeAnswer : uint32_t {
+    kAnswerShip = 0,     // Probed parent follows in the glyph frames
+    kAnswerPull = 1,     // Send me your parent instead
+    kAnswerMissing = 2,  // Probed parent unknown
+};
+
+void append_one(GlyphStore& dst, const GlyphStore& src, size_t i) {
+    dst.append_columns(1, &src.id(i), &src.parent1_id(i), &src.parent2_id(i), src.energy() + i,
+                       src.activation_count() + i, src.last_update_time() + i,
+                       src.content_lens() + i, src.content(i));
+}
+
+/**
+ * One phase: send(peer) for every peer on a helper thread while recv(peer)
+ * runs here, so no pair of nodes can block each other on full send buffers
+ */
+template <typename Send, typename Recv>
+void exchange(const std::vector<uint32_t>& peers, Send send, Recv recv) {
+    if (peers.empty()) {
+        return;
+    }
+    SPU_TELEMETRY_TIMER(kHistFabricRoundNs);
+    std::exception_ptr send_error;
+    std::thread sender([&] {
+        try {
+            for (uint32_t p : peers) {
+                send(p);
+            }
+        } catch (...) {
+            send_error = std::current_exception();
+        }
+    });
+    try {
+        for (uint32_t p : peers) {
+            recv(p);
+        }
+    } catch (...) {
+        sender.join();
+        throw;
+    }
+    sender.join();
+    if (send_error) {
+        std::rethrow_exception(send_error);
+    }
+}
+
+const char* expect(FabricChannel& channel, FrameType type, FrameHeader& h) {
+    const char* body = nullptr;
+    if (!channel.recv_frame(h, body)) {
+        throw std::runtime_error("cluster: peer closed during a merge round");
+    }
+    if (h.type != type) {
+        throw std::runtime_error("cluster: unexpected frame type");
+    }
+    return body;
+}
+
+// Receive glyph frames until n glyphs have been appended to out
+void expect_glyphs(FabricChannel& channel, size_t n, GlyphStore& out) {
+    const size_t target = out.size() + n;
+    while (out.size() < target) {
+        FrameHeader h;
+        const char* body = expect(channel, kFrameGlyphs, h);
+        decode_glyph_frame(h, body, out);
+    }
+    if (out.size() != target) {
+        throw std::runtime_error("cluster: peer sent more glyphs than announced");
+    }
+}
+
+} // namespace
+
+ClusterNode::ClusterNode(uint32_t self, const Partitioner& partitioner,
+                         std::vector<FabricChannel*> peers, ThreadPool* pool)
+    : self_(self), partitioner_(partitioner), peers_(std::move(peers)), pool_(pool) {
+    bool member = false;
+    for (uint32_t node : partitioner_.node_ids()) {
+        if (node == self_) {
+            member = true;
+            continue;
+        }
+        if (node >= peers_.size() || !peers_[node]) {
+            throw std::invalid_argument("ClusterNode: no channel to node " + std::to_string(node));
+        }
+        others_.push_back(node);
+    }
+    if (!member) {
+        throw std::invalid_argument("ClusterNode: self is not in the partitioner");
+    }
+    std::sort(others_.begin(), others_.end());
+}
+
+uint32_t ClusterNode::find(const GlyphId& id) const {
+    auto it = index_.find(id);
+    return it == index_.end() ? npos : it->second;
+}
+
+bool ClusterNode::add(const GlyphStore& src, size_t i) {
+    auto ins = index_.emplace(src.id(i), static_cast<uint32_t>(store_.size()));
+    if (!ins.second) {
+        return false;
+    }
+    append_one(store_, src, i);
+    return true;
+}
+
+bool ClusterNode::insert(const Glyph& g) {
+    if (partitioner_.owner(g.id) != self_) {
+        throw std::invalid_argument("ClusterNode: glyph belongs to another node");
+    }
+    auto ins = index_.emplace(g.id, static_cast<uint32_t>(store_.size()));
+    if (!ins.second) {
+        return false;
+    }
+    store_.append(g);
+    return true;
+}
+
+ClusterMergeStats ClusterNode::merge_round(const GlyphIdPair* requests, size_t n,
+                                           GlyphStore* results) {
+    ClusterMergeStats stats{};
+    stats.requests = n;
+    const size_t slots = peers_.size() > self_ ? peers_.size() : self_ + 1;
+
+    // 1. Route: to the owner of the first parent
+    std::vector<std::vector<GlyphIdPair>> routed(slots);
+    std::vector<GlyphIdPair> work;
+    for (size_t i = 0; i < n; i++) {
+        uint32_t owner = partitioner_.owner(requests[i].first);
+        (owner == self_ ? work : routed[owner]).push_back(requests[i]);
+    }
+    exchange(others_,
+             [&](uint32_t p) { peers_[p]->send_records(kFrameIdPairs, routed[p].data(), routed[p].size()); },
+             [&](uint32_t p) {
+                 FrameHeader h;
+                 const GlyphIdPair* r = reinterpret_cast<const GlyphIdPair*>(expect(*peers_[p], kFrameIdPairs, h));
+                 work.insert(work.end(), r, r + h.count);
+             });
+
+    // 2. Probe: ask the second parent's owner, naming our parent's size
+    std::vector<MergePair> local_pairs;  // Into store_
+    std::vector<std::vector<MergeProbe>> probes(slots);
+    std::vector<std::vector<uint32_t>> probe_parent(slots);  // Our first parent per probe
+    for (const GlyphIdPair& w : work) {
+        uint32_t p = find(w.first);
+        if (p == npos) {
+            stats.missing++;
+            continue;
+        }
+        uint32_t owner = partitioner_.owner(w.second);
+        if (owner == self_) {
+            uint32_t q = find(w.second);
+            if (q == npos) {
+                stats.missing++;
+            } else {
+                local_pairs.push_back(MergePair{p, q});
+            }
+            continue;
+        }
+        probes[owner].push_back(MergeProbe{w.second, w.first, store_.content_len(p), 0});
+        probe_parent[owner].push_back(p);
+    }
+    std::vector<std::vector<MergeProbe>> asked(slots);
+    exchange(others_,
+             [&](uint32_t p) { peers_[p]->send_records(kFrameProbes, probes[p].data(), probes[p].size()); },
+             [&](uint32_t p) {
+                 FrameHeader h;
+                 const MergeProbe* r = reinterpret_cast<const MergeProbe*>(expect(*peers_[p], kFrameProbes, h));
+                 asked[p].assign(r, r + h.count);
+             });
+
+    // 3. Resolve: the smaller parent moves (ties ship the probed one)
+    std::vector<std::vector<uint32_t>> answers(slots);
+    std::vector<GlyphStore> outbox(slots);
+    std::vector<std::vector<uint32_t>> pulled_partner(slots);  // Our second parent per pull
+    for (uint32_t x : others_) {
+        for (const MergeProbe& probe : asked[x]) {
+            uint32_t q = find(probe.remote);
+            if (q == npos) {
+                answers[x].push_back(kAnswerMissing);
+            } else if (store_.content_len(q) <= probe.local_len) {
+                answers[x].push_back(kAnswerShip);
+                append_one(outbox[x], store_, q);
+                stats.shipped++;
+                stats.shipped_bytes += store_.content_len(q);
+            } else {
+                answers[x].push_back(kAnswerPull);
+                pulled_partner[x].push_back(q);
+            }
+        }
+    }
+
+    GlyphStore staging;  // Both parents of every pair merged with a visitor
+    std::vector<MergePair> staged_pairs;
+    std::vector<std::vector<uint32_t>> pull_requests(slots);  // Our parents the peer asked for
+    exchange(others_,
+             [&](uint32_t p) {
+                 peers_[p]->send_records(kFrameIndices, answers[p].data(), answers[p].size());
+                 peers_[p]->send_batch(outbox[p], 0, outbox[p].size());
+             },
+             [&](uint32_t p) {
+                 FrameHeader h;
+                 const uint32_t* a = reinterpret_cast<const uint32_t*>(expect(*peers_[p], kFrameIndices, h));
+                 if (h.count != probes[p].size()) {
+                     throw std::runtime_error("cluster: answer count does not match probes");
+                 }
+                 std::vector<uint32_t> answer(a, a + h.count);
+                 const size_t ships = static_cast<size_t>(std::count(answer.begin(), answer.end(), uint32_t(kAnswerShip)));
+                 uint32_t visitor = static_cast<uint32_t>(staging.size());
+                 expect_glyphs(*peers_[p], ships, staging);
+                 for (size_t i = 0; i < answer.size(); i++) {
+                     if (answer[i] == kAnswerShip) {
+                         uint32_t first = static_cast<uint32_t>(staging.size());
+                         append_one(staging, store_, probe_parent[p][i]);
+                         staged_pairs.push_back(MergePair{first, visitor++});
+                     } else if (answer[i] == kAnswerPull) {
+                         pull_requests[p].push_back(probe_parent[p][i]);
+                     } else {
+                         stats.missing++;
+                     }
+                 }
+             });
+
+    // 4. Pull: ship the first parents asked for; merge them with ours
+    std::vector<GlyphStore> pullbox(slots);
+    for (uint32_t x : others_) {
+        for (uint32_t i : pull_requests[x]) {
+            append_one(pullbox[x], store_, i);
+            stats.shipped++;
+            stats.shipped_bytes += store_.content_len(i);
+        }
+    }
+    exchange(others_,
+             [&](uint32_t p) { peers_[p]->send_batch(pullbox[p], 0, pullbox[p].size()); },
+             [&](uint32_t p) {
+                 uint32_t visitor = static_cast<uint32_t>(staging.size());
+                 expect_glyphs(*peers_[p], pulled_partner[p].size(), staging);
+                 for (uint32_t q : pulled_partner[p]) {
+                     uint32_t second = static_cast<uint32_t>(staging.size());
+                     append_one(staging, store_, q);
+                     staged_pairs.push_back(MergePair{visitor++, second});
+                 }
+             });
+
+    // 5. Merge what we hold, then place each result on its owner
+    GlyphStore merged;
+    merge_batch(store_, local_pairs.data(), local_pairs.size(), merged, pool_);
+    merge_batch(staging, staged_pairs.data(), staged_pairs.size(), merged, pool_);
+    stats.local = local_pairs.size();
+    stats.remote = staged_pairs.size();
+
+    std::vector<GlyphStore> placebox(slots);
+    auto keep = [&](const GlyphStore& src, size_t i) {
+        if (add(src, i)) {
+            stats.placed++;
+            if (results) {
+                append_one(*results, src, i);
+            }
+        }
+    };
+    for (size_t i = 0; i < merged.size(); i++) {
+        uint32_t owner = partitioner_.owner(merged.id(i));
+        if (owner == self_) {
+            keep(merged, i);
+        } else {
+            append_one(placebox[owner], merged, i);
+        }
+    }
+    GlyphStore arrived;
+    exchange(others_,
+             [&](uint32_t p) {
+                 uint32_t count = static_cast<uint32_t>(placebox[p].size());
+                 peers_[p]->send_records(kFrameIndices, &count, 1);
+                 peers_[p]->send_batch(placebox[p], 0, placebox[p].size());
+             },
+             [&](uint32_t p) {
+                 FrameHeader h;
+                 const uint32_t* count = reinterpret_cast<const uint32_t*>(expect(*peers_[p], kFrameIndices, h));
+                 if (h.count != 1) {
+                     throw std::runtime_error("cluster: malformed placement count");
+                 }
+                 arrived.clear();
+                 expect_glyphs(*peers_[p], *count, arrived);
+                 for (size_t i = 0; i < arrived.size(); i++) {
+                     keep(arrived, i);
+                 }
+             });
+    return stats;
+}
+
+} // namespace spu
@@ -0,0 +1,103 @@
+/**
+ * SPU Cluster Merge - merge_batch() over glyphs partitioned across nodes
+ *
+ * Every node owns the glyphs the Partitioner maps to it and keeps them in
+ * its own GlyphStore. Merges are named by parent IDs and run in collective
+ * rounds: every node calls merge_round() with the requests it originated
+ * (possibly none), and each phase sends exactly one batch per peer, so
+ * traffic is one frame per destination per phase, not one per glyph, and
+ * all destinations are sent to while replies are received.
+ *
+ *   1. route    requests go to the owner of the first parent
+ *   2. probe    that node asks the owner of the second parent to merge
+ *               the pair, naming its parent's content size
+ *   3. resolve  the smaller parent moves to the owner of the larger:
+ *               the probed node ships its parent back, or asks for the
+ *               first one
+ *   4. pull     first parents asked for in step 3 are shipped
+ *   5. place    each node merges the pairs it holds both parents of
+ *               (merge_batch(), pool-parallel) and sends every result to
+ *               the owner of its ID
+ *
+ * Pairs whose parents share an owner skip steps 2-4. Results are the same
+ * glyphs merge() would produce on one node, and each lands on exactly one
+ * node. A round is collective: a node that does not call merge_round()
+ * stalls the others.
+ */
+
+#ifndef SPU_CLUSTER_MERGE_H
+#define SPU_CLUSTER_MERGE_H
+
+#include "fabric.h"
+#include "partitioner.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace spu {
+
+struct ClusterMergeStats {
+    uint64_t requests;       // Pairs submitted on this node
+    uint64_t local;          // Pairs this node merged without moving a parent
+    uint64_t remote;         // Pairs this node merged with a parent from a peer
+    uint64_t shipped;        // Parents this node sent to a peer
+    uint64_t shipped_bytes;  // Their content bytes
+    uint64_t placed;         // Results this node now owns (new glyphs)
+    uint64_t missing;        // Requests naming a parent its owner does not have
+};
+
+class ClusterNode {
+public:
+    static constexpr uint32_t npos = 0xffffffffu;
+
+    /**
+     * @param self This node's ID in partitioner
+     * @param partitioner Shared ring (identical on every node)
+     * @param peers Channel to each node, indexed by node ID (nullptr for self)
+     * @param pool Threads for the local merge_batch() (nullptr = calling thread)
+     * @throws std::invalid_argument if a node of the ring has no channel
+     */
+    ClusterNode(uint32_t self, const Partitioner& partitioner, std::vector<FabricChannel*> peers,
+                ThreadPool* pool = nullptr);
+
+    uint32_t self() const { return self_; }
+    const GlyphStore& store() const { return store_; }
+
+    /**
+     * Add a glyph this node owns
+     *
+     * @return false if the ID is already present
+     * @throws std::invalid_argument if the partitioner maps it to another node
+     */
+    bool insert(const Glyph& g);
+
+    // Store index of id, or npos
+    uint32_t find(const GlyphId& id) const;
+
+    /**
+     * Run one collective merge round
+     *
+     * @param requests Merges to run, by parent IDs (from any node's glyphs)
+     * @param results Receives copies of the results this node now owns
+     * @throws std::runtime_error if a peer closes or sends an unexpected frame
+     */
+    ClusterMergeStats merge_round(const GlyphIdPair* requests, size_t n, GlyphStore* results = nullptr);
+
+private:
+    bool add(const GlyphStore& src, size_t i);
+
+    uint32_t self_;
+    const Partitioner& partitioner_;
+    std::vector<FabricChannel*> peers_;
+    std::vector<uint32_t> others_;  // Peer node IDs, ascending
+    ThreadPool* pool_;
+
+    GlyphStore store_;
+    std::unordered_map<GlyphId, uint32_t, GlyphIdHash> index_;
+};
+
+} // namespace spu
+
+#endif // SPU_CLUSTER_MERGE_H
@@ -0,0 +1,121 @@
+/**
+ * SPU Fabric Channel - Batched glyph and merge traffic over a Transport
+ */
+
+#include "fabric.h"
+#include "telemetry.h"
+#include <stdexcept>
+
+namespace spu {
+
+FabricChannel::FabricChannel(std::unique_ptr<Transport> transport, const ChannelOptions& options)
+    : transport_(std::move(transport)), options_(options) {
+    if (!transport_) {
+        throw std::invalid_argument("FabricChannel needs a transport");
+    }
+}
+
+FabricChannel::~FabricChannel() {
+    try {
+        flush();
+    } catch (...) {
+    }
+}
+
+void FabricChannel::send_frame(FrameType type, uint32_t count, const iovec* body, size_t n) {
+    FrameHeader h{};
+    h.magic = kFrameMagic;
+    h.type = type;
+    h.count = count;
+    size_t length = 0;
+    for (size_t i = 0; i < n; i++) {
+        length += body[i].iov_len;
+    }
+    if (length > kMaxFrameBody) {
+        throw std::length_error("fabric: frame body too large");
+    }
+    h.length = static_cast<uint32_t>(length);
+    h.seq = ++seq_;
+    transport_->send(h, body, n);
+    SPU_TELEMETRY_ADD(kCountFabricSentBytes, sizeof(FrameHeader) + length);
+}
+
+void FabricChannel::send(const Glyph& g) {
+    pending_.append(g);
+    pending_bytes_ += kFrameGlyphFixedBytes + g.content.size();
+    if (pending_bytes_ >= options_.batch_bytes) {
+        flush();
+    }
+}
+
+void FabricChannel::flush() {
+    if (pending_.empty()) {
+        return;
+    }
+    iovec iov[kGlyphFrameIovecs];
+    size_t n = encode_glyph_frame(pending_, 0, pending_.size(), iov, scratch_);
+    send_frame(kFrameGlyphs, static_cast<uint32_t>(pending_.size()), iov, n);
+    pending_.clear();
+    pending_bytes_ = 0;
+}
+
+void FabricChannel::send_batch(const GlyphStore& store, size_t begin, size_t end) {
+    flush();
+    iovec iov[kGlyphFrameIovecs];
+    while (begin < end) {
+        // Leave room for the header: max_frame_bytes bounds the whole frame
+        size_t stop = begin;
+        size_t bytes = sizeof(FrameHeader);
+        do {
+            bytes += kFrameGlyphFixedBytes + store.content_len(stop);
+            stop++;
+        } while (stop < end &&
+                 bytes + kFrameGlyphFixedBytes + store.content_len(stop) <= options_.max_frame_bytes);
+        size_t n = encode_glyph_frame(store, begin, stop, iov, scratch_);
+        send_frame(kFrameGlyphs, static_cast<uint32_t>(stop - begin), iov, n);
+        begin = stop;
+    }
+}
+
+void FabricChannel::send_pairs(const MergePair* pairs, size_t n) {
+    send_records(kFrameMergePairs, pairs, n);
+}
+
+void FabricChannel::send_records(FrameType type, const void* records, size_t count) {
+    const size_t record = frame_record_bytes(type);
+    if (record == 0) {
+        throw std::invalid_argument("fabric: not a record frame type");
+    }
+    flush();
+    iovec iov;
+    iov.iov_base = const_cast<void*>(records);
+    iov.iov_len = count * record;
+    send_frame(type, static_cast<uint32_t>(count), &iov, 1);
+}
+
+int FabricChannel::recv(GlyphStore& glyphs, std::vector<MergePair>& pairs) {
+    FrameHeader h;
+    if (!transport_->recv(h, body_)) {
+        return 0;
+    }
+    SPU_TELEMETRY_ADD(kCountFabricReceivedBytes, sizeof(FrameHeader) + h.length);
+    if (h.type == kFrameGlyphs) {
+        decode_glyph_frame(h, body_.data(), glyphs);
+    } else if (h.type == kFrameMergePairs) {
+        decode_pair_frame(h, body_.data(), pairs);
+    } else {
+        throw std::runtime_error("fabric: unexpected record frame");
+    }
+    return h.type;
+}
+
+bool FabricChannel::recv_frame(FrameHeader& header, const char*& body) {
+    if (!transport_->recv(header, body_)) {
+        return false;
+    }
+    SPU_TELEMETRY_ADD(kCountFabricReceivedBytes, sizeof(FrameHeader) + header.length);
+    body = body_.data();
+    return true;
+}
+
+} // namespace spu
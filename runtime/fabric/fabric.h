@@ -0,0 +1,103 @@
+/**
+ * SPU Fabric Channel - Batched glyph and merge traffic over a Transport
+ *
+ * send() buffers single glyphs in a GlyphStore and ships them as one
+ * glyph frame once batch_bytes have accumulated or flush() is called, so a
+ * tick's worth of small messages costs one frame. send_batch() ships a
+ * store range straight from its columns (split into frames of at most
+ * max_frame_bytes), and send_pairs() ships merge requests for the peer's
+ * store. Frames are delivered in order. One thread may send while another
+ * receives; two senders (or two receivers) need a lock.
+ *
+ *   spu::TcpListener listener(7400);
+ *   spu::FabricChannel rx(listener.accept());                 // node B
+ *   spu::FabricChannel tx(spu::tcp_connect("node-b", 7400));  // node A
+ *
+ *   tx.send_batch(store, 0, store.size());                    // A
+ *   rx.recv(glyphs, pairs);                                   // B
+ */
+
+#ifndef SPU_FABRIC_H
+#define SPU_FABRIC_H
+
+#include "transport.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace spu {
+
+struct ChannelOptions {
+    size_t batch_bytes = 64 * 1024;      // Buffered send() glyphs are flushed at this body size
+    size_t max_frame_bytes = 1u << 20;   // Larger send_batch() ranges are split (fits RDMA slots)
+};
+
+class FabricChannel {
+public:
+    explicit FabricChannel(std::unique_ptr<Transport> transport,
+                           const ChannelOptions& options = ChannelOptions());
+
+    // Flushes buffered glyphs; a send error here is dropped
+    ~FabricChannel();
+
+    FabricChannel(const FabricChannel&) = delete;
+    FabricChannel& operator=(const FabricChannel&) = delete;
+
+    // Buffer one glyph (sent by flush() or once batch_bytes are buffered)
+    void send(const Glyph& g);
+
+    /**
+     * Send store[begin, end) without copying it into a buffer
+     *
+     * Buffered glyphs are flushed first, so order is kept.
+     */
+    void send_batch(const GlyphStore& store, size_t begin, size_t end);
+
+    // Send merge requests (indices into the receiver's store) as one frame
+    void send_pairs(const MergePair* pairs, size_t n);
+
+    // Send count fixed-size records of a record frame type as one frame
+    void send_records(FrameType type, const void* records, size_t count);
+
+    // Send buffered glyphs now
+    void flush();
+
+    /**
+     * Receive the next frame
+     *
+     * @param glyphs Receives the glyphs of a glyph frame (appended)
+     * @param pairs Receives the pairs of a merge-pair frame (appended)
+     * @return The frame's FrameType, or 0 once the peer has closed
+     * @throws std::runtime_error on other record frames (use recv_frame())
+     */
+    int recv(GlyphStore& glyphs, std::vector<MergePair>& pairs);
+
+    /**
+     * Receive the next frame without decoding it
+     *
+     * @param body Set to the body bytes (8-byte aligned, valid until the next receive)
+     * @return false once the peer has closed
+     */
+    bool recv_frame(FrameHeader& header, const char*& body);
+
+    size_t buffered() const { return pending_.size(); }
+    Transport& transport() { return *transport_; }
+
+private:
+    void send_frame(FrameType type, uint32_t count, const iovec* body, size_t n);
+
+    std::unique_ptr<Transport> transport_;
+    ChannelOptions options_;
+    uint64_t seq_ = 0;
+
+    GlyphStore pending_;
+    size_t pending_bytes_ = 0;
+    std::vector<char> scratch_;
+    std::vector<char> body_;
+};
+
+} // namespace spu
+
+#endif // SPU_FABRIC_H
@@ -0,0 +1,388 @@
+/**
+ * SPU Fabric Tool - Transport latency and throughput benchmark
+ *
+ * Build (from runtime/fabric):
+ *   g++ -O3 -std=c++17 -pthread -I. -I../spu fabric_tool.cpp fabric.cpp frame.cpp \
+ *       partitioner.cpp cluster_merge.cpp tcp_transport.cpp shm_transport.cpp \
+ *       rdma_transport.cpp ../spu/glyph_store.cpp ../spu/merge_ref.cpp ../spu/content.cpp \
+ *       ../spu/hash.cpp ../spu/sha256_x86.cpp ../spu/thread_pool.cpp ../spu/perf_counters.cpp \
+ *       ../spu/telemetry.cpp -lrt -o fabric_tool
+ *   (add -DSPU_WITH_IBVERBS ... -libverbs for --transport rdma)
+ *
+ * Usage:
+ *   ./fabric_tool pingpong --transport tcp --batch 1 --count 100000
+ *   ./fabric_tool stream --transport shm --batch 4096 --count 2000
+ *   ./fabric_tool cluster --nodes 4 --batch 4096 --count 20
+ *
+ * Both commands fork a peer process and connect to it over the chosen
+ * transport (tcp: loopback socket; shm: shared memory ring; rdma: queue
+ * pair bootstrapped over a loopback socket). pingpong sends a batch of
+ * glyphs and waits for the peer to echo it, and prints round-trip
+ * percentiles in the format of benchmarks/fabric_loopback.json; stream
+ * sends count batches one way and prints glyphs and bytes per second.
+ *
+ * cluster runs nodes ClusterNodes in one process, one thread each, over
+ * socket pairs. Each node starts with batch glyphs and submits batch
+ * random merges per round for count rounds; it prints merges per second
+ * and the parent bytes shipped per merge.
+ *
+ * --metrics FILE writes this process's telemetry (fabric bytes, cluster
+ * phase round trips, merge_batch latency) in OpenMetrics text format.
+ */
+
+#include "cluster_merge.h"
+#include "fabric.h"
+#include "rdma_transport.h"
+#include "shm_transport.h"
+#include "tcp_transport.h"
+#include "telemetry.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace {
+
+struct Args {
+    std::string command;
+    std::string transport = "tcp";
+    size_t batch = 1;
+    size_t count = 100000;
+    size_t content = 32;  // Content bytes per glyph
+    size_t nodes = 4;     // cluster only
+    std::string metrics;  // OpenMetrics output file ("" = none)
+};
+
+void usage() {
+    fprintf(stderr,
+            "usage: fabric_tool pingpong|stream [--transport tcp|shm|rdma] [--batch B]\n"
+            "                   [--count N] [--content BYTES] [--metrics FILE]\n"
+            "       fabric_tool cluster [--nodes N] [--batch B] [--count ROUNDS] [--content BYTES]\n"
+            "                   [--metrics FILE]\n");
+    exit(2);
+}
+
+Args parse_args(int argc, char** argv) {
+    if (argc < 2) {
+        usage();
+    }
+    Args a;
+    a.command = argv[1];
+    for (int i = 2; i < argc; i++) {
+        std::string flag = argv[i];
+        if (i + 1 >= argc) {
+            usage();
+        }
+        const char* v = argv[++i];
+        if (flag == "--transport") a.transport = v;
+        else if (flag == "--batch") a.batch = std::max<size_t>(1, strtoull(v, nullptr, 10));
+        else if (flag == "--count") a.count = std::max<size_t>(1, strtoull(v, nullptr, 10));
+        else if (flag == "--content") a.content = strtoull(v, nullptr, 10);
+        else if (flag == "--nodes") a.nodes = std::max<size_t>(1, strtoull(v, nullptr, 10));
+        else if (flag == "--metrics") a.metrics = v;
+        else usage();
+    }
+    if (a.transport != "tcp" && a.transport != "shm" && a.transport != "rdma") {
+        usage();
+    }
+    return a;
+}
+
+double now_s() {
+    return std::chrono::duration<double>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+spu::GlyphStore make_batch(const Args& a) {
+    spu::GlyphStore store;
+    spu::ContentArena arena;
+    for (size_t i = 0; i < a.batch; i++) {
+        std::string content = "fabric glyph " + std::to_string(i);
+        content.resize(std::max(a.content, content.size()), 'x');
+        spu::Glyph g;
+        g.content.assign(content.data(), content.size(), arena);
+        spu::content_hash(content.data(), content.size(), g.id);
+        g.energy = 1.0 + static_cast<double>(i);
+        g.activation_count = static_cast<uint32_t>(i);
+        g.last_update_time = i;
+        store.append(g);
+    }
+    return store;
+}
+
+// Rendezvous for the two ends of the connection
+struct Endpoints {
+    std::unique_ptr<spu::TcpListener> listener;
+    std::string shm_name;
+};
+
+// server: the forked peer
+std::unique_ptr<spu::Transport> make_transport(const Args& a, Endpoints& ep, bool server) {
+    if (a.transport == "shm") {
+        if (server) {
+            return spu::ShmTransport::open(ep.shm_name);
+        }
+        return std::unique_ptr<spu::Transport>(spu::ShmTransport::create(ep.shm_name).release());
+    }
+    std::unique_ptr<spu::TcpTransport> tcp =
+        server ? spu::tcp_connect("127.0.0.1", ep.listener->port()) : ep.listener->accept();
+    if (a.transport == "rdma") {
+        return spu::rdma_connect(tcp->fd());  // The socket only carries the handshake
+    }
+    return std::unique_ptr<spu::Transport>(tcp.release());
+}
+
+// Peer process: echo (pingpong) or drain (stream) until the channel closes
+int run_peer(const Args& a, Endpoints& ep) {
+    spu::FabricChannel channel(make_transport(a, ep, true));
+    spu::GlyphStore glyphs;
+    std::vector<spu::MergePair> pairs;
+    while (channel.recv(glyphs, pairs) != 0) {
+        if (a.command == "pingpong") {
+            channel.send_batch(glyphs, 0, glyphs.size());
+        }
+        glyphs.clear();
+    }
+    return 0;
+}
+
+int run(const Args& a) {
+    Endpoints ep;
+    if (a.transport == "shm") {
+        ep.shm_name = "/spu-fabric-tool-" + std::to_string(getpid());
+    } else {
+        ep.listener.reset(new spu::TcpListener(0, "127.0.0.1"));
+    }
+    // shm: the creator must exist before the peer opens it
+    std::unique_ptr<spu::Transport> shm_side;
+    if (a.transport == "shm") {
+        shm_side = make_transport(a, ep, false);
+    }
+
+    pid_t pid = fork();
+    if (pid < 0) {
+        throw std::runtime_error("fork failed");
+    }
+    if (pid == 0) {
+        int rc = 1;
+        try {
+            shm_side.release();  // Parent's mapping; not ours to close
+            rc = run_peer(a, ep);
+        } catch (const std::exception& e) {
+            fprintf(stderr, "fabric_tool peer: %s\n", e.what());
+        }
+        _exit(rc);
+    }
+
+    std::unique_ptr<spu::FabricChannel> channel(
+        new spu::FabricChannel(shm_side ? std::move(shm_side) : make_transport(a, ep, false)));
+    spu::GlyphStore batch = make_batch(a);
+    spu::GlyphStore echo;
+    std::vector<spu::MergePair> pairs;
+    std::vector<double> rtt_us;
+    rtt_us.reserve(a.count);
+
+    const size_t warmup = std::min<size_t>(a.count / 10, 1000);
+    double t0 = now_s();
+    for (size_t i = 0; i < warmup + a.count; i++) {
+        if (i == warmup) {
+            t0 = now_s();
+        }
+        double start = now_s();
+        channel->send_batch(batch, 0, batch.size());
+        if (a.command == "pingpong") {
+            echo.clear();
+            while (echo.size() < batch.size()) {
+                if (channel->recv(echo, pairs) == 0) {
+                    throw std::runtime_error("peer closed");
+                }
+            }
+            if (i >= warmup) {
+                rtt_us.push_back((now_s() - start) * 1e6);
+            }
+        }
+    }
+    double seconds = now_s() - t0;
+    spu::Transport::Stats s = channel->transport().stats();
+    const char* name = channel->transport().name();
+    channel.reset();  // Closes the connection; the peer exits
+    int status = 0;
+    waitpid(pid, &status, 0);
+
+    if (a.command == "stream") {
+        double glyphs = static_cast<double>(a.count * a.batch);
+        double bytes = static_cast<double>(a.count) *
+                       (sizeof(spu::FrameHeader) + spu::glyph_frame_body(batch, 0, batch.size()));
+        printf("{\n");
+        printf("  \"transport\": \"%s\",\n", name);
+        printf("  \"batch\": %zu,\n", a.batch);
+        printf("  \"content_bytes\": %zu,\n", a.content);
+        printf("  \"glyphs_per_sec\": %.0f,\n", glyphs / seconds);
+        printf("  \"mb_per_sec\": %.1f,\n", bytes / seconds / 1e6);
+        printf("  \"send_syscalls_per_frame\": %.2f\n",
+               static_cast<double>(s.send_syscalls) / static_cast<double>(s.frames_sent));
+        printf("}\n");
+        return WIFEXITED(status) ? WEXITSTATUS(status) : 1;
+    }
+
+    std::sort(rtt_us.begin(), rtt_us.end());
+    auto pct = [&](double p) {
+        return rtt_us[std::min(rtt_us.size() - 1, static_cast<size_t>(p * rtt_us.size()))];
+    };
+    double mean = 0;
+    for (double v : rtt_us) {
+        mean += v;
+    }
+    mean /= static_cast<double>(rtt_us.size());
+    printf("{\n");
+    printf("  \"p50_ms\": %.4f,\n", pct(0.50) / 1e3);
+    printf("  \"p95_ms\": %.4f,\n", pct(0.95) / 1e3);
+    printf("  \"p99_ms\": %.4f,\n", pct(0.99) / 1e3);
+    printf("  \"avg_ms\": %.4f,\n", mean / 1e3);
+    printf("  \"transport\": \"%s\",\n", name);
+    printf("  \"rdma_available\": %s,\n", spu::rdma_available() ? "true" : "false");
+    printf("  \"batch\": %zu,\n", a.batch);
+    printf("  \"us_per_glyph_round_trip\": %.4f,\n", mean / static_cast<double>(a.batch));
+    printf("  \"notes\": \"Round trip: send_batch + echo over a forked peer\"\n");
+    printf("}\n");
+    return WIFEXITED(status) ? WEXITSTATUS(status) : 1;
+}
+
+int run_cluster(const Args& a) {
+    const uint32_t nodes = static_cast<uint32_t>(a.nodes);
+    spu::Partitioner partitioner;
+    for (uint32_t n = 0; n < nodes; n++) {
+        partitioner.add_node(n);
+    }
+
+    // links[a][b]: node a's end of the a-b socket pair
+    std::vector<std::vector<std::unique_ptr<spu::FabricChannel>>> links(nodes);
+    for (auto& row : links) {
+        row.resize(nodes);
+    }
+    for (uint32_t x = 0; x < nodes; x++) {
+        for (uint32_t y = x + 1; y < nodes; y++) {
+            int sv[2];
+            if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) != 0) {
+                throw std::runtime_error("socketpair failed");
+            }
+            links[x][y].reset(new spu::FabricChannel(std::unique_ptr<spu::Transport>(new spu::TcpTransport(sv[0]))));
+            links[y][x].reset(new spu::FabricChannel(std::unique_ptr<spu::Transport>(new spu::TcpTransport(sv[1]))));
+        }
+    }
+    std::vector<std::unique_ptr<spu::ClusterNode>> cluster;
+    for (uint32_t x = 0; x < nodes; x++) {
+        std::vector<spu::FabricChannel*> peers(nodes);
+        for (uint32_t y = 0; y < nodes; y++) {
+            peers[y] = links[x][y].get();
+        }
+        cluster.emplace_back(new spu::ClusterNode(x, partitioner, peers));
+    }
+
+    // Every node gets batch glyphs on average; IDs are spread by the ring
+    Args seed = a;
+    seed.batch = a.batch * nodes;
+    spu::GlyphStore all = make_batch(seed);
+    spu::ContentArena arena;
+    for (size_t i = 0; i < all.size(); i++) {
+        spu::Glyph g;
+        all.load(i, g, arena);
+        cluster[partitioner.owner(g.id)]->insert(g);
+    }
+
+    std::mt19937_64 rng(42);
+    std::vector<std::vector<std::vector<spu::GlyphIdPair>>> requests(a.count);
+    for (auto& round : requests) {
+        round.resize(nodes);
+        for (auto& mine : round) {
+            for (size_t i = 0; i < a.batch; i++) {
+                mine.push_back(spu::GlyphIdPair{all.id(rng() % all.size()), all.id(rng() % all.size())});
+            }
+        }
+    }
+
+    std::vector<spu::ClusterMergeStats> total(nodes, spu::ClusterMergeStats{});
+    double t0 = now_s();
+    std::vector<std::thread> threads;
+    std::vector<std::string> errors(nodes);
+    for (uint32_t x = 0; x < nodes; x++) {
+        threads.emplace_back([&, x] {
+            try {
+                for (size_t r = 0; r < a.count; r++) {
+                    spu::ClusterMergeStats s =
+                        cluster[x]->merge_round(requests[r][x].data(), requests[r][x].size());
+                    total[x].local += s.local;
+                    total[x].remote += s.remote;
+                    total[x].shipped += s.shipped;
+                    total[x].shipped_bytes += s.shipped_bytes;
+                }
+            } catch (const std::exception& e) {
+                errors[x] = e.what();
+            }
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    double seconds = now_s() - t0;
+    for (const std::string& e : errors) {
+        if (!e.empty()) {
+            throw std::runtime_error(e);
+        }
+    }
+
+    spu::ClusterMergeStats sum{};
+    for (const spu::ClusterMergeStats& s : total) {
+        sum.local += s.local;
+        sum.remote += s.remote;
+        sum.shipped += s.shipped;
+        sum.shipped_bytes += s.shipped_bytes;
+    }
+    const double merges = static_cast<double>(sum.local + sum.remote);
+    printf("{\n");
+    printf("  \"nodes\": %u,\n", nodes);
+    printf("  \"merges_per_round\": %zu,\n", a.batch * nodes);
+    printf("  \"content_bytes\": %zu,\n", a.content);
+    printf("  \"merges_per_sec\": %.0f,\n", merges / seconds);
+    printf("  \"remote_fraction\": %.3f,\n", static_cast<double>(sum.remote) / merges);
+    printf("  \"shipped_bytes_per_merge\": %.1f,\n", static_cast<double>(sum.shipped_bytes) / merges);
+    printf("  \"notes\": \"In-process nodes over unix socket pairs\"\n");
+    printf("}\n");
+    return 0;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Args a = parse_args(argc, argv);
+    int (*command)(const Args&) = nullptr;
+    if (a.command == "pingpong" || a.command == "stream") {
+        command = run;
+    } else if (a.command == "cluster") {
+        command = run_cluster;
+    } else {
+        usage();
+    }
+    try {
+        int rc = command(a);
+        if (!a.metrics.empty()) {
+            spu::telemetry_write(a.metrics);
+        }
+        return rc;
+    } catch (const std::exception& e) {
+        fprintf(stderr, "fabric_tool: %s\n", e.what());
+        return 1;
+    }
+}
@@ -0,0 +1,126 @@
+/**
+ * SPU Fabric Frames - Length-prefixed binary frames for glyph traffic
+ */
+
+#include "frame.h"
+#include <cstring>
+#include <stdexcept>
+
+namespace spu {
+
+namespace {
+
+uint64_t content_total(const GlyphStore& store, size_t begin, size_t end) {
+    uint64_t total = 0;
+    for (size_t i = begin; i < end; i++) {
+        total += store.content_len(i);
+    }
+    return total;
+}
+
+} // namespace
+
+size_t glyph_frame_body(const GlyphStore& store, size_t begin, size_t end) {
+    return (end - begin) * kFrameGlyphFixedBytes + content_total(store, begin, end);
+}
+
+size_t encode_glyph_frame(const GlyphStore& store, size_t begin, size_t end, iovec* iov,
+                          std::vector<char>& scratch) {
+    const size_t n = end - begin;
+    if (n == 0) {
+        return 0;
+    }
+    auto column = [&](size_t k, const void* data, size_t bytes) {
+        iov[k].iov_base = const_cast<void*>(data);
+        iov[k].iov_len = bytes;
+    };
+    column(0, &store.id(begin), n * sizeof(GlyphId));
+    column(1, &store.parent1_id(begin), n * sizeof(GlyphId));
+    column(2, &store.parent2_id(begin), n * sizeof(GlyphId));
+    column(3, store.energy() + begin, n * sizeof(double));
+    column(4, store.last_update_time() + begin, n * sizeof(uint64_t));
+    column(5, store.activation_count() + begin, n * sizeof(uint32_t));
+    column(6, store.content_lens() + begin, n * sizeof(uint32_t));
+
+    // Stores built by append() / merge_batch() keep a range's content contiguous
+    const uint64_t total = content_total(store, begin, end);
+    const char* first = store.content(begin);
+    if (store.content(end - 1) + store.content_len(end - 1) == first + total) {
+        column(7, first, total);
+    } else {
+        scratch.resize(total);
+        char* dst = scratch.data();
+        for (size_t i = begin; i < end; i++) {
+            memcpy(dst, store.content(i), store.content_len(i));
+            dst += store.content_len(i);
+        }
+        column(7, scratch.data(), total);
+    }
+    return kGlyphFrameIovecs;
+}
+
+size_t frame_record_bytes(uint16_t type) {
+    switch (type) {
+    case kFrameMergePairs:
+        return sizeof(MergePair);
+    case kFrameIdPairs:
+        return sizeof(GlyphIdPair);
+    case kFrameProbes:
+        return sizeof(MergeProbe);
+    case kFrameIndices:
+        return sizeof(uint32_t);
+    default:
+        return 0;
+    }
+}
+
+bool valid_frame_header(const FrameHeader& h) {
+    if (h.magic != kFrameMagic || h.length > kMaxFrameBody) {
+        return false;
+    }
+    if (h.type == kFrameGlyphs) {
+        return uint64_t(h.count) * kFrameGlyphFixedBytes <= h.length;
+    }
+    size_t record = frame_record_bytes(h.type);
+    return record != 0 && uint64_t(h.count) * record == h.length;
+}
+
+void decode_glyph_frame(const FrameHeader& h, const char* body, GlyphStore& out) {
+    const size_t n = h.count;
+    if (h.type != kFrameGlyphs || n * kFrameGlyphFixedBytes > h.length) {
+        throw std::runtime_error("fabric: malformed glyph frame");
+    }
+    if (n == 0) {
+        return;
+    }
+    // Bodies are received into 8-byte-aligned buffers, so the columns are aligned too
+    const uint32_t* content_len = reinterpret_cast<const uint32_t*>(body + n * 116);
+    uint64_t total = 0;
+    for (size_t i = 0; i < n; i++) {
+        total += content_len[i];
+    }
+    if (n * kFrameGlyphFixedBytes + total != h.length) {
+        throw std::runtime_error("fabric: glyph frame content length mismatch");
+    }
+    out.append_columns(n, reinterpret_cast<const GlyphId*>(body),
+                       reinterpret_cast<const GlyphId*>(body + n * 32),
+                       reinterpret_cast<const GlyphId*>(body + n * 64),
+                       reinterpret_cast<const double*>(body + n * 96),
+                       reinterpret_cast<const uint32_t*>(body + n * 112),
+                       reinterpret_cast<const uint64_t*>(body + n * 104),
+                       content_len,
+                       body + n * kFrameGlyphFixedBytes);
+}
+
+void decode_pair_frame(const FrameHeader& h, const char* body, std::vector<MergePair>& out) {
+    if (h.type != kFrameMergePairs || uint64_t(h.count) * sizeof(MergePair) != h.length) {
+        throw std::runtime_error("fabric: malformed merge-pair frame");
+    }
+    size_t base = out.size();
+    out.resize(base + h.count);
+    if (h.count > 0) {
+        memcpy(out.data() + base, body, h.length);
+    }
+}
+
+} // namespace spu
@@ -0,0 +1,126 @@
+/**
+ * SPU Fabric Frames - Length-prefixed binary frames for glyph traffic
+ *
+ * Every message between nodes is one frame:
+ *
+ *   FrameHeader (32 bytes) | body (length bytes)
+ *
+ * A glyph batch body is the GlyphStore columns back to back, so a batch is
+ * sent straight from the store's vectors (one iovec per column, no
+ * serialization) and received with one bulk append:
+ *
+ *   ids[n] (32 B) | parent1_ids[n] | parent2_ids[n] | energy[n] (f64) |
+ *   last_update_time[n] (u64) | activation_count[n] (u32) |
+ *   content_len[n] (u32) | content (sum of content_len bytes)
+ *
+ * Every column is aligned to its element size within the body. Merge-pair
+ * bodies are n MergePair structs. Fields are in host byte order
+ * (little-endian on every supported target), as in the storage records.
+ */
+
+#ifndef SPU_FRAME_H
+#define SPU_FRAME_H
+
+#include "glyph_store.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <sys/uio.h>
+
+namespace spu {
+
+constexpr uint32_t kFrameMagic = 0x46555053;  // "SPUF"
+
+// Largest body accepted from a peer
+constexpr uint32_t kMaxFrameBody = 64u * 1024 * 1024;
+
+enum FrameType : uint16_t {
+    kFrameGlyphs = 1,      // Glyph batch (columns above)
+    kFrameMergePairs = 2,  // MergePair[count], indices into the receiver's store
+    kFrameIdPairs = 3,     // GlyphIdPair[count]
+    kFrameProbes = 4,      // MergeProbe[count]
+    kFrameIndices = 5,     // uint32_t[count]
+};
+
+// Merge named by parent IDs (nodes do not share store indices)
+struct GlyphIdPair {
+    GlyphId first;
+    GlyphId second;
+};
+
+// Cluster merge: "merge your glyph `remote` with my `local` of local_len content bytes"
+struct MergeProbe {
+    GlyphId remote;
+    GlyphId local;
+    uint32_t local_len;
+    uint32_t reserved;
+};
+
+static_assert(sizeof(GlyphIdPair) == 64, "GlyphIdPair is sent as raw bytes");
+static_assert(sizeof(MergeProbe) == 72, "MergeProbe is sent as raw bytes");
+
+// Record size of a fixed-record frame type (0 for glyph frames and unknown types)
+size_t frame_record_bytes(uint16_t type);
+
+struct FrameHeader {
+    uint32_t magic;     // kFrameMagic
+    uint16_t type;      // FrameType
+    uint16_t flags;     // Reserved (0)
+    uint32_t count;     // Glyphs or pairs in the body
+    uint32_t length;    // Body bytes
+    uint64_t seq;       // Per-channel sequence number (starts at 1)
+    uint64_t reserved;
+};
+
+static_assert(sizeof(FrameHeader) == 32, "FrameHeader is sent as raw bytes");
+
+// Body bytes per glyph before the content
+constexpr size_t kFrameGlyphFixedBytes = 3 * kDigestLen + 8 + 8 + 4 + 4;
+
+// Body bytes of a glyph frame for store[begin, end)
+size_t glyph_frame_body(const GlyphStore& store, size_t begin, size_t end);
+
+// Most iovecs encode_glyph_frame() fills
+constexpr size_t kGlyphFrameIovecs = 8;
+
+/**
+ * Describe store[begin, end) as a glyph frame body without copying
+ *
+ * The iovecs point into the store's columns, which must stay unchanged
+ * until the frame is sent. Content that is not contiguous in the arena
+ * is gathered into scratch.
+ *
+ * @param iov Output (kGlyphFrameIovecs entries)
+ * @param scratch Backing for gathered content
+ * @return iovecs used
+ */
+size_t encode_glyph_frame(const GlyphStore& store, size_t begin, size_t end, iovec* iov,
+                          std::vector<char>& scratch);
+
+/**
+ * Check a header received from a peer
+ *
+ * @return false on bad magic, type or length
+ */
+bool valid_frame_header(const FrameHeader& h);
+
+/**
+ * Append the glyphs of a glyph frame body to out
+ *
+ * @param body Body bytes (8-byte aligned)
+ * @throws std::runtime_error if the body does not match the header
+ */
+void decode_glyph_frame(const FrameHeader& h, const char* body, GlyphStore& out);
+
+/**
+ * Append the pairs of a merge-pair frame body to out
+ *
+ * @throws std::runtime_error if the body does not match the header
+ */
+void decode_pair_frame(const FrameHeader& h, const char* body, std::vector<MergePair>& out);
+
+} // namespace spu
+
+#endif // SPU_FRAME_H
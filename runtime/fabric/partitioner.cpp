@@ -0,0 +1,80 @@
+/**
+ * SPU Fabric Partitioner - Consistent hashing of glyph IDs onto nodes
+ */
+
+#include "partitioner.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+namespace spu {
+
+namespace {
+
+// splitmix64 finalizer: fixed, so rings agree across processes and builds
+uint64_t mix(uint64_t x) {
+    x += 0x9e3779b97f4a7c15ull;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+    return x ^ (x >> 31);
+}
+
+uint64_t key_of(const GlyphId& id) {
+    uint64_t k;
+    memcpy(&k, id.bytes, sizeof(k));
+    return k;
+}
+
+} // namespace
+
+Partitioner::Partitioner(size_t vnodes) : vnodes_(std::max<size_t>(vnodes, 1)) {}
+
+void Partitioner::add_node(uint32_t node, double weight) {
+    if (!(weight > 0.0)) {
+        throw std::invalid_argument("Partitioner: weight must be > 0");
+    }
+    if (std::find(nodes_.begin(), nodes_.end(), node) != nodes_.end()) {
+        throw std::invalid_argument("Partitioner: node already present");
+    }
+    size_t points = std::max<size_t>(1, static_cast<size_t>(std::lround(weight * double(vnodes_))));
+    for (size_t r = 0; r < points; r++) {
+        ring_.push_back(Point{mix((uint64_t(node) << 32) ^ mix(r)), node});
+    }
+    // Ties (vanishingly rare) break by node, so the order is still deterministic
+    std::sort(ring_.begin(), ring_.end(), [](const Point& a, const Point& b) {
+        return a.token != b.token ? a.token < b.token : a.node < b.node;
+    });
+    nodes_.push_back(node);
+}
+
+void Partitioner::remove_node(uint32_t node) {
+    ring_.erase(std::remove_if(ring_.begin(), ring_.end(),
+                               [node](const Point& p) { return p.node == node; }),
+                ring_.end());
+    nodes_.erase(std::remove(nodes_.begin(), nodes_.end(), node), nodes_.end());
+}
+
+uint32_t Partitioner::lookup(uint64_t key) const {
+    auto it = std::lower_bound(ring_.begin(), ring_.end(), key,
+                               [](const Point& p, uint64_t k) { return p.token < k; });
+    return it == ring_.end() ? ring_.front().node : it->node;
+}
+
+uint32_t Partitioner::owner(const GlyphId& id) const {
+    if (ring_.empty()) {
+        throw std::logic_error("Partitioner: no nodes");
+    }
+    return lookup(key_of(id));
+}
+
+void Partitioner::owners(const GlyphId* ids, size_t n, uint32_t* out) const {
+    if (ring_.empty()) {
+        throw std::logic_error("Partitioner: no nodes");
+    }
+    for (size_t i = 0; i < n; i++) {
+        out[i] = lookup(key_of(ids[i]));
+    }
+}
+
+} // namespace spu
@@ -0,0 +1,68 @@
+/**
+ * SPU Fabric Partitioner - Consistent hashing of glyph IDs onto nodes
+ *
+ * Each node owns vnodes points on a 64-bit ring, placed by a fixed mix of
+ * (node, replica), so every process that adds the same nodes computes the
+ * same ring. A glyph belongs to the node of the first point at or after
+ * its key: the first 8 bytes of its GlyphId, which is already uniform
+ * (SHA-256 of the content). Adding or removing a node moves only the keys
+ * in the arcs it takes or gives up (about 1/N of them); weight scales a
+ * node's point count for uneven hardware.
+ */
+
+#ifndef SPU_PARTITIONER_H
+#define SPU_PARTITIONER_H
+
+#include "glyph_id.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace spu {
+
+class Partitioner {
+public:
+    static constexpr size_t kDefaultVnodes = 128;
+
+    explicit Partitioner(size_t vnodes = kDefaultVnodes);
+
+    /**
+     * Add a node with weight x vnodes ring points
+     *
+     * @throws std::invalid_argument if the node is already present or weight <= 0
+     */
+    void add_node(uint32_t node, double weight = 1.0);
+
+    // Remove a node and its points (no-op if absent)
+    void remove_node(uint32_t node);
+
+    size_t nodes() const { return nodes_.size(); }
+    const std::vector<uint32_t>& node_ids() const { return nodes_; }
+
+    /**
+     * Node owning id
+     *
+     * @throws std::logic_error if there are no nodes
+     */
+    uint32_t owner(const GlyphId& id) const;
+
+    // Owners of n IDs
+    void owners(const GlyphId* ids, size_t n, uint32_t* out) const;
+
+private:
+    struct Point {
+        uint64_t token;
+        uint32_t node;
+    };
+
+    uint32_t lookup(uint64_t key) const;
+
+    size_t vnodes_;
+    std::vector<Point> ring_;  // Ascending token
+    std::vector<uint32_t> nodes_;
+};
+
+} // namespace spu
+
+#endif // SPU_PARTITIONER_H
@@ -0,0 +1,385 @@
+/**
+ * SPU Fabric RDMA - Frame transport over an ibverbs reliable connection
+ */
+
+#include "rdma_transport.h"
+#include <stdexcept>
+
+#if defined(SPU_WITH_IBVERBS)
+#include <infiniband/verbs.h>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <system_error>
+#include <vector>
+
+#include <unistd.h>
+#endif
+
+namespace spu {
+
+#if defined(SPU_WITH_IBVERBS)
+
+namespace {
+
+// Queue pair address swapped over the bootstrap socket
+struct QpAddress {
+    uint32_t qpn;
+    uint32_t psn;
+    uint16_t lid;
+    uint16_t reserved;
+    uint8_t gid[16];
+};
+
+void exchange(int fd, const QpAddress& local, QpAddress& remote) {
+    const char* src = reinterpret_cast<const char*>(&local);
+    for (size_t done = 0; done < sizeof(local);) {
+        ssize_t n = ::write(fd, src + done, sizeof(local) - done);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            throw std::system_error(errno, std::generic_category(), "rdma handshake send");
+        }
+        done += static_cast<size_t>(n);
+    }
+    char* dst = reinterpret_cast<char*>(&remote);
+    for (size_t done = 0; done < sizeof(remote);) {
+        ssize_t n = ::read(fd, dst + done, sizeof(remote) - done);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            throw std::runtime_error("rdma: handshake failed (peer closed)");
+        }
+        done += static_cast<size_t>(n);
+    }
+}
+
+class RdmaTransport : public Transport {
+public:
+    RdmaTransport(int bootstrap_fd, const RdmaOptions& options) : options_(options) {
+        try {
+            open(bootstrap_fd);
+        } catch (...) {
+            teardown();
+            throw;
+        }
+    }
+
+    ~RdmaTransport() override { teardown(); }
+
+    const char* name() const override { return "rdma"; }
+
+    void send(const FrameHeader& header, const iovec* body, size_t n) override {
+        size_t total = sizeof(header);
+        for (size_t i = 0; i < n; i++) {
+            total += body[i].iov_len;
+        }
+        if (total > options_.slot_bytes) {
+            throw std::length_error("rdma: frame larger than a slot");
+        }
+        // Reuse a slot only after its send completed
+        while (send_posted_ - send_done_ >= options_.slots) {
+            poll_send();
+        }
+        size_t slot = send_posted_ % options_.slots;
+        char* dst = send_buf_ + slot * options_.slot_bytes;
+        memcpy(dst, &header, sizeof(header));
+        size_t pos = sizeof(header);
+        for (size_t i = 0; i < n; i++) {
+            memcpy(dst + pos, body[i].iov_base, body[i].iov_len);
+            pos += body[i].iov_len;
+        }
+
+        ibv_sge sge{};
+        sge.addr = reinterpret_cast<uintptr_t>(dst);
+        sge.length = static_cast<uint32_t>(total);
+        sge.lkey = send_mr_->lkey;
+        ibv_send_wr wr{};
+        wr.wr_id = send_posted_;
+        wr.sg_list = &sge;
+        wr.num_sge = 1;
+        wr.opcode = IBV_WR_SEND;
+        wr.send_flags = IBV_SEND_SIGNALED | (total <= max_inline_ ? IBV_SEND_INLINE : 0);
+        ibv_send_wr* bad = nullptr;
+        if (ibv_post_send(qp_, &wr, &bad) != 0) {
+            throw std::runtime_error("rdma: post send failed");
+        }
+        send_posted_++;
+        stats_.frames_sent++;
+        stats_.bytes_sent += total;
+    }
+
+    bool recv(FrameHeader& header, std::vector<char>& body) override {
+        ibv_wc wc;
+        for (;;) {
+            int got = ibv_poll_cq(recv_cq_, 1, &wc);
+            if (got < 0) {
+                throw std::runtime_error("rdma: poll receive queue failed");
+            }
+            if (got == 1) {
+                break;
+            }
+        }
+        if (wc.status != IBV_WC_SUCCESS) {
+            if (wc.status == IBV_WC_WR_FLUSH_ERR) {
+                return false;  // Queue pair torn down
+            }
+            throw std::runtime_error(std::string("rdma: receive failed: ") + ibv_wc_status_str(wc.status));
+        }
+        const size_t slot = wc.wr_id;
+        const char* src = recv_buf_ + slot * options_.slot_bytes;
+        if (wc.byte_len < sizeof(header)) {
+            throw std::runtime_error("rdma: short frame");
+        }
+        memcpy(&header, src, sizeof(header));
+        if (!valid_frame_header(header) || sizeof(header) + header.length != wc.byte_len) {
+            throw std::runtime_error("rdma: malformed frame header");
+        }
+        body.resize(header.length);
+        memcpy(body.data(), src + sizeof(header), header.length);
+        post_recv(slot);
+        stats_.frames_received++;
+        stats_.bytes_received += wc.byte_len;
+        return true;
+    }
+
+private:
+    void open(int bootstrap_fd) {
+        int count = 0;
+        ibv_device** devices = ibv_get_device_list(&count);
+        if (!devices || count == 0) {
+            if (devices) {
+                ibv_free_device_list(devices);
+            }
+            throw std::runtime_error("rdma: no RDMA devices");
+        }
+        ibv_device* device = nullptr;
+        for (int i = 0; i < count && !device; i++) {
+            if (options_.device.empty() || options_.device == ibv_get_device_name(devices[i])) {
+                device = devices[i];
+            }
+        }
+        if (device) {
+            ctx_ = ibv_open_device(device);
+        }
+        ibv_free_device_list(devices);
+        if (!ctx_) {
+            throw std::runtime_error("rdma: cannot open device " + options_.device);
+        }
+
+        pd_ = ibv_alloc_pd(ctx_);
+        send_cq_ = ibv_create_cq(ctx_, static_cast<int>(options_.slots), nullptr, nullptr, 0);
+        recv_cq_ = ibv_create_cq(ctx_, static_cast<int>(options_.slots), nullptr, nullptr, 0);
+        if (!pd_ || !send_cq_ || !recv_cq_) {
+            throw std::runtime_error("rdma: cannot allocate protection domain / completion queues");
+        }
+
+        const size_t bytes = options_.slots * options_.slot_bytes;
+        send_buf_ = static_cast<char*>(std::aligned_alloc(4096, bytes));
+        recv_buf_ = static_cast<char*>(std::aligned_alloc(4096, bytes));
+        if (!send_buf_ || !recv_buf_) {
+            throw std::bad_alloc();
+        }
+        send_mr_ = ibv_reg_mr(pd_, send_buf_, bytes, 0);
+        recv_mr_ = ibv_reg_mr(pd_, recv_buf_, bytes, IBV_ACCESS_LOCAL_WRITE);
+        if (!send_mr_ || !recv_mr_) {
+            throw std::runtime_error("rdma: memory registration failed");
+        }
+
+        ibv_qp_init_attr init{};
+        init.send_cq = send_cq_;
+        init.recv_cq = recv_cq_;
+        init.qp_type = IBV_QPT_RC;
+        init.cap.max_send_wr = static_cast<uint32_t>(options_.slots);
+        init.cap.max_recv_wr = static_cast<uint32_t>(options_.slots);
+        init.cap.max_send_sge = 1;
+        init.cap.max_recv_sge = 1;
+        init.cap.max_inline_data = 256;
+        qp_ = ibv_create_qp(pd_, &init);
+        if (!qp_) {
+            throw std::runtime_error("rdma: cannot create queue pair");
+        }
+        max_inline_ = init.cap.max_inline_data;
+
+        ibv_qp_attr attr{};
+        attr.qp_state = IBV_QPS_INIT;
+        attr.pkey_index = 0;
+        attr.port_num = static_cast<uint8_t>(options_.port);
+        attr.qp_access_flags = 0;
+        if (ibv_modify_qp(qp_, &attr,
+                          IBV_QP_STATE | IBV_QP_PKEY_INDEX | IBV_QP_PORT | IBV_QP_ACCESS_FLAGS) != 0) {
+            throw std::runtime_error("rdma: queue pair INIT failed");
+        }
+        for (size_t s = 0; s < options_.slots; s++) {
+            post_recv(s);
+        }
+
+        ibv_port_attr port{};
+        if (ibv_query_port(ctx_, static_cast<uint8_t>(options_.port), &port) != 0) {
+            throw std::runtime_error("rdma: cannot query port");
+        }
+        QpAddress local{};
+        local.qpn = qp_->qp_num;
+        local.psn = std::random_device()() & 0xffffff;
+        local.lid = port.lid;
+        ibv_gid gid{};
+        if (ibv_query_gid(ctx_, static_cast<uint8_t>(options_.port), options_.gid_index, &gid) == 0) {
+            memcpy(local.gid, gid.raw, sizeof(local.gid));
+        }
+        QpAddress remote{};
+        exchange(bootstrap_fd, local, remote);
+
+        attr = ibv_qp_attr{};
+        attr.qp_state = IBV_QPS_RTR;
+        attr.path_mtu = port.active_mtu;
+        attr.dest_qp_num = remote.qpn;
+        attr.rq_psn = remote.psn;
+        attr.max_dest_rd_atomic = 1;
+        attr.min_rnr_timer = 12;
+        attr.ah_attr.dlid = remote.lid;
+        attr.ah_attr.port_num = static_cast<uint8_t>(options_.port);
+        if (port.link_layer == IBV_LINK_LAYER_ETHERNET) {  // RoCE routes by GID
+            attr.ah_attr.is_global = 1;
+            memcpy(attr.ah_attr.grh.dgid.raw, remote.gid, sizeof(remote.gid));
+            attr.ah_attr.grh.sgid_index = static_cast<uint8_t>(options_.gid_index);
+            attr.ah_attr.grh.hop_limit = 1;
+        }
+        if (ibv_modify_qp(qp_, &attr,
+                          IBV_QP_STATE | IBV_QP_AV | IBV_QP_PATH_MTU | IBV_QP_DEST_QPN |
+                              IBV_QP_RQ_PSN | IBV_QP_MAX_DEST_RD_ATOMIC | IBV_QP_MIN_RNR_TIMER) != 0) {
+            throw std::runtime_error("rdma: queue pair RTR failed");
+        }
+
+        attr = ibv_qp_attr{};
+        attr.qp_state = IBV_QPS_RTS;
+        attr.timeout = 14;
+        attr.retry_cnt = 7;
+        attr.rnr_retry = 7;  // Retry forever while the peer has no receive posted
+        attr.sq_psn = local.psn;
+        attr.max_rd_atomic = 1;
+        if (ibv_modify_qp(qp_, &attr,
+                          IBV_QP_STATE | IBV_QP_TIMEOUT | IBV_QP_RETRY_CNT | IBV_QP_RNR_RETRY |
+                              IBV_QP_SQ_PSN | IBV_QP_MAX_QP_RD_ATOMIC) != 0) {
+            throw std::runtime_error("rdma: queue pair RTS failed");
+        }
+        // Barrier: neither side sends before the other's receives are ready
+        exchange(bootstrap_fd, local, remote);
+    }
+
+    void post_recv(size_t slot) {
+        ibv_sge sge{};
+        sge.addr = reinterpret_cast<uintptr_t>(recv_buf_ + slot * options_.slot_bytes);
+        sge.length = static_cast<uint32_t>(options_.slot_bytes);
+        sge.lkey = recv_mr_->lkey;
+        ibv_recv_wr wr{};
+        wr.wr_id = slot;
+        wr.sg_list = &sge;
+        wr.num_sge = 1;
+        ibv_recv_wr* bad = nullptr;
+        if (ibv_post_recv(qp_, &wr, &bad) != 0) {
+            throw std::runtime_error("rdma: post receive failed");
+        }
+    }
+
+    void poll_send() {
+        ibv_wc wc[16];
+        int got = ibv_poll_cq(send_cq_, 16, wc);
+        if (got < 0) {
+            throw std::runtime_error("rdma: poll send queue failed");
+        }
+        for (int i = 0; i < got; i++) {
+            if (wc[i].status != IBV_WC_SUCCESS) {
+                throw std::runtime_error(std::string("rdma: send failed: ") + ibv_wc_status_str(wc[i].status));
+            }
+        }
+        send_done_ += static_cast<uint64_t>(got);
+    }
+
+    void teardown() {
+        if (qp_) {
+            // Let queued sends reach the peer before the queue pair goes away
+            try {
+                while (send_done_ < send_posted_) {
+                    poll_send();
+                }
+            } catch (...) {
+            }
+            ibv_destroy_qp(qp_);
+        }
+        if (send_mr_) {
+            ibv_dereg_mr(send_mr_);
+        }
+        if (recv_mr_) {
+            ibv_dereg_mr(recv_mr_);
+        }
+        if (send_cq_) {
+            ibv_destroy_cq(send_cq_);
+        }
+        if (recv_cq_) {
+            ibv_destroy_cq(recv_cq_);
+        }
+        if (pd_) {
+            ibv_dealloc_pd(pd_);
+        }
+        if (ctx_) {
+            ibv_close_device(ctx_);
+        }
+        std::free(send_buf_);
+        std::free(recv_buf_);
+        qp_ = nullptr;
+        send_mr_ = recv_mr_ = nullptr;
+        send_cq_ = recv_cq_ = nullptr;
+        pd_ = nullptr;
+        ctx_ = nullptr;
+        send_buf_ = recv_buf_ = nullptr;
+    }
+
+    RdmaOptions options_;
+    ibv_context* ctx_ = nullptr;
+    ibv_pd* pd_ = nullptr;
+    ibv_cq* send_cq_ = nullptr;
+    ibv_cq* recv_cq_ = nullptr;
+    ibv_qp* qp_ = nullptr;
+    ibv_mr* send_mr_ = nullptr;
+    ibv_mr* recv_mr_ = nullptr;
+    char* send_buf_ = nullptr;
+    char* recv_buf_ = nullptr;
+    uint32_t max_inline_ = 0;
+    uint64_t send_posted_ = 0;
+    uint64_t send_done_ = 0;
+};
+
+} // namespace
+
+bool rdma_available() {
+    int count = 0;
+    ibv_device** devices = ibv_get_device_list(&count);
+    if (devices) {
+        ibv_free_device_list(devices);
+    }
+    return count > 0;
+}
+
+std::unique_ptr<Transport> rdma_connect(int bootstrap_fd, const RdmaOptions& options) {
+    if (options.slots == 0 || options.slot_bytes < sizeof(FrameHeader)) {
+        throw std::invalid_argument("rdma: need slots >= 1 and slot_bytes >= a frame header");
+    }
+    return std::unique_ptr<Transport>(new RdmaTransport(bootstrap_fd, options));
+}
+
+#else
+
+bool rdma_available() {
+    return false;
+}
+
+std::unique_ptr<Transport> rdma_connect(int, const RdmaOptions&) {
+    throw std::runtime_error("built without RDMA support (-DSPU_WITH_IBVERBS)");
+}
+
+#endif // SPU_WITH_IBVERBS
+
+} // namespace spu
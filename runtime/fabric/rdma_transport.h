@@ -0,0 +1,51 @@
+/**
+ * SPU Fabric RDMA - Frame transport over an ibverbs reliable connection
+ *
+ * One RC queue pair per connection. Frames are sent with IBV_WR_SEND
+ * from a ring of pre-registered send slots (small frames inline in the
+ * work request) into receive slots the peer keeps posted, and both sides
+ * busy-poll their completion queues, so a frame costs no system call and
+ * no kernel copy. The peer's queue pair address is exchanged once over an
+ * already connected socket (e.g. a TcpListener / tcp_connect() pair).
+ *
+ * Available when built with -DSPU_WITH_IBVERBS (link -libverbs) on a
+ * host with an InfiniBand or RoCE device; docs/fabric_notes.md covers
+ * configuration.
+ */
+
+#ifndef SPU_RDMA_TRANSPORT_H
+#define SPU_RDMA_TRANSPORT_H
+
+#include "transport.h"
+
+#include <cstddef>
+#include <memory>
+#include <string>
+
+namespace spu {
+
+struct RdmaOptions {
+    std::string device;           // ibv device name ("" = first device)
+    int port = 1;
+    int gid_index = 0;            // RoCE GID table entry (ignored on InfiniBand)
+    size_t slot_bytes = 1 << 20;  // Largest frame (header + body)
+    size_t slots = 32;            // Send and receive slots each
+};
+
+// True if built with ibverbs and at least one RDMA device is present
+bool rdma_available();
+
+/**
+ * Connect a queue pair to the peer on the other end of bootstrap_fd
+ *
+ * Both sides call this with their end of the socket. The socket is used
+ * only for the handshake and stays owned by the caller.
+ *
+ * @throws std::runtime_error without ibverbs support, without a device,
+ *         or if the queue pair cannot be brought up
+ */
+std::unique_ptr<Transport> rdma_connect(int bootstrap_fd, const RdmaOptions& options = RdmaOptions());
+
+} // namespace spu
+
+#endif // SPU_RDMA_TRANSPORT_H
@@ -0,0 +1,275 @@
+/**
+ * SPU Fabric Shared Memory - Frame transport between processes on one host
+ */
+
+#include "shm_transport.h"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+#include <system_error>
+
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+namespace spu {
+
+namespace {
+
+constexpr uint64_t kShmMagic = 0x474e495246555053ull;  // "SPUFRING"
+constexpr size_t kDataOffset = 4096;
+constexpr unsigned kSpinRounds = 256;  // About 10 us of pause before sleeping
+
+struct Control {
+    uint64_t magic;
+    uint64_t capacity;
+};
+
+[[noreturn]] void throw_errno(const std::string& what) {
+    throw std::system_error(errno, std::generic_category(), what);
+}
+
+void futex_wait(std::atomic<uint32_t>* word, uint32_t expected) {
+    // Bounded, so a peer that died without waking us is noticed
+    timespec timeout{0, 1000000};
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(word), FUTEX_WAIT, expected, &timeout,
+            nullptr, 0);
+}
+
+void futex_wake(std::atomic<uint32_t>* word) {
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(word), FUTEX_WAKE, 1, nullptr, nullptr, 0);
+}
+
+void cpu_relax() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#endif
+}
+
+size_t frame_bytes(size_t body) {
+    return (sizeof(FrameHeader) + body + 7) & ~size_t(7);
+}
+
+} // namespace
+
+// One direction; the writer owns head / data_seq, the reader tail / space_seq
+struct ShmTransport::Ring {
+    alignas(64) std::atomic<uint64_t> head{0};  // Bytes written
+    std::atomic<uint32_t> data_seq{0};          // Futex word: bumped after each write
+    std::atomic<uint32_t> reader_waiting{0};
+    alignas(64) std::atomic<uint64_t> tail{0};  // Bytes consumed
+    std::atomic<uint32_t> space_seq{0};         // Futex word: bumped after each read
+    std::atomic<uint32_t> writer_waiting{0};
+    alignas(64) std::atomic<uint32_t> closed{0};  // Writer is gone
+};
+
+namespace {
+
+constexpr size_t kRingOffset = 64;
+static_assert(kRingOffset + 2 * 256 <= kDataOffset, "rings fit before the data");
+
+// Wake a peer sleeping on seq, if it said it is
+void notify(std::atomic<uint32_t>& seq, std::atomic<uint32_t>& waiting) {
+    seq.fetch_add(1);
+    if (waiting.load()) {
+        futex_wake(&seq);
+    }
+}
+
+// Spin, then sleep on seq until ready()
+template <typename Ready>
+void wait_until(std::atomic<uint32_t>& seq, std::atomic<uint32_t>& waiting, Ready ready,
+                uint64_t& syscalls) {
+    for (unsigned i = 0; i < kSpinRounds; i++) {
+        if (ready()) {
+            return;
+        }
+        cpu_relax();
+    }
+    for (;;) {
+        waiting.store(1);
+        uint32_t seen = seq.load();
+        if (ready()) {
+            waiting.store(0);
+            return;
+        }
+        futex_wait(&seq, seen);
+        syscalls++;
+        waiting.store(0);
+        if (ready()) {
+            return;
+        }
+    }
+}
+
+void copy_in(char* data, size_t capacity, uint64_t pos, const void* src, size_t len) {
+    size_t off = pos & (capacity - 1);
+    size_t first = std::min(len, capacity - off);
+    memcpy(data + off, src, first);
+    memcpy(data, static_cast<const char*>(src) + first, len - first);
+}
+
+void copy_out(const char* data, size_t capacity, uint64_t pos, void* dst, size_t len) {
+    size_t off = pos & (capacity - 1);
+    size_t first = std::min(len, capacity - off);
+    memcpy(dst, data + off, first);
+    memcpy(static_cast<char*>(dst) + first, data, len - first);
+}
+
+} // namespace
+
+std::unique_ptr<ShmTransport> ShmTransport::create(const std::string& name, size_t capacity) {
+    size_t cap = 4096;
+    while (cap < capacity) {
+        cap *= 2;
+    }
+    const size_t bytes = kDataOffset + 2 * cap;
+    int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        throw_errno("shm_open " + name);
+    }
+    if (ftruncate(fd, static_cast<off_t>(bytes)) != 0) {
+        int err = errno;
+        close(fd);
+        shm_unlink(name.c_str());
+        throw std::system_error(err, std::generic_category(), "shm ftruncate");
+    }
+    void* base = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, 0);
+    int err = errno;
+    close(fd);
+    if (base == MAP_FAILED) {
+        shm_unlink(name.c_str());
+        throw std::system_error(err, std::generic_category(), "shm mmap");
+    }
+    static_assert(sizeof(Ring) <= 256, "Ring fits its slot");
+    char* b = static_cast<char*>(base);
+    new (b + kRingOffset) Ring();
+    new (b + kRingOffset + 256) Ring();
+    Control* control = reinterpret_cast<Control*>(b);
+    control->capacity = cap;
+    std::atomic_thread_fence(std::memory_order_release);
+    reinterpret_cast<std::atomic<uint64_t>*>(&control->magic)->store(kShmMagic);
+    return std::unique_ptr<ShmTransport>(new ShmTransport(base, bytes, 0, name));
+}
+
+std::unique_ptr<ShmTransport> ShmTransport::open(const std::string& name) {
+    int fd = shm_open(name.c_str(), O_RDWR | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        throw_errno("shm_open " + name);
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || size_t(st.st_size) < kDataOffset) {
+        close(fd);
+        throw std::runtime_error("shm: " + name + " is not a fabric ring");
+    }
+    const size_t bytes = static_cast<size_t>(st.st_size);
+    void* base = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, 0);
+    int err = errno;
+    close(fd);
+    if (base == MAP_FAILED) {
+        throw std::system_error(err, std::generic_category(), "shm mmap");
+    }
+    const Control* control = static_cast<const Control*>(base);
+    if (reinterpret_cast<const std::atomic<uint64_t>*>(&control->magic)->load() != kShmMagic ||
+        kDataOffset + 2 * control->capacity != bytes) {
+        munmap(base, bytes);
+        throw std::runtime_error("shm: " + name + " is not a fabric ring");
+    }
+    return std::unique_ptr<ShmTransport>(new ShmTransport(base, bytes, 1, std::string()));
+}
+
+ShmTransport::ShmTransport(void* base, size_t bytes, int side, const std::string& name)
+    : base_(base), bytes_(bytes), unlink_name_(name) {
+    char* b = static_cast<char*>(base);
+    capacity_ = static_cast<const Control*>(base)->capacity;
+    Ring* rings[2] = {reinterpret_cast<Ring*>(b + kRingOffset),
+                      reinterpret_cast<Ring*>(b + kRingOffset + 256)};
+    char* data[2] = {b + kDataOffset, b + kDataOffset + capacity_};
+    tx_ = rings[side];
+    tx_data_ = data[side];
+    rx_ = rings[1 - side];
+    rx_data_ = data[1 - side];
+}
+
+ShmTransport::~ShmTransport() {
+    tx_->closed.store(1);
+    notify(tx_->data_seq, tx_->reader_waiting);   // Peer blocked in recv()
+    notify(rx_->space_seq, rx_->writer_waiting);  // Peer blocked in send()
+    munmap(base_, bytes_);
+    if (!unlink_name_.empty()) {
+        shm_unlink(unlink_name_.c_str());
+    }
+}
+
+void ShmTransport::send(const FrameHeader& header, const iovec* body, size_t n) {
+    size_t len = 0;
+    for (size_t i = 0; i < n; i++) {
+        len += body[i].iov_len;
+    }
+    const size_t total = frame_bytes(len);
+    if (total > capacity_) {
+        throw std::length_error("shm: frame larger than the ring");
+    }
+
+    const uint64_t head = tx_->head.load(std::memory_order_relaxed);
+    auto room = [&] {
+        return capacity_ - (head - tx_->tail.load(std::memory_order_acquire)) >= total ||
+               rx_->closed.load(std::memory_order_relaxed);
+    };
+    if (!room()) {
+        wait_until(tx_->space_seq, tx_->writer_waiting, room, stats_.send_syscalls);
+    }
+    if (rx_->closed.load()) {
+        throw std::runtime_error("shm: peer closed");
+    }
+
+    uint64_t pos = head;
+    copy_in(tx_data_, capacity_, pos, &header, sizeof(header));
+    pos += sizeof(header);
+    for (size_t i = 0; i < n; i++) {
+        copy_in(tx_data_, capacity_, pos, body[i].iov_base, body[i].iov_len);
+        pos += body[i].iov_len;
+    }
+    tx_->head.store(head + total, std::memory_order_release);
+    notify(tx_->data_seq, tx_->reader_waiting);
+
+    stats_.frames_sent++;
+    stats_.bytes_sent += sizeof(header) + len;
+}
+
+bool ShmTransport::recv(FrameHeader& header, std::vector<char>& body) {
+    const uint64_t tail = rx_->tail.load(std::memory_order_relaxed);
+    auto ready = [&] {
+        return rx_->head.load(std::memory_order_acquire) != tail ||
+               rx_->closed.load(std::memory_order_acquire);
+    };
+    if (!ready()) {
+        wait_until(rx_->data_seq, rx_->reader_waiting, ready, stats_.recv_syscalls);
+    }
+    // The writer publishes whole frames, so any data means a complete frame
+    if (rx_->head.load(std::memory_order_acquire) == tail) {
+        return false;  // Closed and drained
+    }
+
+    copy_out(rx_data_, capacity_, tail, &header, sizeof(header));
+    if (!valid_frame_header(header) || frame_bytes(header.length) > capacity_) {
+        throw std::runtime_error("shm: malformed frame header");
+    }
+    body.resize(header.length);
+    copy_out(rx_data_, capacity_, tail + sizeof(header), body.data(), header.length);
+    rx_->tail.store(tail + frame_bytes(header.length), std::memory_order_release);
+    notify(rx_->space_seq, rx_->writer_waiting);
+
+    stats_.frames_received++;
+    stats_.bytes_received += sizeof(header) + header.length;
+    return true;
+}
+
+} // namespace spu
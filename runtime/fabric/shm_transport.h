@@ -0,0 +1,81 @@
+/**
+ * SPU Fabric Shared Memory - Frame transport between processes on one host
+ *
+ * Two single-producer single-consumer byte rings in a POSIX shared memory
+ * object, one per direction. A frame is copied once into the ring by the
+ * sender and once out by the receiver; no system call is made while the
+ * peer keeps up. A side that finds its ring empty (or full) spins briefly,
+ * then sleeps on a futex in the shared mapping, and the peer only issues
+ * FUTEX_WAKE when a waiter has said it is sleeping.
+ *
+ * Frames must fit the ring (capacity bytes per direction).
+ */
+
+#ifndef SPU_SHM_TRANSPORT_H
+#define SPU_SHM_TRANSPORT_H
+
+#include "transport.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace spu {
+
+class ShmTransport : public Transport {
+public:
+    static constexpr size_t kDefaultCapacity = 8 * 1024 * 1024;
+
+    /**
+     * Create the shared object (name like "/spu-fabric-0") and take side 0
+     *
+     * The creator unlinks the name when it is destroyed.
+     *
+     * @param capacity Ring bytes per direction (rounded up to a power of two)
+     * @throws std::system_error if the object exists or cannot be mapped
+     */
+    static std::unique_ptr<ShmTransport> create(const std::string& name,
+                                                size_t capacity = kDefaultCapacity);
+
+    /**
+     * Attach to an object made by create() and take side 1
+     *
+     * @throws std::system_error if it does not exist
+     * @throws std::runtime_error if it is not a fabric ring
+     */
+    static std::unique_ptr<ShmTransport> open(const std::string& name);
+
+    // Marks this side closed, so the peer's recv() returns false once drained
+    ~ShmTransport() override;
+
+    ShmTransport(const ShmTransport&) = delete;
+    ShmTransport& operator=(const ShmTransport&) = delete;
+
+    const char* name() const override { return "shm"; }
+
+    /**
+     * @throws std::length_error if the frame is larger than the ring
+     * @throws std::runtime_error if the peer has closed
+     */
+    void send(const FrameHeader& header, const iovec* body, size_t n) override;
+    bool recv(FrameHeader& header, std::vector<char>& body) override;
+
+private:
+    struct Ring;
+
+    ShmTransport(void* base, size_t bytes, int side, const std::string& name);
+
+    void* base_;
+    size_t bytes_;
+    std::string unlink_name_;  // Set on the creating side
+    Ring* tx_;
+    Ring* rx_;
+    char* tx_data_;
+    char* rx_data_;
+    size_t capacity_;
+};
+
+} // namespace spu
+
+#endif // SPU_SHM_TRANSPORT_H
@@ -0,0 +1,290 @@
+/**
+ * SPU Fabric TCP - Frame transport over a TCP connection
+ */
+
+#include "tcp_transport.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <system_error>
+
+#include <linux/errqueue.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#ifndef SO_ZEROCOPY
+#define SO_ZEROCOPY 60
+#endif
+#ifndef MSG_ZEROCOPY
+#define MSG_ZEROCOPY 0x4000000
+#endif
+
+namespace spu {
+
+namespace {
+
+[[noreturn]] void throw_errno(const std::string& what) {
+    throw std::system_error(errno, std::generic_category(), what);
+}
+
+// Body pieces per sendmsg() (encode_glyph_frame() uses kGlyphFrameIovecs)
+constexpr size_t kMaxBodyIovecs = 64;
+
+} // namespace
+
+TcpTransport::TcpTransport(int fd, const TcpOptions& options)
+    : fd_(fd), options_(options), zerocopy_(false),
+      rbuf_(new char[std::max<size_t>(options.recv_buffer, sizeof(FrameHeader))]) {
+    options_.recv_buffer = std::max<size_t>(options.recv_buffer, sizeof(FrameHeader));
+    int one = 1;
+    setsockopt(fd_, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    if (options_.socket_buffer > 0) {
+        setsockopt(fd_, SOL_SOCKET, SO_SNDBUF, &options_.socket_buffer, sizeof(int));
+        setsockopt(fd_, SOL_SOCKET, SO_RCVBUF, &options_.socket_buffer, sizeof(int));
+    }
+    if (options_.zerocopy_bytes > 0) {
+        zerocopy_ = setsockopt(fd_, SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one)) == 0;
+    }
+}
+
+TcpTransport::~TcpTransport() {
+    close(fd_);
+}
+
+void TcpTransport::send(const FrameHeader& header, const iovec* body, size_t n) {
+    if (n > kMaxBodyIovecs) {
+        throw std::invalid_argument("tcp: too many body pieces");
+    }
+    iovec iov[1 + kMaxBodyIovecs];
+    iov[0].iov_base = const_cast<FrameHeader*>(&header);
+    iov[0].iov_len = sizeof(header);
+    size_t total = sizeof(header);
+    for (size_t i = 0; i < n; i++) {
+        iov[1 + i] = body[i];
+        total += body[i].iov_len;
+    }
+
+    int flags = MSG_NOSIGNAL;
+    if (zerocopy_ && total >= options_.zerocopy_bytes) {
+        flags |= MSG_ZEROCOPY;
+    }
+    size_t first = 0;
+    const size_t count = 1 + n;
+    while (first < count) {
+        msghdr msg{};
+        msg.msg_iov = iov + first;
+        msg.msg_iovlen = count - first;
+        ssize_t sent = sendmsg(fd_, &msg, flags);
+        stats_.send_syscalls++;
+        if (sent < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == ENOBUFS && (flags & MSG_ZEROCOPY)) {
+                flags &= ~MSG_ZEROCOPY;  // Out of optmem for pinning: copy instead
+                continue;
+            }
+            throw_errno("tcp sendmsg");
+        }
+        if (flags & MSG_ZEROCOPY) {
+            zerocopy_next_++;  // One completion id per successful call
+        }
+        // Skip fully sent pieces, trim a partial one
+        size_t left = static_cast<size_t>(sent);
+        while (first < count && left >= iov[first].iov_len) {
+            left -= iov[first].iov_len;
+            first++;
+        }
+        if (first < count) {
+            iov[first].iov_base = static_cast<char*>(iov[first].iov_base) + left;
+            iov[first].iov_len -= left;
+        }
+    }
+    if (zerocopy_done_ != zerocopy_next_) {
+        wait_zerocopy(zerocopy_next_);
+    }
+    stats_.frames_sent++;
+    stats_.bytes_sent += total;
+}
+
+void TcpTransport::wait_zerocopy(uint32_t id) {
+    bool copied = false;
+    bool any = false;
+    while (zerocopy_done_ != id) {
+        char control[128];
+        msghdr msg{};
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+        if (recvmsg(fd_, &msg, MSG_ERRQUEUE) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                throw_errno("tcp zerocopy completion");
+            }
+            pollfd p{fd_, 0, 0};  // POLLERR is always reported
+            poll(&p, 1, -1);
+            stats_.send_syscalls++;
+            continue;
+        }
+        stats_.send_syscalls++;
+        for (cmsghdr* c = CMSG_FIRSTHDR(&msg); c; c = CMSG_NXTHDR(&msg, c)) {
+            if (!((c->cmsg_level == SOL_IP && c->cmsg_type == IP_RECVERR) ||
+                  (c->cmsg_level == SOL_IPV6 && c->cmsg_type == IPV6_RECVERR))) {
+                continue;
+            }
+            const sock_extended_err* err = reinterpret_cast<const sock_extended_err*>(CMSG_DATA(c));
+            if (err->ee_origin != SO_EE_ORIGIN_ZEROCOPY) {
+                continue;
+            }
+            // Completions [ee_info, ee_data] arrive in order
+            zerocopy_done_ = err->ee_data + 1;
+            copied |= (err->ee_code & SO_EE_CODE_ZEROCOPY_COPIED) != 0;
+            any = true;
+        }
+    }
+    if (copied) {
+        zerocopy_ = false;
+    } else if (any) {
+        stats_.zerocopy_sends++;
+    }
+}
+
+size_t TcpTransport::read_some() {
+    if (rbeg_ > 0) {
+        memmove(rbuf_.get(), rbuf_.get() + rbeg_, rend_ - rbeg_);
+        rend_ -= rbeg_;
+        rbeg_ = 0;
+    }
+    for (;;) {
+        ssize_t got = ::recv(fd_, rbuf_.get() + rend_, options_.recv_buffer - rend_, 0);
+        stats_.recv_syscalls++;
+        if (got < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw_errno("tcp recv");
+        }
+        rend_ += static_cast<size_t>(got);
+        return static_cast<size_t>(got);
+    }
+}
+
+bool TcpTransport::recv(FrameHeader& header, std::vector<char>& body) {
+    while (rend_ - rbeg_ < sizeof(header)) {
+        if (read_some() == 0) {
+            if (rend_ == rbeg_) {
+                return false;
+            }
+            throw std::runtime_error("tcp: connection closed mid-frame");
+        }
+    }
+    memcpy(&header, rbuf_.get() + rbeg_, sizeof(header));
+    rbeg_ += sizeof(header);
+    if (!valid_frame_header(header)) {
+        throw std::runtime_error("tcp: malformed frame header");
+    }
+
+    body.resize(header.length);
+    size_t have = std::min<size_t>(rend_ - rbeg_, header.length);
+    memcpy(body.data(), rbuf_.get() + rbeg_, have);
+    rbeg_ += have;
+    // The rest of a large body goes straight into place
+    while (have < header.length) {
+        ssize_t got = ::recv(fd_, body.data() + have, header.length - have, MSG_WAITALL);
+        stats_.recv_syscalls++;
+        if (got < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw_errno("tcp recv");
+        }
+        if (got == 0) {
+            throw std::runtime_error("tcp: connection closed mid-frame");
+        }
+        have += static_cast<size_t>(got);
+    }
+    stats_.frames_received++;
+    stats_.bytes_received += sizeof(header) + header.length;
+    return true;
+}
+
+TcpListener::TcpListener(uint16_t port, const std::string& host) {
+    fd_ = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd_ < 0) {
+        throw_errno("tcp socket");
+    }
+    int one = 1;
+    setsockopt(fd_, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addrinfo hints{};
+    hints.ai_family = AF_INET;
+    addrinfo* res = nullptr;
+    if (getaddrinfo(host.c_str(), nullptr, &hints, &res) != 0 || !res) {
+        close(fd_);
+        throw std::runtime_error("tcp: cannot resolve " + host);
+    }
+    addr.sin_addr = reinterpret_cast<sockaddr_in*>(res->ai_addr)->sin_addr;
+    freeaddrinfo(res);
+    if (bind(fd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 || listen(fd_, 64) != 0) {
+        int err = errno;
+        close(fd_);
+        throw std::system_error(err, std::generic_category(), "tcp bind/listen");
+    }
+    socklen_t len = sizeof(addr);
+    getsockname(fd_, reinterpret_cast<sockaddr*>(&addr), &len);
+    port_ = ntohs(addr.sin_port);
+}
+
+TcpListener::~TcpListener() {
+    close(fd_);
+}
+
+std::unique_ptr<TcpTransport> TcpListener::accept(const TcpOptions& options) {
+    for (;;) {
+        int fd = ::accept4(fd_, nullptr, nullptr, SOCK_CLOEXEC);
+        if (fd >= 0) {
+            return std::unique_ptr<TcpTransport>(new TcpTransport(fd, options));
+        }
+        if (errno != EINTR) {
+            throw_errno("tcp accept");
+        }
+    }
+}
+
+std::unique_ptr<TcpTransport> tcp_connect(const std::string& host, uint16_t port,
+                                          const TcpOptions& options) {
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* res = nullptr;
+    std::string service = std::to_string(port);
+    if (getaddrinfo(host.c_str(), service.c_str(), &hints, &res) != 0 || !res) {
+        throw std::runtime_error("tcp: cannot resolve " + host);
+    }
+    int err = ECONNREFUSED;
+    for (addrinfo* a = res; a; a = a->ai_next) {
+        int fd = socket(a->ai_family, a->ai_socktype | SOCK_CLOEXEC, a->ai_protocol);
+        if (fd < 0) {
+            err = errno;
+            continue;
+        }
+        if (connect(fd, a->ai_addr, a->ai_addrlen) == 0) {
+            freeaddrinfo(res);
+            return std::unique_ptr<TcpTransport>(new TcpTransport(fd, options));
+        }
+        err = errno;
+        close(fd);
+    }
+    freeaddrinfo(res);
+    throw std::system_error(err, std::generic_category(), "tcp connect " + host);
+}
+
+} // namespace spu
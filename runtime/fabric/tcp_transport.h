@@ -0,0 +1,98 @@
+/**
+ * SPU Fabric TCP - Frame transport over a TCP connection
+ *
+ * A frame goes out as one sendmsg() gathering the header and the body
+ * iovecs (the store's columns), so nothing is copied in user space. At or
+ * above zerocopy_bytes the send uses MSG_ZEROCOPY: the kernel pins the
+ * pages and the NIC reads them directly; send() returns once the
+ * completion for that frame arrives on the socket error queue. If the
+ * kernel reports that it copied anyway (loopback, no scatter-gather NIC),
+ * zerocopy is turned off for the connection, since the completion
+ * round trip then only adds latency.
+ *
+ * Receives go through a per-connection buffer, so a stream of small frames
+ * costs one recv() per buffer fill rather than two per frame.
+ */
+
+#ifndef SPU_TCP_TRANSPORT_H
+#define SPU_TCP_TRANSPORT_H
+
+#include "transport.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace spu {
+
+struct TcpOptions {
+    size_t zerocopy_bytes = 64 * 1024;   // Frames this large use MSG_ZEROCOPY (0 = never)
+    size_t recv_buffer = 256 * 1024;     // User-space receive buffer
+    int socket_buffer = 4 * 1024 * 1024; // SO_SNDBUF / SO_RCVBUF (0 = kernel default)
+};
+
+class TcpTransport : public Transport {
+public:
+    // Take ownership of a connected socket (sets TCP_NODELAY)
+    TcpTransport(int fd, const TcpOptions& options = TcpOptions());
+    ~TcpTransport() override;
+
+    TcpTransport(const TcpTransport&) = delete;
+    TcpTransport& operator=(const TcpTransport&) = delete;
+
+    const char* name() const override { return "tcp"; }
+
+    void send(const FrameHeader& header, const iovec* body, size_t n) override;
+    bool recv(FrameHeader& header, std::vector<char>& body) override;
+
+    int fd() const { return fd_; }
+    bool zerocopy() const { return zerocopy_; }
+
+private:
+    size_t read_some();
+    void wait_zerocopy(uint32_t id);
+
+    int fd_;
+    TcpOptions options_;
+    bool zerocopy_;
+    uint32_t zerocopy_next_ = 0;   // Id of the next MSG_ZEROCOPY send
+    uint32_t zerocopy_done_ = 0;   // Completions reaped (ids below are done)
+
+    std::unique_ptr<char[]> rbuf_;
+    size_t rbeg_ = 0;
+    size_t rend_ = 0;
+};
+
+/**
+ * Listening socket
+ *
+ * @param port 0 = any free port (see port())
+ */
+class TcpListener {
+public:
+    explicit TcpListener(uint16_t port, const std::string& host = "0.0.0.0");
+    ~TcpListener();
+
+    TcpListener(const TcpListener&) = delete;
+    TcpListener& operator=(const TcpListener&) = delete;
+
+    uint16_t port() const { return port_; }
+
+    // Block for the next connection
+    std::unique_ptr<TcpTransport> accept(const TcpOptions& options = TcpOptions());
+
+private:
+    int fd_;
+    uint16_t port_;
+};
+
+/**
+ * @throws std::system_error if the connection fails
+ */
+std::unique_ptr<TcpTransport> tcp_connect(const std::string& host, uint16_t port,
+                                          const TcpOptions& options = TcpOptions());
+
+} // namespace spu
+
+#endif // SPU_TCP_TRANSPORT_H
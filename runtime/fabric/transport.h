@@ -0,0 +1,72 @@
+/**
+ * SPU Fabric Transport - Frame transport between two nodes
+ *
+ * A Transport moves whole frames over one connection in each direction.
+ * Implementations: TCP (tcp_transport.h), shared memory for peers on the
+ * same host (shm_transport.h) and ibverbs RDMA (rdma_transport.h, built
+ * with -DSPU_WITH_IBVERBS). Channels (fabric.h) batch small messages on
+ * top of any of them.
+ *
+ * A transport is used by one sending and one receiving thread at a time.
+ */
+
+#ifndef SPU_TRANSPORT_H
+#define SPU_TRANSPORT_H
+
+#include "frame.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <sys/uio.h>
+
+namespace spu {
+
+class Transport {
+public:
+    struct Stats {
+        uint64_t frames_sent;
+        uint64_t bytes_sent;      // Headers included
+        uint64_t frames_received;
+        uint64_t bytes_received;
+        uint64_t send_syscalls;   // Send / wait calls into the kernel on the send side
+        uint64_t recv_syscalls;   // Receive / wait calls on the receive side
+        uint64_t zerocopy_sends;  // Frames the NIC read straight from caller memory
+    };
+
+    virtual ~Transport() = default;
+
+    virtual const char* name() const = 0;
+
+    /**
+     * Send one frame: the header, then the body pieces in order
+     *
+     * Blocks until the body memory may be reused.
+     *
+     * @throws std::system_error or std::runtime_error if the connection fails
+     */
+    virtual void send(const FrameHeader& header, const iovec* body, size_t n) = 0;
+
+    /**
+     * Receive the next frame
+     *
+     * @param body Resized to header.length (8-byte-aligned data)
+     * @return false once the peer has closed the connection cleanly
+     * @throws std::runtime_error on a malformed frame or a failed connection
+     */
+    virtual bool recv(FrameHeader& header, std::vector<char>& body) = 0;
+
+    /**
+     * Counters; the send-side and receive-side fields are separate, so one
+     * thread may send while another receives
+     */
+    Stats stats() const { return stats_; }
+
+protected:
+    Stats stats_{};
+};
+
+} // namespace spu
+
+#endif // SPU_TRANSPORT_H
@@ -2,16 +2,78 @@
  * Python bindings for SPU merge primitive using pybind11
  *
  * Build: python3 setup.py build_ext --inplace
- * Usage: from spu_merge import merge, Glyph
+ * Usage: from spu_merge import merge, Glyph, GlyphArray
+ *
+ * Glyph IDs are 64-char hex strings on the Python side and binary GlyphId
+ * internally; conversion happens only in this file.
+ *
+ * GlyphArray owns a native GlyphStore and exposes its numeric columns as
+ * NumPy views, so batch callers cross the Python boundary once per batch
+ * instead of once per glyph. Batch entry points release the GIL and split
+ * large batches across the native thread pool; do not mutate an array
+ * from another thread while a batch on it is running.
+ *
+ * GlyphIndex wraps the native ID / prefix / token index; pass index= to
+ * merge() or merge_batch() to index results as they are produced.
+ *
+ * LazyDecay attaches event-driven decay to a GlyphArray (kept alive while
+ * attached); its energy() / activation_count() are current, the array's
+ * columns only after touch() or materialize().
+ *
+ * ProvenanceGraph answers lineage queries by integer handle; find() maps
+ * an ID to its handle and id() maps back.
+ *
+ * Snapshot maps a snapshot file (written by write_snapshot() or
+ * runtime/cli/glyph_snapshot.py) read-only; load() copies one glyph out,
+ * to_store() the whole file.
  */
 
 #include <pybind11/pybind11.h>
+#include <pybind11/numpy.h>
 #include <pybind11/stl.h>
 #include "merge_ref.h"
+#include "glyph_store.h"
+#include "glyph_index.h"
+#include "dynamics.h"
+#include "lazy_decay.h"
+#include "provenance.h"
+#include "snapshot.h"
+#include "tick_scheduler.h"
+#include "perf_counters.h"
+#include "telemetry.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <memory>
+#include <vector>
 
 namespace py = pybind11;
 using namespace spu;
 
+// Hex string <-> binary GlyphId (IDs are hex only at the Python edge)
+static GlyphId id_from_python(const std::string& hex) {
+    if (hex.empty()) {
+        return GlyphId::zero();
+    }
+    GlyphId id;
+    if (!GlyphId::from_hex(hex.data(), hex.size(), id)) {
+        throw py::value_error("glyph id must be a 64-char hex SHA-256 digest: '" + hex + "'");
+    }
+    return id;
+}
+
+static std::string id_to_python(const GlyphId& id) {
+    return id.is_zero() ? std::string() : id.hex();
+}
+
+// Per-thread arena for single-glyph conversions; reset by each call, so
+// steady-state merge() calls allocate only the Python-side strings
+static ContentArena& scratch_arena() {
+    thread_local ContentArena arena;
+    arena.reset();
+    return arena;
+}
+
 // Python-friendly Glyph wrapper
 struct PyGlyph {
     std::string id;
@@ -22,12 +84,11 @@ struct PyGlyph {
     std::string parent1_id;
     std::string parent2_id;
 
-    // Convert to C++ Glyph
-    Glyph to_cpp() const {
+    // Convert to C++ Glyph (content longer than Content::kInlineCapacity goes in arena)
+    Glyph to_cpp(ContentArena& arena) const {
         Glyph g;
-        strncpy(g.id, id.c_str(), 64);
-        strncpy(g.content, content.c_str(), 256);
-        g.content_len = std::min(content.length(), size_t(255));
+        g.id = id_from_python(id);
+        g.content.assign(content.data(), content.size(), arena);
         g.energy = energy;
         g.activation_count = activation_count;
         g.last_update_time = last_update_time;
@@ -37,28 +98,287 @@ struct PyGlyph {
     // Convert from C++ Glyph
     static PyGlyph from_cpp(const Glyph& g) {
         PyGlyph pg;
-        pg.id = std::string(g.id);
-        pg.content = std::string(g.content, g.content_len);
+        pg.id = id_to_python(g.id);
+        pg.content = g.content.str();
         pg.energy = g.energy;
         pg.activation_count = g.activation_count;
         pg.last_update_time = g.last_update_time;
-        pg.parent1_id = std::string(g.parent1_id);
-        pg.parent2_id = std::string(g.parent2_id);
+        pg.parent1_id = id_to_python(g.parent1_id);
+        pg.parent2_id = id_to_python(g.parent2_id);
         return pg;
     }
 };
 
-// Python-callable merge function
-PyGlyph py_merge(const PyGlyph& g1, const PyGlyph& g2) {
-    Glyph cpp_g1 = g1.to_cpp();
-    Glyph cpp_g2 = g2.to_cpp();
-    Glyph result;
+// Python-callable merge function (indexes the result if index is given)
+PyGlyph py_merge(const PyGlyph& g1, const PyGlyph& g2, GlyphIndex* index) {
+    ContentArena& arena = scratch_arena();
+    Glyph cpp_g1 = g1.to_cpp(arena);
+    Glyph cpp_g2 = g2.to_cpp(arena);
+    Glyph result(no_init);
 
-    merge(cpp_g1, cpp_g2, result);
+    if (index) {
+        merge(cpp_g1, cpp_g2, result, arena, *index);
+    } else {
+        merge(cpp_g1, cpp_g2, result, arena);
+    }
 
     return PyGlyph::from_cpp(result);
 }
 
+// Python-visible SoA glyph array
+struct PyGlyphArray {
+    GlyphStore store;
+
+    PyGlyphArray() = default;
+
+    explicit PyGlyphArray(const std::vector<PyGlyph>& glyphs) {
+        ContentArena arena;
+        store.reserve(glyphs.size());
+        for (const PyGlyph& pg : glyphs) {
+            append(pg, arena);
+        }
+    }
+
+    void append(const PyGlyph& pg, ContentArena& arena) {
+        Glyph g = pg.to_cpp(arena);
+        g.parent1_id = id_from_python(pg.parent1_id);
+        g.parent2_id = id_from_python(pg.parent2_id);
+        store.append(g);
+    }
+
+    size_t checked_index(ssize_t i) const {
+        ssize_t n = static_cast<ssize_t>(store.size());
+        if (i < 0) {
+            i += n;
+        }
+        if (i < 0 || i >= n) {
+            throw py::index_error("glyph index out of range");
+        }
+        return static_cast<size_t>(i);
+    }
+
+    PyGlyph get(ssize_t i) const {
+        Glyph g(no_init);
+        store.load(checked_index(i), g, scratch_arena());
+        return PyGlyph::from_cpp(g);
+    }
+};
+
+// Writable 1-D NumPy view of a column; owner keeps the array alive.
+// Views are invalidated when the array grows (append).
+template <typename T>
+static py::array_t<T> column_view(T* data, size_t n, py::handle owner) {
+    return py::array_t<T>({static_cast<ssize_t>(n)}, {static_cast<ssize_t>(sizeof(T))},
+                          data, owner);
+}
+
+static_assert(sizeof(MergePair) == 2 * sizeof(uint32_t), "MergePair must match an Nx2 uint32 array");
+
+// Merge index pairs (N x 2 array) of an array into a new array
+static PyGlyphArray py_merge_batch(const PyGlyphArray& in,
+                                   py::array_t<uint32_t, py::array::c_style | py::array::forcecast> pairs,
+                                   GlyphIndex* index) {
+    if (pairs.ndim() != 2 || pairs.shape(1) != 2) {
+        throw py::value_error("pairs must have shape (N, 2)");
+    }
+    const size_t n = static_cast<size_t>(pairs.shape(0));
+    const MergePair* p = reinterpret_cast<const MergePair*>(pairs.data());
+    for (size_t i = 0; i < n; i++) {
+        if (p[i].first >= in.store.size() || p[i].second >= in.store.size()) {
+            throw py::index_error("merge pair index out of range");
+        }
+    }
+
+    PyGlyphArray out;
+    {
+        py::gil_scoped_release release;
+        merge_batch(in.store, p, n, out.store, default_thread_pool().get());
+    }
+    if (index) {
+        index->add(out.store);  // Under the GIL: GlyphIndex is not thread-safe
+    }
+    return out;
+}
+
+static std::vector<std::string> ids_to_python(const std::vector<GlyphId>& ids) {
+    std::vector<std::string> out;
+    out.reserve(ids.size());
+    for (const GlyphId& id : ids) {
+        out.push_back(id.hex());
+    }
+    return out;
+}
+
+// One dynamics step over the whole array; returns per-glyph activation flags.
+// time_delta is an int or an array with one delta per glyph.
+static py::array_t<bool> py_step(PyGlyphArray& array, py::object time_delta,
+                                 double activation_threshold, double decay_rate) {
+    using DeltaArray = py::array_t<uint64_t, py::array::c_style | py::array::forcecast>;
+
+    DynamicsEngine engine(activation_threshold, decay_rate);
+    py::array_t<bool> activated(static_cast<ssize_t>(array.store.size()));
+    uint8_t* flags = reinterpret_cast<uint8_t*>(activated.mutable_data());
+
+    if (py::isinstance<py::int_>(time_delta)) {
+        uint64_t dt = time_delta.cast<uint64_t>();
+        {
+            py::gil_scoped_release release;
+            TickScheduler(engine, default_thread_pool().get()).step(array.store, dt, flags);
+        }
+        return activated;
+    }
+
+    DeltaArray deltas = DeltaArray::ensure(time_delta);
+    if (!deltas || deltas.ndim() != 1 ||
+        static_cast<size_t>(deltas.shape(0)) != array.store.size()) {
+        throw py::value_error("time_delta must be an int or have one entry per glyph");
+    }
+    {
+        py::gil_scoped_release release;
+        engine.step(array.store, deltas.data(), flags);
+    }
+    return activated;
+}
+
+// One tick: step the array in place, then merge (N, 2) index pairs of the
+// stepped array; returns (merged GlyphArray, activation flags)
+static py::tuple py_tick(PyGlyphArray& array,
+                         py::array_t<uint32_t, py::array::c_style | py::array::forcecast> pairs,
+                         uint64_t time_delta, double activation_threshold, double decay_rate) {
+    if (pairs.ndim() != 2 || pairs.shape(1) != 2) {
+        throw py::value_error("pairs must have shape (N, 2)");
+    }
+    const size_t n = static_cast<size_t>(pairs.shape(0));
+    const MergePair* p = reinterpret_cast<const MergePair*>(pairs.data());
+    for (size_t i = 0; i < n; i++) {
+        if (p[i].first >= array.store.size() || p[i].second >= array.store.size()) {
+            throw py::index_error("merge pair index out of range");
+        }
+    }
+
+    DynamicsEngine engine(activation_threshold, decay_rate);
+    py::array_t<bool> activated(static_cast<ssize_t>(array.store.size()));
+    uint8_t* flags = reinterpret_cast<uint8_t*>(activated.mutable_data());
+    PyGlyphArray out;
+    {
+        py::gil_scoped_release release;
+        TickScheduler scheduler(engine, default_thread_pool().get());
+        scheduler.tick(array.store, time_delta, p, n, out.store, flags);
+    }
+    return py::make_tuple(std::move(out), activated);
+}
+
+static size_t lazy_index(const LazyDecay& lazy, ssize_t i) {
+    if (i < 0) {
+        i += static_cast<ssize_t>(lazy.size());
+    }
+    if (i < 0 || static_cast<size_t>(i) >= lazy.size()) {
+        throw py::index_error("glyph index out of range");
+    }
+    return static_cast<size_t>(i);
+}
+
+// Touch and merge (N, 2) index pairs of the attached array into a new GlyphArray
+static PyGlyphArray py_lazy_merge_batch(LazyDecay& lazy,
+                                        py::array_t<uint32_t, py::array::c_style | py::array::forcecast> pairs) {
+    if (pairs.ndim() != 2 || pairs.shape(1) != 2) {
+        throw py::value_error("pairs must have shape (N, 2)");
+    }
+    PyGlyphArray out;
+    const MergePair* p = reinterpret_cast<const MergePair*>(pairs.data());
+    {
+        py::gil_scoped_release release;
+        lazy.merge_batch(p, static_cast<size_t>(pairs.shape(0)), out.store,
+                         default_thread_pool().get());
+    }
+    return out;
+}
+
+using Handle = ProvenanceGraph::Handle;
+
+static Handle provenance_handle(const ProvenanceGraph& graph, Handle h) {
+    if (h >= graph.size()) {
+        throw py::index_error("provenance handle out of range");
+    }
+    return h;
+}
+
+// Ancestor or descendant counts of a list of handles
+template <bool kDown>
+static std::vector<uint64_t> py_provenance_counts(const ProvenanceGraph& graph,
+                                                  const std::vector<Handle>& sources) {
+    for (Handle h : sources) {
+        provenance_handle(graph, h);
+    }
+    std::vector<uint64_t> out(sources.size());
+    py::gil_scoped_release release;
+    if (kDown) {
+        graph.descendant_counts(sources.data(), sources.size(), out.data());
+    } else {
+        graph.ancestor_counts(sources.data(), sources.size(), out.data());
+    }
+    return out;
+}
+
+static size_t snapshot_index(const Snapshot& snap, ssize_t i) {
+    if (i < 0) {
+        i += static_cast<ssize_t>(snap.size());
+    }
+    if (i < 0 || static_cast<size_t>(i) >= snap.size()) {
+        throw py::index_error("glyph index out of range");
+    }
+    return static_cast<size_t>(i);
+}
+
+// Per-phase counters as {phase: {counter: value}} (phases that ran only)
+static py::dict py_perf_stats() {
+    PerfStats stats[kPerfNumPhases];
+    perf_snapshot(stats);
+
+    py::dict out;
+    for (size_t p = 0; p < kPerfNumPhases; p++) {
+        const PerfStats& s = stats[p];
+        if (s.calls == 0) {
+            continue;
+        }
+        py::dict d;
+        d["calls"] = s.calls;
+        d["items"] = s.items;
+        d["nanoseconds"] = s.nanoseconds;
+        d["cycles"] = s.cycles;
+        d["instructions"] = s.instructions;
+        d["cache_misses"] = s.cache_misses;
+        d["branch_misses"] = s.branch_misses;
+        out[perf_phase_name(static_cast<PerfPhase>(p))] = d;
+    }
+    return out;
+}
+
+// Telemetry as {histogram: {count, sum, max, mean, p50, p90, p99, p999}, counter: value}
+static py::dict py_telemetry_stats() {
+    std::unique_ptr<TelemetrySnapshot> snapshot(new TelemetrySnapshot());
+    telemetry_snapshot(*snapshot);
+
+    py::dict out;
+    for (size_t h = 0; h < kTelemetryNumHistograms; h++) {
+        const HistogramSnapshot& s = snapshot->histograms[h];
+        py::dict d;
+        d["count"] = s.count;
+        d["sum"] = s.sum;
+        d["max"] = s.max;
+        d["mean"] = s.mean();
+        d["p50"] = s.quantile(0.50);
+        d["p90"] = s.quantile(0.90);
+        d["p99"] = s.quantile(0.99);
+        d["p999"] = s.quantile(0.999);
+        out[telemetry_histogram_name(static_cast<TelemetryHistogram>(h))] = d;
+    }
+    for (size_t c = 0; c < kTelemetryNumCounters; c++) {
+        out[telemetry_counter_name(static_cast<TelemetryCounter>(c))] = snapshot->counters[c];
+    }
+    return out;
+}
+
 // Module definition
 PYBIND11_MODULE(spu_merge, m) {
     m.doc() = "SPU merge primitive - C++ accelerated glyph merging";
@@ -79,9 +399,253 @@ PYBIND11_MODULE(spu_merge, m) {
         });
 
     // merge function
+    // GlyphIndex class (declared before merge so index= arguments resolve)
+    py::class_<GlyphIndex>(m, "GlyphIndex")
+        .def(py::init<>())
+        .def_static("load", &GlyphIndex::load, "Read an index file", py::arg("path"))
+        .def("save", &GlyphIndex::save, "Write an index file (readable by glyph_index.py)",
+             py::arg("path"))
+        .def("__len__", &GlyphIndex::size)
+        .def_property_readonly("token_count", &GlyphIndex::token_count)
+        .def("add", [](GlyphIndex& index, const std::string& id, const std::string& content) {
+            index.add(id_from_python(id), content.data(), content.size());
+        }, "Index a glyph ID and its content tokens", py::arg("id"), py::arg("content"))
+        .def("add", [](GlyphIndex& index, const PyGlyph& g) {
+            index.add(id_from_python(g.id), g.content.data(), g.content.size());
+        }, py::arg("glyph"))
+        .def("add", [](GlyphIndex& index, const PyGlyphArray& a) { index.add(a.store); },
+             py::arg("array"))
+        .def("__contains__", [](const GlyphIndex& index, const std::string& id) {
+            GlyphId key;
+            return GlyphId::from_hex(id.data(), id.size(), key) && index.contains(key);
+        })
+        .def("find_prefix", [](const GlyphIndex& index, const std::string& prefix, size_t limit) {
+            try {
+                return ids_to_python(index.find_prefix(prefix, limit));
+            } catch (const std::invalid_argument& e) {
+                throw py::value_error(e.what());
+            }
+        }, "IDs starting with a hex prefix, ascending", py::arg("prefix"), py::arg("limit") = 100)
+        .def("find_tokens", [](const GlyphIndex& index, const std::vector<std::string>& tokens,
+                               size_t limit) {
+            std::vector<GlyphId> ids;
+            for (uint32_t o : index.find_tokens(tokens, limit)) {
+                ids.push_back(index.id(o));
+            }
+            return ids_to_python(ids);
+        }, "IDs whose content contains every token", py::arg("tokens"), py::arg("limit") = 100)
+        .def("__repr__", [](const GlyphIndex& index) {
+            return "<GlyphIndex len=" + std::to_string(index.size()) +
+                   " tokens=" + std::to_string(index.token_count()) + ">";
+        });
+
     m.def("merge", &py_merge,
           "Merge two glyphs with energy-based precedence",
-          py::arg("glyph1"), py::arg("glyph2"));
+          py::arg("glyph1"), py::arg("glyph2"), py::arg("index") = nullptr);
+
+    // GlyphArray class
+    py::class_<PyGlyphArray>(m, "GlyphArray")
+        .def(py::init<>())
+        .def(py::init<const std::vector<PyGlyph>&>(), py::arg("glyphs"))
+        .def("__len__", [](const PyGlyphArray& a) { return a.store.size(); })
+        .def("__getitem__", &PyGlyphArray::get, py::arg("index"))
+        .def("append", [](PyGlyphArray& a, const PyGlyph& g) {
+            ContentArena arena;
+            a.append(g, arena);
+        }, py::arg("glyph"))
+        .def("id", [](const PyGlyphArray& a, ssize_t i) {
+            return id_to_python(a.store.id(a.checked_index(i)));
+        }, py::arg("index"))
+        .def("content", [](const PyGlyphArray& a, ssize_t i) {
+            size_t k = a.checked_index(i);
+            return std::string(a.store.content(k), a.store.content_len(k));
+        }, py::arg("index"))
+        .def_property_readonly("energy", [](py::object self) {
+            PyGlyphArray& a = self.cast<PyGlyphArray&>();
+            return column_view(a.store.energy(), a.store.size(), self);
+        })
+        .def_property_readonly("activation_count", [](py::object self) {
+            PyGlyphArray& a = self.cast<PyGlyphArray&>();
+            return column_view(a.store.activation_count(), a.store.size(), self);
+        })
+        .def_property_readonly("last_update_time", [](py::object self) {
+            PyGlyphArray& a = self.cast<PyGlyphArray&>();
+            return column_view(a.store.last_update_time(), a.store.size(), self);
+        })
+        .def("__repr__", [](const PyGlyphArray& a) {
+            return "<GlyphArray len=" + std::to_string(a.store.size()) + ">";
+        });
+
+    m.def("merge_batch", &py_merge_batch,
+          "Merge (N, 2) index pairs of a GlyphArray into a new GlyphArray",
+          py::arg("array"), py::arg("pairs"), py::arg("index") = nullptr);
+
+    m.def("step", &py_step,
+          "Decay then activate every glyph in place; returns activation flags",
+          py::arg("array"), py::arg("time_delta") = 1,
+          py::arg("activation_threshold") = 1.0, py::arg("decay_rate") = 0.1);
+
+    m.def("tick", &py_tick,
+          "Step every glyph in place, then merge (N, 2) index pairs of the stepped array; "
+          "returns (merged GlyphArray, activation flags)",
+          py::arg("array"), py::arg("pairs"), py::arg("time_delta") = 1,
+          py::arg("activation_threshold") = 1.0, py::arg("decay_rate") = 0.1);
+
+    // Native exceptions: out_of_range -> IndexError, invalid_argument -> ValueError
+    py::class_<LazyDecay>(m, "LazyDecay")
+        .def(py::init([](PyGlyphArray& array, double activation_threshold, double decay_rate,
+                         uint64_t tick_delta) {
+            return new LazyDecay(DynamicsEngine(activation_threshold, decay_rate), array.store,
+                                 tick_delta);
+        }), py::keep_alive<1, 2>(),
+             py::arg("array"), py::arg("activation_threshold") = 1.0,
+             py::arg("decay_rate") = 0.1, py::arg("tick_delta") = 1)
+        .def("__len__", &LazyDecay::size)
+        .def_property_readonly("now", &LazyDecay::now)
+        .def("tick", &LazyDecay::tick,
+             "Advance n ticks and retire glyphs below the threshold; returns active count",
+             py::arg("n") = 1)
+        .def("active", [](const LazyDecay& lazy) {
+            std::vector<uint32_t> active = lazy.active();
+            std::sort(active.begin(), active.end());
+            return active;
+        }, "Indexes of glyphs at or over the threshold, ascending")
+        .def("energy", [](const LazyDecay& lazy, ssize_t i) {
+            return lazy.energy(lazy_index(lazy, i));
+        }, py::arg("index"))
+        .def("activation_count", [](const LazyDecay& lazy, ssize_t i) {
+            return lazy.activation_count(lazy_index(lazy, i));
+        }, py::arg("index"))
+        .def("touch", [](LazyDecay& lazy, ssize_t i) { lazy.touch(lazy_index(lazy, i)); },
+             "Write a glyph's current state into the array columns", py::arg("index"))
+        .def("materialize", &LazyDecay::materialize, "touch() every glyph")
+        .def("set_energy", [](LazyDecay& lazy, ssize_t i, double energy) {
+            lazy.set_energy(lazy_index(lazy, i), energy);
+        }, py::arg("index"), py::arg("energy"))
+        .def("sync", &LazyDecay::sync, "Track glyphs appended to the array since the last call")
+        .def("merge_batch", &py_lazy_merge_batch,
+             "Touch both sides of (N, 2) index pairs, then merge them into a new GlyphArray",
+             py::arg("pairs"));
+
+    py::class_<ProvenanceGraph>(m, "ProvenanceGraph")
+        .def(py::init<>())
+        .def("__len__", &ProvenanceGraph::size)
+        .def("add", [](ProvenanceGraph& graph, const std::string& id, const std::string& parent1,
+                       const std::string& parent2) {
+            return graph.add(id_from_python(id), id_from_python(parent1), id_from_python(parent2));
+        }, "Record a glyph ID and its parents ('' = none); returns its handle",
+             py::arg("id"), py::arg("parent1") = "", py::arg("parent2") = "")
+        .def("add", [](ProvenanceGraph& graph, const PyGlyph& g) {
+            return graph.add(id_from_python(g.id), id_from_python(g.parent1_id),
+                             id_from_python(g.parent2_id));
+        }, py::arg("glyph"))
+        .def("add", [](ProvenanceGraph& graph, const PyGlyphArray& a) { graph.add(a.store); },
+             py::arg("array"))
+        .def("find", [](const ProvenanceGraph& graph, const std::string& id) -> py::object {
+            GlyphId key;
+            Handle h = GlyphId::from_hex(id.data(), id.size(), key) ? graph.find(key)
+                                                                     : ProvenanceGraph::kNone;
+            return h == ProvenanceGraph::kNone ? py::object(py::none()) : py::int_(h);
+        }, "Handle of an ID, or None", py::arg("id"))
+        .def("id", [](const ProvenanceGraph& graph, Handle h) {
+            return id_to_python(graph.id(provenance_handle(graph, h)));
+        }, py::arg("handle"))
+        .def("parents", [](const ProvenanceGraph& graph, Handle h) {
+            provenance_handle(graph, h);
+            std::vector<Handle> out;
+            for (Handle p : {graph.parent1(h), graph.parent2(h)}) {
+                if (p != ProvenanceGraph::kNone && (out.empty() || out[0] != p)) {
+                    out.push_back(p);
+                }
+            }
+            return out;
+        }, "Parent handles (distinct)", py::arg("handle"))
+        .def("children", [](const ProvenanceGraph& graph, Handle h) {
+            std::vector<Handle> out;
+            graph.for_each_child(provenance_handle(graph, h), [&](Handle c) { out.push_back(c); });
+            return out;
+        }, py::arg("handle"))
+        .def("ancestors", [](const ProvenanceGraph& graph, Handle h, size_t max_depth) {
+            return graph.ancestors(provenance_handle(graph, h), max_depth);
+        }, "Ancestor handles, breadth-first", py::arg("handle"),
+             py::arg("max_depth") = ProvenanceGraph::kUnlimited)
+        .def("descendants", [](const ProvenanceGraph& graph, Handle h, size_t max_depth) {
+            return graph.descendants(provenance_handle(graph, h), max_depth);
+        }, "Descendant handles, breadth-first", py::arg("handle"),
+             py::arg("max_depth") = ProvenanceGraph::kUnlimited)
+        .def("common_ancestors", [](const ProvenanceGraph& graph, Handle a, Handle b) {
+            return graph.common_ancestors(provenance_handle(graph, a), provenance_handle(graph, b));
+        }, "Handles that are ancestors of both, nearest first", py::arg("a"), py::arg("b"))
+        .def("ancestor_counts", &py_provenance_counts<false>,
+             "Ancestor count of each handle (bit-parallel BFS)", py::arg("handles"))
+        .def("descendant_counts", &py_provenance_counts<true>,
+             "Descendant count of each handle (bit-parallel BFS)", py::arg("handles"))
+        .def("compact", &ProvenanceGraph::compact, "Fold new child edges into CSR")
+        .def_property_readonly("memory_bytes", &ProvenanceGraph::memory_bytes)
+        .def("__repr__", [](const ProvenanceGraph& graph) {
+            return "<ProvenanceGraph len=" + std::to_string(graph.size()) + ">";
+        });
+
+    py::class_<Snapshot>(m, "Snapshot")
+        .def(py::init<const std::string&>(), "Map a snapshot file read-only", py::arg("path"))
+        .def("__len__", &Snapshot::size)
+        .def("find", [](const Snapshot& snap, const std::string& id) -> py::object {
+            GlyphId key;
+            size_t i = GlyphId::from_hex(id.data(), id.size(), key) ? snap.find(key)
+                                                                     : Snapshot::npos;
+            return i == Snapshot::npos ? py::object(py::none()) : py::int_(i);
+        }, "Index of an ID, or None", py::arg("id"))
+        .def("id", [](const Snapshot& snap, ssize_t i) {
+            return id_to_python(snap.id(snapshot_index(snap, i)));
+        }, py::arg("index"))
+        .def("load", [](const Snapshot& snap, ssize_t i) {
+            Glyph g(no_init);
+            snap.load(snapshot_index(snap, i), g);
+            return PyGlyph::from_cpp(g);
+        }, "Glyph i (a copy)", py::arg("index"))
+        .def("document", [](const Snapshot& snap, ssize_t i) {
+            const size_t k = snapshot_index(snap, i);
+            return py::bytes(snap.document(k), snap.document_len(k));
+        }, "Original JSON document of glyph i (b'' if none)", py::arg("index"))
+        .def("to_store", [](const Snapshot& snap) {
+            PyGlyphArray out;
+            py::gil_scoped_release release;
+            out.store = snap.to_store();
+            return out;
+        }, "Copy every glyph into a new GlyphArray")
+        .def("prefetch", &Snapshot::prefetch, "Start reading the whole file in the background")
+        .def("__repr__", [](const Snapshot& snap) {
+            return "<Snapshot len=" + std::to_string(snap.size()) + ">";
+        });
+
+    m.def("write_snapshot", [](const PyGlyphArray& a, const std::string& path) {
+        py::gil_scoped_release release;
+        write_snapshot(a.store, path);
+    }, "Write an array as a snapshot (sorted by ID, no documents)",
+          py::arg("array"), py::arg("path"));
+
+    m.def("set_num_threads", [](size_t n) { set_num_threads(n); },
+          "Set the native thread count for batch calls (0 = all cores)",
+          py::arg("num_threads"));
+
+    m.def("get_num_threads", []() { return num_threads(); },
+          "Native thread count used by batch calls");
+
+    m.def("perf_stats", &py_perf_stats,
+          "Per-phase perf counters summed over threads (build with SPU_PERF_COUNTERS=1)");
+
+    m.def("perf_reset", []() { perf_reset(); }, "Zero the perf counters");
+
+    m.def("perf_source", []() { return std::string(perf_source()); },
+          "Counter source: 'perf_event', 'tsc' or 'disabled'");
+
+    m.def("telemetry_stats", &py_telemetry_stats,
+          "Telemetry histograms (ns for *_seconds) and counters summed over threads");
+
+    m.def("telemetry_openmetrics", []() { return telemetry_openmetrics(); },
+          "Telemetry in OpenMetrics text format, for a /metrics scrape");
+
+    m.def("telemetry_reset", []() { telemetry_reset(); }, "Zero the telemetry");
 
     // Version info
     m.attr("__version__") = "1.0.0";
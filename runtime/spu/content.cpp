@@ -0,0 +1,142 @@
+/**
+ * SPU Glyph Content - Variable-length content storage
+ */
+
+#include "content.h"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace spu {
+
+ContentArena::ContentArena(size_t chunk_size)
+    : chunk_size_(std::max<size_t>(chunk_size, 64)),
+      current_(0),
+      offset_(0),
+      bytes_used_(0),
+      bytes_reserved_(0) {}
+
+void ContentArena::next_chunk(size_t len) {
+    size_t next = chunks_.empty() ? 0 : current_ + 1;
+    if (next == chunks_.size() || chunks_[next].size < len) {
+        // Oversized requests get a dedicated chunk so nothing is wasted; a
+        // kept chunk too small for one is replaced, so reuse cannot pile up
+        size_t size = std::max(chunk_size_, len);
+        Chunk chunk{std::unique_ptr<char[]>(new char[size]), size};
+        bytes_reserved_ += size;
+        if (next == chunks_.size()) {
+            chunks_.push_back(std::move(chunk));
+        } else {
+            bytes_reserved_ -= chunks_[next].size;
+            chunks_[next] = std::move(chunk);
+        }
+    }
+    current_ = next;
+    offset_ = 0;
+}
+
+char* ContentArena::allocate(size_t len) {
+    if (chunks_.empty() || chunks_[current_].size - offset_ < len) {
+        next_chunk(len);
+    }
+    char* p = chunks_[current_].data.get() + offset_;
+    offset_ += len;
+    bytes_used_ += len;
+    return p;
+}
+
+void* ContentArena::allocate_aligned(size_t len, size_t align) {
+    if (!chunks_.empty()) {
+        uintptr_t base = reinterpret_cast<uintptr_t>(chunks_[current_].data.get());
+        size_t pad = (align - ((base + offset_) & (align - 1))) & (align - 1);
+        if (chunks_[current_].size - offset_ >= pad + len) {
+            offset_ += pad;
+            bytes_used_ += pad;
+            return allocate(len);
+        }
+    }
+    // Fresh chunk: new[] storage is aligned for any fundamental type
+    char* p = allocate(len + align);
+    uintptr_t addr = reinterpret_cast<uintptr_t>(p);
+    return p + ((align - (addr & (align - 1))) & (align - 1));
+}
+
+void ContentArena::reset() {
+    current_ = 0;
+    offset_ = 0;
+    bytes_used_ = 0;
+}
+
+void ContentArena::release() {
+    if (chunks_.size() > 1) {
+        chunks_.erase(chunks_.begin() + 1, chunks_.end());
+    }
+    reset();
+    bytes_reserved_ = chunks_.empty() ? 0 : chunks_.front().size;
+}
+
+char* Content::prepare(size_t n, ContentArena& arena) {
+    if (n > UINT32_MAX) {
+        throw std::length_error("glyph content exceeds 4 GiB");
+    }
+    len = static_cast<uint32_t>(n);
+    if (n <= kInlineCapacity) {
+        kind = kInline;
+        return inline_data;
+    }
+    kind = kArena;
+    char* p = arena.allocate(n);
+    ptr = p;
+    return p;
+}
+
+void Content::assign(const char* src, size_t n, ContentArena& arena) {
+    char* dst = prepare(n, arena);
+    if (n > 0) {
+        memcpy(dst, src, n);
+    }
+}
+
+void Content::copy_to(char* out) const {
+    for_each_chunk([&out](const char* chunk, size_t n) {
+        memcpy(out, chunk, n);
+        out += n;
+    });
+}
+
+std::string Content::str() const {
+    std::string s(len, '\0');
+    copy_to(&s[0]);
+    return s;
+}
+
+void Content::flatten(ContentArena& arena) {
+    if (kind != kRope) {
+        return;
+    }
+    size_t n = len;
+    char* dst = arena.allocate(n);
+    copy_to(dst);
+    kind = kArena;
+    ptr = dst;
+}
+
+void Content::assign_rope(const RopeNode* node, size_t n) {
+    if (n > UINT32_MAX) {
+        throw std::length_error("glyph content exceeds 4 GiB");
+    }
+    len = static_cast<uint32_t>(n);
+    kind = kRope;
+    rope = node;
+}
+
+void Content::assign_external(const char* src, size_t n) {
+    if (n > UINT32_MAX) {
+        throw std::length_error("glyph content exceeds 4 GiB");
+    }
+    len = static_cast<uint32_t>(n);
+    kind = kArena;
+    ptr = src;
+}
+
+} // namespace spu
@@ -0,0 +1,194 @@
+/**
+ * SPU Glyph Content - Variable-length content storage
+ *
+ * Short content (the common case) is stored inline in the Content handle;
+ * longer content lives in a ContentArena, a chunked bump allocator whose
+ * allocations never move. Memory scales with actual content length and
+ * there is no fixed cap to overflow.
+ *
+ * In lazy mode, merge results are ropes: a RopeNode referencing
+ * (primary, " + ", secondary) plus the SHA-256 state after absorbing the
+ * whole content, so further merges resume hashing from the cached state
+ * instead of copying and rehashing both parents.
+ */
+
+#ifndef SPU_CONTENT_H
+#define SPU_CONTENT_H
+
+#include "hash.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace spu {
+
+/**
+ * Chunked bump allocator for glyph content
+ *
+ * Allocations stay valid until reset(), release() or destruction. reset()
+ * keeps every chunk and hands them out again in order, so a loop that
+ * resets the arena each batch stops allocating once the arena has grown
+ * to its largest batch. Not thread-safe; use one arena per thread.
+ */
+class ContentArena {
+public:
+    static constexpr size_t kDefaultChunkSize = 64 * 1024;
+
+    explicit ContentArena(size_t chunk_size = kDefaultChunkSize);
+
+    ContentArena(const ContentArena&) = delete;
+    ContentArena& operator=(const ContentArena&) = delete;
+    ContentArena(ContentArena&&) = default;
+    ContentArena& operator=(ContentArena&&) = default;
+
+    // Allocate len bytes (unaligned)
+    char* allocate(size_t len);
+
+    // Allocate len bytes aligned to align (power of two)
+    void* allocate_aligned(size_t len, size_t align);
+
+    // Drop all content; every chunk is kept for reuse
+    void reset();
+
+    // Drop all content and free every chunk but the first
+    void release();
+
+    // Bytes handed out / bytes held in chunks
+    size_t bytes_used() const { return bytes_used_; }
+    size_t bytes_reserved() const { return bytes_reserved_; }
+
+private:
+    struct Chunk {
+        std::unique_ptr<char[]> data;
+        size_t size;
+    };
+
+    // Move to the next chunk with room for len bytes (kept or new)
+    void next_chunk(size_t len);
+
+    size_t chunk_size_;
+    std::vector<Chunk> chunks_;
+    size_t current_;        // Chunk being filled
+    size_t offset_;         // Next free byte in chunks_[current_]
+    size_t bytes_used_;
+    size_t bytes_reserved_;
+};
+
+struct RopeNode;
+
+/**
+ * Content handle: inline bytes, a pointer + length into a ContentArena, or
+ * a lazy RopeNode
+ *
+ * Copying a handle copies inline bytes or shares the arena bytes / rope; it
+ * never copies arena content.
+ */
+struct Content {
+    // Content up to this many bytes is stored inline
+    static constexpr size_t kInlineCapacity = 24;
+
+    enum Kind : uint32_t {
+        kInline = 0,
+        kArena = 1,
+        kRope = 2,
+    };
+
+    uint32_t len;
+    uint32_t kind;
+    union {
+        char inline_data[kInlineCapacity];
+        const char* ptr;
+        const RopeNode* rope;
+    };
+
+    Content() : len(0), kind(kInline), ptr(nullptr) {}
+
+    size_t size() const { return len; }
+    bool empty() const { return len == 0; }
+    bool is_rope() const { return kind == kRope; }
+
+    // Contiguous bytes (not valid for ropes: use copy_to(), str() or flatten())
+    const char* data() const { return kind == kInline ? inline_data : ptr; }
+
+    // Materialize into out (size() bytes); works for every kind
+    void copy_to(char* out) const;
+
+    // Materialized copy
+    std::string str() const;
+
+    // Replace a rope by a flat copy (no-op for flat content)
+    void flatten(ContentArena& arena);
+
+    /**
+     * Visit the content as contiguous chunks, in order
+     *
+     * @param fn Called as fn(const char* data, size_t len)
+     */
+    template <typename Fn>
+    void for_each_chunk(Fn&& fn) const;
+
+    /**
+     * Reserve len writable bytes (inline or from arena) and return them
+     *
+     * @throws std::length_error if len exceeds 4 GiB
+     */
+    char* prepare(size_t len, ContentArena& arena);
+
+    // Copy n bytes from src
+    void assign(const char* src, size_t n, ContentArena& arena);
+
+    // Point at bytes owned elsewhere (must outlive this handle)
+    void assign_external(const char* src, size_t n);
+
+    // Reference a rope node of total length n
+    void assign_rope(const RopeNode* node, size_t n);
+};
+
+/**
+ * Lazy concatenation node: left + " + " + right
+ *
+ * Children are handles (inline, arena or rope) and must outlive the node.
+ */
+struct RopeNode {
+    static constexpr char kSeparator[] = " + ";
+    static constexpr size_t kSeparatorLen = 3;
+
+    Content left;
+    Content right;
+    Sha256 hash_state;  // SHA-256 state after absorbing the whole content
+};
+
+template <typename Fn>
+void Content::for_each_chunk(Fn&& fn) const {
+    if (kind != kRope) {
+        if (len > 0) {
+            fn(data(), static_cast<size_t>(len));
+        }
+        return;
+    }
+
+    // Iterative in-order walk (merge chains can be arbitrarily deep);
+    // nullptr marks a separator
+    std::vector<const Content*> stack;
+    stack.push_back(this);
+    while (!stack.empty()) {
+        const Content* c = stack.back();
+        stack.pop_back();
+        if (c == nullptr) {
+            fn(RopeNode::kSeparator, RopeNode::kSeparatorLen);
+        } else if (c->kind == kRope) {
+            stack.push_back(&c->rope->right);
+            stack.push_back(nullptr);
+            stack.push_back(&c->rope->left);
+        } else if (c->len > 0) {
+            fn(c->data(), static_cast<size_t>(c->len));
+        }
+    }
+}
+
+} // namespace spu
+
+#endif // SPU_CONTENT_H
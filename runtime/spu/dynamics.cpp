@@ -0,0 +1,336 @@
+/**
+ * SPU Dynamics Engine - Native decay / activation rules
+ *
+ * Decay and the threshold compare-and-increment run as one fused pass per
+ * column block. Kernels are selected once at runtime by CPU feature:
+ * AVX-512 (8 glyphs/iteration), AVX2 (4), NEON (2) or scalar.
+ */
+
+#include "dynamics.h"
+#include "perf_counters.h"
+#include <algorithm>
+#include <cmath>
+#include <unordered_map>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SPU_DYNAMICS_X86 1
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#define SPU_DYNAMICS_NEON 1
+#endif
+
+namespace spu {
+
+namespace {
+
+// Arguments shared by every step kernel
+struct StepArgs {
+    double* energy;
+    uint32_t* activation_count;
+    uint64_t* last_update_time;
+    size_t n;
+
+    bool decay;                   // Apply rule 3
+    double factor;                // Uniform decay factor
+    uint64_t time_delta;          // Uniform time delta
+    const double* factors;        // Per-glyph factors (varying kernels only)
+    const uint64_t* time_deltas;  // Per-glyph deltas (varying kernels only)
+
+    bool activate;                // Apply rule 1
+    double threshold;
+    uint8_t* activated;           // Optional per-glyph output flags
+};
+
+template <bool kVarying>
+size_t step_scalar(const StepArgs& a, size_t begin) {
+    size_t activated = 0;
+    for (size_t i = begin; i < a.n; i++) {
+        if (a.decay) {
+            a.energy[i] = a.energy[i] * (kVarying ? a.factors[i] : a.factor);
+            a.last_update_time[i] += kVarying ? a.time_deltas[i] : a.time_delta;
+        }
+        if (a.activate) {
+            bool on = a.energy[i] >= a.threshold;
+            a.activation_count[i] += on;
+            activated += on;
+            if (a.activated) {
+                a.activated[i] = on;
+            }
+        }
+    }
+    return activated;
+}
+
+#if defined(SPU_DYNAMICS_X86)
+
+template <bool kVarying>
+__attribute__((target("avx512f,avx512vl")))
+size_t step_avx512(const StepArgs& a) {
+    const __m512d factor = _mm512_set1_pd(a.factor);
+    const __m512i time_delta = _mm512_set1_epi64(static_cast<long long>(a.time_delta));
+    const __m512d threshold = _mm512_set1_pd(a.threshold);
+    const __m256i one = _mm256_set1_epi32(1);
+
+    size_t activated = 0;
+    size_t i = 0;
+    for (; i + 8 <= a.n; i += 8) {
+        __m512d e = _mm512_loadu_pd(a.energy + i);
+        if (a.decay) {
+            __m512d f = factor;
+            __m512i dt = time_delta;
+            if constexpr (kVarying) {
+                f = _mm512_loadu_pd(a.factors + i);
+                dt = _mm512_loadu_si512(a.time_deltas + i);
+            }
+            e = _mm512_mul_pd(e, f);
+            _mm512_storeu_pd(a.energy + i, e);
+            __m512i t = _mm512_loadu_si512(a.last_update_time + i);
+            _mm512_storeu_si512(a.last_update_time + i, _mm512_add_epi64(t, dt));
+        }
+        if (a.activate) {
+            __mmask8 mask = _mm512_cmp_pd_mask(e, threshold, _CMP_GE_OQ);
+            __m256i* counts = reinterpret_cast<__m256i*>(a.activation_count + i);
+            __m256i c = _mm256_loadu_si256(counts);
+            _mm256_storeu_si256(counts, _mm256_mask_add_epi32(c, mask, c, one));
+            activated += __builtin_popcount(mask);
+            if (a.activated) {
+                for (int k = 0; k < 8; k++) {
+                    a.activated[i + k] = (mask >> k) & 1;
+                }
+            }
+        }
+    }
+    return activated + step_scalar<kVarying>(a, i);
+}
+
+template <bool kVarying>
+__attribute__((target("avx2")))
+size_t step_avx2(const StepArgs& a) {
+    const __m256d factor = _mm256_set1_pd(a.factor);
+    const __m256i time_delta = _mm256_set1_epi64x(static_cast<long long>(a.time_delta));
+    const __m256d threshold = _mm256_set1_pd(a.threshold);
+    // Low 32 bits of each 64-bit compare lane
+    const __m256i narrow = _mm256_setr_epi32(0, 2, 4, 6, 0, 2, 4, 6);
+
+    size_t activated = 0;
+    size_t i = 0;
+    for (; i + 4 <= a.n; i += 4) {
+        __m256d e = _mm256_loadu_pd(a.energy + i);
+        if (a.decay) {
+            __m256d f = factor;
+            __m256i dt = time_delta;
+            if constexpr (kVarying) {
+                f = _mm256_loadu_pd(a.factors + i);
+                dt = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a.time_deltas + i));
+            }
+            e = _mm256_mul_pd(e, f);
+            _mm256_storeu_pd(a.energy + i, e);
+            __m256i* times = reinterpret_cast<__m256i*>(a.last_update_time + i);
+            _mm256_storeu_si256(times, _mm256_add_epi64(_mm256_loadu_si256(times), dt));
+        }
+        if (a.activate) {
+            __m256d mask = _mm256_cmp_pd(e, threshold, _CMP_GE_OQ);
+            __m128i mask32 = _mm256_castsi256_si128(
+                _mm256_permutevar8x32_epi32(_mm256_castpd_si256(mask), narrow));
+            __m128i* counts = reinterpret_cast<__m128i*>(a.activation_count + i);
+            // mask lanes are -1 where activated
+            _mm_storeu_si128(counts, _mm_sub_epi32(_mm_loadu_si128(counts), mask32));
+            int bits = _mm256_movemask_pd(mask);
+            activated += __builtin_popcount(bits);
+            if (a.activated) {
+                for (int k = 0; k < 4; k++) {
+                    a.activated[i + k] = (bits >> k) & 1;
+                }
+            }
+        }
+    }
+    return activated + step_scalar<kVarying>(a, i);
+}
+
+#endif // SPU_DYNAMICS_X86
+
+#if defined(SPU_DYNAMICS_NEON)
+
+template <bool kVarying>
+size_t step_neon(const StepArgs& a) {
+    const float64x2_t threshold = vdupq_n_f64(a.threshold);
+
+    size_t activated = 0;
+    size_t i = 0;
+    for (; i + 2 <= a.n; i += 2) {
+        float64x2_t e = vld1q_f64(a.energy + i);
+        if (a.decay) {
+            float64x2_t f = vdupq_n_f64(a.factor);
+            uint64x2_t dt = vdupq_n_u64(a.time_delta);
+            if constexpr (kVarying) {
+                f = vld1q_f64(a.factors + i);
+                dt = vld1q_u64(a.time_deltas + i);
+            }
+            e = vmulq_f64(e, f);
+            vst1q_f64(a.energy + i, e);
+            vst1q_u64(a.last_update_time + i, vaddq_u64(vld1q_u64(a.last_update_time + i), dt));
+        }
+        if (a.activate) {
+            uint32x2_t mask = vmovn_u64(vcgeq_f64(e, threshold));
+            // mask lanes are all-ones where activated
+            vst1_u32(a.activation_count + i, vsub_u32(vld1_u32(a.activation_count + i), mask));
+            uint32_t on0 = vget_lane_u32(mask, 0) & 1;
+            uint32_t on1 = vget_lane_u32(mask, 1) & 1;
+            activated += on0 + on1;
+            if (a.activated) {
+                a.activated[i] = on0;
+                a.activated[i + 1] = on1;
+            }
+        }
+    }
+    return activated + step_scalar<kVarying>(a, i);
+}
+
+#endif // SPU_DYNAMICS_NEON
+
+// Runtime-selected kernel pair
+struct KernelSet {
+    const char* name;
+    size_t (*uniform)(const StepArgs&);
+    size_t (*varying)(const StepArgs&);
+};
+
+template <bool kVarying>
+size_t step_scalar_all(const StepArgs& a) {
+    return step_scalar<kVarying>(a, 0);
+}
+
+KernelSet select_kernels() {
+#if defined(SPU_DYNAMICS_X86)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512vl")) {
+        return {"avx512", step_avx512<false>, step_avx512<true>};
+    }
+    if (__builtin_cpu_supports("avx2")) {
+        return {"avx2", step_avx2<false>, step_avx2<true>};
+    }
+#elif defined(SPU_DYNAMICS_NEON)
+    return {"neon", step_neon<false>, step_neon<true>};
+#endif
+    return {"scalar", step_scalar_all<false>, step_scalar_all<true>};
+}
+
+const KernelSet& kernels() {
+    static const KernelSet selected = select_kernels();
+    return selected;
+}
+
+StepArgs make_args(GlyphStore& store) {
+    StepArgs a{};
+    a.energy = store.energy();
+    a.activation_count = store.activation_count();
+    a.last_update_time = store.last_update_time();
+    a.n = store.size();
+    a.factor = 1.0;
+    return a;
+}
+
+} // namespace
+
+DynamicsEngine::DynamicsEngine(double activation_threshold, double decay_rate)
+    : activation_threshold_(activation_threshold),
+      decay_rate_(std::max(0.0, std::min(1.0, decay_rate))) {}
+
+double DynamicsEngine::decay_factor(uint64_t time_delta) const {
+    // Same expression as engine.py: (1.0 - decay_rate) ** time_delta
+    return std::pow(1.0 - decay_rate_, static_cast<double>(time_delta));
+}
+
+void DynamicsEngine::apply_decay(GlyphStore& store, uint64_t time_delta) const {
+    SPU_PERF_SCOPE(kPerfDecay, store.size());
+    StepArgs a = make_args(store);
+    a.decay = true;
+    a.factor = decay_factor(time_delta);
+    a.time_delta = time_delta;
+    kernels().uniform(a);
+}
+
+size_t DynamicsEngine::apply_activation_threshold(GlyphStore& store, uint8_t* activated) const {
+    SPU_PERF_SCOPE(kPerfActivation, store.size());
+    StepArgs a = make_args(store);
+    a.activate = true;
+    a.threshold = activation_threshold_;
+    a.activated = activated;
+    return kernels().uniform(a);
+}
+
+size_t DynamicsEngine::step(GlyphStore& store, uint64_t time_delta, uint8_t* activated) const {
+    SPU_PERF_SCOPE(kPerfDynamicsStep, store.size());
+    StepArgs a = make_args(store);
+    a.decay = true;
+    a.factor = decay_factor(time_delta);
+    a.time_delta = time_delta;
+    a.activate = true;
+    a.threshold = activation_threshold_;
+    a.activated = activated;
+    return kernels().uniform(a);
+}
+
+size_t DynamicsEngine::step_range(GlyphStore& store, size_t begin, size_t end,
+                                  uint64_t time_delta, uint8_t* activated) const {
+    end = std::min(end, store.size());
+    if (begin >= end) {
+        return 0;
+    }
+    SPU_PERF_SCOPE(kPerfDynamicsStep, end - begin);
+    StepArgs a = make_args(store);
+    a.energy += begin;
+    a.activation_count += begin;
+    a.last_update_time += begin;
+    a.n = end - begin;
+    a.decay = true;
+    a.factor = decay_factor(time_delta);
+    a.time_delta = time_delta;
+    a.activate = true;
+    a.threshold = activation_threshold_;
+    a.activated = activated ? activated + begin : nullptr;
+    return kernels().uniform(a);
+}
+
+size_t DynamicsEngine::step(GlyphStore& store, const uint64_t* time_deltas,
+                            uint8_t* activated) const {
+    SPU_PERF_SCOPE(kPerfDynamicsStep, store.size());
+
+    // One pow() per distinct delta
+    std::vector<double> factors(store.size());
+    std::unordered_map<uint64_t, double> cache;
+    uint64_t last_delta = 0;
+    double last_factor = 1.0;
+    bool have_last = false;
+
+    for (size_t i = 0; i < store.size(); i++) {
+        uint64_t dt = time_deltas[i];
+        if (!have_last || dt != last_delta) {
+            auto it = cache.find(dt);
+            if (it == cache.end()) {
+                it = cache.emplace(dt, decay_factor(dt)).first;
+            }
+            last_delta = dt;
+            last_factor = it->second;
+            have_last = true;
+        }
+        factors[i] = last_factor;
+    }
+
+    StepArgs a = make_args(store);
+    a.decay = true;
+    a.factors = factors.data();
+    a.time_deltas = time_deltas;
+    a.activate = true;
+    a.threshold = activation_threshold_;
+    a.activated = activated;
+    return kernels().varying(a);
+}
+
+const char* DynamicsEngine::kernel_name() {
+    return kernels().name;
+}
+
+} // namespace spu
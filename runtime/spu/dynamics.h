@@ -0,0 +1,91 @@
+/**
+ * SPU Dynamics Engine - Native decay / activation rules
+ *
+ * C++ port of runtime/dynamics/engine.py operating on GlyphStore columns.
+ * Results are bit-identical to the Python engine: the decay factor is
+ * computed with the same pow() call, and the per-glyph work (one multiply,
+ * one compare) is exact in every SIMD width.
+ */
+
+#ifndef SPU_DYNAMICS_H
+#define SPU_DYNAMICS_H
+
+#include "glyph_store.h"
+
+#include <cstddef>
+#include <cstdint>
+
+namespace spu {
+
+class DynamicsEngine {
+public:
+    /**
+     * @param activation_threshold Energy threshold for activation
+     * @param decay_rate Rate of energy decay per time unit (clamped to 0.0-1.0)
+     */
+    explicit DynamicsEngine(double activation_threshold = 1.0, double decay_rate = 0.1);
+
+    double activation_threshold() const { return activation_threshold_; }
+    double decay_rate() const { return decay_rate_; }
+
+    /**
+     * Decay factor (1 - decay_rate)^time_delta
+     */
+    double decay_factor(uint64_t time_delta) const;
+
+    /**
+     * Rule 3: Decay every glyph in the store by time_delta
+     */
+    void apply_decay(GlyphStore& store, uint64_t time_delta) const;
+
+    /**
+     * Rule 1: Increment activation_count of every glyph with
+     * energy >= activation_threshold
+     *
+     * @param activated Optional per-glyph output flags (size() entries)
+     * @return Number of glyphs activated
+     */
+    size_t apply_activation_threshold(GlyphStore& store, uint8_t* activated = nullptr) const;
+
+    /**
+     * One dynamics step (decay, then activation) over the whole store
+     *
+     * @param store Glyphs to update in place
+     * @param time_delta Time units since last step
+     * @param activated Optional per-glyph output flags (size() entries)
+     * @return Number of glyphs activated
+     */
+    size_t step(GlyphStore& store, uint64_t time_delta = 1, uint8_t* activated = nullptr) const;
+
+    /**
+     * One dynamics step over glyphs [begin, end) of the store
+     *
+     * Same per-glyph result as step(); other glyphs are not touched, so
+     * disjoint ranges can run on different threads.
+     *
+     * @param activated Optional per-glyph output flags, indexed like the store
+     */
+    size_t step_range(GlyphStore& store, size_t begin, size_t end, uint64_t time_delta,
+                      uint8_t* activated = nullptr) const;
+
+    /**
+     * One dynamics step with a per-glyph time delta
+     *
+     * The decay factor is computed once per distinct delta.
+     *
+     * @param time_deltas Per-glyph time deltas (size() entries)
+     */
+    size_t step(GlyphStore& store, const uint64_t* time_deltas,
+                uint8_t* activated = nullptr) const;
+
+    // Name of the SIMD kernel selected at runtime ("avx512", "avx2", "neon", "scalar")
+    static const char* kernel_name();
+
+private:
+    double activation_threshold_;
+    double decay_rate_;
+};
+
+} // namespace spu
+
+#endif // SPU_DYNAMICS_H
@@ -0,0 +1,278 @@
+/**
+ * SPU Energy Index - Ordered index on decayed glyph energy
+ */
+
+#include "energy_index.h"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace spu {
+
+namespace {
+
+// Rounding allowance of bound_of(), relative to the magnitudes it sums:
+// several thousand ulps, so the exact re-check never misses a glyph
+constexpr double kBandScale = 1e-12;
+
+} // namespace
+
+EnergyIndex::EnergyIndex(const DynamicsEngine& engine, uint64_t tick_delta)
+    : engine_(engine), tick_delta_(tick_delta) {
+    if (engine.decay_rate() >= 1.0) {
+        throw std::invalid_argument("EnergyIndex: decay_rate must be below 1");
+    }
+    // log() of the same rounded factor decay_factor() raises to a power, so
+    // that keys and pow() agree however many ticks apart
+    log_factor_ = static_cast<double>(tick_delta) * std::log(1.0 - engine.decay_rate());
+}
+
+double EnergyIndex::key_of(double energy, uint64_t tick) const {
+    if (!(energy > 0.0)) {
+        return -HUGE_VAL;  // 0, negative and NaN energies sort below everything
+    }
+    return std::log(energy) - static_cast<double>(tick) * log_factor_;
+}
+
+double EnergyIndex::bound_of(double level, uint64_t now) const {
+    if (!(level > 0.0)) {
+        return -HUGE_VAL;
+    }
+    return std::log(level) - static_cast<double>(now) * log_factor_;
+}
+
+double EnergyIndex::band(double level, uint64_t now) const {
+    if (!(level > 0.0) || std::isinf(level)) {
+        return 0.0;
+    }
+    return kBandScale * (1.0 + std::fabs(std::log(level)) - static_cast<double>(now) * log_factor_);
+}
+
+bool EnergyIndex::contains(uint32_t glyph) const {
+    return glyph < slots_.size() && slots_[glyph].present;
+}
+
+double EnergyIndex::energy(uint32_t glyph, uint64_t now) const {
+    if (!contains(glyph)) {
+        throw std::out_of_range("EnergyIndex::energy: glyph not indexed");
+    }
+    const Slot& s = slots_[glyph];
+    // Same expression as DynamicsEngine::step() over the whole interval
+    return s.energy * engine_.decay_factor((now - s.tick) * tick_delta_);
+}
+
+EnergyIndex::Pos EnergyIndex::lower_bound(const Entry& e) const {
+    size_t leaf = std::lower_bound(maxima_.begin(), maxima_.end(), e) - maxima_.begin();
+    if (leaf == leaves_.size()) {
+        return {leaf, 0};
+    }
+    const std::vector<Entry>& l = leaves_[leaf];
+    return {leaf, static_cast<size_t>(std::lower_bound(l.begin(), l.end(), e) - l.begin())};
+}
+
+void EnergyIndex::insert(const Entry& e) {
+    if (leaves_.empty()) {
+        leaves_.emplace_back(1, e);
+        maxima_.push_back(e);
+        return;
+    }
+    size_t leaf = std::lower_bound(maxima_.begin(), maxima_.end(), e) - maxima_.begin();
+    if (leaf == leaves_.size()) {
+        leaf--;  // New maximum: append to the last leaf
+    }
+    std::vector<Entry>& l = leaves_[leaf];
+    l.insert(std::lower_bound(l.begin(), l.end(), e), e);
+    maxima_[leaf] = l.back();
+    rebalance(leaf);
+}
+
+void EnergyIndex::remove(const Entry& e) {
+    Pos p = lower_bound(e);
+    std::vector<Entry>& l = leaves_[p.leaf];
+    l.erase(l.begin() + p.i);
+    if (l.empty()) {
+        leaves_.erase(leaves_.begin() + p.leaf);
+        maxima_.erase(maxima_.begin() + p.leaf);
+        return;
+    }
+    maxima_[p.leaf] = l.back();
+    rebalance(p.leaf);
+}
+
+void EnergyIndex::rebalance(size_t leaf) {
+    std::vector<Entry>& l = leaves_[leaf];
+    if (l.size() > 2 * kLeafLoad) {
+        std::vector<Entry> upper(l.begin() + kLeafLoad, l.end());
+        l.resize(kLeafLoad);
+        maxima_[leaf] = l.back();
+        maxima_.insert(maxima_.begin() + leaf + 1, upper.back());
+        leaves_.insert(leaves_.begin() + leaf + 1, std::move(upper));
+        return;
+    }
+    if (l.size() >= kLeafLoad / 2 || leaves_.size() == 1) {
+        return;
+    }
+    // Fold into a neighbour (the right one if any), splitting again if too full
+    size_t left = leaf + 1 < leaves_.size() ? leaf : leaf - 1;
+    std::vector<Entry>& into = leaves_[left];
+    std::vector<Entry>& from = leaves_[left + 1];
+    into.insert(into.end(), from.begin(), from.end());
+    maxima_[left] = into.back();
+    leaves_.erase(leaves_.begin() + left + 1);
+    maxima_.erase(maxima_.begin() + left + 1);
+    rebalance(left);
+}
+
+void EnergyIndex::set(uint32_t glyph, double energy, uint64_t tick) {
+    if (glyph >= slots_.size()) {
+        slots_.resize(static_cast<size_t>(glyph) + 1, Slot{0.0, 0, 0.0, false});
+    }
+    Slot& s = slots_[glyph];
+    const double key = key_of(energy, tick);
+    if (s.present) {
+        if (key == s.key) {
+            s.energy = energy;
+            s.tick = tick;
+            return;
+        }
+        remove({s.key, glyph});
+    } else {
+        size_++;
+    }
+    s = Slot{energy, tick, key, true};
+    insert({key, glyph});
+}
+
+void EnergyIndex::erase(uint32_t glyph) {
+    if (!contains(glyph)) {
+        return;
+    }
+    Slot& s = slots_[glyph];
+    remove({s.key, glyph});
+    s.present = false;
+    size_--;
+}
+
+void EnergyIndex::clear() {
+    slots_.clear();
+    leaves_.clear();
+    maxima_.clear();
+    size_ = 0;
+}
+
+void EnergyIndex::assign(size_t n, const double* energy, const uint64_t* ticks) {
+    if (n > UINT32_MAX) {
+        throw std::length_error("EnergyIndex: more than 2^32 - 1 glyphs");
+    }
+    clear();
+    slots_.resize(n);
+    std::vector<Entry> entries(n);
+    for (size_t i = 0; i < n; i++) {
+        const double key = key_of(energy[i], ticks[i]);
+        slots_[i] = Slot{energy[i], ticks[i], key, true};
+        entries[i] = Entry{key, static_cast<uint32_t>(i)};
+    }
+    std::sort(entries.begin(), entries.end());
+
+    for (size_t i = 0; i < n; i += kLeafLoad) {
+        const size_t end = std::min(n, i + kLeafLoad);
+        leaves_.emplace_back(entries.begin() + i, entries.begin() + end);
+        maxima_.push_back(entries[end - 1]);
+    }
+    // A short last leaf goes into its neighbour, as in remove()
+    if (leaves_.size() > 1 && leaves_.back().size() < kLeafLoad / 2) {
+        rebalance(leaves_.size() - 1);
+    }
+    size_ = n;
+}
+
+void EnergyIndex::assign(const GlyphStore& store, uint64_t tick) {
+    std::vector<uint64_t> ticks(store.size(), tick);
+    assign(store.size(), store.energy(), ticks.data());
+}
+
+void EnergyIndex::top(size_t k, uint64_t now, std::vector<uint32_t>& out) const {
+    range(-HUGE_VAL, HUGE_VAL, now, out, k);
+}
+
+void EnergyIndex::range(double lo, double hi, uint64_t now, std::vector<uint32_t>& out,
+                        size_t limit) const {
+    if (limit == 0 || !(lo < hi)) {
+        return;
+    }
+    const double lo_key = bound_of(lo, now);
+    const double hi_key = bound_of(hi, now);
+    const double lo_band = band(lo, now);
+    const double hi_band = band(hi, now);
+    // Keys strictly inside the bands are in range; the rest are checked
+    const double lo_sure = lo_key + lo_band;
+    const double hi_sure = hi_key - hi_band;
+
+    // Walk down from the first entry past the upper band
+    Pos p = lower_bound({hi_key + hi_band, UINT32_MAX});
+    if (p.leaf == leaves_.size()) {
+        if (leaves_.empty()) {
+            return;
+        }
+        p = {leaves_.size() - 1, leaves_.back().size()};
+    }
+    const bool hi_open = hi == HUGE_VAL;  // Infinite energies are in range too
+    size_t found = 0;
+    for (size_t leaf = p.leaf, i = p.i;; i = leaves_[--leaf].size()) {
+        const std::vector<Entry>& l = leaves_[leaf];
+        while (i-- > 0) {
+            const Entry& e = l[i];
+            if (e.key < lo_key - lo_band) {
+                return;
+            }
+            bool in = e.key > lo_sure && e.key < hi_sure;
+            if (!in) {
+                const double x = energy(e.glyph, now);
+                in = x >= lo && (hi_open || x < hi);
+            }
+            if (in) {
+                out.push_back(e.glyph);
+                if (++found == limit) {
+                    return;
+                }
+            }
+        }
+        if (leaf == 0) {
+            return;
+        }
+    }
+}
+
+void EnergyIndex::active(uint64_t now, std::vector<uint32_t>& out) const {
+    range(engine_.activation_threshold(), HUGE_VAL, now, out);
+}
+
+void EnergyIndex::next_to_activate(size_t k, uint64_t now, std::vector<uint32_t>& out) const {
+    range(-HUGE_VAL, engine_.activation_threshold(), now, out, k);
+}
+
+void EnergyIndex::next_to_deactivate(size_t k, uint64_t now, std::vector<uint32_t>& out) const {
+    const double level = engine_.activation_threshold();
+    const double key = bound_of(level, now);
+    const double width = band(level, now);
+    if (k == 0) {
+        return;
+    }
+    // Walk up from the lower edge of the band
+    Pos p = lower_bound({key - width, 0});
+    size_t found = 0;
+    for (size_t leaf = p.leaf, i = p.i; leaf < leaves_.size(); leaf++, i = 0) {
+        const std::vector<Entry>& l = leaves_[leaf];
+        for (; i < l.size(); i++) {
+            const Entry& e = l[i];
+            if (e.key > key + width || energy(e.glyph, now) >= level) {
+                out.push_back(e.glyph);
+                if (++found == k) {
+                    return;
+                }
+            }
+        }
+    }
+}
+
+} // namespace spu
@@ -0,0 +1,160 @@
+/**
+ * SPU Energy Index - Ordered index on decayed glyph energy
+ *
+ * Every glyph decays by the same factor per tick, E(t) = E0 * f^(t - t0),
+ * so ordering glyphs by current energy is ordering them by the
+ * time-normalized key
+ *
+ *   key = ln E0 - t0 * ln f        (ln E(t) = key + t * ln f)
+ *
+ * which does not change while a glyph only decays. The index keeps
+ * (key, glyph) in a two-level B-tree (sorted leaves of up to 2 * kLeafLoad
+ * entries under a sorted directory of leaf maxima) and is updated only when
+ * energy changes other than by decay: a stimulus or a new merge result.
+ * Ticks cost nothing, set() is O(log n + kLeafLoad), and top-K, range and
+ * threshold queries at any tick are O(log n + output) instead of a scan of
+ * every glyph's energy.
+ *
+ * Queries turn their energy bounds into keys with the closed form, then
+ * re-check glyphs within rounding distance of a bound with the same pow()
+ * as DynamicsEngine, so membership agrees exactly with energy(glyph, now).
+ * Output is in key order; glyphs whose energies differ only in the last
+ * bits can come out in either order.
+ *
+ * Not thread-safe.
+ */
+
+#ifndef SPU_ENERGY_INDEX_H
+#define SPU_ENERGY_INDEX_H
+
+#include "dynamics.h"
+#include "glyph_store.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace spu {
+
+class EnergyIndex {
+public:
+    // Target leaf size: leaves split past 2x and merge below 1/2x
+    static constexpr size_t kLeafLoad = 256;
+
+    /**
+     * @param engine Decay rule; its activation_threshold is the level of
+     *        active() and the next_* queries
+     * @param tick_delta Time units per tick
+     * @throws std::invalid_argument if decay_rate is 1 (no order survives a tick)
+     */
+    explicit EnergyIndex(const DynamicsEngine& engine, uint64_t tick_delta = 1);
+
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+    bool contains(uint32_t glyph) const;
+
+    /**
+     * Set a glyph's energy as of a tick (inserting it if absent)
+     *
+     * Queries must be at ticks >= the tick of every glyph they cover.
+     */
+    void set(uint32_t glyph, double energy, uint64_t tick);
+
+    // Remove a glyph (no-op if absent)
+    void erase(uint32_t glyph);
+
+    void clear();
+
+    /**
+     * Replace the contents with glyphs [0, n), glyph i at energy[i] as of
+     * ticks[i] (bulk build, O(n log n))
+     */
+    void assign(size_t n, const double* energy, const uint64_t* ticks);
+
+    // assign() of every glyph in a store with its energy column as of tick
+    void assign(const GlyphStore& store, uint64_t tick);
+
+    /**
+     * A glyph's energy at tick now (one pow() since the tick it was set)
+     *
+     * @throws std::out_of_range if the glyph is not indexed
+     */
+    double energy(uint32_t glyph, uint64_t now) const;
+
+    /**
+     * Queries at tick now; results are appended to out
+     */
+
+    // The k glyphs with the highest energy, highest first
+    void top(size_t k, uint64_t now, std::vector<uint32_t>& out) const;
+
+    /**
+     * Glyphs with lo <= energy < hi, highest first, at most limit of them
+     *
+     * hi = HUGE_VAL for no upper bound, lo <= 0 for no lower bound above 0
+     * (lo = -HUGE_VAL includes negative energies).
+     */
+    void range(double lo, double hi, uint64_t now, std::vector<uint32_t>& out,
+               size_t limit = SIZE_MAX) const;
+
+    // Glyphs at or over the activation threshold, highest first
+    void active(uint64_t now, std::vector<uint32_t>& out) const;
+
+    /**
+     * The k glyphs just below the threshold, closest first: the cheapest
+     * to activate with a stimulus, and the merge candidates nearest to it
+     */
+    void next_to_activate(size_t k, uint64_t now, std::vector<uint32_t>& out) const;
+
+    // The k active glyphs closest to the threshold, i.e. the next to fall below it
+    void next_to_deactivate(size_t k, uint64_t now, std::vector<uint32_t>& out) const;
+
+    const DynamicsEngine& engine() const { return engine_; }
+    uint64_t tick_delta() const { return tick_delta_; }
+
+private:
+    struct Entry {
+        double key;
+        uint32_t glyph;
+
+        bool operator<(const Entry& o) const {
+            return key < o.key || (key == o.key && glyph < o.glyph);
+        }
+    };
+
+    // Position of an entry: leaf and offset (leaf == leaves_.size() is the end)
+    struct Pos {
+        size_t leaf;
+        size_t i;
+    };
+
+    struct Slot {
+        double energy;  // As of tick
+        uint64_t tick;
+        double key;
+        bool present;
+    };
+
+    double key_of(double energy, uint64_t tick) const;
+    // Key of the energy level at now, and the rounding band around it
+    double bound_of(double level, uint64_t now) const;
+    double band(double level, uint64_t now) const;
+
+    Pos lower_bound(const Entry& e) const;
+    void insert(const Entry& e);
+    void remove(const Entry& e);
+    void rebalance(size_t leaf);
+
+    DynamicsEngine engine_;
+    uint64_t tick_delta_;
+    double log_factor_;  // ln f per tick (<= 0)
+
+    std::vector<Slot> slots_;  // By glyph
+    size_t size_ = 0;
+    std::vector<std::vector<Entry>> leaves_;  // Ascending, no leaf empty
+    std::vector<Entry> maxima_;               // maxima_[j] = leaves_[j].back()
+};
+
+} // namespace spu
+
+#endif // SPU_ENERGY_INDEX_H
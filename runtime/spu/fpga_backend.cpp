@@ -0,0 +1,522 @@
+/**
+ * SPU FPGA Backend - Host side of the merge kernel DMA path
+ */
+
+#include "fpga_backend.h"
+#include "hash.h"
+#include <sys/mman.h>
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#if defined(SPU_WITH_XRT)
+#include <xrt/xrt_bo.h>
+#include <xrt/xrt_device.h>
+#include <xrt/xrt_kernel.h>
+#include <unordered_map>
+#endif
+
+namespace spu {
+
+namespace {
+
+size_t round_up(size_t n, size_t align) {
+    return (n + align - 1) / align * align;
+}
+
+/**
+ * The merge kernel in software: the same steps as merge_one() in
+ * merge_ref.cpp, reading descriptors and writing result records
+ */
+void run_merge_kernel(const DmaGlyphPair* in, DmaMergeResult* out, uint32_t count) {
+    for (uint32_t i = 0; i < count; i++) {
+        const DmaGlyph& g1 = in[i].glyph[0];
+        const DmaGlyph& g2 = in[i].glyph[1];
+        const bool first_wins = g1.energy >= g2.energy;
+        const DmaGlyph& primary = first_wins ? g1 : g2;
+        const DmaGlyph& secondary = first_wins ? g2 : g1;
+        DmaMergeResult& r = out[i];
+
+        memcpy(r.content, primary.content, primary.content_len);
+        memcpy(r.content + primary.content_len, " + ", 3);
+        memcpy(r.content + primary.content_len + 3, secondary.content, secondary.content_len);
+        r.content_len = static_cast<uint16_t>(primary.content_len + 3 + secondary.content_len);
+
+        r.energy = primary.energy + secondary.energy;
+        r.activation_count = std::max(primary.activation_count, secondary.activation_count);
+        r.last_update_time = std::max(primary.last_update_time, secondary.last_update_time);
+        memcpy(r.parent1_id, primary.id, sizeof(r.parent1_id));
+        memcpy(r.parent2_id, secondary.id, sizeof(r.parent2_id));
+    }
+
+    // Hash pipeline: kHashLanes results at a time
+    const void* data[kHashLanes];
+    size_t len[kHashLanes];
+    uint8_t* digest[kHashLanes];
+    for (uint32_t i = 0; i < count; i += kHashLanes) {
+        size_t group = std::min<size_t>(kHashLanes, count - i);
+        for (size_t k = 0; k < group; k++) {
+            data[k] = out[i + k].content;
+            len[k] = out[i + k].content_len;
+            digest[k] = out[i + k].id;
+        }
+        hash_many(data, len, digest, group);
+    }
+}
+
+/**
+ * Software device: pinned host buffers mirrored by "device memory", and a
+ * device thread that runs the register protocol, both DMA copies and the
+ * kernel for each queued run
+ */
+class EmulatedDevice : public MergeDevice {
+public:
+    explicit EmulatedDevice(size_t lanes) : lanes_(std::max<size_t>(1, std::min<size_t>(lanes, 16))) {
+        regs_[kRegCtrl / 4] = kCtrlApIdle;
+        regs_[kRegLaneMask / 4] = static_cast<uint32_t>((1u << lanes_) - 1);
+        thread_ = std::thread([this] { run(); });
+    }
+
+    ~EmulatedDevice() override {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        wake_.notify_all();
+        thread_.join();
+    }
+
+    const char* name() const override { return "emulated"; }
+    size_t lanes() const override { return lanes_; }
+
+    Buffer alloc(size_t bytes) override {
+        size_t size = round_up(std::max<size_t>(bytes, 1), 64);
+        Buffer b;
+        b.host = std::aligned_alloc(64, size);
+        void* device = std::aligned_alloc(64, size);
+        if (!b.host || !device) {
+            std::free(b.host);
+            std::free(device);
+            throw std::bad_alloc();
+        }
+        mlock(b.host, size);  // Best effort, as pinned DMA memory would be
+        b.bytes = size;
+        b.handle = device;
+        b.device_addr = reinterpret_cast<uintptr_t>(device);
+        return b;
+    }
+
+    void release(Buffer& b) override {
+        if (b.host) {
+            munlock(b.host, b.bytes);
+        }
+        std::free(b.host);
+        std::free(b.handle);
+        b = Buffer();
+    }
+
+    uint64_t submit(const Buffer& in, const Buffer& out, uint32_t count,
+                    uint32_t lane_mask) override {
+        if (size_t(count) * sizeof(DmaGlyphPair) > in.bytes ||
+            size_t(count) * sizeof(DmaMergeResult) > out.bytes) {
+            throw std::invalid_argument("emulated device: run larger than its buffers");
+        }
+        std::lock_guard<std::mutex> lock(mutex_);
+        uint64_t ticket = ++submitted_;
+        queue_.push_back(Run{in, out, count, lane_mask, ticket});
+        wake_.notify_all();
+        return ticket;
+    }
+
+    void wait(uint64_t ticket) override {
+        std::unique_lock<std::mutex> lock(mutex_);
+        done_.wait(lock, [&] { return completed_ >= ticket; });
+        auto it = std::find(failed_.begin(), failed_.end(), ticket);
+        if (it != failed_.end()) {
+            failed_.erase(it);
+            throw std::runtime_error("emulated device: kernel error flags set");
+        }
+    }
+
+    uint32_t read_register(uint32_t offset) const override {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return offset / 4 < kNumRegs ? regs_[offset / 4] : 0;
+    }
+
+private:
+    static constexpr size_t kNumRegs = kRegLaneMask / 4 + 1;
+
+    struct Run {
+        Buffer in;
+        Buffer out;
+        uint32_t count;
+        uint32_t lane_mask;
+        uint64_t ticket;
+    };
+
+    void run() {
+        for (;;) {
+            Run r;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                wake_.wait(lock, [&] { return stop_ || !queue_.empty(); });
+                if (stop_ && queue_.empty()) {
+                    return;
+                }
+                r = queue_.front();
+                queue_.pop_front();
+                // Host programs the registers, then sets AP_START
+                regs_[kRegInputAddrLo / 4] = static_cast<uint32_t>(r.in.device_addr);
+                regs_[kRegInputAddrHi / 4] = static_cast<uint32_t>(r.in.device_addr >> 32);
+                regs_[kRegOutputAddrLo / 4] = static_cast<uint32_t>(r.out.device_addr);
+                regs_[kRegOutputAddrHi / 4] = static_cast<uint32_t>(r.out.device_addr >> 32);
+                regs_[kRegCount / 4] = r.count;
+                regs_[kRegBatchSize / 4] = r.count;
+                regs_[kRegLaneMask / 4] = r.lane_mask;
+                regs_[kRegCtrl / 4] = kCtrlApStart;
+                regs_[kRegStatus / 4] = r.lane_mask & 0xffff;
+            }
+
+            auto start = std::chrono::steady_clock::now();
+            uint32_t error = (r.lane_mask & ((1u << lanes_) - 1)) == 0 ? 1 : 0;
+            if (!error) {
+                // Host -> device, kernel, device -> host
+                memcpy(r.in.handle, r.in.host, size_t(r.count) * sizeof(DmaGlyphPair));
+                run_merge_kernel(static_cast<const DmaGlyphPair*>(r.in.handle),
+                                 static_cast<DmaMergeResult*>(r.out.handle), r.count);
+                memcpy(r.out.host, r.out.handle, size_t(r.count) * sizeof(DmaMergeResult));
+            }
+            auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                          std::chrono::steady_clock::now() - start).count();
+
+            std::lock_guard<std::mutex> lock(mutex_);
+            regs_[kRegPerfCycles / 4] += static_cast<uint32_t>(ns / 5);  // Cycles at 200 MHz
+            regs_[kRegPerfMerges / 4] += error ? 0 : r.count;
+            regs_[kRegErrorFlags / 4] = error;  // Per run
+            if (error) {
+                failed_.push_back(r.ticket);
+            }
+            regs_[kRegStatus / 4] = 0;
+            regs_[kRegCtrl / 4] = kCtrlApDone | kCtrlApIdle;
+            completed_ = r.ticket;
+            done_.notify_all();
+        }
+    }
+
+    const size_t lanes_;
+    mutable std::mutex mutex_;
+    std::condition_variable wake_;
+    std::condition_variable done_;
+    std::deque<Run> queue_;
+    std::vector<uint64_t> failed_;  // Runs that set ERROR_FLAGS, until waited on
+    uint64_t submitted_ = 0;
+    uint64_t completed_ = 0;
+    bool stop_ = false;
+    uint32_t regs_[kNumRegs] = {};
+    std::thread thread_;
+};
+
+#if defined(SPU_WITH_XRT)
+
+/**
+ * Alveo card: kernel arguments (input, output, count, batch_size,
+ * lane_mask) land in the INPUT_ADDR .. LANE_MASK registers. submit()
+ * syncs the input BO and starts the run, so the host -> device copy of
+ * one slot overlaps the kernel of the previous one; wait() finishes the
+ * run and syncs the output BO back.
+ */
+class XrtDevice : public MergeDevice {
+public:
+    XrtDevice(const std::string& xclbin, unsigned index) {
+        device_ = xrtDeviceOpen(index);
+        if (!device_) {
+            throw std::runtime_error("xrt: cannot open device " + std::to_string(index));
+        }
+        xclbin_ = xrtXclbinAllocFilename(xclbin.c_str());
+        if (!xclbin_ || xrtDeviceLoadXclbinHandle(device_, xclbin_) != 0) {
+            close();
+            throw std::runtime_error("xrt: cannot load " + xclbin);
+        }
+        xuid_t uuid;
+        xrtXclbinGetUUID(xclbin_, uuid);
+        kernel_ = xrtPLKernelOpen(device_, uuid, "merge_kernel");
+        if (!kernel_) {
+            close();
+            throw std::runtime_error("xrt: no merge_kernel in " + xclbin);
+        }
+    }
+
+    ~XrtDevice() override { close(); }
+
+    const char* name() const override { return "xrt"; }
+    size_t lanes() const override { return 16; }
+
+    Buffer alloc(size_t bytes) override {
+        Buffer b;
+        b.bytes = round_up(std::max<size_t>(bytes, 1), 4096);
+        xrtBufferHandle bo = xrtBOAlloc(device_, b.bytes, XCL_BO_FLAGS_NONE,
+                                        xrtKernelArgGroupId(kernel_, 0));
+        if (!bo) {
+            throw std::runtime_error("xrt: buffer allocation failed");
+        }
+        b.handle = bo;
+        b.host = xrtBOMap(bo);  // Page-aligned, pinned by XRT
+        b.device_addr = xrtBOAddress(bo);
+        return b;
+    }
+
+    void release(Buffer& b) override {
+        if (b.handle) {
+            xrtBOFree(static_cast<xrtBufferHandle>(b.handle));
+        }
+        b = Buffer();
+    }
+
+    uint64_t submit(const Buffer& in, const Buffer& out, uint32_t count,
+                    uint32_t lane_mask) override {
+        xrtBufferHandle in_bo = static_cast<xrtBufferHandle>(in.handle);
+        if (xrtBOSync(in_bo, XCL_BO_SYNC_BO_TO_DEVICE, size_t(count) * sizeof(DmaGlyphPair), 0) != 0) {
+            throw std::runtime_error("xrt: host to device sync failed");
+        }
+        xrtRunHandle run = xrtRunOpen(kernel_);
+        xrtRunSetArg(run, 0, in_bo);
+        xrtRunSetArg(run, 1, static_cast<xrtBufferHandle>(out.handle));
+        xrtRunSetArg(run, 2, count);
+        xrtRunSetArg(run, 3, count);
+        xrtRunSetArg(run, 4, lane_mask);
+        if (xrtRunStart(run) != 0) {
+            xrtRunClose(run);
+            throw std::runtime_error("xrt: kernel start failed");
+        }
+        uint64_t ticket = ++submitted_;
+        runs_[ticket] = Pending{run, static_cast<xrtBufferHandle>(out.handle),
+                                size_t(count) * sizeof(DmaMergeResult)};
+        return ticket;
+    }
+
+    void wait(uint64_t ticket) override {
+        auto it = runs_.find(ticket);
+        if (it == runs_.end()) {
+            return;
+        }
+        Pending p = it->second;
+        runs_.erase(it);
+        ert_cmd_state state = xrtRunWait(p.run);
+        xrtRunClose(p.run);
+        if (state != ERT_CMD_STATE_COMPLETED) {
+            throw std::runtime_error("xrt: kernel run failed");
+        }
+        if (xrtBOSync(p.out, XCL_BO_SYNC_BO_FROM_DEVICE, p.bytes, 0) != 0) {
+            throw std::runtime_error("xrt: device to host sync failed");
+        }
+    }
+
+    uint32_t read_register(uint32_t offset) const override {
+        uint32_t value = 0;
+        xrtKernelReadRegister(kernel_, offset, &value);
+        return value;
+    }
+
+private:
+    struct Pending {
+        xrtRunHandle run;
+        xrtBufferHandle out;
+        size_t bytes;
+    };
+
+    void close() {
+        for (auto& kv : runs_) {
+            xrtRunWait(kv.second.run);
+            xrtRunClose(kv.second.run);
+        }
+        runs_.clear();
+        if (kernel_) {
+            xrtKernelClose(kernel_);
+        }
+        if (xclbin_) {
+            xrtXclbinFreeHandle(xclbin_);
+        }
+        if (device_) {
+            xrtDeviceClose(device_);
+        }
+        kernel_ = nullptr;
+        xclbin_ = nullptr;
+        device_ = nullptr;
+    }
+
+    xrtDeviceHandle device_ = nullptr;
+    xrtXclbinHandle xclbin_ = nullptr;
+    xrtKernelHandle kernel_ = nullptr;
+    uint64_t submitted_ = 0;
+    std::unordered_map<uint64_t, Pending> runs_;
+};
+
+#endif // SPU_WITH_XRT
+
+bool fits_descriptor(const GlyphStore& in, const MergePair& p) {
+    return in.content_len(p.first) <= kDmaContentBytes && in.content_len(p.second) <= kDmaContentBytes;
+}
+
+void pack_glyph(const GlyphStore& in, uint32_t i, DmaGlyph& d) {
+    memcpy(d.id, in.id(i).bytes, sizeof(d.id));
+    d.energy = in.energy()[i];
+    d.last_update_time = in.last_update_time()[i];
+    d.activation_count = in.activation_count()[i];
+    d.content_len = static_cast<uint16_t>(in.content_len(i));
+    memcpy(d.content, in.content(i), d.content_len);
+}
+
+} // namespace
+
+std::unique_ptr<MergeDevice> open_emulated_device(size_t lanes) {
+    return std::unique_ptr<MergeDevice>(new EmulatedDevice(lanes));
+}
+
+std::unique_ptr<MergeDevice> open_xrt_device(const std::string& xclbin, unsigned index) {
+#if defined(SPU_WITH_XRT)
+    return std::unique_ptr<MergeDevice>(new XrtDevice(xclbin, index));
+#else
+    (void)xclbin;
+    (void)index;
+    throw std::runtime_error("built without XRT support (-DSPU_WITH_XRT)");
+#endif
+}
+
+// One rotation slot: a descriptor buffer, a result buffer and its run
+struct FpgaMergeBackend::Slot {
+    MergeDevice::Buffer in;
+    MergeDevice::Buffer out;
+    uint64_t ticket = 0;
+    size_t count = 0;
+};
+
+FpgaMergeBackend::FpgaMergeBackend(std::unique_ptr<MergeDevice> device, size_t batch,
+                                   size_t buffers, size_t min_offload)
+    : device_(std::move(device)), batch_(batch), min_offload_(min_offload),
+      num_slots_(buffers) {
+    if (!device_ || batch_ == 0 || num_slots_ == 0 || batch_ > UINT32_MAX) {
+        throw std::invalid_argument("FpgaMergeBackend needs a device, batch >= 1, buffers >= 1");
+    }
+    lane_mask_ = static_cast<uint32_t>((uint64_t(1) << device_->lanes()) - 1);
+    slots_.reset(new Slot[num_slots_]);
+    try {
+        for (size_t s = 0; s < num_slots_; s++) {
+            slots_[s].in = device_->alloc(batch_ * sizeof(DmaGlyphPair));
+            slots_[s].out = device_->alloc(batch_ * sizeof(DmaMergeResult));
+        }
+    } catch (...) {
+        for (size_t s = 0; s < num_slots_; s++) {
+            device_->release(slots_[s].in);
+            device_->release(slots_[s].out);
+        }
+        throw;
+    }
+}
+
+FpgaMergeBackend::~FpgaMergeBackend() {
+    for (size_t s = 0; s < num_slots_; s++) {
+        device_->release(slots_[s].in);
+        device_->release(slots_[s].out);
+    }
+}
+
+void FpgaMergeBackend::merge_batch(const GlyphStore& in, const MergePair* pairs, size_t n,
+                                   GlyphStore& out, ThreadPool* pool) {
+    if (n < min_offload_) {
+        spu::merge_batch(in, pairs, n, out, pool);
+        stats_.cpu_merges += n;
+        return;
+    }
+
+    std::deque<size_t> inflight;  // Slots in submission order
+    size_t next_slot = 0;
+
+    // Oldest run: wait, then append its results in pair order
+    auto drain_one = [&] {
+        Slot& slot = slots_[inflight.front()];
+        inflight.pop_front();
+        device_->wait(slot.ticket);
+        const DmaMergeResult* results = static_cast<const DmaMergeResult*>(slot.out.host);
+        Glyph g;
+        for (size_t i = 0; i < slot.count; i++) {
+            const DmaMergeResult& r = results[i];
+            memcpy(g.id.bytes, r.id, sizeof(r.id));
+            memcpy(g.parent1_id.bytes, r.parent1_id, sizeof(r.parent1_id));
+            memcpy(g.parent2_id.bytes, r.parent2_id, sizeof(r.parent2_id));
+            g.content.assign_external(r.content, r.content_len);
+            g.energy = r.energy;
+            g.activation_count = r.activation_count;
+            g.last_update_time = r.last_update_time;
+            out.append(g);
+        }
+    };
+
+    try {
+        for (size_t first = 0; first < n; first += batch_) {
+            const size_t count = std::min(batch_, n - first);
+            const MergePair* chunk = pairs + first;
+            bool fits = true;
+            for (size_t i = 0; i < count && fits; i++) {
+                fits = fits_descriptor(in, chunk[i]);
+            }
+
+            if (!fits) {
+                // Keep output order: earlier device batches land first
+                while (!inflight.empty()) {
+                    drain_one();
+                }
+                spu::merge_batch(in, chunk, count, out, pool);
+                stats_.cpu_merges += count;
+                continue;
+            }
+
+            // All slots busy: the one to reuse is the oldest run
+            Slot& slot = slots_[next_slot];
+            if (!inflight.empty() && inflight.front() == next_slot) {
+                drain_one();
+            }
+
+            DmaGlyphPair* desc = static_cast<DmaGlyphPair*>(slot.in.host);
+            auto pack = [&](size_t begin, size_t end) {
+                for (size_t i = begin; i < end; i++) {
+                    pack_glyph(in, chunk[i].first, desc[i].glyph[0]);
+                    pack_glyph(in, chunk[i].second, desc[i].glyph[1]);
+                }
+            };
+            if (pool) {
+                pool->parallel_for(count, 256, pack);
+            } else {
+                pack(0, count);
+            }
+
+            slot.count = count;
+            slot.ticket = device_->submit(slot.in, slot.out, static_cast<uint32_t>(count), lane_mask_);
+            inflight.push_back(next_slot);
+            next_slot = (next_slot + 1) % num_slots_;
+            stats_.device_batches++;
+            stats_.device_merges += count;
+        }
+        while (!inflight.empty()) {
+            drain_one();
+        }
+    } catch (...) {
+        // Let outstanding runs finish before their buffers are reused
+        for (size_t s : inflight) {
+            try {
+                device_->wait(slots_[s].ticket);
+            } catch (...) {
+            }
+        }
+        throw;
+    }
+}
+
+} // namespace spu
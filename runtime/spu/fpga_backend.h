@@ -0,0 +1,208 @@
+/**
+ * SPU FPGA Backend - Host side of the merge kernel DMA path
+ *
+ * Implements the host contract of docs/merge_fpga_sketch.md: merge_batch()
+ * inputs are packed into 64-byte-aligned DmaGlyphPair descriptors in
+ * pinned buffers, the kernel is started through the control registers
+ * (INPUT_ADDR, OUTPUT_ADDR, COUNT, BATCH_SIZE, LANE_MASK), and
+ * DmaMergeResult records are unpacked into the output store.
+ *
+ * Batches are split into device batches that rotate through two or more
+ * buffer slots: while the device transfers and merges batch k, the host
+ * packs batch k + 1 and unpacks batch k - 1. Batches below min_offload,
+ * and device batches with content too long for a descriptor, run on the
+ * CPU merge_batch() instead, in order. Results are identical to the CPU
+ * path (same precedence, concatenation, metadata and provenance; the ID is
+ * SHA-256, so the CPU side must use a SHA-256 hash backend).
+ *
+ * Devices: open_emulated_device() is a software device (a thread that
+ * models the DMA copies and runs the kernel with the active hash backend)
+ * for CI and development; open_xrt_device() drives an Alveo card through
+ * XRT and is only available when built with -DSPU_WITH_XRT (link -lxrt_coreutil).
+ */
+
+#ifndef SPU_FPGA_BACKEND_H
+#define SPU_FPGA_BACKEND_H
+
+#include "glyph_store.h"
+#include "thread_pool.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace spu {
+
+// Longest glyph content a descriptor carries
+constexpr size_t kDmaContentBytes = 256;
+
+// One glyph of a descriptor (320 bytes; content starts on the second cache line)
+struct alignas(64) DmaGlyph {
+    uint8_t id[32];             // +0: Binary ID
+    double energy;              // +32
+    uint64_t last_update_time;  // +40
+    uint32_t activation_count;  // +48
+    uint16_t content_len;       // +52
+    uint16_t reserved;          // +54
+    uint8_t pad[8];             // +56
+    char content[kDmaContentBytes];  // +64
+};
+
+// Host -> device: one merge (640 bytes)
+struct alignas(64) DmaGlyphPair {
+    DmaGlyph glyph[2];
+};
+
+// Device -> host: one merge result (704 bytes)
+struct alignas(64) DmaMergeResult {
+    uint8_t id[32];             // +0: SHA-256 of content
+    double energy;              // +32
+    uint64_t last_update_time;  // +40
+    uint32_t activation_count;  // +48
+    uint16_t content_len;       // +52
+    uint16_t reserved;          // +54
+    uint8_t pad[8];             // +56
+    uint8_t parent1_id[32];     // +64: Primary
+    uint8_t parent2_id[32];     // +96: Secondary
+    char content[2 * kDmaContentBytes + 3 + 61];  // +128: primary + " + " + secondary
+};
+
+static_assert(sizeof(DmaGlyph) == 320, "DmaGlyph layout");
+static_assert(sizeof(DmaGlyphPair) == 640, "DmaGlyphPair layout");
+static_assert(sizeof(DmaMergeResult) == 704, "DmaMergeResult layout");
+
+// AXI4-Lite register offsets (docs/merge_fpga_sketch.md)
+enum FpgaRegister : uint32_t {
+    kRegCtrl = 0x00,
+    kRegStatus = 0x04,
+    kRegInputAddrLo = 0x08,
+    kRegInputAddrHi = 0x0C,
+    kRegOutputAddrLo = 0x10,
+    kRegOutputAddrHi = 0x14,
+    kRegCount = 0x18,
+    kRegBatchSize = 0x1C,
+    kRegPerfCycles = 0x20,
+    kRegPerfMerges = 0x24,
+    kRegErrorFlags = 0x28,
+    kRegLaneMask = 0x2C,
+};
+
+// CTRL bits
+constexpr uint32_t kCtrlApStart = 1u << 0;
+constexpr uint32_t kCtrlApDone = 1u << 1;
+constexpr uint32_t kCtrlApIdle = 1u << 2;
+
+/**
+ * A merge kernel with its own DMA engine
+ *
+ * Buffers are pinned host memory the device can DMA from / to. A run
+ * copies count descriptors host -> device, merges them, and copies the
+ * results back; runs complete in submission order.
+ */
+class MergeDevice {
+public:
+    struct Buffer {
+        void* host = nullptr;    // 64-byte-aligned mapping
+        size_t bytes = 0;
+        uint64_t device_addr = 0;
+        void* handle = nullptr;  // Device-specific
+    };
+
+    virtual ~MergeDevice() = default;
+
+    virtual const char* name() const = 0;
+    virtual size_t lanes() const = 0;
+
+    /**
+     * @throws std::bad_alloc or std::runtime_error if the device is out of memory
+     */
+    virtual Buffer alloc(size_t bytes) = 0;
+    virtual void release(Buffer& buffer) = 0;
+
+    /**
+     * Queue a run over count descriptors of in, results to out
+     *
+     * @return Ticket for wait()
+     */
+    virtual uint64_t submit(const Buffer& in, const Buffer& out, uint32_t count,
+                            uint32_t lane_mask) = 0;
+
+    /**
+     * Block until the run and its device -> host copy are done
+     *
+     * @throws std::runtime_error if the device reported an error
+     */
+    virtual void wait(uint64_t ticket) = 0;
+
+    virtual uint32_t read_register(uint32_t offset) const = 0;
+};
+
+// Software device for CI: DMA copies and the kernel run on a device thread
+std::unique_ptr<MergeDevice> open_emulated_device(size_t lanes = 16);
+
+/**
+ * Alveo card through XRT
+ *
+ * @param xclbin Bitstream with a "merge_kernel" compute unit
+ * @throws std::runtime_error if the device or kernel cannot be opened, or
+ *         when built without SPU_WITH_XRT
+ */
+std::unique_ptr<MergeDevice> open_xrt_device(const std::string& xclbin, unsigned index = 0);
+
+class FpgaMergeBackend {
+public:
+    static constexpr size_t kDefaultBatch = 1024;      // Pairs per device batch
+    static constexpr size_t kDefaultBuffers = 2;
+    static constexpr size_t kDefaultMinOffload = 256;  // Smaller batches stay on the CPU
+
+    struct Stats {
+        uint64_t device_batches;
+        uint64_t device_merges;
+        uint64_t cpu_merges;  // Small batches and over-long content
+    };
+
+    /**
+     * @param device Kernel to drive
+     * @param batch Pairs per device batch (the BATCH_SIZE register)
+     * @param buffers Buffer slots in rotation (>= 2 for overlap)
+     * @param min_offload Batches with fewer pairs run on the CPU
+     * @throws std::invalid_argument if batch or buffers is 0
+     */
+    explicit FpgaMergeBackend(std::unique_ptr<MergeDevice> device, size_t batch = kDefaultBatch,
+                              size_t buffers = kDefaultBuffers,
+                              size_t min_offload = kDefaultMinOffload);
+    ~FpgaMergeBackend();
+
+    FpgaMergeBackend(const FpgaMergeBackend&) = delete;
+    FpgaMergeBackend& operator=(const FpgaMergeBackend&) = delete;
+
+    /**
+     * Same contract as merge_batch(in, pairs, n, out, pool)
+     *
+     * @param pool Packs descriptors and runs CPU fallbacks (nullptr = calling thread)
+     */
+    void merge_batch(const GlyphStore& in, const MergePair* pairs, size_t n, GlyphStore& out,
+                     ThreadPool* pool = nullptr);
+
+    // Lanes the kernel may use (LANE_MASK); default all
+    void set_lane_mask(uint32_t mask) { lane_mask_ = mask; }
+
+    MergeDevice& device() { return *device_; }
+    Stats stats() const { return stats_; }
+
+private:
+    struct Slot;
+
+    std::unique_ptr<MergeDevice> device_;
+    size_t batch_;
+    size_t min_offload_;
+    uint32_t lane_mask_;
+    std::unique_ptr<Slot[]> slots_;
+    size_t num_slots_;
+    Stats stats_{};
+};
+
+} // namespace spu
+
+#endif // SPU_FPGA_BACKEND_H
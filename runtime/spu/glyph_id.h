@@ -0,0 +1,99 @@
+/**
+ * SPU Glyph ID - Binary 32-byte content ID
+ *
+ * Internal representation of glyph IDs for merge, store and index code.
+ * Converted to the 64-char hex form only at the Python / JSON edges.
+ */
+
+#ifndef SPU_GLYPH_ID_H
+#define SPU_GLYPH_ID_H
+
+#include "hash.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+namespace spu {
+
+struct GlyphId {
+    // Hex string length (without null)
+    static constexpr size_t kHexLen = 2 * kDigestLen;
+
+    uint8_t bytes[kDigestLen];
+
+    // All-zero ID ("no ID", e.g. provenance of an unmerged glyph)
+    static GlyphId zero() {
+        GlyphId id;
+        memset(id.bytes, 0, sizeof(id.bytes));
+        return id;
+    }
+
+    bool is_zero() const {
+        for (size_t i = 0; i < kDigestLen; i++) {
+            if (bytes[i] != 0) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /**
+     * Format as lowercase hex
+     *
+     * @param output Output buffer (must be 65 bytes for hex string + null)
+     */
+    void to_hex(char* output) const { digest_to_hex(bytes, output); }
+
+    std::string hex() const {
+        char buf[kHexLen + 1];
+        to_hex(buf);
+        return std::string(buf, kHexLen);
+    }
+
+    /**
+     * Parse a 64-char hex string (either case)
+     *
+     * @return false if hex is not exactly 64 hex digits
+     */
+    static bool from_hex(const char* hex, size_t len, GlyphId& out) {
+        if (len != kHexLen) {
+            return false;
+        }
+        for (size_t i = 0; i < kDigestLen; i++) {
+            int hi = hex_value(hex[2 * i]);
+            int lo = hex_value(hex[2 * i + 1]);
+            if (hi < 0 || lo < 0) {
+                return false;
+            }
+            out.bytes[i] = static_cast<uint8_t>((hi << 4) | lo);
+        }
+        return true;
+    }
+
+    bool operator==(const GlyphId& o) const { return memcmp(bytes, o.bytes, kDigestLen) == 0; }
+    bool operator!=(const GlyphId& o) const { return !(*this == o); }
+    bool operator<(const GlyphId& o) const { return memcmp(bytes, o.bytes, kDigestLen) < 0; }
+
+private:
+    static int hex_value(char c) {
+        if (c >= '0' && c <= '9') return c - '0';
+        if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+        if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+        return -1;
+    }
+};
+
+// Hash functor for unordered containers (IDs are already uniformly distributed)
+struct GlyphIdHash {
+    size_t operator()(const GlyphId& id) const {
+        uint64_t h;
+        memcpy(&h, id.bytes, sizeof(h));
+        return static_cast<size_t>(h);
+    }
+};
+
+} // namespace spu
+
+#endif // SPU_GLYPH_ID_H
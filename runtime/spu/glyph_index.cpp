@@ -0,0 +1,459 @@
+/**
+ * SPU Glyph Index - ID, ID-prefix and content-token lookup
+ */
+
+#include "glyph_index.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <system_error>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace spu {
+
+namespace {
+
+[[noreturn]] void throw_errno(const std::string& what) {
+    throw std::system_error(errno, std::generic_category(), what);
+}
+
+size_t align8(size_t n) {
+    return (n + 7) & ~size_t(7);
+}
+
+int hex_nibble(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+size_t id_hash(const GlyphId& id) {
+    // IDs are uniform hashes; bytes 8-15 are independent of the radix bucket bytes
+    uint64_t h;
+    memcpy(&h, id.bytes + 8, sizeof(h));
+    h *= 0x9e3779b97f4a7c15ULL;
+    return static_cast<size_t>(h ^ (h >> 32));
+}
+
+void write_file(const std::string& path, const std::string& data) {
+    std::string tmp = path + ".tmp";
+    int fd = open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        throw_errno("open " + tmp);
+    }
+    const char* p = data.data();
+    size_t len = data.size();
+    while (len > 0) {
+        ssize_t w = write(fd, p, len);
+        if (w < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            int err = errno;
+            close(fd);
+            unlink(tmp.c_str());
+            throw std::system_error(err, std::generic_category(), "write " + tmp);
+        }
+        p += w;
+        len -= static_cast<size_t>(w);
+    }
+    if (fsync(fd) != 0) {
+        int err = errno;
+        close(fd);
+        unlink(tmp.c_str());
+        throw std::system_error(err, std::generic_category(), "sync " + tmp);
+    }
+    close(fd);
+    if (rename(tmp.c_str(), path.c_str()) != 0) {
+        int err = errno;
+        unlink(tmp.c_str());
+        throw std::system_error(err, std::generic_category(), "rename " + tmp);
+    }
+}
+
+std::string read_file(const std::string& path) {
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        throw_errno("open " + path);
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        int err = errno;
+        close(fd);
+        throw std::system_error(err, std::generic_category(), "fstat " + path);
+    }
+    std::string data(static_cast<size_t>(st.st_size), '\0');
+    size_t done = 0;
+    while (done < data.size()) {
+        ssize_t r = read(fd, &data[done], data.size() - done);
+        if (r < 0 && errno == EINTR) {
+            continue;
+        }
+        if (r <= 0) {
+            int err = r < 0 ? errno : EIO;
+            close(fd);
+            throw std::system_error(err, std::generic_category(), "read " + path);
+        }
+        done += static_cast<size_t>(r);
+    }
+    close(fd);
+    return data;
+}
+
+} // namespace
+
+GlyphIndex::GlyphIndex() : table_(1024, 0), mask_(1023), buckets_(kBuckets) {}
+
+uint64_t GlyphIndex::token_hash(const char* data, size_t len) {
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i < len; i++) {
+        h ^= static_cast<uint8_t>(data[i]);
+        h *= 0x100000001b3ULL;
+    }
+    return h;
+}
+
+void GlyphIndex::tokenize(const char* data, size_t len, std::vector<std::string>& out) {
+    const size_t first = out.size();
+    std::string token;
+    for (size_t i = 0; i <= len; i++) {
+        unsigned char c = i < len ? static_cast<unsigned char>(data[i]) : 0;
+        bool word = (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+                    c >= 0x80;
+        if (word) {
+            token.push_back(c >= 'A' && c <= 'Z' ? static_cast<char>(c + 32) : static_cast<char>(c));
+        }
+        if (!token.empty() && (!word || token.size() == kMaxTokenLen)) {
+            out.push_back(token);
+            token.clear();
+        }
+    }
+    std::sort(out.begin() + first, out.end());
+    out.erase(std::unique(out.begin() + first, out.end()), out.end());
+}
+
+void GlyphIndex::grow_table() {
+    std::vector<uint32_t> table(table_.size() * 2, 0);
+    size_t mask = table.size() - 1;
+    for (uint32_t e : table_) {
+        if (e == 0) {
+            continue;
+        }
+        size_t i = id_hash(ids_[e - 1]) & mask;
+        while (table[i] != 0) {
+            i = (i + 1) & mask;
+        }
+        table[i] = e;
+    }
+    table_.swap(table);
+    mask_ = mask;
+}
+
+uint32_t GlyphIndex::find(const GlyphId& id) const {
+    for (size_t i = id_hash(id) & mask_;; i = (i + 1) & mask_) {
+        uint32_t e = table_[i];
+        if (e == 0) {
+            return npos;
+        }
+        if (ids_[e - 1] == id) {
+            return e - 1;
+        }
+    }
+}
+
+uint32_t GlyphIndex::insert_id(const GlyphId& id) {
+    uint32_t existing = find(id);
+    if (existing != npos) {
+        return existing;
+    }
+    if (ids_.size() >= npos - 1) {
+        throw std::length_error("GlyphIndex holds at most 2^32 - 2 glyphs");
+    }
+    if (2 * (ids_.size() + 1) > table_.size()) {
+        grow_table();
+    }
+
+    uint32_t ordinal = static_cast<uint32_t>(ids_.size());
+    ids_.push_back(id);
+    size_t i = id_hash(id) & mask_;
+    while (table_[i] != 0) {
+        i = (i + 1) & mask_;
+    }
+    table_[i] = ordinal + 1;
+
+    std::vector<uint32_t>& bucket = buckets_[bucket_of(id)];
+    auto at = std::lower_bound(bucket.begin(), bucket.end(), id,
+                               [&](uint32_t o, const GlyphId& key) { return ids_[o] < key; });
+    bucket.insert(at, ordinal);
+    return ordinal;
+}
+
+void GlyphIndex::add_tokens(uint32_t ordinal, std::vector<std::string>& tokens) {
+    for (std::string& t : tokens) {
+        postings_[std::move(t)].push_back(ordinal);  // Ordinals only grow: lists stay sorted
+    }
+}
+
+uint32_t GlyphIndex::add(const GlyphId& id, const char* content, size_t len) {
+    const size_t before = ids_.size();
+    uint32_t ordinal = insert_id(id);
+    if (ordinal == before) {
+        std::vector<std::string> tokens;
+        tokenize(content, len, tokens);
+        add_tokens(ordinal, tokens);
+    }
+    return ordinal;
+}
+
+uint32_t GlyphIndex::add(const Glyph& g) {
+    if (g.content.is_rope()) {
+        std::string flat = g.content.str();
+        return add(g.id, flat.data(), flat.size());
+    }
+    return add(g.id, g.content.data(), g.content.size());
+}
+
+void GlyphIndex::add(const GlyphStore& store, size_t begin, size_t end) {
+    end = std::min(end, store.size());
+    for (size_t i = begin; i < end; i++) {
+        add(store.id(i), store.content(i), store.content_len(i));
+    }
+}
+
+std::vector<GlyphId> GlyphIndex::find_prefix(const std::string& hex, size_t limit) const {
+    if (hex.empty() || hex.size() > GlyphId::kHexLen) {
+        throw std::invalid_argument("ID prefix must be 1-64 hex digits");
+    }
+    // lo / hi: the prefix padded with 0s / fs
+    GlyphId lo = GlyphId::zero();
+    GlyphId hi;
+    memset(hi.bytes, 0xff, sizeof(hi.bytes));
+    for (size_t i = 0; i < hex.size(); i++) {
+        int v = hex_nibble(hex[i]);
+        if (v < 0) {
+            throw std::invalid_argument("ID prefix must be 1-64 hex digits: '" + hex + "'");
+        }
+        const int shift = (i % 2 == 0) ? 4 : 0;
+        lo.bytes[i / 2] = static_cast<uint8_t>(lo.bytes[i / 2] | (v << shift));
+        hi.bytes[i / 2] = static_cast<uint8_t>((hi.bytes[i / 2] & ~(0xf << shift)) | (v << shift));
+    }
+
+    std::vector<GlyphId> out;
+    for (size_t b = bucket_of(lo); b <= bucket_of(hi) && out.size() < limit; b++) {
+        const std::vector<uint32_t>& bucket = buckets_[b];
+        auto it = std::lower_bound(bucket.begin(), bucket.end(), lo,
+                                   [&](uint32_t o, const GlyphId& key) { return ids_[o] < key; });
+        for (; it != bucket.end() && out.size() < limit; ++it) {
+            const GlyphId& id = ids_[*it];
+            if (hi < id) {
+                break;
+            }
+            out.push_back(id);
+        }
+    }
+    return out;
+}
+
+std::vector<uint32_t> GlyphIndex::find_tokens(const std::vector<std::string>& query,
+                                              size_t limit) const {
+    std::vector<std::string> tokens;
+    for (const std::string& q : query) {
+        tokenize(q.data(), q.size(), tokens);
+    }
+    std::sort(tokens.begin(), tokens.end());
+    tokens.erase(std::unique(tokens.begin(), tokens.end()), tokens.end());
+
+    std::vector<const std::vector<uint32_t>*> lists;
+    for (const std::string& t : tokens) {
+        auto it = postings_.find(t);
+        if (it == postings_.end()) {
+            return {};
+        }
+        lists.push_back(&it->second);
+    }
+    if (lists.empty()) {
+        return {};
+    }
+
+    // Walk the shortest list; binary-search forward in the others
+    std::sort(lists.begin(), lists.end(),
+              [](const std::vector<uint32_t>* a, const std::vector<uint32_t>* b) {
+                  return a->size() < b->size();
+              });
+    std::vector<std::vector<uint32_t>::const_iterator> cursor;
+    for (const auto* l : lists) {
+        cursor.push_back(l->begin());
+    }
+    std::vector<uint32_t> out;
+    for (uint32_t candidate : *lists[0]) {
+        bool all = true;
+        for (size_t k = 1; k < lists.size(); k++) {
+            cursor[k] = std::lower_bound(cursor[k], lists[k]->end(), candidate);
+            if (cursor[k] == lists[k]->end()) {
+                return out;
+            }
+            if (*cursor[k] != candidate) {
+                all = false;
+                break;
+            }
+        }
+        if (all) {
+            out.push_back(candidate);
+            if (out.size() >= limit) {
+                break;
+            }
+        }
+    }
+    return out;
+}
+
+void GlyphIndex::save(const std::string& path) const {
+    const size_t n = ids_.size();
+
+    // Buckets in order are the IDs in order: rank = position in that walk
+    std::vector<uint32_t> rank(n);
+    std::string ids;
+    ids.reserve(n * sizeof(GlyphId));
+    uint32_t next = 0;
+    for (const auto& bucket : buckets_) {
+        for (uint32_t o : bucket) {
+            rank[o] = next++;
+            ids.append(reinterpret_cast<const char*>(ids_[o].bytes), sizeof(GlyphId));
+        }
+    }
+
+    struct TokenRef {
+        uint64_t hash;
+        const std::string* token;
+        const std::vector<uint32_t>* list;
+    };
+    std::vector<TokenRef> refs;
+    refs.reserve(postings_.size());
+    for (const auto& kv : postings_) {
+        refs.push_back(TokenRef{token_hash(kv.first.data(), kv.first.size()), &kv.first, &kv.second});
+    }
+    std::sort(refs.begin(), refs.end(), [](const TokenRef& a, const TokenRef& b) {
+        return a.hash != b.hash ? a.hash < b.hash : *a.token < *b.token;
+    });
+
+    std::vector<IndexTokenEntry> entries(refs.size());
+    std::vector<uint32_t> postings;
+    std::string strings;
+    for (size_t i = 0; i < refs.size(); i++) {
+        IndexTokenEntry& e = entries[i];
+        e.hash = refs[i].hash;
+        e.postings_start = postings.size();
+        e.postings_count = static_cast<uint32_t>(refs[i].list->size());
+        e.token_len = static_cast<uint32_t>(refs[i].token->size());
+        e.token_offset = strings.size();
+        size_t start = postings.size();
+        for (uint32_t o : *refs[i].list) {
+            postings.push_back(rank[o]);
+        }
+        std::sort(postings.begin() + start, postings.end());
+        strings += *refs[i].token;
+    }
+
+    IndexFileHeader h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, kIndexMagic, sizeof(h.magic));
+    h.version = kIndexVersion;
+    h.count = n;
+    h.token_count = entries.size();
+    h.ids_offset = align8(sizeof(h));
+    h.tokens_offset = align8(h.ids_offset + ids.size());
+    h.postings_offset = align8(h.tokens_offset + entries.size() * sizeof(IndexTokenEntry));
+    h.strings_offset = align8(h.postings_offset + postings.size() * sizeof(uint32_t));
+    h.file_size = align8(h.strings_offset + strings.size());
+
+    std::string file(h.file_size, '\0');
+    memcpy(&file[0], &h, sizeof(h));
+    memcpy(&file[h.ids_offset], ids.data(), ids.size());
+    if (!entries.empty()) {
+        memcpy(&file[h.tokens_offset], entries.data(), entries.size() * sizeof(IndexTokenEntry));
+    }
+    if (!postings.empty()) {
+        memcpy(&file[h.postings_offset], postings.data(), postings.size() * sizeof(uint32_t));
+    }
+    memcpy(&file[h.strings_offset], strings.data(), strings.size());
+    write_file(path, file);
+}
+
+GlyphIndex GlyphIndex::load(const std::string& path) {
+    std::string file = read_file(path);
+    IndexFileHeader h;
+    if (file.size() < sizeof(h)) {
+        throw std::runtime_error("truncated glyph index " + path);
+    }
+    memcpy(&h, file.data(), sizeof(h));
+    if (memcmp(h.magic, kIndexMagic, sizeof(h.magic)) != 0) {
+        throw std::runtime_error("not a glyph index: " + path);
+    }
+    if (h.version != kIndexVersion) {
+        throw std::runtime_error("unsupported glyph index version " + std::to_string(h.version) +
+                                 ": " + path);
+    }
+    const uint64_t size = file.size();
+    auto section_ok = [&](uint64_t offset, uint64_t count, uint64_t elem) {
+        return offset <= size && count <= (size - offset) / elem;
+    };
+    if (h.file_size != size || h.count >= npos ||
+        !section_ok(h.ids_offset, h.count, sizeof(GlyphId)) ||
+        !section_ok(h.tokens_offset, h.token_count, sizeof(IndexTokenEntry)) ||
+        h.postings_offset > size || h.strings_offset > size) {
+        throw std::runtime_error("invalid glyph index header: " + path);
+    }
+    const uint64_t postings_total = (h.strings_offset - std::min(h.strings_offset, h.postings_offset)) /
+                                    sizeof(uint32_t);
+
+    GlyphIndex index;
+    index.ids_.reserve(h.count);
+    while (index.table_.size() < 2 * h.count) {
+        index.table_.resize(index.table_.size() * 2);
+    }
+    index.mask_ = index.table_.size() - 1;
+    for (uint64_t i = 0; i < h.count; i++) {
+        GlyphId id;
+        memcpy(id.bytes, file.data() + h.ids_offset + i * sizeof(GlyphId), sizeof(id));
+        if (i > 0 && !(index.ids_.back() < id)) {
+            throw std::runtime_error("glyph index IDs not strictly ascending: " + path);
+        }
+        index.insert_id(id);  // Ascending: appends to the end of its bucket
+    }
+
+    for (uint64_t t = 0; t < h.token_count; t++) {
+        IndexTokenEntry e;
+        memcpy(&e, file.data() + h.tokens_offset + t * sizeof(e), sizeof(e));
+        if (e.postings_start > postings_total || e.postings_count > postings_total - e.postings_start ||
+            e.token_offset > size - h.strings_offset ||
+            e.token_len > size - h.strings_offset - e.token_offset) {
+            throw std::runtime_error("invalid glyph index token entry: " + path);
+        }
+        std::vector<uint32_t> list(e.postings_count);
+        if (e.postings_count > 0) {
+            memcpy(list.data(), file.data() + h.postings_offset + e.postings_start * sizeof(uint32_t),
+                   e.postings_count * sizeof(uint32_t));
+        }
+        for (size_t k = 0; k < list.size(); k++) {
+            if (list[k] >= h.count || (k > 0 && list[k] <= list[k - 1])) {
+                throw std::runtime_error("invalid glyph index posting list: " + path);
+            }
+        }
+        index.postings_.emplace(std::string(file.data() + h.strings_offset + e.token_offset, e.token_len),
+                                std::move(list));
+    }
+    return index;
+}
+
+void merge(const Glyph& g1, const Glyph& g2, Glyph& result, ContentArena& arena,
+           GlyphIndex& index) {
+    merge(g1, g2, result, arena);
+    index.add(result);
+}
+
+} // namespace spu
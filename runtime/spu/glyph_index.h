@@ -0,0 +1,169 @@
+/**
+ * SPU Glyph Index - ID, ID-prefix and content-token lookup
+ *
+ * Three structures over the same set of glyph IDs, each updated as glyphs
+ * are added (after a merge, or as they are persisted):
+ *
+ *   - an open-addressing hash table on the binary GlyphId (exact lookup)
+ *   - 65536 radix buckets on the first two ID bytes, each kept sorted, so
+ *     an ID-prefix query (the 8 hex digits __repr__ shows) is one bucket
+ *     and a binary search
+ *   - an inverted index from content token to the glyphs containing it
+ *
+ * Glyphs are identified inside the index by an ordinal (insertion order).
+ * Glyphs are immutable and content-addressed, so there is no removal;
+ * adding an ID already present is a no-op.
+ *
+ * save() writes a flat file (IDs sorted, token table sorted by hash,
+ * posting lists) that runtime/cli/glyph_index.py queries via mmap without
+ * loading it; load() rebuilds the in-memory index from it.
+ *
+ * Not thread-safe: callers serialize add() against queries.
+ */
+
+#ifndef SPU_GLYPH_INDEX_H
+#define SPU_GLYPH_INDEX_H
+
+#include "glyph_store.h"
+#include "merge_ref.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace spu {
+
+constexpr char kIndexMagic[8] = {'S', 'P', 'U', 'I', 'N', 'D', 'X', '\0'};
+constexpr uint32_t kIndexVersion = 1;
+
+// Longer runs of token characters are split
+constexpr size_t kMaxTokenLen = 64;
+
+struct IndexFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t flags;
+    uint64_t count;           // IDs
+    uint64_t token_count;     // Distinct tokens
+    uint64_t ids_offset;      // count x 32 bytes, ascending
+    uint64_t tokens_offset;   // token_count x IndexTokenEntry, by (hash, token)
+    uint64_t postings_offset; // u32 ID ranks
+    uint64_t strings_offset;  // Token bytes
+    uint64_t file_size;
+};
+
+struct IndexTokenEntry {
+    uint64_t hash;            // token_hash(token)
+    uint64_t postings_start;  // Index into the postings array
+    uint32_t postings_count;
+    uint32_t token_len;
+    uint64_t token_offset;    // Into the strings section
+};
+
+static_assert(sizeof(IndexFileHeader) == 72, "IndexFileHeader is written as raw bytes");
+static_assert(sizeof(IndexTokenEntry) == 32, "IndexTokenEntry is written as raw bytes");
+
+class GlyphIndex {
+public:
+    static constexpr uint32_t npos = 0xffffffffu;
+
+    GlyphIndex();
+
+    size_t size() const { return ids_.size(); }
+    size_t token_count() const { return postings_.size(); }
+
+    /**
+     * Index an ID and the tokens of its content
+     *
+     * @return Ordinal of id (the existing one if id was already indexed)
+     */
+    uint32_t add(const GlyphId& id, const char* content, size_t len);
+    uint32_t add(const Glyph& g);
+
+    // Index glyphs [begin, end) of a store
+    void add(const GlyphStore& store, size_t begin = 0, size_t end = static_cast<size_t>(-1));
+
+    // Ordinal of id, or npos
+    uint32_t find(const GlyphId& id) const;
+    bool contains(const GlyphId& id) const { return find(id) != npos; }
+
+    const GlyphId& id(uint32_t ordinal) const { return ids_[ordinal]; }
+
+    /**
+     * IDs whose hex form starts with prefix, ascending
+     *
+     * @param hex 1-64 hex digits (either case)
+     * @param limit Maximum results
+     * @throws std::invalid_argument if prefix is empty, too long or not hex
+     */
+    std::vector<GlyphId> find_prefix(const std::string& hex, size_t limit = 100) const;
+
+    /**
+     * Ordinals of glyphs whose content contains every token (AND), ascending
+     *
+     * Query strings are tokenized like content, so "Hello, world" matches
+     * glyphs containing both "hello" and "world".
+     */
+    std::vector<uint32_t> find_tokens(const std::vector<std::string>& query,
+                                      size_t limit = 100) const;
+
+    /**
+     * Split content into tokens: runs of ASCII letters and digits
+     * (lowercased) and of non-ASCII bytes (UTF-8 text), at most
+     * kMaxTokenLen bytes each. Tokens are appended to out, deduplicated.
+     */
+    static void tokenize(const char* data, size_t len, std::vector<std::string>& out);
+
+    // FNV-1a 64 (the token table key in saved files)
+    static uint64_t token_hash(const char* data, size_t len);
+
+    /**
+     * Write the index file (temp file, fsync, rename)
+     *
+     * @throws std::system_error on I/O errors
+     */
+    void save(const std::string& path) const;
+
+    /**
+     * Read an index file
+     *
+     * Ordinals of the loaded index follow ID order.
+     *
+     * @throws std::system_error if the file cannot be read
+     * @throws std::runtime_error if it is not a valid version-1 index
+     */
+    static GlyphIndex load(const std::string& path);
+
+private:
+    static constexpr size_t kBuckets = 65536;
+
+    static size_t bucket_of(const GlyphId& id) { return (size_t(id.bytes[0]) << 8) | id.bytes[1]; }
+
+    void grow_table();
+    uint32_t insert_id(const GlyphId& id);
+    void add_tokens(uint32_t ordinal, std::vector<std::string>& tokens);
+
+    std::vector<GlyphId> ids_;
+
+    // Linear probing, power-of-two size, <= 50% full; entry = ordinal + 1, 0 = empty
+    std::vector<uint32_t> table_;
+    size_t mask_;
+
+    // Ordinals per leading 16 ID bits, sorted by ID
+    std::vector<std::vector<uint32_t>> buckets_;
+
+    // Token -> ascending ordinals
+    std::unordered_map<std::string, std::vector<uint32_t>> postings_;
+};
+
+/**
+ * merge() that also indexes the result
+ */
+void merge(const Glyph& g1, const Glyph& g2, Glyph& result, ContentArena& arena,
+           GlyphIndex& index);
+
+} // namespace spu
+
+#endif // SPU_GLYPH_INDEX_H
@@ -0,0 +1,48 @@
+/**
+ * SPU Glyph Pool - Slab allocator for Glyph records
+ */
+
+#include "glyph_pool.h"
+#include <algorithm>
+#include <new>
+#include <type_traits>
+
+namespace spu {
+
+// Records are reused without running destructors
+static_assert(std::is_trivially_destructible<Glyph>::value, "GlyphPool needs a trivial ~Glyph");
+
+GlyphPool::GlyphPool(size_t slab_glyphs) : slab_glyphs_(std::max<size_t>(slab_glyphs, 1)) {}
+
+void GlyphPool::grow() {
+    void* slab = ::operator new(slab_glyphs_ * sizeof(Glyph));
+    slabs_.emplace_back(slab);
+    capacity_ += slab_glyphs_;
+    free_.reserve(capacity_);
+
+    // Hand out low addresses first
+    Glyph* records = static_cast<Glyph*>(slab);
+    for (size_t i = slab_glyphs_; i-- > 0;) {
+        free_.push_back(records + i);
+    }
+}
+
+Glyph* GlyphPool::acquire() {
+    if (free_.empty()) {
+        grow();
+    }
+    Glyph* g = free_.back();
+    free_.pop_back();
+    return ::new (static_cast<void*>(g)) Glyph(no_init);
+}
+
+void GlyphPool::release(Glyph* g) {
+    free_.push_back(g);
+}
+
+GlyphPool& GlyphPool::local() {
+    thread_local GlyphPool pool;
+    return pool;
+}
+
+} // namespace spu
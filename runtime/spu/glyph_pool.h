@@ -0,0 +1,67 @@
+/**
+ * SPU Glyph Pool - Slab allocator for Glyph records
+ *
+ * Hands out Glyph records from slabs and takes them back on a free list,
+ * so code that creates and retires glyphs one at a time (merge results,
+ * glyphs dropped once they decay) reuses records instead of calling new
+ * per glyph. Once the pool has grown to its peak number of live records,
+ * acquire() and release() never allocate.
+ *
+ * Records come back from acquire() as Glyph(no_init): only the content
+ * handle is set (empty), because merge() and GlyphStore::load() write
+ * every other field. The pool does not own content; pair it with a
+ * ContentArena that is reset() between batches.
+ *
+ * Not thread-safe; local() is a per-thread pool.
+ */
+
+#ifndef SPU_GLYPH_POOL_H
+#define SPU_GLYPH_POOL_H
+
+#include "merge_ref.h"
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+namespace spu {
+
+class GlyphPool {
+public:
+    static constexpr size_t kDefaultSlabGlyphs = 1024;
+
+    // @param slab_glyphs Records allocated at a time
+    explicit GlyphPool(size_t slab_glyphs = kDefaultSlabGlyphs);
+
+    GlyphPool(const GlyphPool&) = delete;
+    GlyphPool& operator=(const GlyphPool&) = delete;
+
+    // A record with unset fields (see above)
+    Glyph* acquire();
+
+    // Return a record from acquire() on this pool
+    void release(Glyph* g);
+
+    // Records handed out and not yet released / records in all slabs
+    size_t in_use() const { return capacity_ - free_.size(); }
+    size_t capacity() const { return capacity_; }
+
+    // This thread's pool
+    static GlyphPool& local();
+
+private:
+    struct SlabDeleter {
+        void operator()(void* p) const { ::operator delete(p); }
+    };
+
+    void grow();
+
+    size_t slab_glyphs_;
+    size_t capacity_ = 0;
+    std::vector<std::unique_ptr<void, SlabDeleter>> slabs_;
+    std::vector<Glyph*> free_;  // Capacity kept at capacity_, so release() never reallocates
+};
+
+} // namespace spu
+
+#endif // SPU_GLYPH_POOL_H
@@ -0,0 +1,572 @@
+/**
+ * SPU Glyph Store - Structure-of-Arrays glyph container
+ *
+ * The merge precedence stage (steps 1, 4-5) gathers both parents' numeric
+ * columns and runs compare / add / max with no data-dependent branches; the
+ * compare mask blends each pair into the primary / secondary indices the
+ * content and provenance stages read. It is selected once at runtime by CPU
+ * feature: AVX-512 (16 pairs/iteration), AVX2 (8) or scalar.
+ */
+
+#include "glyph_store.h"
+#include "hash.h"
+#include "perf_counters.h"
+#include "telemetry.h"
+#include <cstring>
+#include <algorithm>
+#include <climits>
+#include <stdexcept>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SPU_GLYPH_STORE_X86 1
+#endif
+
+namespace spu {
+
+void GlyphStore::reserve(size_t glyphs, size_t content_bytes) {
+    energy_.reserve(glyphs);
+    activation_count_.reserve(glyphs);
+    last_update_time_.reserve(glyphs);
+    ids_.reserve(glyphs);
+    parent1_ids_.reserve(glyphs);
+    parent2_ids_.reserve(glyphs);
+    content_offset_.reserve(glyphs);
+    content_len_.reserve(glyphs);
+    if (content_bytes > 0) {
+        content_arena_.reserve(content_bytes);
+    }
+}
+
+void GlyphStore::clear() {
+    energy_.clear();
+    activation_count_.clear();
+    last_update_time_.clear();
+    ids_.clear();
+    parent1_ids_.clear();
+    parent2_ids_.clear();
+    content_arena_.clear();
+    content_offset_.clear();
+    content_len_.clear();
+}
+
+size_t GlyphStore::append(const Glyph& g) {
+    size_t index = size();
+
+    energy_.push_back(g.energy);
+    activation_count_.push_back(g.activation_count);
+    last_update_time_.push_back(g.last_update_time);
+
+    ids_.push_back(g.id);
+    parent1_ids_.push_back(g.parent1_id);
+    parent2_ids_.push_back(g.parent2_id);
+
+    // Ropes from lazy merges are materialized into the arena
+    size_t offset = content_arena_.size();
+    content_offset_.push_back(offset);
+    content_len_.push_back(g.content.len);
+    content_arena_.resize(offset + g.content.size());
+    g.content.copy_to(content_arena_.data() + offset);
+
+    return index;
+}
+
+void GlyphStore::load(size_t i, Glyph& out, ContentArena& arena) const {
+    out.id = ids_[i];
+    out.parent1_id = parent1_ids_[i];
+    out.parent2_id = parent2_ids_[i];
+
+    out.content.assign(content(i), content_len_[i], arena);
+
+    out.energy = energy_[i];
+    out.activation_count = activation_count_[i];
+    out.last_update_time = last_update_time_[i];
+}
+
+GlyphStore GlyphStore::from_glyphs(const Glyph* glyphs, size_t n) {
+    size_t content_bytes = 0;
+    for (size_t i = 0; i < n; i++) {
+        content_bytes += glyphs[i].content.size();
+    }
+
+    GlyphStore store;
+    store.reserve(n, content_bytes);
+    for (size_t i = 0; i < n; i++) {
+        store.append(glyphs[i]);
+    }
+    return store;
+}
+
+void GlyphStore::to_glyphs(Glyph* out, ContentArena& arena) const {
+    for (size_t i = 0; i < size(); i++) {
+        load(i, out[i], arena);
+    }
+}
+
+void GlyphStore::append_columns(size_t n, const GlyphId* ids, const GlyphId* parent1_ids,
+                                const GlyphId* parent2_ids, const double* energy,
+                                const uint32_t* activation_count,
+                                const uint64_t* last_update_time, const uint32_t* content_len,
+                                const char* content) {
+    energy_.insert(energy_.end(), energy, energy + n);
+    activation_count_.insert(activation_count_.end(), activation_count, activation_count + n);
+    last_update_time_.insert(last_update_time_.end(), last_update_time, last_update_time + n);
+    ids_.insert(ids_.end(), ids, ids + n);
+    parent1_ids_.insert(parent1_ids_.end(), parent1_ids, parent1_ids + n);
+    parent2_ids_.insert(parent2_ids_.end(), parent2_ids, parent2_ids + n);
+    content_len_.insert(content_len_.end(), content_len, content_len + n);
+
+    uint64_t offset = content_arena_.size();
+    for (size_t i = 0; i < n; i++) {
+        content_offset_.push_back(offset);
+        offset += content_len[i];
+    }
+    content_arena_.insert(content_arena_.end(), content, content + (offset - content_arena_.size()));
+}
+
+// Pairs per parallel_for chunk (multiple of kHashLanes)
+static constexpr size_t kMergeGrain = 2048;
+
+void GlyphStore::hash_range(size_t begin, size_t end) {
+    for (size_t i = begin; i < end; i += kHashLanes) {
+        size_t count = std::min(kHashLanes, end - i);
+        const void* data[kHashLanes];
+        size_t len[kHashLanes];
+        uint8_t* digests[kHashLanes];
+        for (size_t k = 0; k < count; k++) {
+            data[k] = content(i + k);
+            len[k] = content_len_[i + k];
+            digests[k] = ids_[i + k].bytes;
+        }
+        hash_many(data, len, digests, count);
+    }
+}
+
+void GlyphStore::hash_ids(size_t begin, size_t end, ThreadPool* pool) {
+    if (begin > end || end > size()) {
+        throw std::out_of_range("GlyphStore::hash_ids: range past the store");
+    }
+    auto hash = [this, begin](size_t b, size_t e) {
+        SPU_PERF_SCOPE(kPerfHash, e - b);
+        hash_range(begin + b, begin + e);
+    };
+    if (pool) {
+        pool->parallel_for(end - begin, kMergeGrain, hash);
+    } else {
+        hash(0, end - begin);
+    }
+}
+
+namespace {
+
+static_assert(sizeof(MergePair) == 2 * sizeof(uint32_t), "pairs are loaded as uint32 vectors");
+
+// Arguments of a precedence kernel; output columns are indexed like pairs
+struct PrecedenceArgs {
+    const double* energy;
+    const uint32_t* activation_count;
+    const uint64_t* last_update_time;
+    const MergePair* pairs;
+
+    uint32_t* primary;    // Parent with precedence (first if its energy >=)
+    uint32_t* secondary;  // The other parent
+    double* energy_sum;
+    uint32_t* activation_count_max;
+    uint64_t* last_update_time_max;
+};
+
+using PrecedenceKernel = void (*)(const PrecedenceArgs& a, size_t begin, size_t end);
+
+void precedence_scalar(const PrecedenceArgs& a, size_t begin, size_t end) {
+    for (size_t i = begin; i < end; i++) {
+        uint32_t f = a.pairs[i].first;
+        uint32_t s = a.pairs[i].second;
+        double ef = a.energy[f];
+        double es = a.energy[s];
+        bool first_wins = ef >= es;
+        a.primary[i] = first_wins ? f : s;
+        a.secondary[i] = first_wins ? s : f;
+        a.energy_sum[i] = ef + es;  // Commutative: same sum whichever wins
+        a.activation_count_max[i] = std::max(a.activation_count[f], a.activation_count[s]);
+        a.last_update_time_max[i] = std::max(a.last_update_time[f], a.last_update_time[s]);
+    }
+}
+
+#if defined(SPU_GLYPH_STORE_X86)
+
+// _CMP_GE_OQ is false for NaN, like the scalar >=, so NaN never wins
+
+// Gathers, half extracts and maxes below use the all-lanes masked (or
+// zero-masked) forms: GCC 12 reports the undefined pass-through register of
+// the plain intrinsics as maybe-uninitialized under -Wall. Same results.
+
+template <int kHalf>
+__attribute__((target("avx512f")))
+inline __m256i half_avx512(__m512i v) {
+    return _mm512_maskz_extracti64x4_epi64(0xff, v, kHalf);
+}
+
+__attribute__((target("avx512f")))
+inline __m512d gather_pd_avx512(const double* base, __m256i index) {
+    return _mm512_mask_i32gather_pd(_mm512_setzero_pd(), 0xff, index, base, 8);
+}
+
+__attribute__((target("avx512f")))
+inline __m512i gather_epi32_avx512(const int* base, __m512i index) {
+    return _mm512_mask_i32gather_epi32(_mm512_setzero_si512(), 0xffff, index, base, 4);
+}
+
+__attribute__((target("avx512f")))
+inline __m512i gather_epi64_avx512(const long long* base, __m256i index) {
+    return _mm512_mask_i32gather_epi64(_mm512_setzero_si512(), 0xff, index, base, 8);
+}
+
+__attribute__((target("avx512f,avx512vl,avx512bw")))
+void precedence_avx512(const PrecedenceArgs& a, size_t begin, size_t end) {
+    const __m512i first_lanes = _mm512_setr_epi32(0, 2, 4, 6, 8, 10, 12, 14,
+                                                  16, 18, 20, 22, 24, 26, 28, 30);
+    const __m512i second_lanes = _mm512_add_epi32(first_lanes, _mm512_set1_epi32(1));
+    const int* activation_count = reinterpret_cast<const int*>(a.activation_count);
+    const long long* last_update_time = reinterpret_cast<const long long*>(a.last_update_time);
+    size_t i = begin;
+    for (; i + 16 <= end; i += 16) {
+        __m512i p0 = _mm512_loadu_si512(a.pairs + i);
+        __m512i p1 = _mm512_loadu_si512(a.pairs + i + 8);
+        __m512i first = _mm512_permutex2var_epi32(p0, first_lanes, p1);
+        __m512i second = _mm512_permutex2var_epi32(p0, second_lanes, p1);
+        __m256i first_lo = half_avx512<0>(first);
+        __m256i first_hi = half_avx512<1>(first);
+        __m256i second_lo = half_avx512<0>(second);
+        __m256i second_hi = half_avx512<1>(second);
+
+        __m512d ef_lo = gather_pd_avx512(a.energy, first_lo);
+        __m512d ef_hi = gather_pd_avx512(a.energy, first_hi);
+        __m512d es_lo = gather_pd_avx512(a.energy, second_lo);
+        __m512d es_hi = gather_pd_avx512(a.energy, second_hi);
+        __mmask16 wins = static_cast<__mmask16>(
+            _mm512_cmp_pd_mask(ef_lo, es_lo, _CMP_GE_OQ) |
+            (static_cast<unsigned>(_mm512_cmp_pd_mask(ef_hi, es_hi, _CMP_GE_OQ)) << 8));
+        _mm512_storeu_si512(a.primary + i, _mm512_mask_blend_epi32(wins, second, first));
+        _mm512_storeu_si512(a.secondary + i, _mm512_mask_blend_epi32(wins, first, second));
+        _mm512_storeu_pd(a.energy_sum + i, _mm512_add_pd(ef_lo, es_lo));
+        _mm512_storeu_pd(a.energy_sum + i + 8, _mm512_add_pd(ef_hi, es_hi));
+
+        __m512i ac = _mm512_maskz_max_epu32(0xffff, gather_epi32_avx512(activation_count, first),
+                                            gather_epi32_avx512(activation_count, second));
+        _mm512_storeu_si512(a.activation_count_max + i, ac);
+
+        __m512i lut_lo = _mm512_maskz_max_epu64(0xff,
+                                                gather_epi64_avx512(last_update_time, first_lo),
+                                                gather_epi64_avx512(last_update_time, second_lo));
+        __m512i lut_hi = _mm512_maskz_max_epu64(0xff,
+                                                gather_epi64_avx512(last_update_time, first_hi),
+                                                gather_epi64_avx512(last_update_time, second_hi));
+        _mm512_storeu_si512(a.last_update_time_max + i, lut_lo);
+        _mm512_storeu_si512(a.last_update_time_max + i + 8, lut_hi);
+    }
+    precedence_scalar(a, i, end);
+}
+
+// Unsigned 64-bit max (AVX2 only compares signed)
+__attribute__((target("avx2")))
+inline __m256i max_epu64_avx2(__m256i x, __m256i y) {
+    const __m256i sign = _mm256_set1_epi64x(LLONG_MIN);
+    __m256i y_greater = _mm256_cmpgt_epi64(_mm256_xor_si256(y, sign), _mm256_xor_si256(x, sign));
+    return _mm256_blendv_epi8(x, y, y_greater);
+}
+
+__attribute__((target("avx2")))
+inline __m256d gather_pd_avx2(const double* base, __m128i index) {
+    const __m256d all_lanes = _mm256_castsi256_pd(_mm256_set1_epi64x(-1));
+    return _mm256_mask_i32gather_pd(_mm256_setzero_pd(), base, index, all_lanes, 8);
+}
+
+__attribute__((target("avx2")))
+void precedence_avx2(const PrecedenceArgs& a, size_t begin, size_t end) {
+    const __m256i deinterleave = _mm256_setr_epi32(0, 2, 4, 6, 1, 3, 5, 7);
+    const int* activation_count = reinterpret_cast<const int*>(a.activation_count);
+    const long long* last_update_time = reinterpret_cast<const long long*>(a.last_update_time);
+    size_t i = begin;
+    for (; i + 8 <= end; i += 8) {
+        // f0 f1 f2 f3 s0 s1 s2 s3 per register, then split into firsts / seconds
+        __m256i p0 = _mm256_permutevar8x32_epi32(
+            _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a.pairs + i)), deinterleave);
+        __m256i p1 = _mm256_permutevar8x32_epi32(
+            _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a.pairs + i + 4)), deinterleave);
+        __m256i first = _mm256_permute2x128_si256(p0, p1, 0x20);
+        __m256i second = _mm256_permute2x128_si256(p0, p1, 0x31);
+        __m128i first_lo = _mm256_castsi256_si128(first);
+        __m128i first_hi = _mm256_extracti128_si256(first, 1);
+        __m128i second_lo = _mm256_castsi256_si128(second);
+        __m128i second_hi = _mm256_extracti128_si256(second, 1);
+
+        __m256d ef_lo = gather_pd_avx2(a.energy, first_lo);
+        __m256d ef_hi = gather_pd_avx2(a.energy, first_hi);
+        __m256d es_lo = gather_pd_avx2(a.energy, second_lo);
+        __m256d es_hi = gather_pd_avx2(a.energy, second_hi);
+        // 64-bit compare lanes narrowed to one 32-bit lane per pair
+        __m256i wins_lo = _mm256_permutevar8x32_epi32(
+            _mm256_castpd_si256(_mm256_cmp_pd(ef_lo, es_lo, _CMP_GE_OQ)), deinterleave);
+        __m256i wins_hi = _mm256_permutevar8x32_epi32(
+            _mm256_castpd_si256(_mm256_cmp_pd(ef_hi, es_hi, _CMP_GE_OQ)), deinterleave);
+        __m256i wins = _mm256_permute2x128_si256(wins_lo, wins_hi, 0x20);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(a.primary + i),
+                            _mm256_blendv_epi8(second, first, wins));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(a.secondary + i),
+                            _mm256_blendv_epi8(first, second, wins));
+        _mm256_storeu_pd(a.energy_sum + i, _mm256_add_pd(ef_lo, es_lo));
+        _mm256_storeu_pd(a.energy_sum + i + 4, _mm256_add_pd(ef_hi, es_hi));
+
+        __m256i ac = _mm256_max_epu32(_mm256_i32gather_epi32(activation_count, first, 4),
+                                      _mm256_i32gather_epi32(activation_count, second, 4));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(a.activation_count_max + i), ac);
+
+        __m256i lut_lo = max_epu64_avx2(_mm256_i32gather_epi64(last_update_time, first_lo, 8),
+                                        _mm256_i32gather_epi64(last_update_time, second_lo, 8));
+        __m256i lut_hi = max_epu64_avx2(_mm256_i32gather_epi64(last_update_time, first_hi, 8),
+                                        _mm256_i32gather_epi64(last_update_time, second_hi, 8));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(a.last_update_time_max + i), lut_lo);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(a.last_update_time_max + i + 4), lut_hi);
+    }
+    precedence_scalar(a, i, end);
+}
+
+#endif
+
+PrecedenceKernel select_precedence_kernel() {
+#if defined(SPU_GLYPH_STORE_X86)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512vl") &&
+        __builtin_cpu_supports("avx512bw")) {
+        return precedence_avx512;
+    }
+    if (__builtin_cpu_supports("avx2")) {
+        return precedence_avx2;
+    }
+#endif
+    return precedence_scalar;
+}
+
+/**
+ * Kernel for a store of n glyphs: gathers take signed 32-bit indices, so
+ * larger stores stay scalar
+ */
+PrecedenceKernel precedence_kernel(size_t n) {
+    static const PrecedenceKernel selected = select_precedence_kernel();
+    return n <= size_t(INT32_MAX) ? selected : precedence_scalar;
+}
+
+} // namespace
+
+/**
+ * Copy len <= SizeClass::kMaxLen bytes; with overrun, as one fixed-size
+ * kMaxLen move (no length-dependent branches) that may clobber up to
+ * kMaxLen - len bytes past dst + len
+ */
+template <typename SizeClass>
+static inline void copy_content(char* dst, const char* src, size_t len, bool overrun) {
+    if constexpr (SizeClass::kMaxLen != SIZE_MAX) {
+        if (overrun) {
+            memcpy(dst, src, SizeClass::kMaxLen);
+            return;
+        }
+    }
+    memcpy(dst, src, len);
+}
+
+// Longest parent content over the batch
+static uint32_t max_parent_len(const GlyphStore& in, const MergePair* pairs, size_t n) {
+    const uint32_t* len = in.content_lens();
+    uint32_t longest = 0;
+    for (size_t i = 0; i < n; i++) {
+        longest = std::max(longest, std::max(len[pairs[i].first], len[pairs[i].second]));
+    }
+    return longest;
+}
+
+template <typename SizeClass, typename HashPolicy, typename ProvenancePolicy>
+struct MergeKernel {
+    static void run(const GlyphStore& in, const MergePair* pairs, size_t n, GlyphStore& out,
+                    ThreadPool* pool) {
+        if (n == 0) {
+            return;
+        }
+        SPU_TELEMETRY_TIMER(kHistMergeBatchNs);
+        SPU_TELEMETRY_RECORD(kHistMergeBatchSize, n);
+        const size_t base = out.size();
+
+        auto run_range = [pool](size_t count, ThreadPool::RangeFn fn) {
+            if (pool) {
+                pool->parallel_for(count, kMergeGrain, fn);
+            } else {
+                fn(0, count);
+            }
+        };
+
+        // Size every output column once
+        out.energy_.resize(base + n);
+        out.activation_count_.resize(base + n);
+        out.last_update_time_.resize(base + n);
+        out.ids_.resize(base + n);
+        out.parent1_ids_.resize(base + n);
+        out.parent2_ids_.resize(base + n);
+        out.content_offset_.resize(base + n);
+        out.content_len_.resize(base + n);
+
+        // Content offsets: merged length does not depend on precedence
+        size_t content_base = out.content_arena_.size();
+        size_t pos = content_base;
+        for (size_t i = 0; i < n; i++) {
+            size_t len = size_t(in.content_len_[pairs[i].first]) + 3 +
+                         in.content_len_[pairs[i].second];
+            out.content_offset_[base + i] = pos;
+            out.content_len_[base + i] = static_cast<uint32_t>(len);
+            pos += len;
+        }
+        out.content_arena_.resize(pos);
+
+        // Per-thread scratch: grows to the largest batch, then reused
+        thread_local Column<uint32_t> primary_scratch, secondary_scratch;
+        primary_scratch.resize(n);
+        secondary_scratch.resize(n);
+        uint32_t* primary = primary_scratch.data();
+        uint32_t* secondary = secondary_scratch.data();
+
+        PrecedenceArgs args{};
+        args.energy = in.energy();
+        args.activation_count = in.activation_count();
+        args.last_update_time = in.last_update_time();
+        args.pairs = pairs;
+        args.primary = primary;
+        args.secondary = secondary;
+        args.energy_sum = out.energy_.data() + base;
+        args.activation_count_max = out.activation_count_.data() + base;
+        args.last_update_time_max = out.last_update_time_.data() + base;
+        const PrecedenceKernel precedence = precedence_kernel(in.size());
+
+        // Stages over disjoint ranges of the output columns
+        run_range(n, [&](size_t begin, size_t end) {
+            // Stage 1: precedence, energy sum and metadata max (numeric columns only)
+            {
+                SPU_PERF_SCOPE(kPerfPrecedence, end - begin);
+                precedence(args, begin, end);
+            }
+
+            // Stage 2: content concatenation
+            {
+                SPU_PERF_SCOPE(kPerfContentCopy, end - begin);
+                // Overrun lands on bytes this range writes next: allowed while it
+                // stays inside the range's output and the input arena
+                const uint64_t range_end = out.content_offset_[base + end - 1] +
+                                           out.content_len_[base + end - 1];
+                const uint64_t in_end = in.content_arena_.size();
+                auto overrun = [&](uint64_t dst_offset, uint64_t src_offset) {
+                    return SizeClass::kMaxLen != SIZE_MAX &&
+                           dst_offset + SizeClass::kMaxLen <= range_end &&
+                           src_offset + SizeClass::kMaxLen <= in_end;
+                };
+                for (size_t i = begin; i < end; i++) {
+                    uint32_t p = primary[i];
+                    uint32_t s = secondary[i];
+                    uint64_t offset = out.content_offset_[base + i];
+                    char* dst = out.content_arena_.data() + offset;
+                    uint32_t len = 0;
+
+                    copy_content<SizeClass>(dst, in.content(p), in.content_len_[p],
+                                            overrun(offset, in.content_offset_[p]));
+                    len += in.content_len_[p];
+                    dst[len++] = ' ';
+                    dst[len++] = '+';
+                    dst[len++] = ' ';
+                    copy_content<SizeClass>(dst + len, in.content(s), in.content_len_[s],
+                                            overrun(offset + len, in.content_offset_[s]));
+                }
+            }
+
+            // Stage 3: hash, kHashLanes results at a time
+            if constexpr (HashPolicy::kEnabled) {
+                SPU_PERF_SCOPE(kPerfHash, end - begin);
+                out.hash_range(base + begin, base + end);
+            } else {
+                std::fill(out.ids_.begin() + base + begin, out.ids_.begin() + base + end,
+                          GlyphId::zero());
+            }
+
+            // Stage 4: provenance
+            if constexpr (ProvenancePolicy::kEnabled) {
+                SPU_PERF_SCOPE(kPerfProvenance, end - begin);
+                for (size_t i = begin; i < end; i++) {
+                    out.parent1_ids_[base + i] = in.ids_[primary[i]];
+                    out.parent2_ids_[base + i] = in.ids_[secondary[i]];
+                }
+            } else {
+                std::fill(out.parent1_ids_.begin() + base + begin,
+                          out.parent1_ids_.begin() + base + end, GlyphId::zero());
+                std::fill(out.parent2_ids_.begin() + base + begin,
+                          out.parent2_ids_.begin() + base + end, GlyphId::zero());
+            }
+        });
+    }
+};
+
+template <typename SizeClass, typename HashPolicy, typename ProvenancePolicy>
+void merge_batch_as(const GlyphStore& in, const MergePair* pairs, size_t n, GlyphStore& out,
+                    ThreadPool* pool) {
+    if (SizeClass::kMaxLen != SIZE_MAX && max_parent_len(in, pairs, n) > SizeClass::kMaxLen) {
+        throw std::invalid_argument("merge_batch_as: parent content exceeds the size class");
+    }
+    MergeKernel<SizeClass, HashPolicy, ProvenancePolicy>::run(in, pairs, n, out, pool);
+}
+
+template <typename HashPolicy, typename ProvenancePolicy>
+static void merge_sized(const GlyphStore& in, const MergePair* pairs, size_t n, GlyphStore& out,
+                        ThreadPool* pool) {
+    const uint32_t longest = max_parent_len(in, pairs, n);
+    if (longest <= 16) {
+        MergeKernel<ContentUpTo<16>, HashPolicy, ProvenancePolicy>::run(in, pairs, n, out, pool);
+    } else if (longest <= 32) {
+        MergeKernel<ContentUpTo<32>, HashPolicy, ProvenancePolicy>::run(in, pairs, n, out, pool);
+    } else if (longest <= 64) {
+        MergeKernel<ContentUpTo<64>, HashPolicy, ProvenancePolicy>::run(in, pairs, n, out, pool);
+    } else {
+        MergeKernel<AnyContent, HashPolicy, ProvenancePolicy>::run(in, pairs, n, out, pool);
+    }
+}
+
+void merge_batch(const GlyphStore& in, const MergePair* pairs, size_t n, GlyphStore& out,
+                 ThreadPool* pool) {
+    merge_sized<HashIds, RecordProvenance>(in, pairs, n, out, pool);
+}
+
+void merge_batch(const GlyphStore& in, const MergePair* pairs, size_t n, GlyphStore& out,
+                 const MergeOptions& options, ThreadPool* pool) {
+    if (options.hash && options.provenance) {
+        merge_sized<HashIds, RecordProvenance>(in, pairs, n, out, pool);
+    } else if (options.hash) {
+        merge_sized<HashIds, NoProvenance>(in, pairs, n, out, pool);
+    } else if (options.provenance) {
+        merge_sized<NoHash, RecordProvenance>(in, pairs, n, out, pool);
+    } else {
+        merge_sized<NoHash, NoProvenance>(in, pairs, n, out, pool);
+    }
+}
+
+// Every specialization merge_batch_as() promises
+#define SPU_INSTANTIATE_MERGE(SIZE)                                                            \
+    template void merge_batch_as<SIZE, HashIds, RecordProvenance>(                             \
+        const GlyphStore&, const MergePair*, size_t, GlyphStore&, ThreadPool*);                \
+    template void merge_batch_as<SIZE, HashIds, NoProvenance>(                                 \
+        const GlyphStore&, const MergePair*, size_t, GlyphStore&, ThreadPool*);                \
+    template void merge_batch_as<SIZE, NoHash, RecordProvenance>(                              \
+        const GlyphStore&, const MergePair*, size_t, GlyphStore&, ThreadPool*);                \
+    template void merge_batch_as<SIZE, NoHash, NoProvenance>(                                  \
+        const GlyphStore&, const MergePair*, size_t, GlyphStore&, ThreadPool*);
+
+SPU_INSTANTIATE_MERGE(ContentUpTo<16>)
+SPU_INSTANTIATE_MERGE(ContentUpTo<32>)
+SPU_INSTANTIATE_MERGE(ContentUpTo<64>)
+SPU_INSTANTIATE_MERGE(AnyContent)
+
+#undef SPU_INSTANTIATE_MERGE
+
+} // namespace spu
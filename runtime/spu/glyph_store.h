@@ -0,0 +1,241 @@
+/**
+ * SPU Glyph Store - Structure-of-Arrays glyph container
+ *
+ * Keeps the numeric glyph fields and binary IDs in separate contiguous
+ * columns and content in its own arena, so hot loops (decay, threshold,
+ * merge precedence) stream only the bytes they touch instead of the
+ * full Glyph record.
+ */
+
+#ifndef SPU_GLYPH_STORE_H
+#define SPU_GLYPH_STORE_H
+
+#include "merge_ref.h"
+#include "thread_pool.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace spu {
+
+/**
+ * std::allocator whose value-initialization is default-initialization
+ *
+ * resize() on a vector of trivial elements then leaves the new elements
+ * uninitialized instead of zeroing them, for columns that are written
+ * right after they are sized (merge outputs).
+ */
+template <typename T>
+struct DefaultInitAllocator : std::allocator<T> {
+    template <typename U>
+    struct rebind {
+        using other = DefaultInitAllocator<U>;
+    };
+
+    DefaultInitAllocator() = default;
+    template <typename U>
+    DefaultInitAllocator(const DefaultInitAllocator<U>&) noexcept {}
+
+    template <typename U>
+    void construct(U* p) noexcept(std::is_nothrow_default_constructible<U>::value) {
+        ::new (static_cast<void*>(p)) U;
+    }
+    template <typename U, typename... Args>
+    void construct(U* p, Args&&... args) {
+        ::new (static_cast<void*>(p)) U(std::forward<Args>(args)...);
+    }
+};
+
+// Store column: a vector that does not zero what resize() adds
+template <typename T>
+using Column = std::vector<T, DefaultInitAllocator<T>>;
+
+/**
+ * Compile-time merge policies for merge_batch_as()
+ *
+ * Size classes bound the content of every parent in a batch, so the
+ * content pass copies each parent with one fixed-size move instead of a
+ * variable-length memcpy call. The hash and provenance
+ * policies drop whole passes for ephemeral merges: results then carry a
+ * zero ID / zero parent IDs, the "none" value everywhere else.
+ */
+template <size_t N>
+struct ContentUpTo {
+    static constexpr size_t kMaxLen = N;
+};
+struct AnyContent {
+    static constexpr size_t kMaxLen = SIZE_MAX;
+};
+
+struct HashIds {
+    static constexpr bool kEnabled = true;
+};
+struct NoHash {
+    static constexpr bool kEnabled = false;
+};
+
+struct RecordProvenance {
+    static constexpr bool kEnabled = true;
+};
+struct NoProvenance {
+    static constexpr bool kEnabled = false;
+};
+
+template <typename SizeClass, typename HashPolicy, typename ProvenancePolicy>
+struct MergeKernel;
+
+// Runtime choice of the hash and provenance policies (size class is automatic)
+struct MergeOptions {
+    bool hash = true;        // false: result IDs are zero
+    bool provenance = true;  // false: result parent IDs are zero
+};
+
+class GlyphStore {
+public:
+    GlyphStore() = default;
+
+    // Number of glyphs in the store
+    size_t size() const { return energy_.size(); }
+    bool empty() const { return energy_.empty(); }
+
+    /**
+     * Reserve capacity for glyphs and content bytes
+     *
+     * @param glyphs Number of glyphs
+     * @param content_bytes Total content bytes (0 = leave arena as is)
+     */
+    void reserve(size_t glyphs, size_t content_bytes = 0);
+
+    // Remove all glyphs (keeps capacity)
+    void clear();
+
+    /**
+     * Append a glyph, converting from the AoS layout
+     *
+     * @param g Glyph to append
+     * @return Index of the new glyph
+     */
+    size_t append(const Glyph& g);
+
+    /**
+     * Convert the glyph at index i back to the AoS layout
+     *
+     * @param i Glyph index
+     * @param out Output glyph
+     * @param arena Arena receiving a copy of the content
+     */
+    void load(size_t i, Glyph& out, ContentArena& arena) const;
+
+    // Bulk converters
+    static GlyphStore from_glyphs(const Glyph* glyphs, size_t n);
+    void to_glyphs(Glyph* out, ContentArena& arena) const;
+
+    /**
+     * Append n glyphs given as columns (wire and file layouts)
+     *
+     * @param content The n contents back to back, content_len[i] bytes each
+     */
+    void append_columns(size_t n, const GlyphId* ids, const GlyphId* parent1_ids,
+                        const GlyphId* parent2_ids, const double* energy,
+                        const uint32_t* activation_count, const uint64_t* last_update_time,
+                        const uint32_t* content_len, const char* content);
+
+    // Numeric columns (size() entries each)
+    double* energy() { return energy_.data(); }
+    const double* energy() const { return energy_.data(); }
+    uint32_t* activation_count() { return activation_count_.data(); }
+    const uint32_t* activation_count() const { return activation_count_.data(); }
+    uint64_t* last_update_time() { return last_update_time_.data(); }
+    const uint64_t* last_update_time() const { return last_update_time_.data(); }
+
+    // ID columns (binary, 32 bytes per glyph)
+    const GlyphId& id(size_t i) const { return ids_[i]; }
+    const GlyphId& parent1_id(size_t i) const { return parent1_ids_[i]; }
+    const GlyphId& parent2_id(size_t i) const { return parent2_ids_[i]; }
+
+    // Content arena
+    const char* content(size_t i) const { return content_arena_.data() + content_offset_[i]; }
+    uint32_t content_len(size_t i) const { return content_len_[i]; }
+    const uint32_t* content_lens() const { return content_len_.data(); }
+    size_t content_bytes() const { return content_arena_.size(); }
+
+    /**
+     * Set id(i) to the content hash of glyph i for i in [begin, end)
+     *
+     * The hash pass of merge_batch() on its own, for results merged with
+     * MergeOptions::hash = false (MergePipeline hashes on its own threads).
+     *
+     * @param pool Split the range across this pool (nullptr = calling thread)
+     */
+    void hash_ids(size_t begin, size_t end, ThreadPool* pool = nullptr);
+
+private:
+    // hash_ids() of one range on the calling thread
+    void hash_range(size_t begin, size_t end);
+
+    template <typename SizeClass, typename HashPolicy, typename ProvenancePolicy>
+    friend struct MergeKernel;  // glyph_store.cpp
+
+    Column<double> energy_;
+    Column<uint32_t> activation_count_;
+    Column<uint64_t> last_update_time_;
+
+    Column<GlyphId> ids_;
+    Column<GlyphId> parent1_ids_;
+    Column<GlyphId> parent2_ids_;
+
+    Column<char> content_arena_;
+    Column<uint64_t> content_offset_;
+    Column<uint32_t> content_len_;
+};
+
+/**
+ * Merge n index pairs of a store, appending the results to another store
+ *
+ * @param in Source store
+ * @param pairs Index pairs into in (n entries)
+ * @param n Number of pairs
+ * @param out Destination store (must not be in)
+ * @param pool Split the batch across this pool (nullptr = calling thread)
+ *
+ * Runs merge as column passes: a branch-free SIMD stage gathers the numeric
+ * columns (precedence, energy sum, metadata max), then content, hash and
+ * provenance are built per column.
+ * With a pool, each thread runs the passes over its own range of pairs;
+ * output ranges are disjoint, so results do not depend on the thread count.
+ * Results match merge() on the equivalent Glyph records.
+ */
+void merge_batch(const GlyphStore& in, const MergePair* pairs, size_t n, GlyphStore& out,
+                 ThreadPool* pool = nullptr);
+
+/**
+ * merge_batch() with the hash and provenance passes chosen at run time
+ *
+ * Both overloads pick the smallest size class (16, 32, 64 bytes or any)
+ * that holds every parent's content, then run that instantiation of
+ * merge_batch_as(); the size class never changes the results.
+ */
+void merge_batch(const GlyphStore& in, const MergePair* pairs, size_t n, GlyphStore& out,
+                 const MergeOptions& options, ThreadPool* pool = nullptr);
+
+/**
+ * One compile-time specialization of merge_batch()
+ *
+ * Instantiated for ContentUpTo<16>, <32>, <64> and AnyContent, each with
+ * HashIds / NoHash and RecordProvenance / NoProvenance.
+ *
+ * @throws std::invalid_argument if a parent's content exceeds SizeClass::kMaxLen
+ *         (checked before out is modified)
+ */
+template <typename SizeClass, typename HashPolicy, typename ProvenancePolicy>
+void merge_batch_as(const GlyphStore& in, const MergePair* pairs, size_t n, GlyphStore& out,
+                    ThreadPool* pool = nullptr);
+
+} // namespace spu
+
+#endif // SPU_GLYPH_STORE_H
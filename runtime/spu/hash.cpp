@@ -0,0 +1,427 @@
+/**
+ * SPU Content Hashing - Backend registry, portable SHA-256 and xxh64x2
+ */
+
+#include "hash.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+
+namespace spu {
+namespace detail {
+
+const uint32_t kSha256Init[8] = {
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+    0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+};
+
+const uint32_t kSha256K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+static inline uint32_t rotr32(uint32_t x, int n) {
+    return (x >> n) | (x << (32 - n));
+}
+
+static inline uint32_t load_be32(const uint8_t* p) {
+    return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | uint32_t(p[3]);
+}
+
+static inline void store_be32(uint8_t* p, uint32_t v) {
+    p[0] = uint8_t(v >> 24);
+    p[1] = uint8_t(v >> 16);
+    p[2] = uint8_t(v >> 8);
+    p[3] = uint8_t(v);
+}
+
+void sha256_compress_scalar(uint32_t* state, const uint8_t* blocks, size_t count) {
+    for (size_t blk = 0; blk < count; blk++, blocks += 64) {
+        uint32_t w[64];
+        for (int t = 0; t < 16; t++) {
+            w[t] = load_be32(blocks + 4 * t);
+        }
+        for (int t = 16; t < 64; t++) {
+            uint32_t s0 = rotr32(w[t - 15], 7) ^ rotr32(w[t - 15], 18) ^ (w[t - 15] >> 3);
+            uint32_t s1 = rotr32(w[t - 2], 17) ^ rotr32(w[t - 2], 19) ^ (w[t - 2] >> 10);
+            w[t] = w[t - 16] + s0 + w[t - 7] + s1;
+        }
+
+        uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+        uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+
+        for (int t = 0; t < 64; t++) {
+            uint32_t s1 = rotr32(e, 6) ^ rotr32(e, 11) ^ rotr32(e, 25);
+            uint32_t ch = (e & f) ^ (~e & g);
+            uint32_t t1 = h + s1 + ch + kSha256K[t] + w[t];
+            uint32_t s0 = rotr32(a, 2) ^ rotr32(a, 13) ^ rotr32(a, 22);
+            uint32_t maj = (a & b) ^ (a & c) ^ (b & c);
+            uint32_t t2 = s0 + maj;
+            h = g;
+            g = f;
+            f = e;
+            e = d + t1;
+            d = c;
+            c = b;
+            b = a;
+            a = t1 + t2;
+        }
+
+        state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+        state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+    }
+}
+
+Sha256Compress sha256_compress() {
+    static const Sha256Compress selected =
+        cpu_has_sha_ni() ? sha256_compress_shani : sha256_compress_scalar;
+    return selected;
+}
+
+void sha256_oneshot(Sha256Compress compress, const void* data, size_t len, uint8_t* digest) {
+    uint32_t state[8];
+    memcpy(state, kSha256Init, sizeof(state));
+
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+    size_t full = len / 64;
+    if (full > 0) {
+        compress(state, p, full);
+    }
+
+    // Final one or two blocks: tail + 0x80 + zero pad + 64-bit bit length
+    uint8_t tail[128] = {0};
+    size_t rem = len % 64;
+    memcpy(tail, p + full * 64, rem);
+    tail[rem] = 0x80;
+    size_t tail_blocks = (rem < 56) ? 1 : 2;
+    uint64_t bits = static_cast<uint64_t>(len) * 8;
+    uint8_t* lp = tail + tail_blocks * 64 - 8;
+    store_be32(lp, uint32_t(bits >> 32));
+    store_be32(lp + 4, uint32_t(bits));
+    compress(state, tail, tail_blocks);
+
+    for (int i = 0; i < 8; i++) {
+        store_be32(digest + 4 * i, state[i]);
+    }
+}
+
+} // namespace detail
+
+// --- Incremental SHA-256 ---
+
+Sha256::Sha256() : length_(0) {
+    memcpy(state_, detail::kSha256Init, sizeof(state_));
+}
+
+void Sha256::update(const void* data, size_t len) {
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+    size_t used = length_ % 64;
+    length_ += len;
+
+    if (used > 0) {
+        size_t take = 64 - used;
+        if (len < take) {
+            memcpy(buffer_ + used, p, len);
+            return;
+        }
+        memcpy(buffer_ + used, p, take);
+        detail::sha256_compress()(state_, buffer_, 1);
+        p += take;
+        len -= take;
+    }
+
+    size_t full = len / 64;
+    if (full > 0) {
+        detail::sha256_compress()(state_, p, full);
+        p += full * 64;
+        len -= full * 64;
+    }
+    memcpy(buffer_, p, len);
+}
+
+void Sha256::finish(uint8_t* digest) {
+    uint64_t bits = length_ * 8;
+    size_t used = length_ % 64;
+
+    uint8_t pad[128] = {0};
+    memcpy(pad, buffer_, used);
+    pad[used] = 0x80;
+    size_t blocks = (used < 56) ? 1 : 2;
+    uint8_t* lp = pad + blocks * 64 - 8;
+    for (int i = 0; i < 8; i++) {
+        lp[i] = uint8_t(bits >> (56 - 8 * i));
+    }
+    detail::sha256_compress()(state_, pad, blocks);
+
+    for (int i = 0; i < 8; i++) {
+        digest[4 * i + 0] = uint8_t(state_[i] >> 24);
+        digest[4 * i + 1] = uint8_t(state_[i] >> 16);
+        digest[4 * i + 2] = uint8_t(state_[i] >> 8);
+        digest[4 * i + 3] = uint8_t(state_[i]);
+    }
+}
+
+// --- Backends ---
+
+namespace {
+
+void sha256_scalar(const void* data, size_t len, uint8_t* digest) {
+    detail::sha256_oneshot(detail::sha256_compress_scalar, data, len, digest);
+}
+
+void sha256_scalar_x8(const void* const* data, const size_t* len, uint8_t* const* digest) {
+    for (size_t i = 0; i < kHashLanes; i++) {
+        sha256_scalar(data[i], len[i], digest[i]);
+    }
+}
+
+void sha256_shani(const void* data, size_t len, uint8_t* digest) {
+    detail::sha256_oneshot(detail::sha256_compress_shani, data, len, digest);
+}
+
+void sha256_shani_x8(const void* const* data, const size_t* len, uint8_t* const* digest) {
+    for (size_t i = 0; i < kHashLanes; i++) {
+        sha256_shani(data[i], len[i], digest[i]);
+    }
+}
+
+// Longest lane the AVX2 multi-buffer path takes when SHA-NI is also
+// present: it runs every lane for as many blocks as the longest one, and
+// past ~4 blocks eight SHA-NI one-shots are faster
+constexpr size_t kAvx2MaxLaneBytes = 256;
+
+// SHA-NI for single hashes, AVX2 lanes for batches of short messages
+void sha256_shani_avx2_x8(const void* const* data, const size_t* len, uint8_t* const* digest) {
+    size_t longest = 0;
+    for (size_t i = 0; i < kHashLanes; i++) {
+        longest = std::max(longest, len[i]);
+    }
+    if (longest <= kAvx2MaxLaneBytes) {
+        detail::sha256_x8_avx2(data, len, digest);
+    } else {
+        sha256_shani_x8(data, len, digest);
+    }
+}
+
+bool cpu_has_sha_ni_and_avx2() { return detail::cpu_has_sha_ni() && detail::cpu_has_avx2(); }
+
+// xxh64x2: two seeded XXH64 passes expanded to 256 bits. Fast dedup IDs only.
+constexpr uint64_t kPrime64_1 = 0x9E3779B185EBCA87ULL;
+constexpr uint64_t kPrime64_2 = 0xC2B2AE3D27D4EB4FULL;
+constexpr uint64_t kPrime64_3 = 0x165667B19E3779F9ULL;
+constexpr uint64_t kPrime64_4 = 0x85EBCA77C2B2AE63ULL;
+constexpr uint64_t kPrime64_5 = 0x27D4EB2F165667C5ULL;
+
+inline uint64_t rotl64(uint64_t x, int n) {
+    return (x << n) | (x >> (64 - n));
+}
+
+inline uint64_t read64(const uint8_t* p) {
+    uint64_t v;
+    memcpy(&v, p, 8);
+    return v;
+}
+
+inline uint32_t read32(const uint8_t* p) {
+    uint32_t v;
+    memcpy(&v, p, 4);
+    return v;
+}
+
+inline uint64_t xxh64_round(uint64_t acc, uint64_t input) {
+    acc += input * kPrime64_2;
+    acc = rotl64(acc, 31);
+    return acc * kPrime64_1;
+}
+
+inline uint64_t xxh64_merge_round(uint64_t acc, uint64_t val) {
+    acc ^= xxh64_round(0, val);
+    return acc * kPrime64_1 + kPrime64_4;
+}
+
+uint64_t xxh64(const uint8_t* p, size_t len, uint64_t seed) {
+    const uint8_t* end = p + len;
+    uint64_t h;
+
+    if (len >= 32) {
+        uint64_t v1 = seed + kPrime64_1 + kPrime64_2;
+        uint64_t v2 = seed + kPrime64_2;
+        uint64_t v3 = seed;
+        uint64_t v4 = seed - kPrime64_1;
+        do {
+            v1 = xxh64_round(v1, read64(p));
+            v2 = xxh64_round(v2, read64(p + 8));
+            v3 = xxh64_round(v3, read64(p + 16));
+            v4 = xxh64_round(v4, read64(p + 24));
+            p += 32;
+        } while (p + 32 <= end);
+        h = rotl64(v1, 1) + rotl64(v2, 7) + rotl64(v3, 12) + rotl64(v4, 18);
+        h = xxh64_merge_round(h, v1);
+        h = xxh64_merge_round(h, v2);
+        h = xxh64_merge_round(h, v3);
+        h = xxh64_merge_round(h, v4);
+    } else {
+        h = seed + kPrime64_5;
+    }
+
+    h += static_cast<uint64_t>(len);
+
+    while (p + 8 <= end) {
+        h ^= xxh64_round(0, read64(p));
+        h = rotl64(h, 27) * kPrime64_1 + kPrime64_4;
+        p += 8;
+    }
+    if (p + 4 <= end) {
+        h ^= static_cast<uint64_t>(read32(p)) * kPrime64_1;
+        h = rotl64(h, 23) * kPrime64_2 + kPrime64_3;
+        p += 4;
+    }
+    while (p < end) {
+        h ^= (*p) * kPrime64_5;
+        h = rotl64(h, 11) * kPrime64_1;
+        p++;
+    }
+
+    h ^= h >> 33;
+    h *= kPrime64_2;
+    h ^= h >> 29;
+    h *= kPrime64_3;
+    h ^= h >> 32;
+    return h;
+}
+
+inline uint64_t splitmix64(uint64_t x) {
+    x += 0x9E3779B97F4A7C15ULL;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    return x ^ (x >> 31);
+}
+
+void xxh64x2(const void* data, size_t len, uint8_t* digest) {
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+    uint64_t words[4];
+    words[0] = xxh64(p, len, 0);
+    words[1] = xxh64(p, len, kPrime64_1);
+    words[2] = splitmix64(words[0] ^ rotl64(words[1], 32));
+    words[3] = splitmix64(words[0] + words[1]);
+    // Little-endian word order, independent of host byte order
+    for (int w = 0; w < 4; w++) {
+        for (int b = 0; b < 8; b++) {
+            digest[8 * w + b] = uint8_t(words[w] >> (8 * b));
+        }
+    }
+}
+
+void xxh64x2_x8(const void* const* data, const size_t* len, uint8_t* const* digest) {
+    for (size_t i = 0; i < kHashLanes; i++) {
+        xxh64x2(data[i], len[i], digest[i]);
+    }
+}
+
+bool always_supported() { return true; }
+
+struct BackendEntry {
+    HashBackend backend;
+    bool (*supported)();
+};
+
+// Preference order for "auto"
+const BackendEntry kBackends[] = {
+    {{"sha256-shani-avx2", true, sha256_shani, sha256_shani_avx2_x8}, cpu_has_sha_ni_and_avx2},
+    {{"sha256-shani", true, sha256_shani, sha256_shani_x8}, detail::cpu_has_sha_ni},
+    {{"sha256-avx2", true, sha256_scalar, detail::sha256_x8_avx2}, detail::cpu_has_avx2},
+    {{"sha256-scalar", true, sha256_scalar, sha256_scalar_x8}, always_supported},
+    {{"xxh64x2", false, xxh64x2, xxh64x2_x8}, always_supported},
+};
+
+constexpr size_t kNumBackends = sizeof(kBackends) / sizeof(kBackends[0]);
+
+const HashBackend* select_default() {
+    const char* env = std::getenv("SPU_HASH_BACKEND");
+    if (env && *env) {
+        if (const HashBackend* b = find_hash_backend(env)) {
+            return b;
+        }
+    }
+    return find_hash_backend("auto");
+}
+
+std::atomic<const HashBackend*>& active_backend() {
+    static std::atomic<const HashBackend*> active{select_default()};
+    return active;
+}
+
+} // namespace
+
+const HashBackend* find_hash_backend(const char* name) {
+    bool want_auto = std::strcmp(name, "auto") == 0;
+    for (size_t i = 0; i < kNumBackends; i++) {
+        const BackendEntry& e = kBackends[i];
+        if (!e.supported()) {
+            continue;
+        }
+        if (want_auto ? e.backend.cryptographic : std::strcmp(name, e.backend.name) == 0) {
+            return &e.backend;
+        }
+    }
+    return nullptr;
+}
+
+const HashBackend& hash_backend() {
+    return *active_backend().load(std::memory_order_acquire);
+}
+
+bool set_hash_backend(const char* name) {
+    const HashBackend* b = find_hash_backend(name);
+    if (!b) {
+        return false;
+    }
+    active_backend().store(b, std::memory_order_release);
+    return true;
+}
+
+size_t hash_backend_count() {
+    size_t count = 0;
+    for (size_t i = 0; i < kNumBackends; i++) {
+        count += kBackends[i].supported();
+    }
+    return count;
+}
+
+const HashBackend& hash_backend_at(size_t index) {
+    for (size_t i = 0; i < kNumBackends; i++) {
+        if (kBackends[i].supported() && index-- == 0) {
+            return kBackends[i].backend;
+        }
+    }
+    return kBackends[kNumBackends - 1].backend;
+}
+
+void hash_many(const void* const* data, const size_t* len, uint8_t* const* digest, size_t n) {
+    const HashBackend& b = hash_backend();
+    size_t i = 0;
+    for (; i + kHashLanes <= n; i += kHashLanes) {
+        b.hash_x8(data + i, len + i, digest + i);
+    }
+    for (; i < n; i++) {
+        b.hash(data[i], len[i], digest[i]);
+    }
+}
+
+void digest_to_hex(const uint8_t* digest, char* output) {
+    static const char kHex[] = "0123456789abcdef";
+    for (size_t i = 0; i < kDigestLen; i++) {
+        output[2 * i] = kHex[digest[i] >> 4];
+        output[2 * i + 1] = kHex[digest[i] & 0x0f];
+    }
+    output[2 * kDigestLen] = '\0';
+}
+
+} // namespace spu
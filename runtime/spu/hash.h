@@ -0,0 +1,122 @@
+/**
+ * SPU Content Hashing - Pluggable hash backends
+ *
+ * Content IDs are SHA-256 digests, matching hashlib.sha256 on the Python
+ * path. Backends are selected at runtime by CPU feature:
+ *
+ *   sha256-shani   SHA extensions (one message at a time, ~2 cycles/byte)
+ *   sha256-avx2    8-lane multi-buffer SHA-256 for batched merges
+ *   sha256-scalar  Portable reference
+ *   xxh64x2        Non-cryptographic dedup IDs (NOT hashlib compatible)
+ *
+ * The SPU_HASH_BACKEND environment variable overrides the automatic choice.
+ */
+
+#ifndef SPU_HASH_H
+#define SPU_HASH_H
+
+#include <cstddef>
+#include <cstdint>
+
+namespace spu {
+
+// Digest size of every backend (bytes)
+static constexpr size_t kDigestLen = 32;
+
+// Messages hashed together by HashBackend::hash_x8
+static constexpr size_t kHashLanes = 8;
+
+struct HashBackend {
+    const char* name;
+    bool cryptographic;  // true = SHA-256, IDs match hashlib.sha256
+
+    // Hash one message
+    void (*hash)(const void* data, size_t len, uint8_t* digest);
+
+    // Hash kHashLanes independent messages
+    void (*hash_x8)(const void* const* data, const size_t* len, uint8_t* const* digest);
+};
+
+/**
+ * Active backend (selected on first use)
+ */
+const HashBackend& hash_backend();
+
+/**
+ * Select the active backend by name ("auto" = best for this CPU)
+ *
+ * @return false if the backend is unknown or unsupported on this CPU
+ */
+bool set_hash_backend(const char* name);
+
+/**
+ * Look up a backend supported on this CPU
+ *
+ * @return nullptr if unknown or unsupported
+ */
+const HashBackend* find_hash_backend(const char* name);
+
+// Backends supported on this CPU, best first
+size_t hash_backend_count();
+const HashBackend& hash_backend_at(size_t i);
+
+/**
+ * Hash n messages with the active backend, kHashLanes at a time
+ */
+void hash_many(const void* const* data, const size_t* len, uint8_t* const* digest, size_t n);
+
+/**
+ * Format a digest as a 64-char hex string
+ *
+ * @param output Output buffer (must be 65 bytes for hex string + null)
+ */
+void digest_to_hex(const uint8_t* digest, char* output);
+
+/**
+ * Incremental SHA-256 (fastest compression function for this CPU)
+ */
+class Sha256 {
+public:
+    Sha256();
+
+    void update(const void* data, size_t len);
+
+    // Write the digest; the object must not be updated afterwards
+    void finish(uint8_t* digest);
+
+    // Bytes absorbed so far
+    uint64_t length() const { return length_; }
+
+private:
+    uint32_t state_[8];
+    uint8_t buffer_[64];
+    uint64_t length_;
+};
+
+namespace detail {
+
+// SHA-256 compression over whole 64-byte blocks
+using Sha256Compress = void (*)(uint32_t* state, const uint8_t* blocks, size_t count);
+
+extern const uint32_t kSha256Init[8];
+extern const uint32_t kSha256K[64];
+
+void sha256_compress_scalar(uint32_t* state, const uint8_t* blocks, size_t count);
+
+// x86 kernels (sha256_x86.cpp); only call when the CPU supports them
+bool cpu_has_sha_ni();
+bool cpu_has_avx2();
+void sha256_compress_shani(uint32_t* state, const uint8_t* blocks, size_t count);
+void sha256_x8_avx2(const void* const* data, const size_t* len, uint8_t* const* digest);
+
+// Best compression function for this CPU
+Sha256Compress sha256_compress();
+
+// One-shot SHA-256 with a given compression function
+void sha256_oneshot(Sha256Compress compress, const void* data, size_t len, uint8_t* digest);
+
+} // namespace detail
+
+} // namespace spu
+
+#endif // SPU_HASH_H
@@ -0,0 +1,231 @@
+/**
+ * SPU Lazy Decay - Event-driven dynamics ticks
+ */
+
+#include "lazy_decay.h"
+#include "energy_index.h"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace spu {
+
+namespace {
+
+constexpr uint32_t kInactive = UINT32_MAX;
+
+// Min-heap order on crossing tick
+struct LaterCrossing {
+    template <typename T>
+    bool operator()(const T& a, const T& b) const { return a.tick > b.tick; }
+};
+
+} // namespace
+
+LazyDecay::LazyDecay(const DynamicsEngine& engine, GlyphStore& store, uint64_t tick_delta)
+    : engine_(engine), store_(store), tick_delta_(tick_delta) {
+    sync();
+}
+
+double LazyDecay::energy_after(double energy, uint64_t ticks) const {
+    // Same expression as step(): energy * (1 - decay_rate)^time_delta
+    return energy * engine_.decay_factor(ticks * tick_delta_);
+}
+
+uint64_t LazyDecay::active_ticks(double energy) const {
+    const double threshold = engine_.activation_threshold();
+    // decay_factor() raises this rounded base, not the exact 1 - rate
+    const double base = 1.0 - engine_.decay_rate();
+    if (threshold <= 0.0 || !(base < 1.0) || tick_delta_ == 0 || std::isinf(energy)) {
+        return kNever;  // Never falls below the threshold
+    }
+    if (base <= 0.0) {
+        return 0;
+    }
+
+    // Closed-form estimate, then gallop away from it until the exact pow()
+    // boundary is bracketed (lo active, hi not) and bisect
+    const uint64_t max_k = UINT64_MAX / tick_delta_;  // k * tick_delta_ fits in the time
+    auto active = [&](uint64_t k) { return energy_after(energy, k) >= threshold; };
+    const double estimate = std::log(threshold / energy) /
+                            (static_cast<double>(tick_delta_) * std::log(base));
+    uint64_t lo, hi;
+    uint64_t k = estimate < static_cast<double>(max_k)
+                     ? static_cast<uint64_t>(std::max(0.0, estimate))
+                     : max_k;
+    if (active(k)) {
+        lo = k;
+        for (uint64_t step = 1;; step = step > max_k / 2 ? max_k : 2 * step) {
+            if (step > max_k - lo) {
+                if (active(max_k)) {
+                    return kNever;
+                }
+                hi = max_k;
+                break;
+            }
+            if (!active(lo + step)) {
+                hi = lo + step;
+                break;
+            }
+            lo += step;
+        }
+    } else {
+        hi = k;
+        lo = 0;  // Active: energy is at or over the threshold
+        for (uint64_t step = 1; step < hi; step *= 2) {
+            if (active(hi - step)) {
+                lo = hi - step;
+                break;
+            }
+            hi -= step;
+        }
+    }
+    while (hi - lo > 1) {
+        const uint64_t mid = lo + (hi - lo) / 2;
+        (active(mid) ? lo : hi) = mid;
+    }
+    return lo;
+}
+
+double LazyDecay::energy(size_t i) const {
+    return energy_after(store_.energy()[i], now_ - touched_[i]);
+}
+
+uint32_t LazyDecay::activation_count(size_t i) const {
+    uint64_t count = store_.activation_count()[i];
+    const uint64_t expires = expires_[i];
+    if (expires != 0) {
+        uint64_t last_active = expires == kNever ? now_ : std::min(now_, expires - 1);
+        if (last_active > touched_[i]) {
+            count += last_active - touched_[i];
+        }
+    }
+    return static_cast<uint32_t>(count);
+}
+
+void LazyDecay::touch(size_t i) {
+    if (touched_[i] == now_) {
+        return;
+    }
+    store_.energy()[i] = energy(i);
+    store_.activation_count()[i] = activation_count(i);
+    store_.last_update_time()[i] += (now_ - touched_[i]) * tick_delta_;
+    touched_[i] = now_;
+}
+
+void LazyDecay::materialize() {
+    // Most glyphs share a touch tick: one pow() per run of equal elapsed times
+    uint64_t last_elapsed = 0;
+    double factor = 1.0;
+    for (size_t i = 0; i < touched_.size(); i++) {
+        uint64_t elapsed = now_ - touched_[i];
+        if (elapsed == 0) {
+            continue;
+        }
+        if (elapsed != last_elapsed) {
+            last_elapsed = elapsed;
+            factor = engine_.decay_factor(elapsed * tick_delta_);
+        }
+        store_.activation_count()[i] = activation_count(i);
+        store_.energy()[i] *= factor;
+        store_.last_update_time()[i] += elapsed * tick_delta_;
+        touched_[i] = now_;
+    }
+}
+
+void LazyDecay::deactivate(size_t i) {
+    uint32_t pos = active_pos_[i];
+    if (pos == kInactive) {
+        return;
+    }
+    uint32_t last = active_.back();
+    active_[pos] = last;
+    active_pos_[last] = pos;
+    active_.pop_back();
+    active_pos_[i] = kInactive;
+}
+
+void LazyDecay::schedule(size_t i) {
+    const double e = store_.energy()[i];
+    if (!(e >= engine_.activation_threshold())) {
+        expires_[i] = 0;
+        deactivate(i);
+        return;
+    }
+
+    uint64_t ticks = active_ticks(e);
+    expires_[i] = ticks == kNever || ticks >= kNever - 1 - now_ ? kNever : now_ + ticks + 1;
+    if (active_pos_[i] == kInactive) {
+        active_pos_[i] = static_cast<uint32_t>(active_.size());
+        active_.push_back(static_cast<uint32_t>(i));
+    }
+    if (expires_[i] != kNever) {
+        heap_.push_back(Crossing{expires_[i], static_cast<uint32_t>(i)});
+        std::push_heap(heap_.begin(), heap_.end(), LaterCrossing());
+    }
+}
+
+size_t LazyDecay::tick(uint64_t n) {
+    now_ += n;
+    while (!heap_.empty() && heap_.front().tick <= now_) {
+        Crossing c = heap_.front();
+        std::pop_heap(heap_.begin(), heap_.end(), LaterCrossing());
+        heap_.pop_back();
+        if (expires_[c.glyph] == c.tick) {  // Skip entries replaced by set_energy()
+            deactivate(c.glyph);
+        }
+    }
+    return active_.size();
+}
+
+void LazyDecay::set_energy(size_t i, double energy) {
+    touch(i);
+    store_.energy()[i] = energy;
+    schedule(i);
+    if (index_) {
+        index_->set(static_cast<uint32_t>(i), energy, now_);
+    }
+}
+
+void LazyDecay::sync() {
+    const size_t n = store_.size();
+    if (n > kInactive) {
+        throw std::length_error("LazyDecay tracks at most 2^32 - 1 glyphs");
+    }
+    for (size_t i = touched_.size(); i < n; i++) {
+        touched_.push_back(now_);
+        expires_.push_back(0);
+        active_pos_.push_back(kInactive);
+        schedule(i);
+        if (index_) {
+            index_->set(static_cast<uint32_t>(i), store_.energy()[i], now_);
+        }
+    }
+}
+
+void LazyDecay::merge_batch(const MergePair* pairs, size_t n, GlyphStore& out, ThreadPool* pool) {
+    if (&out == &store_) {
+        throw std::invalid_argument("LazyDecay::merge_batch: out must not be the attached store");
+    }
+    for (size_t i = 0; i < n; i++) {
+        if (pairs[i].first >= touched_.size() || pairs[i].second >= touched_.size()) {
+            throw std::out_of_range("LazyDecay::merge_batch: pair index out of range");
+        }
+        touch(pairs[i].first);
+        touch(pairs[i].second);
+    }
+    spu::merge_batch(store_, pairs, n, out, pool);
+}
+
+void LazyDecay::track_energy(EnergyIndex* index) {
+    if (index && (index->engine().decay_rate() != engine_.decay_rate() ||
+                  index->tick_delta() != tick_delta_)) {
+        throw std::invalid_argument("LazyDecay::track_energy: index decays at a different rate");
+    }
+    index_ = index;
+    if (index) {
+        index->assign(touched_.size(), store_.energy(), touched_.data());
+    }
+}
+
+} // namespace spu
@@ -0,0 +1,154 @@
+/**
+ * SPU Lazy Decay - Event-driven dynamics ticks
+ *
+ * Decay has a closed form, E(t) = E0 * (1 - decay_rate)^(t - t0), so an
+ * idle glyph needs no per-tick work: LazyDecay keeps each glyph's energy
+ * as of the tick it was last touched and evaluates it on demand. Energy
+ * only falls between touches, so a glyph at or over the threshold stays
+ * active for a fixed number of ticks; a min-heap keyed on that predicted
+ * crossing tick retires glyphs as they drop out. tick() therefore costs
+ * O(glyphs crossing the threshold) instead of O(store size), and the
+ * active set is listed in O(active).
+ *
+ * While a LazyDecay is attached, the store's energy, activation_count and
+ * last_update_time columns hold each glyph's state as of its last touch.
+ * Read through energy() / activation_count(), or call touch() /
+ * materialize() before using the columns directly (merge_batch and
+ * snapshots read them). A touch writes what one eager DynamicsEngine::step()
+ * over the time since the previous touch would: the same decay_factor()
+ * pow(), and last_update_time advanced by that time.
+ *
+ * Activation counts one per tick at which the decayed energy is at or
+ * over the threshold, like one eager step per tick. The eager engine
+ * compounds the factor tick by tick (E * f * f ...) while LazyDecay uses
+ * one pow() per touch, so the two can differ in the last bit, and a
+ * crossing that lands exactly on the threshold can move by one tick.
+ *
+ * track_energy() keeps an EnergyIndex (energy_index.h) of every glyph for
+ * top-K and threshold queries; like the heap, it changes only when a
+ * glyph's energy does.
+ *
+ * Not thread-safe.
+ */
+
+#ifndef SPU_LAZY_DECAY_H
+#define SPU_LAZY_DECAY_H
+
+#include "dynamics.h"
+#include "glyph_store.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace spu {
+
+class EnergyIndex;
+
+class LazyDecay {
+public:
+    /**
+     * Attach to a store whose columns are current; tracks every glyph
+     *
+     * @param tick_delta Time units per tick
+     */
+    LazyDecay(const DynamicsEngine& engine, GlyphStore& store, uint64_t tick_delta = 1);
+
+    // Ticks since construction
+    uint64_t now() const { return now_; }
+    uint64_t tick_delta() const { return tick_delta_; }
+
+    // Glyphs tracked (the store's size at the last sync())
+    size_t size() const { return touched_.size(); }
+
+    /**
+     * Advance the clock by n ticks and retire glyphs that fell below the
+     * threshold
+     *
+     * @return Glyphs activated at the last of the n ticks (active_count())
+     */
+    size_t tick(uint64_t n = 1);
+
+    // Glyphs whose current energy is at or over the threshold, in no particular order
+    const std::vector<uint32_t>& active() const { return active_; }
+    size_t active_count() const { return active_.size(); }
+
+    // Current state of glyph i, without touching it
+    double energy(size_t i) const;
+    uint32_t activation_count(size_t i) const;
+
+    /**
+     * Write glyph i's current state into the store columns
+     *
+     * Rebases its decay at now(); the predicted crossing is unchanged.
+     */
+    void touch(size_t i);
+
+    // touch() every glyph
+    void materialize();
+
+    /**
+     * Replace glyph i's energy at now() (e.g. a stimulus)
+     *
+     * The new energy first counts toward activation at the next tick.
+     */
+    void set_energy(size_t i, double energy);
+
+    /**
+     * Start tracking glyphs appended to the store since the last call,
+     * with their columns taken as current at now()
+     */
+    void sync();
+
+    /**
+     * Touch both sides of n index pairs, then merge_batch() them
+     *
+     * Results are appended to out, which must not be the attached store;
+     * to tick merged glyphs too, append them to the store and sync().
+     *
+     * @throws std::invalid_argument if out is the attached store
+     * @throws std::out_of_range if a pair indexes past the store
+     */
+    void merge_batch(const MergePair* pairs, size_t n, GlyphStore& out, ThreadPool* pool = nullptr);
+
+    /**
+     * Keep an energy index of every tracked glyph (nullptr to stop)
+     *
+     * The index is rebuilt from the current state, then updated by
+     * set_energy() and sync(); ticks and touches leave it alone. Query it
+     * at now(). It must outlive the attachment.
+     *
+     * @throws std::invalid_argument if its decay rate or tick_delta differ
+     */
+    void track_energy(EnergyIndex* index);
+
+private:
+    static constexpr uint64_t kNever = UINT64_MAX;
+
+    // Ticks after a touch during which energy stays >= threshold (kNever = forever)
+    uint64_t active_ticks(double energy) const;
+    double energy_after(double energy, uint64_t ticks) const;
+    void schedule(size_t i);
+    void deactivate(size_t i);
+
+    struct Crossing {
+        uint64_t tick;   // First tick at which the glyph is inactive
+        uint32_t glyph;
+    };
+
+    DynamicsEngine engine_;
+    GlyphStore& store_;
+    uint64_t tick_delta_;
+    uint64_t now_ = 0;
+
+    std::vector<uint64_t> touched_;     // Tick at which the store columns are current
+    std::vector<uint64_t> expires_;     // First inactive tick (0 = not active)
+    std::vector<uint32_t> active_pos_;  // Index into active_, or UINT32_MAX
+    std::vector<uint32_t> active_;
+    std::vector<Crossing> heap_;        // Min-heap on tick; entries go stale on reschedule
+    EnergyIndex* index_ = nullptr;
+};
+
+} // namespace spu
+
+#endif // SPU_LAZY_DECAY_H
@@ -0,0 +1,907 @@
+/**
+ * SPU Merge Benchmarks - Google Benchmark suite
+ *
+ * Cases:
+ *   BM_MergeBatch            fixed 8-byte glyphs, batched (CI gate: /1024)
+ *   BM_MergeRandomLength     randomized content lengths
+ *   BM_MergeWorkingSet       random pairs over pools sized past L1/L2/L3
+ *   BM_StoreMergeWorkingSet  same, on the SoA GlyphStore
+ *   BM_StoreMergeThreads     one large store batch split across a ThreadPool
+ *   BM_StoreMergePolicy/<len>/<variant> generic vs size-class kernels, with and without hashing
+ *   BM_TickThreads           TickScheduler step + merges over 1M glyphs per thread count
+ *   BM_PooledMerge           merges into GlyphPool records, retired each batch
+ *   BM_DecayTick/<lazy>      one tick over 1M glyphs (1% active, ~150 crossings), eager vs LazyDecay
+ *   BM_EnergyQuery/<indexed>/<query> top-100 / next-100-to-activate over 1M glyphs, scan vs EnergyIndex
+ *   BM_ProvenanceCounts/<batched> 256 ancestor counts over a 1M-glyph DAG, one BFS each vs batched
+ *   BM_MergeStage/<producers> requests pushed through MergeStage's queue into merge_batch
+ *   BM_MergePipeline/<staged>/<threads> a stream of batches, merge_batch() per batch vs MergePipeline
+ *   BM_FpgaEmulated/<buffers> FpgaMergeBackend on the emulated device, 1 vs 2 buffer slots
+ *   BM_MergeChain            deep merge cascade, flat vs lazy content
+ *   BM_MergeCached/<pairs>   batches drawn from a fixed set of distinct pairs
+ *   BM_MergeHash/<backend>   BM_MergeBatch per supported hash backend
+ *   BM_Telemetry/<timed>     one telemetry record, bare vs timed (two clock reads)
+ *
+ * Build:
+ *   g++ -O3 -std=c++17 -pthread merge_bench.cpp merge_ref.cpp glyph_store.cpp \
+ *       dynamics.cpp hash.cpp sha256_x86.cpp content.cpp thread_pool.cpp perf_counters.cpp \
+ *       merge_cache.cpp tick_scheduler.cpp lazy_decay.cpp energy_index.cpp \
+ *       merge_queue.cpp merge_pipeline.cpp fpga_backend.cpp glyph_pool.cpp telemetry.cpp \
+ *       provenance.cpp -lbenchmark -o merge_bench
+ *
+ * Run (JSON read by ci/check_perf.py --current-native):
+ *   ./merge_bench --benchmark_repetitions=5 --benchmark_report_aggregates_only=true \
+ *       --benchmark_out=benchmarks/merge_bench_results.json --benchmark_out_format=json
+ *
+ * Throughput is reported as items_per_second (merges per second). Steady-
+ * state cases also report allocs_per_iter, the heap allocations per timed
+ * iteration counted by this binary's replacement allocation functions
+ * (every operator new, aligned and nothrow included; 0 = allocation-free;
+ * the inputs and one warm-up iteration run before timing). Built with
+ * -DSPU_PERF_COUNTERS, every case also reports
+ * per-item cycles / instructions / cache misses / branch misses for each
+ * instrumented phase, e.g. "hash.cycles".
+ */
+
+#include "merge_ref.h"
+#include "glyph_pool.h"
+#include "merge_cache.h"
+#include "merge_queue.h"
+#include "merge_pipeline.h"
+#include "glyph_store.h"
+#include "dynamics.h"
+#include "energy_index.h"
+#include "fpga_backend.h"
+#include "hash.h"
+#include "lazy_decay.h"
+#include "perf_counters.h"
+#include "provenance.h"
+#include "telemetry.h"
+#include "thread_pool.h"
+#include "tick_scheduler.h"
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Every operator new in the process bumps this (see AllocationCounter)
+static std::atomic<uint64_t> g_heap_allocations{0};
+
+// Every allocation function below goes through these two. They stay out of
+// line so GCC pairs each operator new with an operator delete instead of
+// seeing malloc on one side and free on the other (-Wmismatched-new-delete).
+__attribute__((noinline)) static void* counted_alloc(size_t size, size_t align) noexcept {
+    g_heap_allocations.fetch_add(1, std::memory_order_relaxed);
+    size = size ? size : 1;
+    if (align <= alignof(std::max_align_t)) {
+        return std::malloc(size);
+    }
+    void* p = nullptr;
+    return posix_memalign(&p, align, size) == 0 ? p : nullptr;
+}
+
+__attribute__((noinline)) static void counted_free(void* p) noexcept { std::free(p); }
+
+static void* counted_alloc_or_throw(size_t size, size_t align) {
+    if (void* p = counted_alloc(size, align)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+static constexpr size_t kDefaultAlign = alignof(std::max_align_t);
+
+void* operator new(size_t size) { return counted_alloc_or_throw(size, kDefaultAlign); }
+void* operator new[](size_t size) { return counted_alloc_or_throw(size, kDefaultAlign); }
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+    return counted_alloc(size, kDefaultAlign);
+}
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+    return counted_alloc(size, kDefaultAlign);
+}
+void* operator new(size_t size, std::align_val_t align) {
+    return counted_alloc_or_throw(size, static_cast<size_t>(align));
+}
+void* operator new[](size_t size, std::align_val_t align) {
+    return counted_alloc_or_throw(size, static_cast<size_t>(align));
+}
+void* operator new(size_t size, std::align_val_t align, const std::nothrow_t&) noexcept {
+    return counted_alloc(size, static_cast<size_t>(align));
+}
+void* operator new[](size_t size, std::align_val_t align, const std::nothrow_t&) noexcept {
+    return counted_alloc(size, static_cast<size_t>(align));
+}
+
+void operator delete(void* p) noexcept { counted_free(p); }
+void operator delete[](void* p) noexcept { counted_free(p); }
+void operator delete(void* p, size_t) noexcept { counted_free(p); }
+void operator delete[](void* p, size_t) noexcept { counted_free(p); }
+void operator delete(void* p, const std::nothrow_t&) noexcept { counted_free(p); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept { counted_free(p); }
+void operator delete(void* p, std::align_val_t) noexcept { counted_free(p); }
+void operator delete[](void* p, std::align_val_t) noexcept { counted_free(p); }
+void operator delete(void* p, size_t, std::align_val_t) noexcept { counted_free(p); }
+void operator delete[](void* p, size_t, std::align_val_t) noexcept { counted_free(p); }
+void operator delete(void* p, std::align_val_t, const std::nothrow_t&) noexcept { counted_free(p); }
+void operator delete[](void* p, std::align_val_t, const std::nothrow_t&) noexcept {
+    counted_free(p);
+}
+
+namespace {
+
+using namespace spu;
+
+// Deterministic generator so every run benchmarks the same inputs
+struct SplitMix64 {
+    uint64_t state;
+
+    explicit SplitMix64(uint64_t seed) : state(seed) {}
+
+    uint64_t next() {
+        uint64_t z = (state += 0x9e3779b97f4a7c15ULL);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        return z ^ (z >> 31);
+    }
+
+    size_t uniform(size_t lo, size_t hi) { return lo + next() % (hi - lo + 1); }
+};
+
+/**
+ * Glyphs with content lengths in [min_len, max_len] and energy in [0, 10)
+ */
+void make_glyphs(size_t n, size_t min_len, size_t max_len, uint64_t seed,
+                 std::vector<Glyph>& out, ContentArena& arena) {
+    SplitMix64 rng(seed);
+    std::string content;
+    out.resize(n);
+    for (size_t i = 0; i < n; i++) {
+        content.resize(rng.uniform(min_len, max_len));
+        for (char& c : content) {
+            c = static_cast<char>('a' + rng.next() % 26);
+        }
+        Glyph& g = out[i];
+        g.content.assign(content.data(), content.size(), arena);
+        content_hash(content.data(), content.size(), g.id);
+        g.energy = static_cast<double>(rng.next() % 10000) / 1000.0;
+        g.activation_count = static_cast<uint32_t>(rng.next() % 16);
+        g.last_update_time = rng.next() % 1000;
+    }
+}
+
+std::vector<MergePair> make_pairs(size_t n, size_t pool_size, uint64_t seed) {
+    SplitMix64 rng(seed);
+    std::vector<MergePair> pairs(n);
+    for (MergePair& p : pairs) {
+        p.first = static_cast<uint32_t>(rng.next() % pool_size);
+        p.second = static_cast<uint32_t>(rng.next() % pool_size);
+    }
+    return pairs;
+}
+
+// Arena whose first chunk holds a whole batch
+size_t batch_arena_size(size_t batch, size_t max_len) {
+    return batch * (2 * max_len + 3) + ContentArena::kDefaultChunkSize;
+}
+
+// Heap allocations from construction to report(), per iteration
+class AllocationCounter {
+public:
+    AllocationCounter() : start_(g_heap_allocations.load(std::memory_order_relaxed)) {}
+
+    void report(benchmark::State& state) const {
+        uint64_t allocs = g_heap_allocations.load(std::memory_order_relaxed) - start_;
+        state.counters["allocs_per_iter"] = static_cast<double>(allocs) /
+                                            static_cast<double>(std::max<int64_t>(state.iterations(), 1));
+    }
+
+private:
+    uint64_t start_;
+};
+
+// Phase counters per processed item since the last perf_reset()
+void report_perf(benchmark::State& state) {
+    if (!perf_enabled()) {
+        return;
+    }
+    PerfStats stats[kPerfNumPhases];
+    perf_snapshot(stats);
+    const bool hardware = std::string(perf_source()) == "perf_event";
+    for (size_t p = 0; p < kPerfNumPhases; p++) {
+        if (stats[p].items == 0) {
+            continue;
+        }
+        std::string name = perf_phase_name(static_cast<PerfPhase>(p));
+        double items = static_cast<double>(stats[p].items);
+        state.counters[name + ".cycles"] = stats[p].cycles / items;
+        if (!hardware) {
+            continue;  // TSC fallback: cycles only
+        }
+        state.counters[name + ".instructions"] = stats[p].instructions / items;
+        state.counters[name + ".cache_misses"] = stats[p].cache_misses / items;
+        state.counters[name + ".branch_misses"] = stats[p].branch_misses / items;
+    }
+}
+
+void BM_MergeBatch(benchmark::State& state) {
+    const size_t batch = static_cast<size_t>(state.range(0));
+
+    ContentArena arena;
+    std::vector<Glyph> a(batch), b(batch), out(batch);
+    for (size_t i = 0; i < batch; i++) {
+        a[i].content.assign("content1", 8, arena);
+        content_hash(a[i].content.data(), a[i].content.size(), a[i].id);
+        a[i].energy = 2.0;
+        b[i].content.assign("content2", 8, arena);
+        content_hash(b[i].content.data(), b[i].content.size(), b[i].id);
+        b[i].energy = 3.0;
+    }
+
+    perf_reset();
+    for (auto _ : state) {
+        merge_batch(a.data(), b.data(), out.data(), batch, arena);
+        benchmark::DoNotOptimize(out.data());
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(batch));
+    report_perf(state);
+    state.SetLabel(hash_backend().name);
+}
+BENCHMARK(BM_MergeBatch)->RangeMultiplier(4)->Range(1, 16384);
+
+void BM_MergeRandomLength(benchmark::State& state) {
+    const size_t min_len = static_cast<size_t>(state.range(0));
+    const size_t max_len = static_cast<size_t>(state.range(1));
+    const size_t pool_size = 4096;
+    const size_t batch = 1024;
+
+    ContentArena pool_arena;
+    std::vector<Glyph> pool;
+    make_glyphs(pool_size, min_len, max_len, 1, pool, pool_arena);
+    std::vector<MergePair> pairs = make_pairs(batch, pool_size, 2);
+    std::vector<Glyph> out(batch);
+    ContentArena arena;
+    merge_batch(pool.data(), pairs.data(), out.data(), batch, arena);  // Warm-up: grow the arena
+
+    perf_reset();
+    AllocationCounter allocs;
+    for (auto _ : state) {
+        arena.reset();
+        merge_batch(pool.data(), pairs.data(), out.data(), batch, arena);
+        benchmark::DoNotOptimize(out.data());
+        benchmark::ClobberMemory();
+    }
+    allocs.report(state);
+    state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(batch));
+    report_perf(state);
+    state.SetBytesProcessed(state.iterations() * static_cast<int64_t>(arena.bytes_used()));
+}
+BENCHMARK(BM_MergeRandomLength)
+    ->Args({1, 16})
+    ->Args({8, 64})
+    ->Args({16, 256})
+    ->Args({64, 1024});
+
+// Pool sizes: 2^8 glyphs (~40 KiB, L1/L2) up to 2^20 (~150 MiB, past L3)
+void BM_MergeWorkingSet(benchmark::State& state) {
+    const size_t pool_size = static_cast<size_t>(state.range(0));
+    const size_t batch = 1024;
+
+    ContentArena pool_arena;
+    std::vector<Glyph> pool;
+    make_glyphs(pool_size, 4, 20, 3, pool, pool_arena);
+    std::vector<MergePair> pairs = make_pairs(batch, pool_size, 4);
+    std::vector<Glyph> out(batch);
+    ContentArena arena(batch_arena_size(batch, 20));
+
+    perf_reset();
+    for (auto _ : state) {
+        arena.reset();
+        merge_batch(pool.data(), pairs.data(), out.data(), batch, arena);
+        benchmark::DoNotOptimize(out.data());
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(batch));
+    report_perf(state);
+    state.counters["pool_bytes"] = static_cast<double>(pool_size * sizeof(Glyph));
+}
+BENCHMARK(BM_MergeWorkingSet)->RangeMultiplier(8)->Range(1 << 8, 1 << 20);
+
+void BM_StoreMergeWorkingSet(benchmark::State& state) {
+    const size_t pool_size = static_cast<size_t>(state.range(0));
+    const size_t batch = 1024;
+
+    ContentArena pool_arena;
+    std::vector<Glyph> glyphs;
+    make_glyphs(pool_size, 4, 20, 3, glyphs, pool_arena);
+    GlyphStore in = GlyphStore::from_glyphs(glyphs.data(), glyphs.size());
+    std::vector<MergePair> pairs = make_pairs(batch, pool_size, 4);
+    GlyphStore out;
+    out.reserve(batch, batch * 43);
+
+    perf_reset();
+    for (auto _ : state) {
+        out.clear();
+        merge_batch(in, pairs.data(), batch, out);
+        benchmark::DoNotOptimize(out.energy());
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(batch));
+    report_perf(state);
+}
+BENCHMARK(BM_StoreMergeWorkingSet)->RangeMultiplier(8)->Range(1 << 8, 1 << 20);
+
+void BM_StoreMergeThreads(benchmark::State& state) {
+    const size_t threads = static_cast<size_t>(state.range(0));
+    const size_t pool_size = 1 << 16;
+    const size_t batch = 1 << 16;
+
+    ContentArena pool_arena;
+    std::vector<Glyph> glyphs;
+    make_glyphs(pool_size, 4, 20, 5, glyphs, pool_arena);
+    GlyphStore in = GlyphStore::from_glyphs(glyphs.data(), glyphs.size());
+    std::vector<MergePair> pairs = make_pairs(batch, pool_size, 6);
+    GlyphStore out;
+    out.reserve(batch, batch * 43);
+    ThreadPool pool(threads);
+    merge_batch(in, pairs.data(), batch, out, &pool);  // Warm-up: per-thread scratch
+
+    perf_reset();
+    AllocationCounter allocs;
+    for (auto _ : state) {
+        out.clear();
+        merge_batch(in, pairs.data(), batch, out, &pool);
+        benchmark::DoNotOptimize(out.energy());
+        benchmark::ClobberMemory();
+    }
+    allocs.report(state);
+    state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(batch));
+    report_perf(state);
+    state.counters["threads"] = static_cast<double>(threads);
+}
+BENCHMARK(BM_StoreMergeThreads)->RangeMultiplier(2)->Range(1, 32)->UseRealTime();
+
+// Variants: 0 = generic kernel, 1 = size-class dispatch, 2 = dispatch without hash / provenance
+void BM_StoreMergePolicy(benchmark::State& state) {
+    const size_t max_len = static_cast<size_t>(state.range(0));
+    const int variant = static_cast<int>(state.range(1));
+    const size_t pool_size = 4096;
+    const size_t batch = 1024;
+
+    ContentArena pool_arena;
+    std::vector<Glyph> glyphs;
+    make_glyphs(pool_size, max_len / 2, max_len, 7, glyphs, pool_arena);
+    GlyphStore in = GlyphStore::from_glyphs(glyphs.data(), glyphs.size());
+    std::vector<MergePair> pairs = make_pairs(batch, pool_size, 8);
+    GlyphStore out;
+    out.reserve(batch, batch * (2 * max_len + 3));
+    MergeOptions ephemeral;
+    ephemeral.hash = false;
+    ephemeral.provenance = false;
+
+    perf_reset();
+    for (auto _ : state) {
+        out.clear();
+        if (variant == 0) {
+            merge_batch_as<AnyContent, HashIds, RecordProvenance>(in, pairs.data(), batch, out);
+        } else if (variant == 1) {
+            merge_batch(in, pairs.data(), batch, out);
+        } else {
+            merge_batch(in, pairs.data(), batch, out, ephemeral);
+        }
+        benchmark::DoNotOptimize(out.energy());
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(batch));
+    report_perf(state);
+}
+BENCHMARK(BM_StoreMergePolicy)->ArgsProduct({{16, 32, 64}, {0, 1, 2}});
+
+// One tick (step every glyph, then merge 1/16 of them) on a work-stealing pool
+void BM_TickThreads(benchmark::State& state) {
+    const size_t threads = static_cast<size_t>(state.range(0));
+    const size_t glyphs = 1 << 20;
+    const size_t batch = glyphs / 16;
+
+    ContentArena pool_arena;
+    std::vector<Glyph> pool_glyphs;
+    make_glyphs(glyphs, 4, 20, 5, pool_glyphs, pool_arena);
+    GlyphStore store = GlyphStore::from_glyphs(pool_glyphs.data(), pool_glyphs.size());
+    std::vector<MergePair> pairs = make_pairs(batch, glyphs, 7);
+    GlyphStore merged;
+    merged.reserve(batch, batch * 43);
+    ThreadPool pool(threads);
+    // Decay 0 keeps energies fixed across iterations
+    TickScheduler scheduler(DynamicsEngine(1.0, 0.0), &pool);
+    scheduler.tick(store, 1, pairs.data(), batch, merged);  // Warm-up
+
+    AllocationCounter allocs;
+    for (auto _ : state) {
+        merged.clear();
+        TickStats stats = scheduler.tick(store, 1, pairs.data(), batch, merged);
+        benchmark::DoNotOptimize(stats);
+        benchmark::ClobberMemory();
+    }
+    allocs.report(state);
+    state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(glyphs));
+    state.counters["threads"] = static_cast<double>(threads);
+}
+BENCHMARK(BM_TickThreads)->RangeMultiplier(2)->Range(1, 32)->UseRealTime();
+
+// AoS merges whose results are GlyphPool records: each batch takes batch
+// records, merges into them, runs a dynamics step over them and retires them
+void BM_PooledMerge(benchmark::State& state) {
+    const size_t batch = static_cast<size_t>(state.range(0));
+    const size_t pool_size = 4096;
+
+    ContentArena pool_arena;
+    std::vector<Glyph> glyphs;
+    make_glyphs(pool_size, 8, 64, 11, glyphs, pool_arena);
+    std::vector<MergePair> pairs = make_pairs(batch, pool_size, 12);
+    GlyphPool records;
+    ContentArena arena;
+    std::vector<Glyph*> live;
+    live.reserve(batch);
+    const double factor = DynamicsEngine(1.0, 0.1).decay_factor(1);
+
+    auto run_batch = [&] {
+        arena.reset();
+        for (const MergePair& p : pairs) {
+            Glyph* g = records.acquire();
+            merge(glyphs[p.first], glyphs[p.second], *g, arena);
+            live.push_back(g);
+        }
+        for (Glyph* g : live) {
+            g->energy *= factor;
+            g->activation_count += g->energy >= 1.0;
+        }
+        benchmark::DoNotOptimize(live.back()->id.bytes);
+        for (Glyph* g : live) {
+            records.release(g);
+        }
+        live.clear();
+    };
+    run_batch();  // Warm-up: grow the pool and arena
+
+    perf_reset();
+    AllocationCounter allocs;
+    for (auto _ : state) {
+        run_batch();
+    }
+    allocs.report(state);
+    state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(batch));
+    report_perf(state);
+}
+BENCHMARK(BM_PooledMerge)->Arg(64)->Arg(1024)->Arg(16384);
+
+// Eager step of every glyph vs LazyDecay::tick() in a steady state with 1% of
+// glyphs over the threshold: each tick ~150 stimuli raise glyphs to 2.0 and
+// about as many decay back below 1.0 (69 ticks later at rate 0.01). Items are
+// the glyphs active going into the tick: those still active after it plus
+// those that crossed out.
+void BM_DecayTick(benchmark::State& state) {
+    const bool lazy = state.range(0) != 0;
+    const size_t glyphs = 1 << 20;
+    const size_t stimuli = glyphs / 100 / 69;
+
+    ContentArena pool_arena;
+    std::vector<Glyph> pool_glyphs;
+    make_glyphs(glyphs, 4, 20, 5, pool_glyphs, pool_arena);
+    SplitMix64 rng(8);
+    for (Glyph& g : pool_glyphs) {
+        // Active glyphs spread over every remaining lifetime, so crossings are steady
+        g.energy = rng.next() % 100 == 0 ? 1.0 + static_cast<double>(rng.next() % 1024) / 1024.0
+                                         : 0.5;
+    }
+    GlyphStore store = GlyphStore::from_glyphs(pool_glyphs.data(), pool_glyphs.size());
+    DynamicsEngine engine(1.0, 0.01);
+    LazyDecay decay(engine, store);
+
+    size_t active = 0;
+    for (size_t i = 0; i < glyphs; i++) {
+        active += store.energy()[i] >= 1.0;
+    }
+    int64_t items = 0;
+    int64_t crossings = 0;
+    auto run_tick = [&] {
+        for (size_t k = 0; k < stimuli; k++) {
+            const size_t i = rng.next() % glyphs;
+            if (lazy) {
+                active += decay.energy(i) < 1.0;
+                decay.set_energy(i, 2.0);
+            } else {
+                active += store.energy()[i] < 1.0;
+                store.energy()[i] = 2.0;
+            }
+        }
+        const size_t after = lazy ? decay.tick() : engine.step(store, 1);
+        items += static_cast<int64_t>(active);
+        crossings += static_cast<int64_t>(active - after);
+        active = after;
+    };
+    for (int t = 0; t < 100; t++) {
+        run_tick();  // Warm-up: reach the steady state
+    }
+    items = crossings = 0;
+
+    for (auto _ : state) {
+        run_tick();
+    }
+    const double ticks = static_cast<double>(state.iterations());
+    state.counters["active"] = static_cast<double>(items - crossings) / ticks;
+    state.counters["crossings"] = static_cast<double>(crossings) / ticks;
+    state.SetItemsProcessed(items);
+}
+BENCHMARK(BM_DecayTick)->Arg(0)->Arg(1);
+
+// A tick of 64 stimuli and one query (0 = top 100, 1 = the 100 closest
+// below the threshold): a K-element heap over the energy column vs
+// EnergyIndex. Neither side pays for decay (the eager step keeps the
+// column current; the index needs nothing per tick).
+void BM_EnergyQuery(benchmark::State& state) {
+    const bool indexed = state.range(0) != 0;
+    const bool below = state.range(1) != 0;
+    const size_t glyphs = 1 << 20;
+    const size_t k = 100;
+    const size_t stimuli = 64;
+
+    ContentArena pool_arena;
+    std::vector<Glyph> pool_glyphs;
+    make_glyphs(glyphs, 4, 20, 5, pool_glyphs, pool_arena);
+    SplitMix64 rng(9);
+    auto random_energy = [&rng]() { return static_cast<double>(rng.next() % 4096) / 1024.0; };
+    for (Glyph& g : pool_glyphs) {
+        g.energy = random_energy();
+    }
+    GlyphStore store = GlyphStore::from_glyphs(pool_glyphs.data(), pool_glyphs.size());
+    DynamicsEngine engine(1.0, 0.01);
+    EnergyIndex index(engine);
+    uint64_t now = 0;
+    if (indexed) {
+        index.assign(store, now);
+    }
+
+    std::vector<uint32_t> out;
+    out.reserve(k);
+    std::vector<std::pair<double, uint32_t>> heap;  // Min-heap of the best k so far
+    heap.reserve(k + 1);
+    auto scan = [&]() {
+        const double* energy = store.energy();
+        const double threshold = engine.activation_threshold();
+        heap.clear();
+        for (size_t i = 0; i < glyphs; i++) {
+            const double e = energy[i];
+            if (below && !(e < threshold)) {
+                continue;
+            }
+            if (heap.size() < k || e > heap.front().first) {
+                heap.emplace_back(e, static_cast<uint32_t>(i));
+                std::push_heap(heap.begin(), heap.end(), std::greater<>());
+                if (heap.size() > k) {
+                    std::pop_heap(heap.begin(), heap.end(), std::greater<>());
+                    heap.pop_back();
+                }
+            }
+        }
+        std::sort_heap(heap.begin(), heap.end(), std::greater<>());
+        for (const auto& h : heap) {
+            out.push_back(h.second);
+        }
+    };
+
+    for (auto _ : state) {
+        out.clear();
+        for (size_t s = 0; s < stimuli; s++) {
+            const size_t i = rng.next() % glyphs;
+            if (indexed) {
+                index.set(static_cast<uint32_t>(i), random_energy(), now);
+            } else {
+                store.energy()[i] = random_energy();
+            }
+        }
+        if (indexed) {
+            if (below) {
+                index.next_to_activate(k, now, out);
+            } else {
+                index.top(k, now, out);
+            }
+            now++;
+        } else {
+            scan();
+        }
+        benchmark::DoNotOptimize(out.data());
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_EnergyQuery)->ArgsProduct({{0, 1}, {0, 1}});
+
+// 256 ancestor counts over a 1M-glyph merge DAG (64K roots, parents drawn
+// uniformly from all earlier glyphs, ~40 ancestors each), one bit-parallel ancestor_counts() call
+// vs one ancestors() BFS per source. Half the glyphs are added before a
+// compact(), so queries walk both the CSR block and the linked edges.
+// Both sides are checked against each other before timing.
+void BM_ProvenanceCounts(benchmark::State& state) {
+    using Handle = ProvenanceGraph::Handle;
+    const bool batched = state.range(0) != 0;
+    const size_t glyphs = 1 << 20;
+    const size_t roots = 1 << 16;
+    const size_t sources = 256;
+
+    ProvenanceGraph graph;
+    SplitMix64 rng(11);
+    std::vector<GlyphId> ids(glyphs);
+    for (size_t i = 0; i < glyphs; i++) {
+        const uint64_t key = i;
+        content_hash(reinterpret_cast<const char*>(&key), sizeof(key), ids[i]);
+        GlyphId p1{}, p2{};
+        if (i >= roots) {
+            p1 = ids[rng.next() % i];
+            p2 = ids[rng.next() % i];
+        }
+        graph.add(ids[i], p1, p2);
+        if (i == glyphs / 2) {
+            graph.compact();
+        }
+    }
+
+    std::vector<Handle> handles(sources);
+    for (Handle& h : handles) {
+        h = static_cast<Handle>(glyphs - 1 - rng.next() % (glyphs / 2));
+    }
+    std::vector<uint64_t> counts(sources);
+    graph.ancestor_counts(handles.data(), sources, counts.data());
+    for (size_t i = 0; i < sources; i++) {
+        if (counts[i] != graph.ancestors(handles[i]).size()) {
+            state.SkipWithError("ancestor_counts() disagrees with ancestors()");
+            return;
+        }
+    }
+
+    for (auto _ : state) {
+        if (batched) {
+            graph.ancestor_counts(handles.data(), sources, counts.data());
+        } else {
+            for (size_t i = 0; i < sources; i++) {
+                counts[i] = graph.ancestors(handles[i]).size();
+            }
+        }
+        benchmark::DoNotOptimize(counts.data());
+    }
+    state.SetItemsProcessed(state.iterations() * sources);
+}
+BENCHMARK(BM_ProvenanceCounts)->Arg(0)->Arg(1);
+
+// Producers push their share of a batch through the queue; the stage merges it
+void BM_MergeStage(benchmark::State& state) {
+    const size_t producers = static_cast<size_t>(state.range(0));
+    const size_t pool_size = 1 << 16;
+    const size_t batch = 1 << 16;
+
+    ContentArena pool_arena;
+    std::vector<Glyph> glyphs;
+    make_glyphs(pool_size, 4, 20, 5, glyphs, pool_arena);
+    GlyphStore in = GlyphStore::from_glyphs(glyphs.data(), glyphs.size());
+    std::vector<MergePair> pairs = make_pairs(batch, pool_size, 9);
+
+    std::atomic<size_t> merged{0};
+    MergeStage stage(in, [&](const MergeRequest*, const GlyphStore&, size_t n) {
+        merged.fetch_add(n, std::memory_order_release);
+    });
+
+    for (auto _ : state) {
+        merged.store(0);
+        std::vector<std::thread> threads;
+        for (size_t p = 0; p < producers; p++) {
+            threads.emplace_back([&, p] {
+                for (size_t i = p; i < batch; i += producers) {
+                    stage.push(pairs[i], i);
+                }
+            });
+        }
+        for (std::thread& t : threads) {
+            t.join();
+        }
+        while (merged.load(std::memory_order_acquire) < batch) {
+            std::this_thread::yield();
+        }
+    }
+    MergeStage::Stats stats = stage.stats();
+    state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(batch));
+    state.counters["mean_batch"] = stats.mean_batch();
+    state.counters["p99_latency_us"] = static_cast<double>(stats.latency_quantile_ns(0.99)) / 1e3;
+}
+BENCHMARK(BM_MergeStage)->RangeMultiplier(2)->Range(1, 8)->UseRealTime();
+
+// 32 batches of 4096 pairs; threads = merge_batch() pool size, or the pipeline's hash pool
+void BM_MergePipeline(benchmark::State& state) {
+    const bool staged = state.range(0) != 0;
+    const size_t threads = static_cast<size_t>(state.range(1));
+    const size_t pool_size = 1 << 16;
+    const size_t batch = 4096;
+    const size_t batches = 32;
+
+    ContentArena pool_arena;
+    std::vector<Glyph> glyphs;
+    make_glyphs(pool_size, 4, 20, 5, glyphs, pool_arena);
+    GlyphStore in = GlyphStore::from_glyphs(glyphs.data(), glyphs.size());
+    std::vector<MergePair> pairs = make_pairs(batch * batches, pool_size, 10);
+    ThreadPool pool(threads);
+
+    double published = 0.0;  // Per-batch sink work: touch every result
+    auto sink = [&](uint64_t, const GlyphStore& results) {
+        published += results.energy()[results.size() - 1];
+    };
+
+    if (!staged) {
+        GlyphStore results;
+        for (auto _ : state) {
+            for (size_t b = 0; b < batches; b++) {
+                results.clear();
+                merge_batch(in, pairs.data() + b * batch, batch, results, &pool);
+                sink(b, results);
+            }
+        }
+    } else {
+        PipelineOptions options;
+        options.hash_pool = &pool;
+        MergePipeline pipeline(in, sink, options);
+        for (auto _ : state) {
+            for (size_t b = 0; b < batches; b++) {
+                pipeline.submit(pairs.data() + b * batch, batch, b);
+            }
+            pipeline.drain();
+        }
+        MergePipeline::Stats stats = pipeline.stats();
+        double busy = double(stats.build_ns + stats.hash_ns + stats.publish_ns);
+        state.counters["build_share"] = busy > 0 ? double(stats.build_ns) / busy : 0.0;
+        state.counters["hash_share"] = busy > 0 ? double(stats.hash_ns) / busy : 0.0;
+    }
+    benchmark::DoNotOptimize(published);
+    state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(batch * batches));
+    state.counters["threads"] = static_cast<double>(threads);
+}
+BENCHMARK(BM_MergePipeline)->ArgsProduct({{0, 1}, {1, 2, 4, 8}})->UseRealTime();
+
+// Descriptor packing, device thread and unpacking; overlap needs >= 2 slots
+void BM_FpgaEmulated(benchmark::State& state) {
+    const size_t buffers = static_cast<size_t>(state.range(0));
+    const size_t pool_size = 1 << 16;
+    const size_t batch = 1 << 14;
+
+    ContentArena pool_arena;
+    std::vector<Glyph> glyphs;
+    make_glyphs(pool_size, 4, 20, 5, glyphs, pool_arena);
+    GlyphStore in = GlyphStore::from_glyphs(glyphs.data(), glyphs.size());
+    std::vector<MergePair> pairs = make_pairs(batch, pool_size, 9);
+
+    FpgaMergeBackend backend(open_emulated_device(), FpgaMergeBackend::kDefaultBatch, buffers);
+    GlyphStore out;
+    out.reserve(batch, batch * 48);
+    for (auto _ : state) {
+        out.clear();
+        backend.merge_batch(in, pairs.data(), pairs.size(), out);
+        benchmark::DoNotOptimize(out.energy());
+    }
+    state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(batch));
+}
+BENCHMARK(BM_FpgaEmulated)->Arg(1)->Arg(2)->UseRealTime();
+
+// Cascade: each merge result absorbs one more leaf (higher energy, so it stays primary)
+void BM_MergeChain(benchmark::State& state) {
+    const size_t depth = static_cast<size_t>(state.range(0));
+    const ContentMode mode = state.range(1) ? ContentMode::kLazy : ContentMode::kFlat;
+
+    ContentArena leaf_arena;
+    std::vector<Glyph> leaves;
+    make_glyphs(depth + 1, 8, 32, 7, leaves, leaf_arena);
+    for (Glyph& g : leaves) {
+        g.energy = 1.0;
+    }
+    std::vector<Glyph> chain(depth + 1);
+    ContentArena arena;
+
+    perf_reset();
+    for (auto _ : state) {
+        arena.reset();
+        chain[0] = leaves[0];
+        for (size_t i = 1; i <= depth; i++) {
+            merge(chain[i - 1], leaves[i], chain[i], arena, mode);
+        }
+        benchmark::DoNotOptimize(chain[depth].id.bytes);
+    }
+    state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(depth));
+    report_perf(state);
+    state.SetLabel(mode == ContentMode::kLazy ? "lazy" : "flat");
+}
+BENCHMARK(BM_MergeChain)->ArgsProduct({{64, 512}, {0, 1}});
+
+// Repeated merges: successive 1024-pair batches drawn from `distinct` pairs
+// (64K-entry cache, so the larger sets also exercise eviction)
+void BM_MergeCached(benchmark::State& state) {
+    const size_t distinct = static_cast<size_t>(state.range(0));
+    const size_t pool_size = 4096;
+    const size_t batch = 1024;
+
+    ContentArena pool_arena;
+    std::vector<Glyph> pool;
+    make_glyphs(pool_size, 8, 32, 8, pool, pool_arena);
+    std::vector<MergePair> uniq = make_pairs(distinct, pool_size, 9);
+    std::vector<MergePair> stream(std::max<size_t>(4 * distinct, 64 * batch));
+    SplitMix64 rng(10);
+    for (MergePair& p : stream) {
+        p = uniq[rng.next() % distinct];
+    }
+    std::vector<Glyph> out(batch);
+    ContentArena arena(batch_arena_size(batch, 32));
+    MergeCache cache;
+
+    size_t offset = 0;
+    perf_reset();
+    for (auto _ : state) {
+        arena.reset();
+        merge_batch(pool.data(), stream.data() + offset, out.data(), batch, arena, cache);
+        offset = (offset + batch) % (stream.size() - batch + 1);
+        benchmark::DoNotOptimize(out.data());
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(batch));
+    MergeCache::Stats stats = cache.stats();
+    state.counters["hit_rate"] = static_cast<double>(stats.hits) /
+                                 static_cast<double>(std::max<uint64_t>(stats.hits + stats.misses, 1));
+    report_perf(state);
+}
+BENCHMARK(BM_MergeCached)->RangeMultiplier(16)->Range(64, 1 << 18);
+
+// BM_MergeBatch/1024 under a specific hash backend
+void BM_MergeHash(benchmark::State& state, const char* backend) {
+    std::string previous = hash_backend().name;
+    set_hash_backend(backend);
+    BM_MergeBatch(state);
+    set_hash_backend(previous.c_str());
+}
+
+// Cost of one record on the calling thread; every caller pays it once per batch / call
+void BM_Telemetry(benchmark::State& state) {
+    const bool timed = state.range(0) != 0;
+    uint64_t v = 0;
+    for (auto _ : state) {
+        if (timed) {
+            TelemetryTimer timer(kHistTickNs);
+        } else {
+            telemetry_record(kHistMergeBatchSize, ++v & 4095);
+        }
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_Telemetry)->Arg(0)->Arg(1);
+
+} // namespace
+
+int main(int argc, char** argv) {
+    for (size_t i = 0; i < spu::hash_backend_count(); i++) {
+        const char* name = spu::hash_backend_at(i).name;
+        benchmark::RegisterBenchmark((std::string("BM_MergeHash/") + name).c_str(),
+                                     BM_MergeHash, name)
+            ->Arg(1024);
+    }
+
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv)) {
+        return 1;
+    }
+    benchmark::AddCustomContext("hash_backend", spu::hash_backend().name);
+    benchmark::AddCustomContext("dynamics_kernel", spu::DynamicsEngine::kernel_name());
+    benchmark::AddCustomContext("sizeof_glyph", std::to_string(sizeof(spu::Glyph)));
+    benchmark::AddCustomContext("perf_counters", spu::perf_source());
+    benchmark::AddCustomContext("telemetry", spu::telemetry_enabled() ? "on" : "off");
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
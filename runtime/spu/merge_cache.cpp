@@ -0,0 +1,233 @@
+/**
+ * SPU Merge Cache - Bounded memo of merge results
+ */
+
+#include "merge_cache.h"
+#include "telemetry.h"
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+namespace spu {
+
+size_t MergeCache::KeyHash::operator()(const Key& k) const {
+    // IDs are uniformly distributed; mix the two so (a, b) != (b, a)
+    uint64_t a, b;
+    memcpy(&a, k.primary.bytes, sizeof(a));
+    memcpy(&b, k.secondary.bytes, sizeof(b));
+    return static_cast<size_t>(a ^ (b * 0x9e3779b97f4a7c15ULL));
+}
+
+MergeCache::MergeCache(size_t capacity, size_t shards) {
+    shards = std::max<size_t>(shards, 1);
+    shard_capacity_ = std::max<size_t>((capacity + shards - 1) / shards, 1);
+    shards_.reserve(shards);
+    size_t table_size = 2;
+    while (table_size < 2 * shard_capacity_) {
+        table_size *= 2;
+    }
+    for (size_t i = 0; i < shards; i++) {
+        shards_.emplace_back(new Shard());
+        shards_.back()->slots.reserve(shard_capacity_);
+        shards_.back()->table.assign(table_size, 0);
+        shards_.back()->mask = table_size - 1;
+    }
+}
+
+size_t MergeCache::find(const Shard& shard, const Key& key, size_t hash) {
+    const uint64_t tag = static_cast<uint32_t>(hash);
+    for (size_t i = hash & shard.mask;; i = (i + 1) & shard.mask) {
+        uint64_t e = shard.table[i];
+        if (e == 0) {
+            return std::numeric_limits<size_t>::max();
+        }
+        if ((e >> 32) == tag && shard.slots[(e & 0xffffffffu) - 1].key == key) {
+            return i;
+        }
+    }
+}
+
+void MergeCache::erase_at(Shard& shard, size_t pos) {
+    // Backward-shift deletion keeps probe sequences unbroken (no tombstones)
+    size_t hole = pos;
+    for (size_t i = (hole + 1) & shard.mask;; i = (i + 1) & shard.mask) {
+        uint64_t e = shard.table[i];
+        if (e == 0) {
+            break;
+        }
+        size_t home = (e >> 32) & shard.mask;
+        if (((i - home) & shard.mask) >= ((i - hole) & shard.mask)) {
+            shard.table[hole] = e;
+            hole = i;
+        }
+    }
+    shard.table[hole] = 0;
+}
+
+MergeCache::Shard& MergeCache::shard_for(size_t hash) {
+    // High bits pick the shard; low bits index the shard's table
+    return *shards_[(hash >> 48) % shards_.size()];
+}
+
+bool MergeCache::lookup(const GlyphId& primary, const GlyphId& secondary, Glyph& result,
+                        ContentArena& arena) {
+    Key key{primary, secondary};
+    size_t hash = KeyHash()(key);
+    Shard& shard = shard_for(hash);
+
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    size_t pos = find(shard, key, hash);
+    if (pos == std::numeric_limits<size_t>::max()) {
+        shard.misses++;
+        SPU_TELEMETRY_ADD(kCountMergeCacheMisses, 1);
+        return false;
+    }
+    Slot& slot = shard.slots[(shard.table[pos] & 0xffffffffu) - 1];
+    slot.referenced = true;
+    shard.hits++;
+    SPU_TELEMETRY_ADD(kCountMergeCacheHits, 1);
+
+    // Copy out under the lock: the slot may be evicted once it is released
+    result.id = slot.id;
+    result.content.assign(slot.content.data(), slot.content.size(), arena);
+    return true;
+}
+
+void MergeCache::insert(const GlyphId& primary, const GlyphId& secondary, const Glyph& result) {
+    Key key{primary, secondary};
+    size_t hash = KeyHash()(key);
+    Shard& shard = shard_for(hash);
+
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    if (find(shard, key, hash) != std::numeric_limits<size_t>::max()) {
+        return;  // Deterministic: an existing entry is already correct
+    }
+
+    size_t victim;
+    if (shard.slots.size() < shard_capacity_) {
+        victim = shard.slots.size();
+        shard.slots.push_back(Slot());
+    } else {
+        // CLOCK: give referenced slots a second chance
+        for (;;) {
+            Slot& s = shard.slots[shard.hand];
+            if (!s.referenced) {
+                break;
+            }
+            s.referenced = false;
+            shard.hand = (shard.hand + 1) % shard.slots.size();
+        }
+        victim = shard.hand;
+        shard.hand = (shard.hand + 1) % shard.slots.size();
+        const Key& old = shard.slots[victim].key;
+        erase_at(shard, find(shard, old, KeyHash()(old)));
+        shard.evictions++;
+    }
+
+    Slot& slot = shard.slots[victim];
+    slot.key = key;
+    slot.id = result.id;
+    slot.content.resize(result.content.size());  // Reuses the evicted entry's buffer
+    result.content.copy_to(&slot.content[0]);
+    slot.referenced = false;
+    size_t i = hash & shard.mask;
+    while (shard.table[i] != 0) {
+        i = (i + 1) & shard.mask;
+    }
+    shard.table[i] = (uint64_t(static_cast<uint32_t>(hash)) << 32) | (victim + 1);
+    shard.insertions++;
+}
+
+MergeCache::Stats MergeCache::stats() const {
+    Stats s{0, 0, 0, 0, 0};
+    for (const auto& shard : shards_) {
+        std::lock_guard<std::mutex> lock(shard->mutex);
+        s.hits += shard->hits;
+        s.misses += shard->misses;
+        s.insertions += shard->insertions;
+        s.evictions += shard->evictions;
+        s.size += shard->slots.size();
+    }
+    return s;
+}
+
+void MergeCache::clear() {
+    for (auto& shard : shards_) {
+        std::lock_guard<std::mutex> lock(shard->mutex);
+        shard->slots.clear();
+        std::fill(shard->table.begin(), shard->table.end(), 0);
+        shard->hand = 0;
+        shard->hits = shard->misses = shard->insertions = shard->evictions = 0;
+    }
+}
+
+/**
+ * Steps 4-6 of merge() for a cache hit
+ */
+static inline void merge_numeric(const Glyph& primary, const Glyph& secondary, Glyph& result) {
+    result.energy = primary.energy + secondary.energy;
+    result.activation_count = std::max(primary.activation_count, secondary.activation_count);
+    result.last_update_time = std::max(primary.last_update_time, secondary.last_update_time);
+    result.parent1_id = primary.id;
+    result.parent2_id = secondary.id;
+}
+
+static inline bool cacheable(const Glyph& a, const Glyph& b) {
+    return !a.id.is_zero() && !b.id.is_zero();
+}
+
+void merge(const Glyph& g1, const Glyph& g2, Glyph& result, ContentArena& arena,
+           MergeCache& cache) {
+    const bool first_wins = g1.energy >= g2.energy;
+    const Glyph& primary = first_wins ? g1 : g2;
+    const Glyph& secondary = first_wins ? g2 : g1;
+
+    if (!cacheable(primary, secondary)) {
+        merge(g1, g2, result, arena);
+        return;
+    }
+    if (cache.lookup(primary.id, secondary.id, result, arena)) {
+        merge_numeric(primary, secondary, result);
+        return;
+    }
+    merge(g1, g2, result, arena);
+    cache.insert(primary.id, secondary.id, result);
+}
+
+void merge_batch(const Glyph* pool, const MergePair* pairs, Glyph* out, size_t n,
+                 ContentArena& arena, MergeCache& cache) {
+    std::vector<MergePair> miss_pairs;
+    std::vector<size_t> miss_index;
+
+    for (size_t i = 0; i < n; i++) {
+        const Glyph& g1 = pool[pairs[i].first];
+        const Glyph& g2 = pool[pairs[i].second];
+        const bool first_wins = g1.energy >= g2.energy;
+        const Glyph& primary = first_wins ? g1 : g2;
+        const Glyph& secondary = first_wins ? g2 : g1;
+
+        if (cacheable(primary, secondary) &&
+            cache.lookup(primary.id, secondary.id, out[i], arena)) {
+            merge_numeric(primary, secondary, out[i]);
+        } else {
+            miss_pairs.push_back(pairs[i]);
+            miss_index.push_back(i);
+        }
+    }
+    if (miss_pairs.empty()) {
+        return;
+    }
+
+    std::vector<Glyph> merged(miss_pairs.size());
+    merge_batch(pool, miss_pairs.data(), merged.data(), merged.size(), arena);
+
+    for (size_t k = 0; k < merged.size(); k++) {
+        const Glyph& r = merged[k];
+        if (cacheable(pool[miss_pairs[k].first], pool[miss_pairs[k].second])) {
+            cache.insert(r.parent1_id, r.parent2_id, r);
+        }
+        out[miss_index[k]] = r;
+    }
+}
+
+} // namespace spu
@@ -0,0 +1,141 @@
+/**
+ * SPU Merge Cache - Bounded memo of merge results
+ *
+ * Merged content and ID depend only on the parents' content in precedence
+ * order, and the parents' IDs are content hashes, so (primary ID,
+ * secondary ID) identifies a merge result. A hit copies the cached content
+ * and ID and recomputes only the numeric fields (energy sum, max metadata,
+ * provenance), skipping the concatenation and the hash.
+ *
+ * The cache is split into independently locked shards, each with CLOCK
+ * (second-chance) eviction. Glyphs without an ID (zero GlyphId) are never
+ * cached. Only use the cache when glyph IDs are content hashes.
+ */
+
+#ifndef SPU_MERGE_CACHE_H
+#define SPU_MERGE_CACHE_H
+
+#include "merge_ref.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace spu {
+
+class MergeCache {
+public:
+    static constexpr size_t kDefaultCapacity = 64 * 1024;
+    static constexpr size_t kDefaultShards = 16;
+
+    struct Stats {
+        uint64_t hits;
+        uint64_t misses;
+        uint64_t insertions;
+        uint64_t evictions;
+        size_t size;
+    };
+
+    /**
+     * @param capacity Maximum cached results (split evenly across shards)
+     * @param shards Number of independently locked shards
+     */
+    explicit MergeCache(size_t capacity = kDefaultCapacity, size_t shards = kDefaultShards);
+
+    MergeCache(const MergeCache&) = delete;
+    MergeCache& operator=(const MergeCache&) = delete;
+
+    /**
+     * Look up the merge of primary and secondary (in precedence order)
+     *
+     * On a hit, sets result.id and copies the content into result (inline
+     * or arena); other fields are left to the caller.
+     *
+     * @return true on a hit
+     */
+    bool lookup(const GlyphId& primary, const GlyphId& secondary, Glyph& result,
+                ContentArena& arena);
+
+    /**
+     * Record the content and ID of a merge result
+     */
+    void insert(const GlyphId& primary, const GlyphId& secondary, const Glyph& result);
+
+    // Counters and current size, summed over shards
+    Stats stats() const;
+
+    // Drop every entry and zero the counters
+    void clear();
+
+    size_t capacity() const { return shard_capacity_ * shards_.size(); }
+
+private:
+    struct Key {
+        GlyphId primary;
+        GlyphId secondary;
+
+        bool operator==(const Key& o) const {
+            return primary == o.primary && secondary == o.secondary;
+        }
+    };
+
+    struct KeyHash {
+        size_t operator()(const Key& k) const;
+    };
+
+    struct Slot {
+        Key key;
+        GlyphId id;
+        std::string content;
+        bool referenced;  // CLOCK bit: set on hit, cleared as the hand passes
+    };
+
+    struct Shard {
+        mutable std::mutex mutex;
+        std::vector<Slot> slots;
+
+        // Open-addressing index (linear probing, power-of-two size, <= 50% full).
+        // Entry = (low 32 hash bits << 32) | (slot + 1); 0 = empty.
+        std::vector<uint64_t> table;
+        size_t mask = 0;
+
+        size_t hand = 0;
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t insertions = 0;
+        uint64_t evictions = 0;
+    };
+
+    Shard& shard_for(size_t hash);
+
+    // Table position holding key, or SIZE_MAX
+    static size_t find(const Shard& shard, const Key& key, size_t hash);
+    static void erase_at(Shard& shard, size_t pos);
+
+    size_t shard_capacity_;
+    std::vector<std::unique_ptr<Shard>> shards_;
+};
+
+/**
+ * merge() with a result cache in front
+ *
+ * Same result as merge(g1, g2, result, arena) (flat content).
+ */
+void merge(const Glyph& g1, const Glyph& g2, Glyph& result, ContentArena& arena,
+           MergeCache& cache);
+
+/**
+ * Index-pair merge_batch() with a result cache in front
+ *
+ * Misses are merged together as one batch (keeping multi-lane hashing),
+ * then inserted.
+ */
+void merge_batch(const Glyph* pool, const MergePair* pairs, Glyph* out, size_t n,
+                 ContentArena& arena, MergeCache& cache);
+
+} // namespace spu
+
+#endif // SPU_MERGE_CACHE_H
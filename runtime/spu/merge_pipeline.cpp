@@ -0,0 +1,221 @@
+/**
+ * SPU Merge Pipeline - Staged, overlapped merge of a stream of batches
+ */
+
+#include "merge_pipeline.h"
+#include <chrono>
+#include <stdexcept>
+
+namespace spu {
+
+namespace {
+
+uint64_t now_ns() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                     std::chrono::steady_clock::now().time_since_epoch())
+                                     .count());
+}
+
+// Spin, then yield, then sleep: cheap when the wait is short, idle when long
+void back_off(unsigned& round) {
+    if (round < 64) {
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_ia32_pause();
+#endif
+    } else if (round < 128) {
+        std::this_thread::yield();
+    } else {
+        std::this_thread::sleep_for(std::chrono::microseconds(50));
+    }
+    round++;
+}
+
+size_t checked_slots(size_t slots) {
+    if (slots < 2) {
+        throw std::invalid_argument("MergePipeline needs at least 2 slots");
+    }
+    return slots;
+}
+
+} // namespace
+
+MergePipeline::MergePipeline(const GlyphStore& in, Sink sink, const PipelineOptions& options)
+    : in_(in), sink_(std::move(sink)), options_(options), slots_(checked_slots(options.slots)),
+      free_(options.slots), submitted_(options.slots), built_(options.slots),
+      hashed_(options.slots) {
+    for (size_t i = 0; i < slots_.size(); i++) {
+        free_.try_push(static_cast<uint32_t>(i));
+    }
+
+    build_thread_ = std::thread([this] {
+        MergeOptions merge;
+        merge.hash = false;
+        merge.provenance = options_.provenance;
+        run_stage(submitted_, [this] { return stopping_.load() && producers_.load() == 0; },
+                  built_, build_ns_, [&](Slot& slot) {
+                      slot.results.clear();
+                      merge_batch(in_, slot.pairs.data(), slot.pairs.size(), slot.results, merge,
+                                  options_.build_pool);
+                  });
+        build_done_.store(true);
+    });
+    hash_thread_ = std::thread([this] {
+        run_stage(built_, [this] { return build_done_.load(); }, hashed_, hash_ns_,
+                  [this](Slot& slot) {
+                      if (options_.hash) {
+                          slot.results.hash_ids(0, slot.results.size(), options_.hash_pool);
+                      }
+                  });
+        hash_done_.store(true);
+    });
+    publish_thread_ = std::thread([this] {
+        run_stage(hashed_, [this] { return hash_done_.load(); }, free_, publish_ns_,
+                  [this](Slot& slot) {
+                      sink_(slot.tag, slot.results);
+                      merged_.fetch_add(slot.pairs.size(), std::memory_order_relaxed);
+                      published_.fetch_add(1);
+                  });
+    });
+}
+
+MergePipeline::~MergePipeline() {
+    try {
+        stop();
+    } catch (...) {
+    }
+}
+
+/**
+ * Move slots from one queue to the next through work until the upstream
+ * stage is done and from is empty (or any stage has failed)
+ */
+template <typename UpstreamDone, typename Work>
+void MergePipeline::run_stage(MpmcQueue<uint32_t>& from, UpstreamDone upstream_done,
+                              MpmcQueue<uint32_t>& to, std::atomic<uint64_t>& busy_ns, Work work) {
+    unsigned round = 0;
+    for (;;) {
+        if (failed_.load()) {
+            return;
+        }
+        uint32_t slot;
+        if (!from.try_pop(slot)) {
+            // Upstream pushes its last slot before it reports done
+            if (!upstream_done()) {
+                back_off(round);
+                continue;
+            }
+            if (!from.try_pop(slot)) {
+                return;
+            }
+        }
+        round = 0;
+
+        uint64_t start = now_ns();
+        try {
+            work(slots_[slot]);
+        } catch (...) {
+            fail(std::current_exception());
+            return;
+        }
+        busy_ns.fetch_add(now_ns() - start, std::memory_order_relaxed);
+        // Never full: every queue holds all the slots
+        to.try_push(slot);
+    }
+}
+
+bool MergePipeline::submit(const MergePair* pairs, size_t n, uint64_t tag) {
+    for (size_t i = 0; i < n; i++) {
+        if (pairs[i].first >= in_.size() || pairs[i].second >= in_.size()) {
+            throw std::out_of_range("MergePipeline: merge pair index out of range");
+        }
+    }
+    // Registered before the check, so the build stage cannot exit under us
+    producers_.fetch_add(1);
+    if (stopping_.load()) {
+        producers_.fetch_sub(1);
+        return false;
+    }
+    uint32_t index;
+    if (!free_.try_pop(index)) {
+        full_waits_.fetch_add(1, std::memory_order_relaxed);
+        unsigned round = 0;
+        do {
+            if (failed_.load()) {  // The stages stopped and will not free a slot
+                producers_.fetch_sub(1);
+                return false;
+            }
+            back_off(round);
+        } while (!free_.try_pop(index));
+    }
+    Slot& slot = slots_[index];
+    slot.pairs.assign(pairs, pairs + n);
+    slot.tag = tag;
+    submitted_count_.fetch_add(1);
+    submitted_.try_push(index);
+    producers_.fetch_sub(1);
+    return true;
+}
+
+void MergePipeline::fail(std::exception_ptr error) {
+    {
+        std::lock_guard<std::mutex> lock(error_mutex_);
+        if (!error_) {
+            error_ = error;
+        }
+    }
+    stopping_.store(true);
+    failed_.store(true);
+}
+
+void MergePipeline::rethrow() {
+    std::exception_ptr error;
+    {
+        std::lock_guard<std::mutex> lock(error_mutex_);
+        error = error_;
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+void MergePipeline::drain() {
+    const uint64_t target = submitted_count_.load();
+    unsigned round = 0;
+    while (published_.load() < target && !failed_.load()) {
+        back_off(round);
+    }
+    rethrow();
+}
+
+void MergePipeline::stop() {
+    stopping_.store(true);
+    std::lock_guard<std::mutex> lock(stop_mutex_);
+    for (std::thread* t : {&build_thread_, &hash_thread_, &publish_thread_}) {
+        if (t->joinable()) {
+            t->join();
+        }
+    }
+    std::exception_ptr error;
+    {
+        std::lock_guard<std::mutex> lock(error_mutex_);
+        error = error_;
+        error_ = nullptr;
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+MergePipeline::Stats MergePipeline::stats() const {
+    Stats s{};
+    s.submitted = submitted_count_.load(std::memory_order_relaxed);
+    s.published = published_.load(std::memory_order_relaxed);
+    s.merged = merged_.load(std::memory_order_relaxed);
+    s.full_waits = full_waits_.load(std::memory_order_relaxed);
+    s.build_ns = build_ns_.load(std::memory_order_relaxed);
+    s.hash_ns = hash_ns_.load(std::memory_order_relaxed);
+    s.publish_ns = publish_ns_.load(std::memory_order_relaxed);
+    return s;
+}
+
+} // namespace spu
@@ -0,0 +1,173 @@
+/**
+ * SPU Merge Pipeline - Staged, overlapped merge of a stream of batches
+ *
+ * merge_batch() runs every merge step on one batch before the next batch
+ * starts. The pipeline splits the steps into three stages, each on its own
+ * thread, connected by bounded queues of batch slots:
+ *
+ *   build    gather the pairs, then precedence, content, metadata and
+ *            provenance (merge_batch() with MergeOptions::hash = false)
+ *   hash     GlyphStore::hash_ids() on the hash pool (~85% of the work)
+ *   publish  the sink, in submission order (store, index, persistence)
+ *
+ * While batch N is hashed, batch N + 1 is built and batch N - 1 is
+ * published. The same slot rotation as the FPGA backend's DMA buffers:
+ * `slots` bounds the batches in flight (3 keeps every stage busy, one more
+ * absorbs jitter), and submit() waits for a free slot, so a slow sink
+ * throttles producers. Give the hash stage the most threads: throughput is
+ * set by the slowest stage, and hashing is the only one that is not cheap.
+ *
+ *   spu::ThreadPool hash_threads(6);
+ *   spu::PipelineOptions options;
+ *   options.hash_pool = &hash_threads;
+ *   spu::MergePipeline pipeline(store, [&](uint64_t tag, const spu::GlyphStore& results) {
+ *       index.add(results);                       // publish thread
+ *   }, options);
+ *   pipeline.submit(pairs, n, tag);               // any thread
+ *   pipeline.stop();                              // publishes what is in flight
+ *
+ * Results are identical to merge_batch(). The source store must not be
+ * modified while batches are in flight.
+ */
+
+#ifndef SPU_MERGE_PIPELINE_H
+#define SPU_MERGE_PIPELINE_H
+
+#include "glyph_store.h"
+#include "mpmc_queue.h"
+#include "thread_pool.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace spu {
+
+struct PipelineOptions {
+    size_t slots = 4;                  // Batches in flight (at least 2)
+    bool hash = true;                  // false: the hash stage passes batches through (zero IDs)
+    bool provenance = true;            // false: result parent IDs are zero
+    ThreadPool* build_pool = nullptr;  // Threads for the build stage (nullptr = its thread only)
+    ThreadPool* hash_pool = nullptr;   // Threads for the hash stage (nullptr = its thread only)
+};
+
+class MergePipeline {
+public:
+    /**
+     * Called on the publish thread for every batch, in submission order
+     *
+     * results[i] is the merge of the batch's pairs[i]; the store is reused
+     * once the sink returns.
+     */
+    using Sink = std::function<void(uint64_t tag, const GlyphStore& results)>;
+
+    struct Stats {
+        uint64_t submitted;   // Batches accepted
+        uint64_t published;   // Batches handed to the sink
+        uint64_t merged;      // Pairs handed to the sink
+        uint64_t full_waits;  // submit() calls that waited for a free slot
+        // Time each stage spent on batches (not waiting)
+        uint64_t build_ns;
+        uint64_t hash_ns;
+        uint64_t publish_ns;
+    };
+
+    /**
+     * Start the stage threads
+     *
+     * @param in Store the pair indices refer to
+     * @param sink Receives every merged batch
+     * @throws std::invalid_argument if options.slots < 2
+     */
+    MergePipeline(const GlyphStore& in, Sink sink, const PipelineOptions& options = PipelineOptions());
+
+    // stop()s the pipeline; an exception from a stage is dropped
+    ~MergePipeline();
+
+    MergePipeline(const MergePipeline&) = delete;
+    MergePipeline& operator=(const MergePipeline&) = delete;
+
+    /**
+     * Queue a batch (pairs are copied), waiting while every slot is in flight
+     *
+     * Safe from any number of threads; batches are published in the order
+     * they were queued (for one thread, the order of its submit() calls).
+     *
+     * @return false once stop() has begun, or if a stage stopped at an error
+     * @throws std::out_of_range if an index is past the source store
+     */
+    bool submit(const MergePair* pairs, size_t n, uint64_t tag = 0);
+
+    /**
+     * Wait until every batch submitted so far has been published
+     *
+     * @throws The first exception thrown by a stage
+     */
+    void drain();
+
+    /**
+     * Refuse new batches, publish everything in flight, join the stages
+     *
+     * @throws The first exception thrown by a stage (the pipeline stops at it)
+     */
+    void stop();
+
+    size_t slots() const { return slots_.size(); }
+    size_t in_flight() const { return slots_.size() - free_.size(); }
+
+    Stats stats() const;
+
+private:
+    struct Slot {
+        std::vector<MergePair> pairs;
+        GlyphStore results;
+        uint64_t tag = 0;
+    };
+
+    template <typename UpstreamDone, typename Work>
+    void run_stage(MpmcQueue<uint32_t>& from, UpstreamDone upstream_done, MpmcQueue<uint32_t>& to,
+                   std::atomic<uint64_t>& busy_ns, Work work);
+    void fail(std::exception_ptr error);
+    void rethrow();
+
+    const GlyphStore& in_;
+    Sink sink_;
+    PipelineOptions options_;
+
+    std::vector<Slot> slots_;
+    // Every slot index is in exactly one queue (or owned by one stage)
+    MpmcQueue<uint32_t> free_;
+    MpmcQueue<uint32_t> submitted_;
+    MpmcQueue<uint32_t> built_;
+    MpmcQueue<uint32_t> hashed_;
+
+    std::atomic<bool> stopping_{false};
+    std::atomic<bool> failed_{false};
+    std::atomic<size_t> producers_{0};  // submit() calls in progress
+    std::atomic<bool> build_done_{false};
+    std::atomic<bool> hash_done_{false};
+
+    std::atomic<uint64_t> submitted_count_{0};
+    std::atomic<uint64_t> published_{0};
+    std::atomic<uint64_t> merged_{0};
+    std::atomic<uint64_t> full_waits_{0};
+    std::atomic<uint64_t> build_ns_{0};
+    std::atomic<uint64_t> hash_ns_{0};
+    std::atomic<uint64_t> publish_ns_{0};
+
+    std::mutex error_mutex_;
+    std::exception_ptr error_;  // First stage error
+    std::mutex stop_mutex_;     // Serializes stop() callers
+    std::thread build_thread_;
+    std::thread hash_thread_;
+    std::thread publish_thread_;
+};
+
+} // namespace spu
+
+#endif // SPU_MERGE_PIPELINE_H
@@ -0,0 +1,205 @@
+/**
+ * SPU Merge Queue - Batched merge stage fed by many producers
+ */
+
+#include "merge_queue.h"
+#include "telemetry.h"
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+#include <vector>
+
+namespace spu {
+
+namespace {
+
+uint64_t now_ns() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                     std::chrono::steady_clock::now().time_since_epoch())
+                                     .count());
+}
+
+// Spin, then yield, then sleep: cheap when the wait is short, idle when long
+void back_off(unsigned& round) {
+    if (round < 64) {
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_ia32_pause();
+#endif
+    } else if (round < 128) {
+        std::this_thread::yield();
+    } else {
+        std::this_thread::sleep_for(std::chrono::microseconds(50));
+    }
+    round++;
+}
+
+void atomic_max(std::atomic<uint64_t>& target, uint64_t value) {
+    uint64_t seen = target.load(std::memory_order_relaxed);
+    while (value > seen && !target.compare_exchange_weak(seen, value, std::memory_order_relaxed)) {
+    }
+}
+
+} // namespace
+
+uint64_t MergeStage::Stats::latency_quantile_ns(double q) const {
+    if (merged == 0) {
+        return 0;
+    }
+    uint64_t rank = static_cast<uint64_t>(std::max(0.0, std::min(1.0, q)) * double(merged - 1)) + 1;
+    uint64_t seen = 0;
+    for (size_t b = 0; b < kLatencyBuckets; b++) {
+        seen += latency_log2[b];
+        if (seen >= rank) {
+            return b == 0 ? 0 : std::min(latency_max_ns, (uint64_t(1) << b) - 1);
+        }
+    }
+    return latency_max_ns;
+}
+
+MergeStage::MergeStage(const GlyphStore& in, Sink sink, size_t capacity, size_t max_batch,
+                       ThreadPool* pool)
+    : in_(in), sink_(std::move(sink)), max_batch_(std::max<size_t>(max_batch, 1)), pool_(pool),
+      queue_(capacity) {
+    thread_ = std::thread([this] { run(); });
+}
+
+MergeStage::~MergeStage() {
+    try {
+        stop();
+    } catch (...) {
+    }
+}
+
+bool MergeStage::enter(MergePair pair) {
+    if (pair.first >= in_.size() || pair.second >= in_.size()) {
+        throw std::out_of_range("MergeStage: merge pair index out of range");
+    }
+    // Registered before the check, so the stage cannot exit under us
+    producers_.fetch_add(1);
+    if (stopping_.load()) {
+        producers_.fetch_sub(1);
+        return false;
+    }
+    return true;
+}
+
+bool MergeStage::push(MergePair pair, uint64_t tag) {
+    if (!enter(pair)) {
+        return false;
+    }
+    MergeRequest req{pair, tag, now_ns()};
+    if (!queue_.try_push(req)) {
+        full_waits_.fetch_add(1, std::memory_order_relaxed);
+        unsigned round = 0;
+        do {
+            if (failed_.load()) {  // The stage stopped at a sink error and will not drain
+                producers_.fetch_sub(1);
+                return false;
+            }
+            back_off(round);
+        } while (!queue_.try_push(req));
+    }
+    pushed_.fetch_add(1, std::memory_order_relaxed);
+    producers_.fetch_sub(1);
+    return true;
+}
+
+bool MergeStage::try_push(MergePair pair, uint64_t tag) {
+    if (!enter(pair)) {
+        return false;
+    }
+    bool ok = queue_.try_push(MergeRequest{pair, tag, now_ns()});
+    (ok ? pushed_ : rejected_).fetch_add(1, std::memory_order_relaxed);
+    producers_.fetch_sub(1);
+    return ok;
+}
+
+void MergeStage::record(const MergeRequest* requests, size_t n) {
+    const uint64_t done = now_ns();
+    uint64_t sum = 0;
+    uint64_t worst = 0;
+    for (size_t i = 0; i < n; i++) {
+        uint64_t ns = done > requests[i].enqueue_ns ? done - requests[i].enqueue_ns : 0;
+        sum += ns;
+        worst = std::max(worst, ns);
+        size_t bucket = ns == 0 ? 0 : 64 - __builtin_clzll(ns);
+        latency_log2_[std::min(bucket, kLatencyBuckets - 1)].fetch_add(1, std::memory_order_relaxed);
+        SPU_TELEMETRY_RECORD(kHistMergeQueueWaitNs, ns);
+    }
+    latency_sum_ns_.fetch_add(sum, std::memory_order_relaxed);
+    atomic_max(latency_max_ns_, worst);
+    merged_.fetch_add(n, std::memory_order_relaxed);
+    batches_.fetch_add(1, std::memory_order_relaxed);
+}
+
+void MergeStage::run() {
+    std::vector<MergeRequest> requests(max_batch_);
+    std::vector<MergePair> pairs(max_batch_);
+    GlyphStore results;
+    unsigned round = 0;
+
+    for (;;) {
+        size_t queued = queue_.size();
+        if (queued > max_depth_.load(std::memory_order_relaxed)) {
+            max_depth_.store(queued, std::memory_order_relaxed);
+        }
+        size_t n = queue_.try_pop_batch(requests.data(), max_batch_);
+        if (n == 0) {
+            // Exit only once no producer can still add a request
+            if (stopping_.load() && producers_.load() == 0 && queue_.size() == 0) {
+                return;
+            }
+            back_off(round);
+            continue;
+        }
+        round = 0;
+        SPU_TELEMETRY_RECORD(kHistMergeQueueDepth, std::max(queued, n));
+
+        for (size_t i = 0; i < n; i++) {
+            pairs[i] = requests[i].pair;
+        }
+        results.clear();
+        try {
+            merge_batch(in_, pairs.data(), n, results, pool_);
+            sink_(requests.data(), results, n);
+        } catch (...) {
+            error_ = std::current_exception();  // Read by stop() after the join
+            stopping_.store(true);
+            failed_.store(true);
+            return;
+        }
+        record(requests.data(), n);
+    }
+}
+
+void MergeStage::stop() {
+    stopping_.store(true);
+    std::lock_guard<std::mutex> lock(stop_mutex_);
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+    if (error_) {
+        std::exception_ptr error = error_;
+        error_ = nullptr;
+        std::rethrow_exception(error);
+    }
+}
+
+MergeStage::Stats MergeStage::stats() const {
+    Stats s{};
+    s.pushed = pushed_.load(std::memory_order_relaxed);
+    s.rejected = rejected_.load(std::memory_order_relaxed);
+    s.full_waits = full_waits_.load(std::memory_order_relaxed);
+    s.merged = merged_.load(std::memory_order_relaxed);
+    s.batches = batches_.load(std::memory_order_relaxed);
+    s.depth = queue_.size();
+    s.max_depth = max_depth_.load(std::memory_order_relaxed);
+    s.latency_max_ns = latency_max_ns_.load(std::memory_order_relaxed);
+    s.latency_sum_ns = latency_sum_ns_.load(std::memory_order_relaxed);
+    for (size_t b = 0; b < kLatencyBuckets; b++) {
+        s.latency_log2[b] = latency_log2_[b].load(std::memory_order_relaxed);
+    }
+    return s;
+}
+
+} // namespace spu
@@ -0,0 +1,155 @@
+/**
+ * SPU Merge Queue - Batched merge stage fed by many producers
+ *
+ * Producers (fabric receive, ingest, dynamics-triggered merges) push index
+ * pairs into a bounded MpmcQueue instead of calling merge() inline. One
+ * stage thread drains whatever is queued, up to max_batch at a time, into
+ * merge_batch() and hands each batch of results to a sink. Under load the
+ * batches grow toward max_batch (size it for the backend: a few thousand
+ * for the CPU path, 256-4096 pairs per DMA transfer for the FPGA path);
+ * when idle a request is merged as soon as the stage sees it.
+ *
+ * A full queue applies backpressure: push() backs off (spin, yield, then
+ * sleep) until there is room; try_push() fails instead.
+ *
+ * The source store must not be modified while the stage runs.
+ */
+
+#ifndef SPU_MERGE_QUEUE_H
+#define SPU_MERGE_QUEUE_H
+
+#include "glyph_store.h"
+#include "mpmc_queue.h"
+#include "thread_pool.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+namespace spu {
+
+// Queued merge of in[pair.first] and in[pair.second]
+struct MergeRequest {
+    MergePair pair;
+    uint64_t tag;         // Caller cookie, handed back to the sink
+    uint64_t enqueue_ns;  // steady_clock, set by push()
+};
+
+class MergeStage {
+public:
+    static constexpr size_t kDefaultCapacity = 64 * 1024;
+    static constexpr size_t kDefaultMaxBatch = 4096;
+    static constexpr size_t kLatencyBuckets = 64;
+
+    /**
+     * Called on the stage thread after each batch
+     *
+     * results[i] (glyph i of the store) is the merge of requests[i]; the
+     * store is reused for the next batch.
+     */
+    using Sink = std::function<void(const MergeRequest* requests, const GlyphStore& results,
+                                    size_t n)>;
+
+    struct Stats {
+        uint64_t pushed;      // Requests accepted
+        uint64_t rejected;    // try_push() calls refused by a full queue
+        uint64_t full_waits;  // push() calls that had to wait for room
+        uint64_t merged;      // Requests merged and handed to the sink
+        uint64_t batches;
+        size_t depth;         // Requests queued now
+        size_t max_depth;     // Deepest queue seen by the stage
+        uint64_t latency_max_ns;   // push() to sink, worst request
+        uint64_t latency_sum_ns;
+        // Requests whose push-to-sink latency had bit length b (b = 0..63)
+        uint64_t latency_log2[kLatencyBuckets];
+
+        double mean_batch() const { return batches ? double(merged) / double(batches) : 0.0; }
+        double mean_latency_ns() const { return merged ? double(latency_sum_ns) / double(merged) : 0.0; }
+
+        /**
+         * Latency at quantile q (0..1), as the upper bound of its log2 bucket
+         */
+        uint64_t latency_quantile_ns(double q) const;
+    };
+
+    /**
+     * Start the stage thread
+     *
+     * @param in Store the request indices refer to
+     * @param sink Receives every merged batch
+     * @param capacity Queue capacity (rounded up to a power of two)
+     * @param max_batch Largest batch handed to merge_batch()
+     * @param pool Threads for each merge_batch() (nullptr = stage thread only)
+     */
+    MergeStage(const GlyphStore& in, Sink sink, size_t capacity = kDefaultCapacity,
+               size_t max_batch = kDefaultMaxBatch, ThreadPool* pool = nullptr);
+
+    // stop()s the stage; an exception from the sink is dropped
+    ~MergeStage();
+
+    MergeStage(const MergeStage&) = delete;
+    MergeStage& operator=(const MergeStage&) = delete;
+
+    /**
+     * Queue a merge, waiting while the queue is full
+     *
+     * Safe from any number of threads.
+     *
+     * @return false once stop() has begun, or if the stage stopped at a sink error
+     * @throws std::out_of_range if an index is past the source store
+     */
+    bool push(MergePair pair, uint64_t tag = 0);
+
+    // Queue a merge if there is room; false if full or stopping
+    bool try_push(MergePair pair, uint64_t tag = 0);
+
+    /**
+     * Refuse new requests, merge everything already queued, join the stage
+     *
+     * @throws The first exception thrown by the sink (the stage stops at it)
+     */
+    void stop();
+
+    size_t depth() const { return queue_.size(); }
+    size_t capacity() const { return queue_.capacity(); }
+    size_t max_batch() const { return max_batch_; }
+
+    Stats stats() const;
+
+private:
+    bool enter(MergePair pair);
+    void run();
+    void record(const MergeRequest* requests, size_t n);
+
+    const GlyphStore& in_;
+    Sink sink_;
+    size_t max_batch_;
+    ThreadPool* pool_;
+    MpmcQueue<MergeRequest> queue_;
+
+    std::atomic<bool> stopping_{false};
+    std::atomic<bool> failed_{false};   // Stage thread exited on a sink error
+    std::atomic<size_t> producers_{0};  // push() / try_push() calls in progress
+
+    std::atomic<uint64_t> pushed_{0};
+    std::atomic<uint64_t> rejected_{0};
+    std::atomic<uint64_t> full_waits_{0};
+    std::atomic<uint64_t> merged_{0};
+    std::atomic<uint64_t> batches_{0};
+    std::atomic<size_t> max_depth_{0};
+    std::atomic<uint64_t> latency_max_ns_{0};
+    std::atomic<uint64_t> latency_sum_ns_{0};
+    std::atomic<uint64_t> latency_log2_[kLatencyBuckets] = {};
+
+    std::exception_ptr error_;   // Written by the stage thread before it exits
+    std::mutex stop_mutex_;      // Serializes stop() callers
+    std::thread thread_;
+};
+
+} // namespace spu
+
+#endif // SPU_MERGE_QUEUE_H
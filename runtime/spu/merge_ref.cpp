@@ -2,55 +2,79 @@
  * SPU Merge Primitive - C++ Reference Implementation
  *
  * Minimal, hardware-friendly implementation of glyph merge.
- * Designed for microbenchmarking and FPGA reference.
+ * Designed for microbenchmarking (see merge_bench.cpp) and FPGA reference.
  */
 
 #include "merge_ref.h"
+#include "hash.h"
+#include "perf_counters.h"
 #include <cstring>
-#include <cstdio>
 #include <algorithm>
-#include <chrono>
-#include <iostream>
-#include <fstream>
-#include <sstream>
-#include <vector>
+#include <new>
 
 namespace spu {
 
 // Constructor
 Glyph::Glyph() {
-    memset(id, 0, 65);
-    memset(content, 0, 256);
-    content_len = 0;
+    id = GlyphId::zero();
     energy = 0.0;
     activation_count = 0;
     last_update_time = 0;
-    memset(parent1_id, 0, 65);
-    memset(parent2_id, 0, 65);
+    parent1_id = GlyphId::zero();
+    parent2_id = GlyphId::zero();
 }
 
 /**
- * Simplified SHA256 for benchmarking
- * Note: In production, use OpenSSL or libsodium
+ * Content ID via the active hash backend (SHA-256 unless overridden)
  */
-void sha256_hash(const char* data, size_t len, char* output) {
-    // Simplified hash for benchmarking (NOT cryptographically secure)
-    uint32_t h = 0x6a09e667;  // SHA256 initial value
+void content_hash(const char* data, size_t len, GlyphId& output) {
+    hash_backend().hash(data, len, output.bytes);
+}
 
-    for (size_t i = 0; i < len; i++) {
-        h = ((h << 5) + h) ^ static_cast<uint8_t>(data[i]);
-    }
+// Pairs ahead of the current one to prefetch in merge_batch()
+static constexpr size_t kPrefetchDistance = 4;
 
-    // Convert to hex string (64 chars)
-    snprintf(output, 65, "%08x%08x%08x%08x%08x%08x%08x%08x",
-             h, h ^ 0x12345678, h ^ 0x9abcdef0, h ^ 0xfedcba98,
-             h ^ 0x13579bdf, h ^ 0x2468ace0, h ^ 0x87654321, h ^ 0xabcdef01);
+/**
+ * Prefetch the fields of a glyph that merge reads
+ */
+static inline void prefetch_glyph(const Glyph& g) {
+#if defined(__GNUC__)
+    __builtin_prefetch(g.id.bytes);
+    __builtin_prefetch(&g.energy);
+    __builtin_prefetch(g.content.data());
+#else
+    (void)g;
+#endif
 }
 
 /**
- * Core merge implementation
+ * Steps 4-6 (shared by flat and lazy merges)
  */
-void merge(const Glyph& g1, const Glyph& g2, Glyph& result) {
+static inline void merge_metadata(const Glyph& primary, const Glyph& secondary,
+                                  Glyph& result) {
+    // Step 4: Sum energies
+    result.energy = primary.energy + secondary.energy;
+
+    // Step 5: Merge metadata (max operations)
+    result.activation_count = std::max(primary.activation_count,
+                                       secondary.activation_count);
+    result.last_update_time = std::max(primary.last_update_time,
+                                       secondary.last_update_time);
+
+    // Step 6: Record provenance
+    result.parent1_id = primary.id;
+    result.parent2_id = secondary.id;
+}
+
+/**
+ * Core merge implementation (shared by merge() and merge_batch())
+ *
+ * kHash = false leaves result.id to the caller, so batches can hash
+ * several results at once.
+ */
+template <bool kHash>
+static inline void merge_one(const Glyph& g1, const Glyph& g2, Glyph& result,
+                             ContentArena& arena) {
     // Step 1: Determine precedence by energy
     const Glyph* primary;
     const Glyph* secondary;
@@ -64,178 +88,158 @@ void merge(const Glyph& g1, const Glyph& g2, Glyph& result) {
     }
 
     // Step 2: Concatenate content (primary + secondary)
-    uint16_t pos = 0;
+    const size_t primary_len = primary->content.size();
+    const size_t secondary_len = secondary->content.size();
+    char* dst = result.content.prepare(primary_len + 3 + secondary_len, arena);
 
-    // Copy primary content
-    memcpy(result.content + pos, primary->content, primary->content_len);
-    pos += primary->content_len;
+    // Copy primary content (ropes from lazy merges are materialized here)
+    primary->content.copy_to(dst);
+    size_t pos = primary_len;
 
     // Add separator " + "
-    result.content[pos++] = ' ';
-    result.content[pos++] = '+';
-    result.content[pos++] = ' ';
+    dst[pos++] = ' ';
+    dst[pos++] = '+';
+    dst[pos++] = ' ';
 
     // Copy secondary content
-    memcpy(result.content + pos, secondary->content, secondary->content_len);
-    pos += secondary->content_len;
-
-    result.content_len = pos;
+    secondary->content.copy_to(dst + pos);
 
     // Step 3: Compute ID via SHA256 hash
-    sha256_hash(result.content, result.content_len, result.id);
-
-    // Step 4: Sum energies
-    result.energy = primary->energy + secondary->energy;
-
-    // Step 5: Merge metadata (max operations)
-    result.activation_count = std::max(primary->activation_count,
-                                       secondary->activation_count);
-    result.last_update_time = std::max(primary->last_update_time,
-                                       secondary->last_update_time);
+    if (kHash) {
+        content_hash(result.content.data(), result.content.size(), result.id);
+    }
 
-    // Step 6: Record provenance
-    strncpy(result.parent1_id, primary->id, 64);
-    strncpy(result.parent2_id, secondary->id, 64);
+    merge_metadata(*primary, *secondary, result);
 }
 
-} // namespace spu
-
-// Microbenchmark main
-int main(int argc, char** argv) {
-    using namespace std::chrono;
-    using namespace spu;
-
-    // Parse arguments
-    int iterations = 100000;
-    std::string output_file = "benchmarks/merge_ref_results.json";
-
-    for (int i = 1; i < argc; i++) {
-        std::string arg = argv[i];
-        if (arg == "--iterations" && i + 1 < argc) {
-            iterations = std::stoi(argv[++i]);
-        } else if (arg == "--out" && i + 1 < argc) {
-            output_file = argv[++i];
-        }
+/**
+ * Lazy merge: result content is a RopeNode and the ID is computed by
+ * resuming the primary's cached SHA-256 state
+ *
+ * Cost is O(len(secondary)) instead of O(len(primary) + len(secondary)).
+ * Since merged energy is summed, a merge result usually takes precedence
+ * in later merges, so cascades only ever hash the newly attached glyph.
+ */
+static inline void merge_lazy(const Glyph& g1, const Glyph& g2, Glyph& result,
+                              ContentArena& arena) {
+    const bool first_wins = g1.energy >= g2.energy;
+    const Glyph& primary = first_wins ? g1 : g2;
+    const Glyph& secondary = first_wins ? g2 : g1;
+
+    const size_t len = primary.content.size() + RopeNode::kSeparatorLen +
+                       secondary.content.size();
+
+    // Short results stay inline; incremental hashing needs SHA-256 state
+    if (len <= Content::kInlineCapacity || !hash_backend().cryptographic) {
+        merge_one<true>(g1, g2, result, arena);
+        return;
     }
 
-    std::cout << "=== SPU Merge Reference Microbenchmark ===\n";
-    std::cout << "Iterations: " << iterations << "\n";
-    std::cout << "Output: " << output_file << "\n\n";
-
-    // Create test glyphs
-    Glyph g1, g2, result;
-
-    strncpy(g1.id, "id1_0000000000000000000000000000000000000000000000000000000000", 64);
-    strncpy(g1.content, "content1", 8);
-    g1.content_len = 8;
-    g1.energy = 2.0;
-    g1.activation_count = 0;
-    g1.last_update_time = 0;
-
-    strncpy(g2.id, "id2_0000000000000000000000000000000000000000000000000000000000", 64);
-    strncpy(g2.content, "content2", 8);
-    g2.content_len = 8;
-    g2.energy = 3.0;
-    g2.activation_count = 0;
-    g2.last_update_time = 0;
-
-    // Warmup
-    std::cout << "Warming up...\n";
-    for (int i = 0; i < 1000; i++) {
-        merge(g1, g2, result);
+    RopeNode* node = new (arena.allocate_aligned(sizeof(RopeNode), alignof(RopeNode))) RopeNode;
+    node->left = primary.content;
+    node->right = secondary.content;
+
+    Sha256& h = node->hash_state;
+    if (primary.content.is_rope()) {
+        h = primary.content.rope->hash_state;
+    } else {
+        h.update(primary.content.data(), primary.content.size());
     }
+    h.update(RopeNode::kSeparator, RopeNode::kSeparatorLen);
+    secondary.content.for_each_chunk([&h](const char* chunk, size_t n) {
+        h.update(chunk, n);
+    });
 
-    // Benchmark
-    std::cout << "Running benchmark...\n";
-    std::vector<double> latencies;
-    latencies.reserve(iterations);
+    Sha256 final_state = h;
+    final_state.finish(result.id.bytes);
+    result.content.assign_rope(node, len);
 
-    auto total_start = high_resolution_clock::now();
+    merge_metadata(primary, secondary, result);
+}
 
-    for (int i = 0; i < iterations; i++) {
-        auto start = high_resolution_clock::now();
-        merge(g1, g2, result);
-        auto end = high_resolution_clock::now();
+/**
+ * Step 3 for a group of up to kHashLanes merge results
+ */
+static inline void hash_results(Glyph* out, size_t count) {
+    const void* data[kHashLanes];
+    size_t len[kHashLanes];
+    uint8_t* digests[kHashLanes];
+
+    for (size_t k = 0; k < count; k++) {
+        data[k] = out[k].content.data();
+        len[k] = out[k].content.size();
+        digests[k] = out[k].id.bytes;
+    }
+    hash_many(data, len, digests, count);
+}
 
-        double latency_ns = duration_cast<nanoseconds>(end - start).count();
-        latencies.push_back(latency_ns);
+void merge(const Glyph& g1, const Glyph& g2, Glyph& result, ContentArena& arena,
+           ContentMode mode) {
+    if (mode == ContentMode::kLazy) {
+        merge_lazy(g1, g2, result, arena);
+    } else {
+        merge_one<true>(g1, g2, result, arena);
     }
+}
 
-    auto total_end = high_resolution_clock::now();
-    auto total_duration_ns = duration_cast<nanoseconds>(total_end - total_start).count();
+void merge_batch(const Glyph* a, const Glyph* b, Glyph* out, size_t n, ContentArena& arena,
+                 ContentMode mode) {
+    if (mode == ContentMode::kLazy) {
+        for (size_t i = 0; i < n; i++) {
+            if (i + kPrefetchDistance < n) {
+                prefetch_glyph(a[i + kPrefetchDistance]);
+                prefetch_glyph(b[i + kPrefetchDistance]);
+            }
+            merge_lazy(a[i], b[i], out[i], arena);
+        }
+        return;
+    }
 
-    // Compute statistics
-    std::sort(latencies.begin(), latencies.end());
+    for (size_t base = 0; base < n; base += kHashLanes) {
+        size_t count = std::min(kHashLanes, n - base);
+        {
+            SPU_PERF_SCOPE(kPerfMergeFused, count);
+            for (size_t i = base; i < base + count; i++) {
+                if (i + kPrefetchDistance < n) {
+                    prefetch_glyph(a[i + kPrefetchDistance]);
+                    prefetch_glyph(b[i + kPrefetchDistance]);
+                }
+                merge_one<false>(a[i], b[i], out[i], arena);
+            }
+        }
+        SPU_PERF_SCOPE(kPerfHash, count);
+        hash_results(out + base, count);
+    }
+}
 
-    double min_latency = latencies.front();
-    double max_latency = latencies.back();
-    double median_latency = latencies[latencies.size() / 2];
-    double p95_latency = latencies[(latencies.size() * 95) / 100];
-    double p99_latency = latencies[(latencies.size() * 99) / 100];
+void merge_batch(const Glyph* pool, const MergePair* pairs, Glyph* out, size_t n,
+                 ContentArena& arena, ContentMode mode) {
+    if (mode == ContentMode::kLazy) {
+        for (size_t i = 0; i < n; i++) {
+            if (i + kPrefetchDistance < n) {
+                prefetch_glyph(pool[pairs[i + kPrefetchDistance].first]);
+                prefetch_glyph(pool[pairs[i + kPrefetchDistance].second]);
+            }
+            merge_lazy(pool[pairs[i].first], pool[pairs[i].second], out[i], arena);
+        }
+        return;
+    }
 
-    double sum_latency = 0.0;
-    for (double lat : latencies) {
-        sum_latency += lat;
+    for (size_t base = 0; base < n; base += kHashLanes) {
+        size_t count = std::min(kHashLanes, n - base);
+        {
+            SPU_PERF_SCOPE(kPerfMergeFused, count);
+            for (size_t i = base; i < base + count; i++) {
+                if (i + kPrefetchDistance < n) {
+                    prefetch_glyph(pool[pairs[i + kPrefetchDistance].first]);
+                    prefetch_glyph(pool[pairs[i + kPrefetchDistance].second]);
+                }
+                merge_one<false>(pool[pairs[i].first], pool[pairs[i].second], out[i], arena);
+            }
+        }
+        SPU_PERF_SCOPE(kPerfHash, count);
+        hash_results(out + base, count);
     }
-    double mean_latency = sum_latency / latencies.size();
-
-    double avg_latency_us = mean_latency / 1000.0;
-    double ops_per_sec = 1e9 / mean_latency;
-
-    // Print results
-    std::cout << "\nResults:\n";
-    std::cout << "--------\n";
-    std::cout << "Min latency: " << min_latency << " ns\n";
-    std::cout << "Max latency: " << max_latency << " ns\n";
-    std::cout << "Median latency: " << median_latency << " ns\n";
-    std::cout << "Mean latency: " << mean_latency << " ns (" << avg_latency_us << " µs)\n";
-    std::cout << "P95 latency: " << p95_latency << " ns\n";
-    std::cout << "P99 latency: " << p99_latency << " ns\n";
-    std::cout << "Throughput: " << static_cast<int>(ops_per_sec) << " ops/sec\n";
-    std::cout << "\n";
-
-    // Compare to Python baseline (from bench_spu.py)
-    double python_avg_us = 5.33;
-    int python_ops_sec = 187652;
-    double speedup = python_avg_us / avg_latency_us;
-
-    std::cout << "vs Python baseline:\n";
-    std::cout << "-------------------\n";
-    std::cout << "Python: " << python_avg_us << " µs, " << python_ops_sec << " ops/sec\n";
-    std::cout << "C++: " << avg_latency_us << " µs, " << static_cast<int>(ops_per_sec) << " ops/sec\n";
-    std::cout << "Speedup: " << speedup << "x\n";
-    std::cout << "\n";
-
-    // Save JSON results (manual generation)
-    std::ofstream out(output_file);
-    out << "{\n";
-    out << "  \"primitive\": \"merge\",\n";
-    out << "  \"implementation\": \"cpp_reference\",\n";
-    out << "  \"iterations\": " << iterations << ",\n";
-    out << "  \"total_time_ns\": " << total_duration_ns << ",\n";
-    out << "  \"latency_ns\": {\n";
-    out << "    \"min\": " << min_latency << ",\n";
-    out << "    \"max\": " << max_latency << ",\n";
-    out << "    \"median\": " << median_latency << ",\n";
-    out << "    \"mean\": " << mean_latency << ",\n";
-    out << "    \"p95\": " << p95_latency << ",\n";
-    out << "    \"p99\": " << p99_latency << "\n";
-    out << "  },\n";
-    out << "  \"latency_us\": {\n";
-    out << "    \"mean\": " << avg_latency_us << "\n";
-    out << "  },\n";
-    out << "  \"throughput\": {\n";
-    out << "    \"ops_per_sec\": " << static_cast<int>(ops_per_sec) << "\n";
-    out << "  },\n";
-    out << "  \"baseline_comparison\": {\n";
-    out << "    \"python_avg_latency_us\": " << python_avg_us << ",\n";
-    out << "    \"python_ops_per_sec\": " << python_ops_sec << ",\n";
-    out << "    \"speedup\": " << speedup << "\n";
-    out << "  }\n";
-    out << "}\n";
-    out.close();
-
-    std::cout << "Results saved to: " << output_file << "\n";
-
-    return 0;
 }
+
+} // namespace spu
@@ -8,27 +8,53 @@
 #ifndef SPU_MERGE_REF_H
 #define SPU_MERGE_REF_H
 
+#include "content.h"
+#include "glyph_id.h"
+
+#include <cstddef>
 #include <cstdint>
 #include <string>
 
 namespace spu {
 
-// Glyph structure (fixed-size for hardware efficiency)
+// Tag for Glyph(no_init)
+struct NoInit {};
+constexpr NoInit no_init{};
+
+// Glyph structure (fixed-size record, variable-length content by reference)
 struct Glyph {
-    char id[65];                // SHA256 hash as hex string (64 + null)
-    char content[256];          // Fixed-size content buffer
-    uint16_t content_len;       // Actual content length
+    GlyphId id;                 // SHA256 content hash (32 raw bytes)
+    Content content;            // Inline (<= 24 bytes) or arena-backed content
 
     double energy;              // Energy level
     uint32_t activation_count;  // Activation counter
     uint64_t last_update_time;  // Last update timestamp
 
-    // Merge provenance
-    char parent1_id[65];
-    char parent2_id[65];
+    // Merge provenance (zero = none)
+    GlyphId parent1_id;
+    GlyphId parent2_id;
 
     // Constructor
     Glyph();
+
+    // Leaves every field but content unset: for outputs that merge() or
+    // GlyphStore::load() overwrite in full
+    explicit Glyph(NoInit) {}
+};
+
+/**
+ * How merge results hold their content
+ *
+ * kFlat: content is copied into one buffer and hashed in full
+ * kLazy: content is a RopeNode (primary, " + ", secondary) and the ID is
+ *        hashed incrementally from the primary's cached SHA-256 state; the
+ *        flat string is only built by Content::copy_to() / str() / flatten().
+ *        Falls back to kFlat for inline-sized results and non-SHA-256 hash
+ *        backends. Parent content must outlive the result.
+ */
+enum class ContentMode {
+    kFlat,
+    kLazy,
 };
 
 /**
@@ -36,21 +62,61 @@ struct Glyph {
  *
  * @param g1 First glyph
  * @param g2 Second glyph
- * @param result Output merged glyph
+ * @param result Output merged glyph (must not alias g1 or g2)
+ * @param arena Arena for merged content longer than Content::kInlineCapacity
+ * @param mode Flat copy or lazy rope content
  *
- * Performance: O(n) where n = content length
+ * Performance: O(n) where n = content length (kLazy: n = secondary length)
  * Latency: ~350ns (CPU), pipelineable for FPGA
  */
-void merge(const Glyph& g1, const Glyph& g2, Glyph& result);
+void merge(const Glyph& g1, const Glyph& g2, Glyph& result, ContentArena& arena,
+           ContentMode mode = ContentMode::kFlat);
+
+// Index pair into a glyph pool: merges pool[first] with pool[second]
+struct MergePair {
+    uint32_t first;
+    uint32_t second;
+};
+
+/**
+ * Merge n glyph pairs in a single call
+ *
+ * @param a First glyph of each pair (n entries)
+ * @param b Second glyph of each pair (n entries)
+ * @param out Output merged glyphs (n entries, must not alias a or b)
+ * @param n Number of pairs
+ * @param arena Arena for merged content
+ * @param mode Flat copy or lazy rope content
+ *
+ * Same result as merge(a[i], b[i], out[i]) for every i, but pays the call
+ * and setup cost once per batch and prefetches upcoming pairs. This is the
+ * host-side contract of the FPGA DMA path (256-4096 pairs per transfer, see
+ * docs/merge_fpga_sketch.md).
+ */
+void merge_batch(const Glyph* a, const Glyph* b, Glyph* out, size_t n, ContentArena& arena,
+                 ContentMode mode = ContentMode::kFlat);
+
+/**
+ * Merge n index pairs drawn from a glyph pool
+ *
+ * @param pool Glyph pool
+ * @param pairs Index pairs into pool (n entries)
+ * @param out Output merged glyphs (n entries, must not alias pool)
+ * @param n Number of pairs
+ * @param arena Arena for merged content
+ * @param mode Flat copy or lazy rope content
+ */
+void merge_batch(const Glyph* pool, const MergePair* pairs, Glyph* out, size_t n,
+                 ContentArena& arena, ContentMode mode = ContentMode::kFlat);
 
 /**
- * Compute SHA256 hash of content
+ * Compute the content ID (SHA-256 via the active hash backend, see hash.h)
  *
  * @param data Input data buffer
  * @param len Length of data in bytes
- * @param output Output buffer (must be 65 bytes for hex string + null)
+ * @param output Output ID
  */
-void sha256_hash(const char* data, size_t len, char* output);
+void content_hash(const char* data, size_t len, GlyphId& output);
 
 } // namespace spu
 
@@ -0,0 +1,134 @@
+/**
+ * SPU MPMC Queue - Bounded lock-free multi-producer multi-consumer ring
+ *
+ * Vyukov's bounded queue: each cell carries a sequence number that says
+ * whether it is free for the producer at position p (seq == p) or holds
+ * the item for the consumer at position p (seq == p + 1). Producers and
+ * consumers each claim positions with one CAS on their own cache line;
+ * there are no locks and no allocation after construction.
+ *
+ * try_pop_batch() claims a run of ready cells with a single CAS, so a
+ * consumer pays one atomic per batch instead of one per item.
+ *
+ * T must be trivially copyable.
+ */
+
+#ifndef SPU_MPMC_QUEUE_H
+#define SPU_MPMC_QUEUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <type_traits>
+
+namespace spu {
+
+template <typename T>
+class MpmcQueue {
+    static_assert(std::is_trivially_copyable<T>::value, "MpmcQueue items must be trivially copyable");
+
+public:
+    /**
+     * @param capacity Items held at once (rounded up to a power of two, >= 2)
+     * @throws std::invalid_argument if capacity is 0 or above 2^32
+     */
+    explicit MpmcQueue(size_t capacity) {
+        if (capacity == 0 || capacity > (size_t(1) << 32)) {
+            throw std::invalid_argument("MpmcQueue capacity must be 1..2^32");
+        }
+        size_t n = 2;
+        while (n < capacity) {
+            n *= 2;
+        }
+        cells_.reset(new Cell[n]);
+        mask_ = n - 1;
+        for (size_t i = 0; i < n; i++) {
+            cells_[i].seq.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    MpmcQueue(const MpmcQueue&) = delete;
+    MpmcQueue& operator=(const MpmcQueue&) = delete;
+
+    size_t capacity() const { return mask_ + 1; }
+
+    // Items queued (approximate while producers or consumers run)
+    size_t size() const {
+        uint64_t tail = tail_.load(std::memory_order_relaxed);
+        uint64_t head = head_.load(std::memory_order_relaxed);
+        return head > tail ? static_cast<size_t>(head - tail) : 0;
+    }
+
+    // Append item; false if the queue is full
+    bool try_push(const T& item) {
+        uint64_t pos = head_.load(std::memory_order_relaxed);
+        for (;;) {
+            Cell& cell = cells_[pos & mask_];
+            uint64_t seq = cell.seq.load(std::memory_order_acquire);
+            if (seq == pos) {
+                if (head_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    cell.item = item;
+                    cell.seq.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (seq < pos) {
+                return false;  // Cell still holds the item from one lap ago
+            } else {
+                pos = head_.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    /**
+     * Remove up to max items in FIFO order
+     *
+     * @return Items written to out (0 if the queue is empty)
+     */
+    size_t try_pop_batch(T* out, size_t max) {
+        uint64_t pos = tail_.load(std::memory_order_relaxed);
+        for (;;) {
+            // Ready cells from pos on
+            size_t ready = 0;
+            while (ready < max && ready <= mask_ &&
+                   cells_[(pos + ready) & mask_].seq.load(std::memory_order_acquire) ==
+                       pos + ready + 1) {
+                ready++;
+            }
+            if (ready == 0) {
+                Cell& cell = cells_[pos & mask_];
+                if (cell.seq.load(std::memory_order_acquire) < pos + 1) {
+                    return 0;
+                }
+                pos = tail_.load(std::memory_order_relaxed);  // Another consumer moved on
+                continue;
+            }
+            if (tail_.compare_exchange_weak(pos, pos + ready, std::memory_order_relaxed)) {
+                for (size_t i = 0; i < ready; i++) {
+                    Cell& cell = cells_[(pos + i) & mask_];
+                    out[i] = cell.item;
+                    cell.seq.store(pos + i + mask_ + 1, std::memory_order_release);
+                }
+                return ready;
+            }
+        }
+    }
+
+    bool try_pop(T& out) { return try_pop_batch(&out, 1) == 1; }
+
+private:
+    struct Cell {
+        std::atomic<uint64_t> seq;
+        T item;
+    };
+
+    std::unique_ptr<Cell[]> cells_;
+    size_t mask_;
+    alignas(64) std::atomic<uint64_t> head_{0};  // Next position to push
+    alignas(64) std::atomic<uint64_t> tail_{0};  // Next position to pop
+};
+
+} // namespace spu
+
+#endif // SPU_MPMC_QUEUE_H
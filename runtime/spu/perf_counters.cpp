@@ -0,0 +1,301 @@
+/**
+ * SPU Perf Counters - Per-phase hardware counter instrumentation
+ */
+
+#include "perf_counters.h"
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#define SPU_PERF_LINUX 1
+#endif
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define SPU_PERF_X86 1
+#endif
+
+namespace spu {
+
+namespace {
+
+const char* const kPhaseNames[kPerfNumPhases] = {
+    "precedence", "content_copy", "hash", "provenance",
+    "merge_fused", "decay", "activation", "dynamics_step",
+};
+
+// Hardware events in group order (index 0 is the leader)
+constexpr size_t kNumEvents = 4;
+
+uint64_t now_ns() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+uint64_t read_tsc() {
+#ifdef SPU_PERF_X86
+    return __rdtsc();
+#else
+    return now_ns();
+#endif
+}
+
+// Per-thread counter state; owned by the registry so totals survive thread exit
+struct ThreadCounters {
+    std::atomic<uint64_t> stats[kPerfNumPhases][7];
+
+    int fds[kNumEvents];
+#ifdef SPU_PERF_LINUX
+    perf_event_mmap_page* pages[kNumEvents];
+#endif
+    bool hardware;
+
+    ThreadCounters() : hardware(false) {
+        for (auto& phase : stats) {
+            for (auto& v : phase) {
+                v.store(0, std::memory_order_relaxed);
+            }
+        }
+        for (size_t i = 0; i < kNumEvents; i++) {
+            fds[i] = -1;
+#ifdef SPU_PERF_LINUX
+            pages[i] = nullptr;
+#endif
+        }
+        open_events();
+    }
+
+    ~ThreadCounters() { close_events(); }
+
+    // Events count only the thread that opened them: closed when it exits
+    void close_events() {
+#ifdef SPU_PERF_LINUX
+        for (size_t i = 0; i < kNumEvents; i++) {
+            if (pages[i]) {
+                munmap(pages[i], static_cast<size_t>(sysconf(_SC_PAGESIZE)));
+                pages[i] = nullptr;
+            }
+            if (fds[i] >= 0) {
+                close(fds[i]);
+                fds[i] = -1;
+            }
+        }
+#endif
+        hardware = false;
+    }
+
+    void open_events() {
+#ifdef SPU_PERF_LINUX
+        const uint64_t configs[kNumEvents] = {
+            PERF_COUNT_HW_CPU_CYCLES,
+            PERF_COUNT_HW_INSTRUCTIONS,
+            PERF_COUNT_HW_CACHE_MISSES,
+            PERF_COUNT_HW_BRANCH_MISSES,
+        };
+        size_t page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+
+        for (size_t i = 0; i < kNumEvents; i++) {
+            perf_event_attr attr;
+            memset(&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = configs[i];
+            attr.disabled = i == 0;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+
+            int group = i == 0 ? -1 : fds[0];
+            fds[i] = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, group, 0));
+            if (fds[i] < 0) {
+                return;
+            }
+            void* page = mmap(nullptr, page_size, PROT_READ, MAP_SHARED, fds[i], 0);
+            if (page == MAP_FAILED) {
+                return;
+            }
+            pages[i] = static_cast<perf_event_mmap_page*>(page);
+        }
+        ioctl(fds[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+        hardware = true;
+#endif
+    }
+
+    uint64_t read_event(size_t i) const {
+#ifdef SPU_PERF_LINUX
+#ifdef SPU_PERF_X86
+        // User-space read (see perf_event_mmap_page in linux/perf_event.h)
+        const volatile perf_event_mmap_page* pc = pages[i];
+        uint32_t seq;
+        uint64_t count;
+        bool via_rdpmc;
+        do {
+            seq = pc->lock;
+            std::atomic_signal_fence(std::memory_order_seq_cst);
+            uint32_t idx = pc->index;
+            count = static_cast<uint64_t>(pc->offset);
+            via_rdpmc = pc->cap_user_rdpmc && idx != 0;
+            if (via_rdpmc) {
+                uint32_t width = pc->pmc_width;
+                int64_t pmc = static_cast<int64_t>(__rdpmc(static_cast<int>(idx - 1)));
+                pmc = static_cast<int64_t>(static_cast<uint64_t>(pmc) << (64 - width)) >> (64 - width);
+                count += static_cast<uint64_t>(pmc);
+            }
+            std::atomic_signal_fence(std::memory_order_seq_cst);
+        } while (pc->lock != seq);
+        if (via_rdpmc) {
+            return count;
+        }
+#endif
+        uint64_t value = 0;
+        if (read(fds[i], &value, sizeof(value)) != sizeof(value)) {
+            return 0;
+        }
+        return value;
+#else
+        (void)i;
+        return 0;
+#endif
+    }
+
+    void read_all(uint64_t* out) const {
+        out[0] = now_ns();
+        if (hardware) {
+            for (size_t i = 0; i < kNumEvents; i++) {
+                out[1 + i] = read_event(i);
+            }
+        } else {
+            out[1] = read_tsc();
+            out[2] = out[3] = out[4] = 0;
+        }
+    }
+};
+
+struct Registry {
+    std::mutex mutex;
+    std::vector<std::unique_ptr<ThreadCounters>> threads;
+    std::vector<ThreadCounters*> free;  // State of exited threads, reused by new ones
+};
+
+// Never destroyed: threads may record after static destructors have run
+Registry& registry() {
+    static Registry* r = new Registry();
+    return *r;
+}
+
+// Closes the thread's events and returns its state to the registry when the thread exits
+struct ThreadSlot {
+    ThreadCounters* state = nullptr;
+
+    ~ThreadSlot() {
+        if (state) {
+            state->close_events();
+            Registry& r = registry();
+            std::lock_guard<std::mutex> lock(r.mutex);
+            r.free.push_back(state);
+        }
+    }
+};
+
+ThreadCounters& this_thread_counters() {
+    thread_local ThreadSlot slot;
+    if (!slot.state) {
+        Registry& r = registry();
+        std::unique_lock<std::mutex> lock(r.mutex);
+        if (!r.free.empty()) {
+            slot.state = r.free.back();
+            r.free.pop_back();
+            lock.unlock();
+            slot.state->open_events();  // Totals carry over; events restart for this thread
+        } else {
+            r.threads.emplace_back(new ThreadCounters());
+            slot.state = r.threads.back().get();
+        }
+    }
+    return *slot.state;
+}
+
+} // namespace
+
+const char* perf_phase_name(PerfPhase phase) {
+    return phase < kPerfNumPhases ? kPhaseNames[phase] : "unknown";
+}
+
+bool perf_enabled() {
+#ifdef SPU_PERF_COUNTERS
+    return true;
+#else
+    return false;
+#endif
+}
+
+const char* perf_source() {
+    if (!perf_enabled()) {
+        return "disabled";
+    }
+    return this_thread_counters().hardware ? "perf_event" : "tsc";
+}
+
+void perf_snapshot(PerfStats* out) {
+    memset(out, 0, sizeof(PerfStats) * kPerfNumPhases);
+    Registry& r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    for (const auto& t : r.threads) {
+        for (size_t p = 0; p < kPerfNumPhases; p++) {
+            uint64_t v[7];
+            for (size_t k = 0; k < 7; k++) {
+                v[k] = t->stats[p][k].load(std::memory_order_relaxed);
+            }
+            out[p].calls += v[0];
+            out[p].items += v[1];
+            out[p].nanoseconds += v[2];
+            out[p].cycles += v[3];
+            out[p].instructions += v[4];
+            out[p].cache_misses += v[5];
+            out[p].branch_misses += v[6];
+        }
+    }
+}
+
+void perf_reset() {
+    Registry& r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    for (const auto& t : r.threads) {
+        for (auto& phase : t->stats) {
+            for (auto& v : phase) {
+                v.store(0, std::memory_order_relaxed);
+            }
+        }
+    }
+}
+
+PerfScope::PerfScope(PerfPhase phase, uint64_t items) : phase_(phase), items_(items) {
+    this_thread_counters().read_all(start_);
+}
+
+PerfScope::~PerfScope() {
+    ThreadCounters& t = this_thread_counters();
+    uint64_t end[5];
+    t.read_all(end);
+
+    // Only this thread writes its counters; relaxed load+store is enough
+    std::atomic<uint64_t>* s = t.stats[phase_];
+    auto add = [](std::atomic<uint64_t>& v, uint64_t d) {
+        v.store(v.load(std::memory_order_relaxed) + d, std::memory_order_relaxed);
+    };
+    add(s[0], 1);
+    add(s[1], items_);
+    for (size_t k = 0; k < 5; k++) {
+        add(s[2 + k], end[k] - start_[k]);
+    }
+}
+
+} // namespace spu
@@ -0,0 +1,97 @@
+/**
+ * SPU Perf Counters - Per-phase hardware counter instrumentation
+ *
+ * Compiled in with -DSPU_PERF_COUNTERS; otherwise SPU_PERF_SCOPE() expands
+ * to nothing and the hot paths carry no instrumentation at all.
+ *
+ * Each thread opens one perf_event_open group (cycles, instructions,
+ * cache misses, branch misses) on first use and reads it from user space
+ * with rdpmc, and closes it when the thread exits; its totals are kept and
+ * its state is reused by the next new thread, so thread churn holds no
+ * extra fds or mappings. Where perf events are unavailable (containers,
+ * perf_event_paranoid, non-Linux) cycles fall back to the TSC and the other
+ * counters stay zero; perf_source() reports which one is active.
+ *
+ * Scopes wrap whole column passes / batches, so the cost of reading the
+ * counters is amortized over every glyph in the batch.
+ */
+
+#ifndef SPU_PERF_COUNTERS_H
+#define SPU_PERF_COUNTERS_H
+
+#include <cstddef>
+#include <cstdint>
+
+namespace spu {
+
+enum PerfPhase : uint32_t {
+    kPerfPrecedence = 0,  // merge steps 1, 4-5 (SoA precedence stage)
+    kPerfContentCopy,     // merge step 2 (SoA stage)
+    kPerfHash,            // merge step 3 (SoA stage and AoS batches)
+    kPerfProvenance,      // merge step 6 (SoA stage)
+    kPerfMergeFused,      // AoS merge_batch: steps 1, 2, 4-6 per glyph
+    kPerfDecay,           // DynamicsEngine::apply_decay
+    kPerfActivation,      // DynamicsEngine::apply_activation_threshold
+    kPerfDynamicsStep,    // DynamicsEngine::step (fused decay + activation)
+    kPerfNumPhases,
+};
+
+struct PerfStats {
+    uint64_t calls;          // Scopes entered
+    uint64_t items;          // Glyphs processed
+    uint64_t nanoseconds;
+    uint64_t cycles;         // Core cycles (TSC ticks in the fallback)
+    uint64_t instructions;
+    uint64_t cache_misses;
+    uint64_t branch_misses;
+};
+
+// Phase name ("precedence", "content_copy", "hash", ...)
+const char* perf_phase_name(PerfPhase phase);
+
+// True if built with SPU_PERF_COUNTERS
+bool perf_enabled();
+
+// Counter source: "perf_event", "tsc" or "disabled"
+const char* perf_source();
+
+/**
+ * Sum of every thread's counters
+ *
+ * @param out kPerfNumPhases entries
+ */
+void perf_snapshot(PerfStats* out);
+
+// Zero every thread's counters
+void perf_reset();
+
+/**
+ * Accumulate counters for one phase while in scope
+ */
+class PerfScope {
+public:
+    PerfScope(PerfPhase phase, uint64_t items);
+    ~PerfScope();
+
+    PerfScope(const PerfScope&) = delete;
+    PerfScope& operator=(const PerfScope&) = delete;
+
+private:
+    PerfPhase phase_;
+    uint64_t items_;
+    uint64_t start_[5];  // ns, cycles, instructions, cache misses, branch misses
+};
+
+} // namespace spu
+
+#define SPU_PERF_CONCAT_(a, b) a##b
+#define SPU_PERF_CONCAT(a, b) SPU_PERF_CONCAT_(a, b)
+
+#ifdef SPU_PERF_COUNTERS
+#define SPU_PERF_SCOPE(phase, items) \
+    ::spu::PerfScope SPU_PERF_CONCAT(spu_perf_scope_, __LINE__)((phase), (items))
+#else
+#define SPU_PERF_SCOPE(phase, items) ((void)0)
+#endif
+
+#endif // SPU_PERF_COUNTERS_H
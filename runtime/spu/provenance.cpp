@@ -0,0 +1,311 @@
+/**
+ * SPU Provenance Graph - Merge ancestry by dense handle
+ */
+
+#include "provenance.h"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace spu {
+
+namespace {
+
+size_t id_hash(const GlyphId& id) {
+    // IDs are uniform hashes: one multiply spreads bytes 0-7 over the word
+    uint64_t h;
+    memcpy(&h, id.bytes, sizeof(h));
+    h *= 0x9e3779b97f4a7c15ULL;
+    return static_cast<size_t>(h ^ (h >> 32));
+}
+
+} // namespace
+
+ProvenanceGraph::ProvenanceGraph() : table_(1024, 0), mask_(1023) {}
+
+void ProvenanceGraph::grow_table() {
+    std::vector<uint32_t> table(table_.size() * 2, 0);
+    size_t mask = table.size() - 1;
+    for (uint32_t e : table_) {
+        if (e == 0) {
+            continue;
+        }
+        size_t i = id_hash(ids_[e - 1]) & mask;
+        while (table[i] != 0) {
+            i = (i + 1) & mask;
+        }
+        table[i] = e;
+    }
+    table_.swap(table);
+    mask_ = mask;
+}
+
+ProvenanceGraph::Handle ProvenanceGraph::find(const GlyphId& id) const {
+    for (size_t i = id_hash(id) & mask_;; i = (i + 1) & mask_) {
+        uint32_t e = table_[i];
+        if (e == 0) {
+            return kNone;
+        }
+        if (ids_[e - 1] == id) {
+            return e - 1;
+        }
+    }
+}
+
+ProvenanceGraph::Handle ProvenanceGraph::intern(const GlyphId& id) {
+    Handle h = find(id);
+    if (h != kNone) {
+        return h;
+    }
+    if (ids_.size() >= kNone - 1) {
+        throw std::length_error("ProvenanceGraph holds at most 2^32 - 2 glyphs");
+    }
+    if (2 * (ids_.size() + 1) > table_.size()) {
+        grow_table();
+    }
+    h = static_cast<Handle>(ids_.size());
+    ids_.push_back(id);
+    parent1_.push_back(kNone);
+    parent2_.push_back(kNone);
+    head_.push_back(kNone);
+    size_t i = id_hash(id) & mask_;
+    while (table_[i] != 0) {
+        i = (i + 1) & mask_;
+    }
+    table_[i] = h + 1;
+    return h;
+}
+
+void ProvenanceGraph::link(Handle parent, Handle child) {
+    if (edges_.size() >= kNone) {
+        compact();
+    }
+    edges_.push_back(ChildEdge{child, head_[parent]});
+    head_[parent] = static_cast<uint32_t>(edges_.size() - 1);
+}
+
+ProvenanceGraph::Handle ProvenanceGraph::add(const GlyphId& id, const GlyphId& parent1,
+                                             const GlyphId& parent2) {
+    // Parents first, so they get the lower handles
+    Handle p1 = parent1.is_zero() ? kNone : intern(parent1);
+    Handle p2 = parent2.is_zero() ? kNone : intern(parent2);
+    Handle h = intern(id);
+    if (parent1_[h] != kNone || parent2_[h] != kNone || (p1 == kNone && p2 == kNone)) {
+        return h;  // Provenance is immutable once known
+    }
+    if (p1 == h || p2 == h) {
+        return h;  // A content hash cannot be its own parent
+    }
+
+    parent1_[h] = p1;
+    parent2_[h] = p2;
+    if (p1 != kNone) {
+        link(p1, h);
+    }
+    if (p2 != kNone && p2 != p1) {
+        link(p2, h);
+    }
+    return h;
+}
+
+void ProvenanceGraph::add(const GlyphStore& store) {
+    for (size_t i = 0; i < store.size(); i++) {
+        add(store.id(i), store.parent1_id(i), store.parent2_id(i));
+    }
+}
+
+size_t ProvenanceGraph::child_count(Handle h) const {
+    size_t n = 0;
+    for_each_child(h, [&](Handle) { n++; });
+    return n;
+}
+
+void ProvenanceGraph::compact() {
+    const size_t n = ids_.size();
+    std::vector<uint64_t> offset(n + 1, 0);
+    for (Handle h = 0; h < n; h++) {
+        offset[h + 1] = offset[h] + child_count(h);
+    }
+    std::vector<Handle> children(offset[n]);
+    for (Handle h = 0; h < n; h++) {
+        uint64_t at = offset[h];
+        for_each_child(h, [&](Handle c) { children[at++] = c; });
+        std::sort(children.begin() + offset[h], children.begin() + at);
+    }
+    csr_offset_.swap(offset);
+    csr_children_.swap(children);
+    std::fill(head_.begin(), head_.end(), kNone);
+    edges_.clear();
+    edges_.shrink_to_fit();
+}
+
+size_t ProvenanceGraph::memory_bytes() const {
+    return ids_.capacity() * sizeof(GlyphId) +
+           (parent1_.capacity() + parent2_.capacity()) * sizeof(Handle) +
+           table_.capacity() * sizeof(uint32_t) + csr_offset_.capacity() * sizeof(uint64_t) +
+           csr_children_.capacity() * sizeof(Handle) + head_.capacity() * sizeof(uint32_t) +
+           edges_.capacity() * sizeof(ChildEdge);
+}
+
+template <bool kDown>
+std::vector<ProvenanceGraph::Handle> ProvenanceGraph::bfs(Handle h, size_t max_depth) const {
+    std::vector<Handle> out;
+    std::unordered_set<Handle> seen{h};
+    size_t level_begin = 0;
+    auto visit = [&](Handle v) {
+        if (seen.insert(v).second) {
+            out.push_back(v);
+        }
+    };
+    if (max_depth >= 1) {
+        if (kDown) {
+            for_each_child(h, visit);
+        } else {
+            for_each_parent(h, visit);
+        }
+    }
+    for (size_t depth = 2; depth <= max_depth && level_begin < out.size(); depth++) {
+        size_t level_end = out.size();
+        for (size_t i = level_begin; i < level_end; i++) {
+            if (kDown) {
+                for_each_child(out[i], visit);
+            } else {
+                for_each_parent(out[i], visit);
+            }
+        }
+        level_begin = level_end;
+    }
+    return out;
+}
+
+std::vector<ProvenanceGraph::Handle> ProvenanceGraph::ancestors(Handle h, size_t max_depth) const {
+    return bfs<false>(h, max_depth);
+}
+
+std::vector<ProvenanceGraph::Handle> ProvenanceGraph::descendants(Handle h, size_t max_depth) const {
+    return bfs<true>(h, max_depth);
+}
+
+size_t ProvenanceGraph::descendant_count(Handle h) const {
+    return bfs<true>(h, kUnlimited).size();
+}
+
+std::vector<ProvenanceGraph::Handle> ProvenanceGraph::common_ancestors(Handle a, Handle b) const {
+    // Generation distance of every ancestor of h, h itself at 0
+    auto depths = [&](Handle h) {
+        std::unordered_map<Handle, uint32_t> depth{{h, 0}};
+        std::vector<Handle> frontier{h}, next;
+        for (uint32_t d = 1; !frontier.empty(); d++) {
+            for (Handle v : frontier) {
+                for_each_parent(v, [&](Handle p) {
+                    if (depth.emplace(p, d).second) {
+                        next.push_back(p);
+                    }
+                });
+            }
+            frontier.swap(next);
+            next.clear();
+        }
+        return depth;
+    };
+    std::unordered_map<Handle, uint32_t> da = depths(a);
+    std::unordered_map<Handle, uint32_t> db = depths(b);
+    if (da.size() > db.size()) {
+        da.swap(db);
+    }
+
+    std::vector<std::pair<uint32_t, Handle>> common;
+    for (const auto& kv : da) {
+        auto it = db.find(kv.first);
+        if (it != db.end() && !(a == b && kv.first == a)) {
+            common.emplace_back(std::max(kv.second, it->second), kv.first);
+        }
+    }
+    std::sort(common.begin(), common.end());
+    std::vector<Handle> out;
+    out.reserve(common.size());
+    for (const auto& c : common) {
+        out.push_back(c.second);
+    }
+    return out;
+}
+
+template <bool kDown>
+void ProvenanceGraph::multi_bfs(const Handle* sources, size_t n, uint64_t* out) const {
+    // Per-thread dense masks, reset through the touched list: queries stay
+    // const and concurrent, and a batch costs what it visits after the
+    // first call on a thread
+    thread_local std::vector<uint64_t> seen;
+    thread_local std::vector<uint64_t> pending;  // Bits reaching a node at the next level
+    if (seen.size() < ids_.size()) {
+        seen.resize(ids_.size(), 0);
+        pending.resize(ids_.size(), 0);
+    }
+    std::vector<Handle> touched, frontier, next;
+
+    for (size_t base = 0; base < n; base += 64) {
+        const size_t lanes = std::min<size_t>(64, n - base);
+        frontier.clear();
+        for (size_t k = 0; k < lanes; k++) {
+            Handle s = sources[base + k];
+            out[base + k] = 0;
+            if (s >= ids_.size()) {
+                continue;
+            }
+            if (seen[s] == 0) {
+                touched.push_back(s);
+                frontier.push_back(s);
+            }
+            seen[s] |= uint64_t(1) << k;
+            pending[s] = seen[s];
+        }
+
+        while (!frontier.empty()) {
+            for (Handle u : frontier) {
+                const uint64_t bits = pending[u];
+                pending[u] = 0;
+                auto visit = [&](Handle v) {
+                    uint64_t fresh = bits & ~seen[v];
+                    if (fresh == 0) {
+                        return;
+                    }
+                    if (seen[v] == 0) {
+                        touched.push_back(v);
+                    }
+                    if (pending[v] == 0) {
+                        next.push_back(v);
+                    }
+                    seen[v] |= fresh;
+                    pending[v] |= fresh;
+                    for (uint64_t m = fresh; m != 0; m &= m - 1) {
+                        out[base + __builtin_ctzll(m)]++;
+                    }
+                };
+                if (kDown) {
+                    for_each_child(u, visit);
+                } else {
+                    for_each_parent(u, visit);
+                }
+            }
+            frontier.swap(next);
+            next.clear();
+        }
+
+        for (Handle v : touched) {
+            seen[v] = 0;
+        }
+        touched.clear();
+    }
+}
+
+void ProvenanceGraph::ancestor_counts(const Handle* sources, size_t n, uint64_t* out) const {
+    multi_bfs<false>(sources, n, out);
+}
+
+void ProvenanceGraph::descendant_counts(const Handle* sources, size_t n, uint64_t* out) const {
+    multi_bfs<true>(sources, n, out);
+}
+
+} // namespace spu
@@ -0,0 +1,172 @@
+/**
+ * SPU Provenance Graph - Merge ancestry by dense handle
+ *
+ * Each glyph seen as a merge result or parent gets a dense uint32_t handle.
+ * Parents are stored as two handle arrays (8 bytes per glyph instead of
+ * the two 32-byte IDs in the Glyph record), and children as adjacency
+ * lists: a CSR block for everything present at the last compact(), plus
+ * append-only linked edges for glyphs added since. add() is O(1) and never
+ * rebuilds; compact() folds the linked edges into CSR for faster traversal.
+ *
+ * Parents are interned before the child, so a parent's handle is always
+ * lower than its children's unless the parents of a glyph were only
+ * learned after the glyph itself was interned.
+ *
+ * Queries are const and may run concurrently with each other, not with
+ * add() or compact().
+ */
+
+#ifndef SPU_PROVENANCE_H
+#define SPU_PROVENANCE_H
+
+#include "glyph_store.h"
+#include "merge_ref.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace spu {
+
+class ProvenanceGraph {
+public:
+    using Handle = uint32_t;
+    static constexpr Handle kNone = 0xffffffffu;
+    static constexpr size_t kUnlimited = static_cast<size_t>(-1);
+
+    ProvenanceGraph();
+
+    size_t size() const { return ids_.size(); }
+
+    /**
+     * Record a glyph and its parents (zero IDs = no parent)
+     *
+     * Unknown parents become parentless nodes. Re-adding a glyph is a no-op
+     * unless it had no parents yet, in which case they are filled in.
+     *
+     * @return Handle of id
+     * @throws std::length_error past 2^32 - 2 glyphs
+     */
+    Handle add(const GlyphId& id, const GlyphId& parent1, const GlyphId& parent2);
+    Handle add(const Glyph& g) { return add(g.id, g.parent1_id, g.parent2_id); }
+
+    // Record every glyph of a store, in order
+    void add(const GlyphStore& store);
+
+    // Handle of id, or kNone
+    Handle find(const GlyphId& id) const;
+
+    const GlyphId& id(Handle h) const { return ids_[h]; }
+    Handle parent1(Handle h) const { return parent1_[h]; }
+    Handle parent2(Handle h) const { return parent2_[h]; }
+
+    /**
+     * Visit the children of h
+     *
+     * @param fn Called as fn(Handle child)
+     */
+    template <typename Fn>
+    void for_each_child(Handle h, Fn&& fn) const;
+
+    size_t child_count(Handle h) const;
+
+    /**
+     * Ancestors of h, breadth-first (parents, then grandparents, ...),
+     * each once, excluding h
+     *
+     * @param max_depth Generations to walk (1 = parents only)
+     */
+    std::vector<Handle> ancestors(Handle h, size_t max_depth = kUnlimited) const;
+
+    // Descendants of h, breadth-first, each once, excluding h
+    std::vector<Handle> descendants(Handle h, size_t max_depth = kUnlimited) const;
+
+    size_t descendant_count(Handle h) const;
+
+    /**
+     * Glyphs that are ancestors of both a and b, nearest first
+     *
+     * Ordered by the larger of the two generation distances, then handle;
+     * the first entry is a nearest common ancestor. a itself counts when it
+     * is an ancestor of b (and vice versa).
+     */
+    std::vector<Handle> common_ancestors(Handle a, Handle b) const;
+
+    /**
+     * Batched counts: out[i] = number of ancestors / descendants of
+     * sources[i]
+     *
+     * Runs one bit-parallel BFS per 64 sources (each node's 64-bit mask
+     * records which sources reached it), so a batch walks shared lineage
+     * once instead of once per source.
+     */
+    void ancestor_counts(const Handle* sources, size_t n, uint64_t* out) const;
+    void descendant_counts(const Handle* sources, size_t n, uint64_t* out) const;
+
+    // Move appended child edges into the CSR block
+    void compact();
+
+    // Heap bytes held by the graph
+    size_t memory_bytes() const;
+
+private:
+    struct ChildEdge {
+        Handle child;
+        uint32_t next;  // Next edge of the same parent in edges_, or kNone
+    };
+
+    Handle intern(const GlyphId& id);
+    void link(Handle parent, Handle child);
+    void grow_table();
+
+    template <typename Fn>
+    void for_each_parent(Handle h, Fn&& fn) const;
+
+    template <bool kDown>
+    void multi_bfs(const Handle* sources, size_t n, uint64_t* out) const;
+
+    template <bool kDown>
+    std::vector<Handle> bfs(Handle h, size_t max_depth) const;
+
+    std::vector<GlyphId> ids_;
+    std::vector<Handle> parent1_;
+    std::vector<Handle> parent2_;
+
+    // ID -> handle: linear probing, power-of-two size, <= 50% full; entry = handle + 1
+    std::vector<uint32_t> table_;
+    size_t mask_;
+
+    // Children as of the last compact(): csr_children_[csr_offset_[h] .. csr_offset_[h + 1])
+    std::vector<uint64_t> csr_offset_;
+    std::vector<Handle> csr_children_;
+
+    // Children added since: per-parent list through edges_ (kNone = empty)
+    std::vector<uint32_t> head_;
+    std::vector<ChildEdge> edges_;
+};
+
+template <typename Fn>
+void ProvenanceGraph::for_each_child(Handle h, Fn&& fn) const {
+    if (h + 1 < csr_offset_.size()) {
+        for (uint64_t i = csr_offset_[h]; i < csr_offset_[h + 1]; i++) {
+            fn(csr_children_[i]);
+        }
+    }
+    for (uint32_t e = head_[h]; e != kNone; e = edges_[e].next) {
+        fn(edges_[e].child);
+    }
+}
+
+template <typename Fn>
+void ProvenanceGraph::for_each_parent(Handle h, Fn&& fn) const {
+    if (parent1_[h] != kNone) {
+        fn(parent1_[h]);
+    }
+    if (parent2_[h] != kNone && parent2_[h] != parent1_[h]) {
+        fn(parent2_[h]);
+    }
+}
+
+} // namespace spu
+
+#endif // SPU_PROVENANCE_H
@@ -4,6 +4,7 @@ Setup script for SPU merge Python bindings
 Build: python3 setup.py build_ext --inplace
 """
 
+import os
 import sys
 from pathlib import Path
 
@@ -14,9 +15,16 @@ try:
     ext_modules = [
         Pybind11Extension(
             "spu_merge",
-            sources=["bindings.cpp", "merge_ref.cpp"],
+            sources=["bindings.cpp", "merge_ref.cpp", "glyph_store.cpp",
+                     "dynamics.cpp", "glyph_index.cpp", "hash.cpp", "sha256_x86.cpp",
+                     "content.cpp", "thread_pool.cpp", "perf_counters.cpp",
+                     "telemetry.cpp", "tick_scheduler.cpp", "lazy_decay.cpp",
+                     "energy_index.cpp", "provenance.cpp", "snapshot.cpp"],
             include_dirs=["."],
-            extra_compile_args=["-O3", "-std=c++17"],
+            # SPU_PERF_COUNTERS=1 python3 setup.py build_ext --inplace
+            define_macros=[("SPU_PERF_COUNTERS", "1")] if os.environ.get("SPU_PERF_COUNTERS") else [],
+            extra_compile_args=["-O3", "-std=c++17", "-pthread"],
+            extra_link_args=["-pthread"],
         ),
     ]
 
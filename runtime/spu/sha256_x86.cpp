@@ -0,0 +1,261 @@
+/**
+ * SPU Content Hashing - x86 SHA-256 kernels
+ *
+ * - SHA-NI: single-buffer compression with the SHA extensions
+ * - AVX2: 8-lane multi-buffer SHA-256, one message per 32-bit lane, used
+ *   to hash 8 merge results at once in merge_batch()
+ */
+
+#include "hash.h"
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#include <immintrin.h>
+
+namespace spu {
+namespace detail {
+
+bool cpu_has_sha_ni() {
+    static const bool supported = [] {
+        unsigned int eax, ebx, ecx, edx;
+        if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx)) {
+            return false;
+        }
+        bool sha = (ebx >> 29) & 1;
+        __builtin_cpu_init();
+        return sha && __builtin_cpu_supports("sse4.1") && __builtin_cpu_supports("ssse3");
+    }();
+    return supported;
+}
+
+bool cpu_has_avx2() {
+    static const bool supported = [] {
+        __builtin_cpu_init();
+        return static_cast<bool>(__builtin_cpu_supports("avx2"));
+    }();
+    return supported;
+}
+
+// --- SHA-NI ---
+
+__attribute__((target("sha,sse4.1,ssse3")))
+void sha256_compress_shani(uint32_t* state, const uint8_t* blocks, size_t count) {
+    const __m128i kByteSwap = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+
+    // Load state as ABEF / CDGH
+    __m128i tmp = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&state[0]));
+    __m128i state1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&state[4]));
+    tmp = _mm_shuffle_epi32(tmp, 0xB1);           // CDAB
+    state1 = _mm_shuffle_epi32(state1, 0x1B);     // EFGH
+    __m128i state0 = _mm_alignr_epi8(tmp, state1, 8);   // ABEF
+    state1 = _mm_blend_epi16(state1, tmp, 0xF0);        // CDGH
+
+    for (size_t blk = 0; blk < count; blk++, blocks += 64) {
+        const __m128i abef_save = state0;
+        const __m128i cdgh_save = state1;
+        __m128i w[4];
+
+        for (int g = 0; g < 16; g++) {
+            if (g < 4) {
+                w[g] = _mm_shuffle_epi8(
+                    _mm_loadu_si128(reinterpret_cast<const __m128i*>(blocks + 16 * g)), kByteSwap);
+            } else {
+                // W[t] = sigma1(W[t-2]) + W[t-7] + sigma0(W[t-15]) + W[t-16]
+                __m128i m = _mm_sha256msg1_epu32(w[g & 3], w[(g + 1) & 3]);
+                m = _mm_add_epi32(m, _mm_alignr_epi8(w[(g + 3) & 3], w[(g + 2) & 3], 4));
+                w[g & 3] = _mm_sha256msg2_epu32(m, w[(g + 3) & 3]);
+            }
+
+            __m128i msg = _mm_add_epi32(
+                w[g & 3], _mm_loadu_si128(reinterpret_cast<const __m128i*>(&kSha256K[4 * g])));
+            state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+            msg = _mm_shuffle_epi32(msg, 0x0E);
+            state0 = _mm_sha256rnds2_epu32(state0, state1, msg);
+        }
+
+        state0 = _mm_add_epi32(state0, abef_save);
+        state1 = _mm_add_epi32(state1, cdgh_save);
+    }
+
+    // Back to ABCD / EFGH
+    tmp = _mm_shuffle_epi32(state0, 0x1B);        // FEBA
+    state1 = _mm_shuffle_epi32(state1, 0xB1);     // DCHG
+    state0 = _mm_blend_epi16(tmp, state1, 0xF0);  // DCBA
+    state1 = _mm_alignr_epi8(state1, tmp, 8);     // ABEF
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(&state[0]), state0);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(&state[4]), state1);
+}
+
+// --- AVX2 multi-buffer ---
+
+namespace {
+
+// Per-lane view of a padded message: whole blocks from the input, then
+// one or two tail blocks built locally
+struct LaneMessage {
+    const uint8_t* data;
+    size_t full_blocks;
+    size_t total_blocks;
+    uint8_t tail[128];
+
+    void init(const void* src, size_t len) {
+        data = static_cast<const uint8_t*>(src);
+        full_blocks = len / 64;
+        size_t rem = len % 64;
+        size_t tail_blocks = (rem < 56) ? 1 : 2;
+        total_blocks = full_blocks + tail_blocks;
+
+        memset(tail, 0, sizeof(tail));
+        memcpy(tail, data + full_blocks * 64, rem);
+        tail[rem] = 0x80;
+        uint64_t bits = static_cast<uint64_t>(len) * 8;
+        uint8_t* lp = tail + tail_blocks * 64 - 8;
+        for (int i = 0; i < 8; i++) {
+            lp[i] = uint8_t(bits >> (56 - 8 * i));
+        }
+    }
+
+    const uint8_t* block(size_t j) const {
+        return j < full_blocks ? data + 64 * j : tail + 64 * (j - full_blocks);
+    }
+};
+
+__attribute__((target("avx2")))
+inline __m256i rotr(__m256i x, int n) {
+    return _mm256_or_si256(_mm256_srli_epi32(x, n), _mm256_slli_epi32(x, 32 - n));
+}
+
+__attribute__((target("avx2")))
+inline uint32_t lane_word(const uint8_t* block, int t) {
+    uint32_t v;
+    memcpy(&v, block + 4 * t, 4);
+    return __builtin_bswap32(v);
+}
+
+} // namespace
+
+__attribute__((target("avx2")))
+void sha256_x8_avx2(const void* const* data, const size_t* len, uint8_t* const* digest) {
+    LaneMessage lanes[kHashLanes];
+    size_t max_blocks = 0;
+    for (size_t l = 0; l < kHashLanes; l++) {
+        lanes[l].init(data[l], len[l]);
+        if (lanes[l].total_blocks > max_blocks) {
+            max_blocks = lanes[l].total_blocks;
+        }
+    }
+
+    __m256i s[8];
+    for (int i = 0; i < 8; i++) {
+        s[i] = _mm256_set1_epi32(static_cast<int>(kSha256Init[i]));
+    }
+
+    static const uint8_t kZeroBlock[64] = {0};
+
+    for (size_t j = 0; j < max_blocks; j++) {
+        // Lanes that still have block j
+        alignas(32) int32_t active[kHashLanes];
+        const uint8_t* blk[kHashLanes];
+        for (size_t l = 0; l < kHashLanes; l++) {
+            bool on = j < lanes[l].total_blocks;
+            active[l] = on ? -1 : 0;
+            blk[l] = on ? lanes[l].block(j) : kZeroBlock;
+        }
+        const __m256i mask = _mm256_load_si256(reinterpret_cast<const __m256i*>(active));
+
+        __m256i w[16];
+        for (int t = 0; t < 16; t++) {
+            w[t] = _mm256_setr_epi32(
+                static_cast<int>(lane_word(blk[0], t)), static_cast<int>(lane_word(blk[1], t)),
+                static_cast<int>(lane_word(blk[2], t)), static_cast<int>(lane_word(blk[3], t)),
+                static_cast<int>(lane_word(blk[4], t)), static_cast<int>(lane_word(blk[5], t)),
+                static_cast<int>(lane_word(blk[6], t)), static_cast<int>(lane_word(blk[7], t)));
+        }
+
+        __m256i a = s[0], b = s[1], c = s[2], d = s[3];
+        __m256i e = s[4], f = s[5], g = s[6], h = s[7];
+
+        for (int t = 0; t < 64; t++) {
+            __m256i wt;
+            if (t < 16) {
+                wt = w[t];
+            } else {
+                __m256i w15 = w[(t - 15) & 15];
+                __m256i w2 = w[(t - 2) & 15];
+                __m256i s0 = _mm256_xor_si256(_mm256_xor_si256(rotr(w15, 7), rotr(w15, 18)),
+                                              _mm256_srli_epi32(w15, 3));
+                __m256i s1 = _mm256_xor_si256(_mm256_xor_si256(rotr(w2, 17), rotr(w2, 19)),
+                                              _mm256_srli_epi32(w2, 10));
+                wt = _mm256_add_epi32(_mm256_add_epi32(w[t & 15], s0),
+                                      _mm256_add_epi32(w[(t - 7) & 15], s1));
+                w[t & 15] = wt;
+            }
+
+            __m256i S1 = _mm256_xor_si256(_mm256_xor_si256(rotr(e, 6), rotr(e, 11)), rotr(e, 25));
+            __m256i ch = _mm256_xor_si256(_mm256_and_si256(e, f), _mm256_andnot_si256(e, g));
+            __m256i t1 = _mm256_add_epi32(_mm256_add_epi32(h, S1),
+                                          _mm256_add_epi32(ch, _mm256_add_epi32(
+                                              _mm256_set1_epi32(static_cast<int>(kSha256K[t])), wt)));
+            __m256i S0 = _mm256_xor_si256(_mm256_xor_si256(rotr(a, 2), rotr(a, 13)), rotr(a, 22));
+            __m256i maj = _mm256_xor_si256(_mm256_xor_si256(_mm256_and_si256(a, b),
+                                                            _mm256_and_si256(a, c)),
+                                           _mm256_and_si256(b, c));
+            __m256i t2 = _mm256_add_epi32(S0, maj);
+            h = g;
+            g = f;
+            f = e;
+            e = _mm256_add_epi32(d, t1);
+            d = c;
+            c = b;
+            b = a;
+            a = _mm256_add_epi32(t1, t2);
+        }
+
+        // Finished lanes keep their state
+        __m256i out[8] = {a, b, c, d, e, f, g, h};
+        for (int i = 0; i < 8; i++) {
+            s[i] = _mm256_blendv_epi8(s[i], _mm256_add_epi32(s[i], out[i]), mask);
+        }
+    }
+
+    alignas(32) uint32_t words[8][kHashLanes];
+    for (int i = 0; i < 8; i++) {
+        _mm256_store_si256(reinterpret_cast<__m256i*>(words[i]), s[i]);
+    }
+    for (size_t l = 0; l < kHashLanes; l++) {
+        for (int i = 0; i < 8; i++) {
+            uint32_t v = words[i][l];
+            digest[l][4 * i + 0] = uint8_t(v >> 24);
+            digest[l][4 * i + 1] = uint8_t(v >> 16);
+            digest[l][4 * i + 2] = uint8_t(v >> 8);
+            digest[l][4 * i + 3] = uint8_t(v);
+        }
+    }
+}
+
+} // namespace detail
+} // namespace spu
+
+#else // non-x86: kernels are never selected
+
+namespace spu {
+namespace detail {
+
+bool cpu_has_sha_ni() { return false; }
+bool cpu_has_avx2() { return false; }
+
+void sha256_compress_shani(uint32_t* state, const uint8_t* blocks, size_t count) {
+    sha256_compress_scalar(state, blocks, count);
+}
+
+void sha256_x8_avx2(const void* const* data, const size_t* len, uint8_t* const* digest) {
+    for (size_t l = 0; l < kHashLanes; l++) {
+        sha256_oneshot(sha256_compress_scalar, data[l], len[l], digest[l]);
+    }
+}
+
+} // namespace detail
+} // namespace spu
+
+#endif
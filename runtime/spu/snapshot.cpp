@@ -0,0 +1,297 @@
+/**
+ * SPU Glyph Snapshot - Memory-mapped GlyphStore columns
+ */
+
+#include "snapshot.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <numeric>
+#include <stdexcept>
+#include <system_error>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace spu {
+
+namespace {
+
+// Bytes per glyph for each column (1 = byte blob)
+constexpr uint32_t kElemSize[kSnapNumColumns] = {
+    sizeof(GlyphId), sizeof(double), sizeof(uint32_t), sizeof(uint64_t),
+    sizeof(GlyphId), sizeof(GlyphId), sizeof(uint64_t), sizeof(uint32_t), 1,
+    sizeof(uint64_t), sizeof(uint32_t), 1,
+};
+
+constexpr size_t kHeaderBytes = kSnapshotAlign;
+
+[[noreturn]] void throw_errno(const std::string& what) {
+    throw std::system_error(errno, std::generic_category(), what);
+}
+
+// Make a rename in path's directory durable
+void sync_parent_dir(const std::string& path) {
+    size_t slash = path.find_last_of('/');
+    std::string dir = slash == std::string::npos ? "." : slash == 0 ? "/" : path.substr(0, slash);
+    int fd = open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) {
+        throw_errno("open " + dir);
+    }
+    if (fsync(fd) != 0) {
+        int err = errno;
+        close(fd);
+        throw std::system_error(err, std::generic_category(), "fsync " + dir);
+    }
+    close(fd);
+}
+
+size_t align_up(size_t n) {
+    return (n + kSnapshotAlign - 1) / kSnapshotAlign * kSnapshotAlign;
+}
+
+} // namespace
+
+Snapshot::Snapshot(const std::string& path) : path_(path), base_(nullptr), map_size_(0), count_(0) {
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        throw_errno("open " + path);
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        int err = errno;
+        close(fd);
+        throw std::system_error(err, std::generic_category(), "fstat " + path);
+    }
+    map_size_ = static_cast<size_t>(st.st_size);
+    if (map_size_ < kHeaderBytes) {
+        close(fd);
+        throw std::runtime_error("truncated snapshot " + path);
+    }
+    // No MAP_POPULATE: pages fault in as lookups touch them
+    void* p = mmap(nullptr, map_size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    int err = errno;
+    close(fd);
+    if (p == MAP_FAILED) {
+        throw std::system_error(err, std::generic_category(), "mmap " + path);
+    }
+    base_ = static_cast<const char*>(p);
+    // Lookups are binary searches: don't read ahead around every probe
+    madvise(p, map_size_, MADV_RANDOM);
+
+    try {
+        SnapshotHeader h;
+        memcpy(&h, base_, sizeof(h));
+        if (memcmp(h.magic, kSnapshotMagic, sizeof(h.magic)) != 0) {
+            throw std::runtime_error("not a glyph snapshot: " + path);
+        }
+        if (h.version != kSnapshotVersion) {
+            throw std::runtime_error("unsupported snapshot version " + std::to_string(h.version) +
+                                     ": " + path);
+        }
+        if (h.num_columns != kSnapNumColumns || h.file_size != map_size_ ||
+            !(h.flags & kSnapshotSorted) ||
+            sizeof(h) + kSnapNumColumns * sizeof(SnapshotColumnEntry) > kHeaderBytes) {
+            throw std::runtime_error("invalid snapshot header: " + path);
+        }
+        // Every glyph takes at least its ID: this also keeps column sizes below 2^64
+        if (h.count > (map_size_ - kHeaderBytes) / sizeof(GlyphId)) {
+            throw std::runtime_error("invalid snapshot glyph count: " + path);
+        }
+        count_ = static_cast<size_t>(h.count);
+
+        const SnapshotColumnEntry* table =
+            reinterpret_cast<const SnapshotColumnEntry*>(base_ + sizeof(SnapshotHeader));
+        ids_ = reinterpret_cast<const GlyphId*>(column(table, kSnapIds));
+        energy_ = reinterpret_cast<const double*>(column(table, kSnapEnergy));
+        activation_count_ = reinterpret_cast<const uint32_t*>(column(table, kSnapActivationCount));
+        last_update_time_ = reinterpret_cast<const uint64_t*>(column(table, kSnapLastUpdateTime));
+        parent1_ids_ = reinterpret_cast<const GlyphId*>(column(table, kSnapParent1Ids));
+        parent2_ids_ = reinterpret_cast<const GlyphId*>(column(table, kSnapParent2Ids));
+        content_offset_ = reinterpret_cast<const uint64_t*>(column(table, kSnapContentOffset));
+        content_len_ = reinterpret_cast<const uint32_t*>(column(table, kSnapContentLen));
+        content_ = column(table, kSnapContent);
+        document_offset_ = reinterpret_cast<const uint64_t*>(column(table, kSnapDocumentOffset));
+        document_len_ = reinterpret_cast<const uint32_t*>(column(table, kSnapDocumentLen));
+        documents_ = column(table, kSnapDocuments);
+    } catch (...) {
+        munmap(const_cast<char*>(base_), map_size_);
+        throw;
+    }
+}
+
+Snapshot::~Snapshot() {
+    munmap(const_cast<char*>(base_), map_size_);
+}
+
+const char* Snapshot::column(const SnapshotColumnEntry* table, uint32_t c) const {
+    SnapshotColumnEntry e;
+    memcpy(&e, &table[c], sizeof(e));
+    uint64_t expected;
+    if (e.column != c || e.elem_size != kElemSize[c] || e.offset % kSnapshotAlign != 0 ||
+        e.offset > map_size_ || e.bytes > map_size_ - e.offset ||
+        (e.elem_size > 1 && (__builtin_mul_overflow(uint64_t(e.elem_size), uint64_t(count_),
+                                                    &expected) ||
+                             e.bytes != expected))) {
+        throw std::runtime_error("invalid snapshot column " + std::to_string(c) + ": " + path_);
+    }
+    return base_ + e.offset;
+}
+
+size_t Snapshot::find(const GlyphId& id) const {
+    const GlyphId* end = ids_ + count_;
+    const GlyphId* it = std::lower_bound(ids_, end, id);
+    return it != end && *it == id ? static_cast<size_t>(it - ids_) : npos;
+}
+
+uint64_t Snapshot::column_bytes(uint32_t c) const {
+    const SnapshotColumnEntry* table =
+        reinterpret_cast<const SnapshotColumnEntry*>(base_ + sizeof(SnapshotHeader));
+    uint64_t bytes;
+    memcpy(&bytes, &table[c].bytes, sizeof(bytes));
+    return bytes;
+}
+
+const char* Snapshot::document(size_t i) const {
+    const uint64_t documents_bytes = column_bytes(kSnapDocuments);
+    if (document_offset_[i] > documents_bytes ||
+        document_len_[i] > documents_bytes - document_offset_[i]) {
+        throw std::runtime_error("snapshot document out of range: " + path_);
+    }
+    return documents_ + document_offset_[i];
+}
+
+void Snapshot::load(size_t i, Glyph& out) const {
+    // Offsets are only checked here and in document(): validating them at
+    // open would read every page
+    const uint64_t content_bytes = column_bytes(kSnapContent);
+    if (content_offset_[i] > content_bytes || content_len_[i] > content_bytes - content_offset_[i]) {
+        throw std::runtime_error("snapshot content out of range: " + path_);
+    }
+
+    out.id = ids_[i];
+    out.content.assign_external(content(i), content_len_[i]);
+    out.energy = energy_[i];
+    out.activation_count = activation_count_[i];
+    out.last_update_time = last_update_time_[i];
+    out.parent1_id = parent1_ids_[i];
+    out.parent2_id = parent2_ids_[i];
+}
+
+GlyphStore Snapshot::to_store() const {
+    GlyphStore store;
+    size_t content_bytes = count_ ? content_offset_[count_ - 1] + content_len_[count_ - 1] : 0;
+    store.reserve(count_, content_bytes);
+    Glyph g;
+    for (size_t i = 0; i < count_; i++) {
+        load(i, g);
+        store.append(g);
+    }
+    return store;
+}
+
+void Snapshot::prefetch() const {
+    madvise(const_cast<char*>(base_), map_size_, MADV_WILLNEED);
+}
+
+void write_snapshot(const GlyphStore& store, const std::string& path) {
+    const size_t n = store.size();
+    std::vector<uint32_t> order(n);
+    std::iota(order.begin(), order.end(), 0u);
+    std::sort(order.begin(), order.end(),
+              [&](uint32_t a, uint32_t b) { return store.id(a) < store.id(b); });
+    for (size_t k = 1; k < n; k++) {
+        if (store.id(order[k]) == store.id(order[k - 1])) {
+            throw std::invalid_argument("duplicate glyph ID in snapshot: " +
+                                        store.id(order[k]).hex());
+        }
+    }
+
+    // Build each column in ID order
+    std::vector<std::string> cols(kSnapNumColumns);
+    auto put = [&](uint32_t c, const void* p, size_t len) {
+        cols[c].append(static_cast<const char*>(p), len);
+    };
+    uint64_t content_off = 0;
+    for (uint32_t i : order) {
+        uint32_t len = store.content_len(i);
+        put(kSnapIds, store.id(i).bytes, sizeof(GlyphId));
+        put(kSnapEnergy, &store.energy()[i], sizeof(double));
+        put(kSnapActivationCount, &store.activation_count()[i], sizeof(uint32_t));
+        put(kSnapLastUpdateTime, &store.last_update_time()[i], sizeof(uint64_t));
+        put(kSnapParent1Ids, store.parent1_id(i).bytes, sizeof(GlyphId));
+        put(kSnapParent2Ids, store.parent2_id(i).bytes, sizeof(GlyphId));
+        put(kSnapContentOffset, &content_off, sizeof(content_off));
+        put(kSnapContentLen, &len, sizeof(len));
+        put(kSnapContent, store.content(i), len);
+        content_off += len;
+    }
+    const uint64_t zero_off = 0;
+    const uint32_t zero_len = 0;
+    for (size_t i = 0; i < n; i++) {
+        put(kSnapDocumentOffset, &zero_off, sizeof(zero_off));
+        put(kSnapDocumentLen, &zero_len, sizeof(zero_len));
+    }
+
+    std::string header(kHeaderBytes, '\0');
+    SnapshotColumnEntry table[kSnapNumColumns];
+    uint64_t offset = kHeaderBytes;
+    for (uint32_t c = 0; c < kSnapNumColumns; c++) {
+        table[c] = SnapshotColumnEntry{c, kElemSize[c], offset, cols[c].size()};
+        offset += align_up(cols[c].size());
+    }
+    SnapshotHeader h;
+    memcpy(h.magic, kSnapshotMagic, sizeof(h.magic));
+    h.version = kSnapshotVersion;
+    h.num_columns = kSnapNumColumns;
+    h.count = n;
+    h.flags = kSnapshotSorted;
+    h.file_size = offset;
+    memcpy(&header[0], &h, sizeof(h));
+    memcpy(&header[sizeof(h)], table, sizeof(table));
+
+    std::string tmp = path + ".tmp";
+    int fd = open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        throw_errno("open " + tmp);
+    }
+    auto write_at = [&](const char* p, size_t len, uint64_t at) {
+        while (len > 0) {
+            ssize_t w = pwrite(fd, p, len, static_cast<off_t>(at));
+            if (w < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                int err = errno;
+                close(fd);
+                unlink(tmp.c_str());
+                throw std::system_error(err, std::generic_category(), "write " + tmp);
+            }
+            p += w;
+            at += static_cast<uint64_t>(w);
+            len -= static_cast<size_t>(w);
+        }
+    };
+    write_at(header.data(), header.size(), 0);
+    for (uint32_t c = 0; c < kSnapNumColumns; c++) {
+        write_at(cols[c].data(), cols[c].size(), table[c].offset);
+    }
+    if (ftruncate(fd, static_cast<off_t>(offset)) != 0 || fsync(fd) != 0) {
+        int err = errno;
+        close(fd);
+        unlink(tmp.c_str());
+        throw std::system_error(err, std::generic_category(), "sync " + tmp);
+    }
+    close(fd);
+    if (rename(tmp.c_str(), path.c_str()) != 0) {
+        int err = errno;
+        unlink(tmp.c_str());
+        throw std::system_error(err, std::generic_category(), "rename " + tmp);
+    }
+    sync_parent_dir(path);
+}
+
+} // namespace spu
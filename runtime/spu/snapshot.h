@@ -0,0 +1,164 @@
+/**
+ * SPU Glyph Snapshot - Memory-mapped GlyphStore columns
+ *
+ * A snapshot holds a glyph set as the GlyphStore columns, sorted by ID, in
+ * one file that is mmap()ed read-only: opening it only parses the header,
+ * and column pages load from disk on first access (no parse, no copy), so
+ * a restarted node can serve lookups immediately.
+ *
+ * Layout (little-endian, version 1):
+ *
+ *   SnapshotHeader + column table (first 4096 bytes)
+ *   ids | energy | activation_count | last_update_time | parent1_ids |
+ *   parent2_ids | content_offset | content_len | content |
+ *   document_offset | document_len | documents
+ *
+ * Every column starts on a 4096-byte boundary, so the numeric column
+ * pointers are directly usable by the dynamics kernels. `documents` holds
+ * each glyph's original JSON (empty for snapshots written from a
+ * GlyphStore). runtime/cli/glyph_snapshot.py builds snapshots from JSON
+ * persistence directories and reads the same format from Python.
+ */
+
+#ifndef SPU_SNAPSHOT_H
+#define SPU_SNAPSHOT_H
+
+#include "glyph_store.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace spu {
+
+constexpr char kSnapshotMagic[8] = {'S', 'P', 'U', 'S', 'N', 'A', 'P', '\0'};
+constexpr uint32_t kSnapshotVersion = 1;
+constexpr size_t kSnapshotAlign = 4096;
+constexpr uint64_t kSnapshotSorted = 1;  // SnapshotHeader::flags: ids ascending
+
+enum SnapshotColumn : uint32_t {
+    kSnapIds = 0,
+    kSnapEnergy,
+    kSnapActivationCount,
+    kSnapLastUpdateTime,
+    kSnapParent1Ids,
+    kSnapParent2Ids,
+    kSnapContentOffset,
+    kSnapContentLen,
+    kSnapContent,
+    kSnapDocumentOffset,
+    kSnapDocumentLen,
+    kSnapDocuments,
+    kSnapNumColumns,
+};
+
+struct SnapshotHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t num_columns;
+    uint64_t count;      // Glyphs
+    uint64_t flags;
+    uint64_t file_size;
+};
+
+struct SnapshotColumnEntry {
+    uint32_t column;     // SnapshotColumn
+    uint32_t elem_size;  // Bytes per glyph (1 for byte blobs)
+    uint64_t offset;     // kSnapshotAlign-aligned
+    uint64_t bytes;
+};
+
+static_assert(sizeof(SnapshotHeader) == 40, "SnapshotHeader is written as raw bytes");
+static_assert(sizeof(SnapshotColumnEntry) == 24, "SnapshotColumnEntry is written as raw bytes");
+
+class Snapshot {
+public:
+    static constexpr size_t npos = static_cast<size_t>(-1);
+
+    /**
+     * Map a snapshot read-only and validate its header and column table
+     *
+     * @throws std::system_error if the file cannot be opened or mapped
+     * @throws std::runtime_error if it is not a valid version-1 snapshot
+     */
+    explicit Snapshot(const std::string& path);
+    ~Snapshot();
+
+    Snapshot(const Snapshot&) = delete;
+    Snapshot& operator=(const Snapshot&) = delete;
+
+    size_t size() const { return count_; }
+
+    // Numeric columns (size() entries each, same layout as GlyphStore)
+    const double* energy() const { return energy_; }
+    const uint32_t* activation_count() const { return activation_count_; }
+    const uint64_t* last_update_time() const { return last_update_time_; }
+
+    // ID columns (ids() is sorted ascending)
+    const GlyphId& id(size_t i) const { return ids_[i]; }
+    const GlyphId& parent1_id(size_t i) const { return parent1_ids_[i]; }
+    const GlyphId& parent2_id(size_t i) const { return parent2_ids_[i]; }
+
+    const char* content(size_t i) const { return content_ + content_offset_[i]; }
+    uint32_t content_len(size_t i) const { return content_len_[i]; }
+
+    /**
+     * Original JSON document of glyph i (document_len() == 0 if none)
+     *
+     * @throws std::runtime_error if the document lies outside its column
+     */
+    const char* document(size_t i) const;
+    uint32_t document_len(size_t i) const { return document_len_[i]; }
+
+    // Index of id (binary search over the ID column), or npos
+    size_t find(const GlyphId& id) const;
+
+    /**
+     * Glyph i as a Glyph record
+     *
+     * Content points into the mapping (valid while the snapshot is open).
+     */
+    void load(size_t i, Glyph& out) const;
+
+    // Copy every glyph into a GlyphStore (reads the whole file)
+    GlyphStore to_store() const;
+
+    // Ask the kernel to start reading the whole file in the background
+    void prefetch() const;
+
+private:
+    const char* column(const SnapshotColumnEntry* table, uint32_t c) const;
+    uint64_t column_bytes(uint32_t c) const;
+
+    std::string path_;
+    const char* base_;
+    size_t map_size_;
+    size_t count_;
+
+    const GlyphId* ids_;
+    const double* energy_;
+    const uint32_t* activation_count_;
+    const uint64_t* last_update_time_;
+    const GlyphId* parent1_ids_;
+    const GlyphId* parent2_ids_;
+    const uint64_t* content_offset_;
+    const uint32_t* content_len_;
+    const char* content_;
+    const uint64_t* document_offset_;
+    const uint32_t* document_len_;
+    const char* documents_;
+};
+
+/**
+ * Write a store as a snapshot (temp file, fsync, rename, fsync directory)
+ *
+ * Glyphs are reordered by ID; document columns are left empty.
+ *
+ * @throws std::invalid_argument if two glyphs share an ID
+ * @throws std::system_error on I/O errors
+ */
+void write_snapshot(const GlyphStore& store, const std::string& path);
+
+} // namespace spu
+
+#endif // SPU_SNAPSHOT_H
@@ -1,7 +1,7 @@
 """
-SPU merge Python wrapper using subprocess
+SPU merge Python wrapper
 
-Simple wrapper that calls the C++ merge_ref binary for testing.
+Pure Python merge with the same results as the C++ reference, for testing.
 For production, use the pybind11 bindings (bindings.cpp).
 """
 
@@ -0,0 +1,344 @@
+/**
+ * SPU Telemetry - Always-on latency histograms and counters
+ */
+
+#include "telemetry.h"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <system_error>
+#include <vector>
+
+namespace spu {
+
+namespace {
+
+struct HistogramInfo {
+    const char* name;
+    const char* help;
+    bool seconds;       // Recorded in ns, exported in seconds
+    unsigned lo_log2;   // Exported le bounds: 2^lo_log2 .. 2^hi_log2 (ns for latencies)
+    unsigned hi_log2;
+};
+
+// 256 ns to 17 s for latencies, 1 to 16M for sizes
+const HistogramInfo kHistograms[kTelemetryNumHistograms] = {
+    {"merge_batch_seconds", "GlyphStore merge_batch() call latency.", true, 8, 34},
+    {"merge_batch_pairs", "Pairs per GlyphStore merge_batch() call.", false, 0, 24},
+    {"tick_seconds", "TickScheduler tick latency (step and merges).", true, 8, 34},
+    {"merge_queue_depth", "MergeStage queued requests at each drain.", false, 0, 24},
+    {"merge_queue_wait_seconds", "MergeStage push() to sink latency per request.", true, 8, 34},
+    {"fsync_seconds", "Storage fsync / fdatasync latency.", true, 8, 34},
+    {"wal_commit_seconds", "WAL group commit latency (write and sync).", true, 8, 34},
+    {"fabric_round_seconds", "Cluster merge phase latency: sends to every peer until every reply is in.",
+     true, 8, 34},
+};
+
+struct CounterInfo {
+    const char* name;
+    const char* help;
+    const char* unit;  // "" for none
+};
+
+const CounterInfo kCounters[kTelemetryNumCounters] = {
+    {"merge_cache_hits", "MergeCache lookups that found the result.", ""},
+    {"merge_cache_misses", "MergeCache lookups that did not.", ""},
+    {"fabric_sent_bytes", "FabricChannel frame bytes sent.", "bytes"},
+    {"fabric_received_bytes", "FabricChannel frame bytes received.", "bytes"},
+};
+
+struct ThreadHistogram {
+    std::atomic<uint64_t> count{0};
+    std::atomic<uint64_t> sum{0};
+    std::atomic<uint64_t> max{0};
+    std::atomic<uint64_t> buckets[kTelemetryBuckets];
+
+    ThreadHistogram() {
+        for (auto& b : buckets) {
+            b.store(0, std::memory_order_relaxed);
+        }
+    }
+};
+
+// Per-thread state; owned by the registry so totals survive thread exit
+struct ThreadTelemetry {
+    std::atomic<ThreadHistogram*> histograms[kTelemetryNumHistograms];
+    std::atomic<uint64_t> counters[kTelemetryNumCounters];
+
+    ThreadTelemetry() {
+        for (auto& h : histograms) {
+            h.store(nullptr, std::memory_order_relaxed);
+        }
+        for (auto& c : counters) {
+            c.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    ~ThreadTelemetry() {
+        for (auto& h : histograms) {
+            delete h.load(std::memory_order_relaxed);
+        }
+    }
+};
+
+struct Registry {
+    std::mutex mutex;
+    std::vector<std::unique_ptr<ThreadTelemetry>> threads;
+    std::vector<ThreadTelemetry*> free;  // State of exited threads, reused by new ones
+};
+
+// Never destroyed: threads may record after static destructors have run
+Registry& registry() {
+    static Registry* r = new Registry();
+    return *r;
+}
+
+// Returns the thread's state to the registry when the thread exits
+struct ThreadSlot {
+    ThreadTelemetry* state = nullptr;
+
+    ~ThreadSlot() {
+        if (state) {
+            Registry& r = registry();
+            std::lock_guard<std::mutex> lock(r.mutex);
+            r.free.push_back(state);
+        }
+    }
+};
+
+ThreadTelemetry& this_thread_telemetry() {
+    thread_local ThreadSlot slot;
+    if (!slot.state) {
+        Registry& r = registry();
+        std::lock_guard<std::mutex> lock(r.mutex);
+        if (!r.free.empty()) {
+            slot.state = r.free.back();
+            r.free.pop_back();
+        } else {
+            r.threads.emplace_back(new ThreadTelemetry());
+            slot.state = r.threads.back().get();
+        }
+    }
+    return *slot.state;
+}
+
+// Only the owning thread writes its state; relaxed load + store is enough
+inline void bump(std::atomic<uint64_t>& v, uint64_t d) {
+    v.store(v.load(std::memory_order_relaxed) + d, std::memory_order_relaxed);
+}
+
+void append(std::string& out, const char* fmt, ...) __attribute__((format(printf, 2, 3)));
+
+void append(std::string& out, const char* fmt, ...) {
+    char buf[512];
+    va_list args;
+    va_start(args, fmt);
+    int n = vsnprintf(buf, sizeof(buf), fmt, args);
+    va_end(args);
+    if (n > 0) {
+        out.append(buf, std::min(static_cast<size_t>(n), sizeof(buf) - 1));
+    }
+}
+
+} // namespace
+
+double telemetry_bucket_upper(size_t b) {
+    if (b <= 16) {
+        return static_cast<double>(b);
+    }
+    const size_t g = (b - 1) / 16;
+    const size_t s = (b - 1) % 16;
+    return std::ldexp(static_cast<double>(17 + s), static_cast<int>(g) - 1);
+}
+
+double HistogramSnapshot::quantile(double q) const {
+    if (count == 0) {
+        return 0.0;
+    }
+    const double clamped = std::min(1.0, std::max(0.0, q));
+    const uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(clamped * count)));
+    uint64_t seen = 0;
+    for (size_t b = 0; b < kTelemetryBuckets; b++) {
+        seen += buckets[b];
+        if (seen >= rank) {
+            return std::min(telemetry_bucket_upper(b), static_cast<double>(max));
+        }
+    }
+    return static_cast<double>(max);
+}
+
+const char* telemetry_histogram_name(TelemetryHistogram h) {
+    return h < kTelemetryNumHistograms ? kHistograms[h].name : "unknown";
+}
+
+const char* telemetry_counter_name(TelemetryCounter c) {
+    return c < kTelemetryNumCounters ? kCounters[c].name : "unknown";
+}
+
+bool telemetry_enabled() {
+#ifdef SPU_NO_TELEMETRY
+    return false;
+#else
+    return true;
+#endif
+}
+
+void telemetry_record(TelemetryHistogram h, uint64_t value) {
+    ThreadTelemetry& t = this_thread_telemetry();
+    ThreadHistogram* hist = t.histograms[h].load(std::memory_order_relaxed);
+    if (!hist) {
+        hist = new ThreadHistogram();
+        t.histograms[h].store(hist, std::memory_order_release);
+    }
+    bump(hist->buckets[telemetry_bucket(value)], 1);
+    bump(hist->count, 1);
+    const uint64_t sum = hist->sum.load(std::memory_order_relaxed);
+    hist->sum.store(sum + value < sum ? UINT64_MAX : sum + value, std::memory_order_relaxed);
+    if (value > hist->max.load(std::memory_order_relaxed)) {
+        hist->max.store(value, std::memory_order_relaxed);
+    }
+}
+
+void telemetry_add(TelemetryCounter c, uint64_t n) {
+    bump(this_thread_telemetry().counters[c], n);
+}
+
+uint64_t telemetry_now_ns() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+void telemetry_snapshot(TelemetrySnapshot& out) {
+    memset(&out, 0, sizeof(out));
+    Registry& r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    for (const auto& t : r.threads) {
+        for (size_t h = 0; h < kTelemetryNumHistograms; h++) {
+            const ThreadHistogram* hist = t->histograms[h].load(std::memory_order_acquire);
+            if (!hist) {
+                continue;
+            }
+            HistogramSnapshot& s = out.histograms[h];
+            s.count += hist->count.load(std::memory_order_relaxed);
+            const uint64_t sum = hist->sum.load(std::memory_order_relaxed);
+            s.sum = s.sum + sum < s.sum ? UINT64_MAX : s.sum + sum;
+            s.max = std::max(s.max, hist->max.load(std::memory_order_relaxed));
+            for (size_t b = 0; b < kTelemetryBuckets; b++) {
+                s.buckets[b] += hist->buckets[b].load(std::memory_order_relaxed);
+            }
+        }
+        for (size_t c = 0; c < kTelemetryNumCounters; c++) {
+            out.counters[c] += t->counters[c].load(std::memory_order_relaxed);
+        }
+    }
+}
+
+void telemetry_reset() {
+    Registry& r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    for (const auto& t : r.threads) {
+        for (auto& h : t->histograms) {
+            ThreadHistogram* hist = h.load(std::memory_order_acquire);
+            if (!hist) {
+                continue;
+            }
+            hist->count.store(0, std::memory_order_relaxed);
+            hist->sum.store(0, std::memory_order_relaxed);
+            hist->max.store(0, std::memory_order_relaxed);
+            for (auto& b : hist->buckets) {
+                b.store(0, std::memory_order_relaxed);
+            }
+        }
+        for (auto& c : t->counters) {
+            c.store(0, std::memory_order_relaxed);
+        }
+    }
+}
+
+std::string telemetry_openmetrics(const TelemetrySnapshot& snapshot) {
+    std::string out;
+    for (size_t h = 0; h < kTelemetryNumHistograms; h++) {
+        const HistogramInfo& info = kHistograms[h];
+        const HistogramSnapshot& s = snapshot.histograms[h];
+        const double scale = info.seconds ? 1e-9 : 1.0;
+        append(out, "# TYPE spu_%s histogram\n", info.name);
+        if (info.seconds) {
+            append(out, "# UNIT spu_%s seconds\n", info.name);
+        }
+        append(out, "# HELP spu_%s %s\n", info.name, info.help);
+
+        // Cumulative counts at 2^k and 1.5 * 2^k; both are bucket upper bounds
+        uint64_t cumulative = 0;
+        size_t b = 0;
+        for (unsigned k = info.lo_log2; k <= info.hi_log2; k++) {
+            for (double bound : {std::ldexp(1.0, static_cast<int>(k)), std::ldexp(1.5, static_cast<int>(k))}) {
+                if (bound > std::ldexp(1.0, static_cast<int>(info.hi_log2))) {
+                    break;
+                }
+                while (b < kTelemetryBuckets && telemetry_bucket_upper(b) <= bound) {
+                    cumulative += s.buckets[b++];
+                }
+                append(out, "spu_%s_bucket{le=\"%.12g\"} %llu\n", info.name, bound * scale,
+                       static_cast<unsigned long long>(cumulative));
+            }
+        }
+        // Count from the buckets, so it matches +Inf even mid-record
+        uint64_t total = cumulative;
+        for (; b < kTelemetryBuckets; b++) {
+            total += s.buckets[b];
+        }
+        append(out, "spu_%s_bucket{le=\"+Inf\"} %llu\n", info.name, static_cast<unsigned long long>(total));
+        append(out, "spu_%s_sum %.12g\n", info.name, static_cast<double>(s.sum) * scale);
+        append(out, "spu_%s_count %llu\n", info.name, static_cast<unsigned long long>(total));
+    }
+    for (size_t c = 0; c < kTelemetryNumCounters; c++) {
+        const CounterInfo& info = kCounters[c];
+        append(out, "# TYPE spu_%s counter\n", info.name);
+        if (info.unit[0]) {
+            append(out, "# UNIT spu_%s %s\n", info.name, info.unit);
+        }
+        append(out, "# HELP spu_%s %s\n", info.name, info.help);
+        append(out, "spu_%s_total %llu\n", info.name, static_cast<unsigned long long>(snapshot.counters[c]));
+    }
+    out += "# EOF\n";
+    return out;
+}
+
+std::string telemetry_openmetrics() {
+    std::unique_ptr<TelemetrySnapshot> snapshot(new TelemetrySnapshot());
+    telemetry_snapshot(*snapshot);
+    return telemetry_openmetrics(*snapshot);
+}
+
+void telemetry_write(const std::string& path) {
+    const std::string text = telemetry_openmetrics();
+    const std::string tmp = path + ".tmp";
+    FILE* f = fopen(tmp.c_str(), "w");
+    if (!f) {
+        throw std::system_error(errno, std::generic_category(), "telemetry_write " + tmp);
+    }
+    bool ok = fwrite(text.data(), 1, text.size(), f) == text.size();
+    int err = ok ? 0 : errno;
+    if (fclose(f) != 0 && ok) {
+        ok = false;
+        err = errno;
+    }
+    if (!ok) {
+        remove(tmp.c_str());
+        throw std::system_error(err ? err : EIO, std::generic_category(), "telemetry_write " + tmp);
+    }
+    if (rename(tmp.c_str(), path.c_str()) != 0) {
+        err = errno;
+        remove(tmp.c_str());
+        throw std::system_error(err, std::generic_category(), "telemetry_write " + path);
+    }
+}
+
+} // namespace spu
@@ -0,0 +1,167 @@
+/**
+ * SPU Telemetry - Always-on latency histograms and counters
+ *
+ * The engines record into a fixed set of histograms (merge_batch latency
+ * and size, tick latency, merge queue depth and wait, fsync and WAL commit
+ * latency, fabric round trips) and counters (merge cache hits / misses,
+ * fabric bytes). Unlike perf_counters.h this is compiled in by default
+ * (-DSPU_NO_TELEMETRY removes it) and cheap enough to leave on:
+ *
+ *   - Every thread records into its own state, allocated on first use: a
+ *     record is a relaxed load + store on cache lines no other thread
+ *     writes, with no lock prefix and no sharing.
+ *   - Histograms are log-linear (HDR-style): values 0-16 are exact, and
+ *     every power of two above is split into 16 sub-buckets, so a recorded
+ *     value is known to within 1/16 (6%) up to 2^64 in 977 buckets. A
+ *     thread allocates the 8 KB of buckets of a histogram it first uses.
+ *   - Callers time whole batches, calls and round trips, never single
+ *     glyphs, so the one or two clock reads are amortized.
+ *
+ * telemetry_snapshot() sums every thread's state (threads that exited
+ * included: their state is kept and reused by the next new thread), and
+ * telemetry_openmetrics() renders it for a Prometheus / OpenMetrics scrape.
+ * A reader racing a writer sees each bucket either before or after the
+ * record, so a snapshot's count and buckets can disagree by in-flight
+ * records.
+ */
+
+#ifndef SPU_TELEMETRY_H
+#define SPU_TELEMETRY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace spu {
+
+enum TelemetryHistogram : uint32_t {
+    kHistMergeBatchNs = 0,  // GlyphStore merge_batch() call
+    kHistMergeBatchSize,    // Pairs per GlyphStore merge_batch() call
+    kHistTickNs,            // TickScheduler::tick() (step + merges)
+    kHistMergeQueueDepth,   // MergeStage queue depth at each drain
+    kHistMergeQueueWaitNs,  // MergeStage push() to sink, per request
+    kHistFsyncNs,           // Storage fsync / fdatasync of a file or directory
+    kHistWalCommitNs,       // WalWriter group commit: write + sync
+    kHistFabricRoundNs,     // ClusterNode phase: sends to every peer until every reply is in
+    kTelemetryNumHistograms,
+};
+
+enum TelemetryCounter : uint32_t {
+    kCountMergeCacheHits = 0,
+    kCountMergeCacheMisses,
+    kCountFabricSentBytes,      // Frame headers and bodies sent by FabricChannel
+    kCountFabricReceivedBytes,  // Frame headers and bodies received by FabricChannel
+    kTelemetryNumCounters,
+};
+
+// Buckets per histogram: 0-16 exact, then 16 per power of two up to 2^64
+constexpr size_t kTelemetryBuckets = 977;
+
+// Bucket of a value
+inline size_t telemetry_bucket(uint64_t v) {
+    if (v <= 16) {
+        return static_cast<size_t>(v);
+    }
+    // Bucket b > 16 holds (upper(b - 1), upper(b)], so upper bounds are round
+    const uint64_t u = v - 1;
+    const unsigned e = 63 - static_cast<unsigned>(__builtin_clzll(u));  // >= 4
+    return (e - 3) * 16 + static_cast<size_t>((u >> (e - 4)) & 15) + 1;
+}
+
+// Largest value in bucket b (as a double: the last bucket ends at 2^64)
+double telemetry_bucket_upper(size_t b);
+
+struct HistogramSnapshot {
+    uint64_t count;
+    uint64_t sum;  // Saturates at UINT64_MAX
+    uint64_t max;
+    uint64_t buckets[kTelemetryBuckets];
+
+    /**
+     * Value at quantile q (0-1): upper bound of the bucket holding it,
+     * capped at max (0 if empty)
+     */
+    double quantile(double q) const;
+    double mean() const { return count ? static_cast<double>(sum) / count : 0.0; }
+};
+
+struct TelemetrySnapshot {
+    HistogramSnapshot histograms[kTelemetryNumHistograms];
+    uint64_t counters[kTelemetryNumCounters];
+};
+
+// Metric names without the "spu_" prefix ("merge_batch_seconds", ...)
+const char* telemetry_histogram_name(TelemetryHistogram h);
+const char* telemetry_counter_name(TelemetryCounter c);
+
+// True unless built with SPU_NO_TELEMETRY
+bool telemetry_enabled();
+
+// Record one value (nanoseconds for *Ns histograms) on this thread
+void telemetry_record(TelemetryHistogram h, uint64_t value);
+
+// Add to a counter on this thread
+void telemetry_add(TelemetryCounter c, uint64_t n = 1);
+
+// steady_clock nanoseconds, the clock for *Ns histograms
+uint64_t telemetry_now_ns();
+
+// Sum of every thread's histograms and counters
+void telemetry_snapshot(TelemetrySnapshot& out);
+
+// Zero every thread's state (records racing the reset may survive it)
+void telemetry_reset();
+
+/**
+ * OpenMetrics text exposition of a snapshot (or of a fresh one)
+ *
+ * Histograms are exported as spu_<name> families with le bounds at 1 and
+ * 1.5 times each power of two over a fixed per-metric range (seconds for
+ * latencies), so series are stable between scrapes; counters as
+ * spu_<name>_total. Ends with "# EOF".
+ */
+std::string telemetry_openmetrics(const TelemetrySnapshot& snapshot);
+std::string telemetry_openmetrics();
+
+/**
+ * Write telemetry_openmetrics() to path via a temporary file and rename,
+ * so a scraper (e.g. node_exporter's textfile collector) never reads a
+ * partial file
+ *
+ * @throws std::system_error if the file cannot be written
+ */
+void telemetry_write(const std::string& path);
+
+/**
+ * Record the time from construction to destruction in nanoseconds
+ */
+class TelemetryTimer {
+public:
+    explicit TelemetryTimer(TelemetryHistogram h) : h_(h), start_(telemetry_now_ns()) {}
+    ~TelemetryTimer() { telemetry_record(h_, telemetry_now_ns() - start_); }
+
+    TelemetryTimer(const TelemetryTimer&) = delete;
+    TelemetryTimer& operator=(const TelemetryTimer&) = delete;
+
+private:
+    TelemetryHistogram h_;
+    uint64_t start_;
+};
+
+} // namespace spu
+
+#define SPU_TELEMETRY_CONCAT_(a, b) a##b
+#define SPU_TELEMETRY_CONCAT(a, b) SPU_TELEMETRY_CONCAT_(a, b)
+
+#ifndef SPU_NO_TELEMETRY
+#define SPU_TELEMETRY_TIMER(h) \
+    ::spu::TelemetryTimer SPU_TELEMETRY_CONCAT(spu_telemetry_timer_, __LINE__)(h)
+#define SPU_TELEMETRY_RECORD(h, value) ::spu::telemetry_record((h), (value))
+#define SPU_TELEMETRY_ADD(c, n) ::spu::telemetry_add((c), (n))
+#else
+#define SPU_TELEMETRY_TIMER(h) ((void)0)
+#define SPU_TELEMETRY_RECORD(h, value) ((void)0)
+#define SPU_TELEMETRY_ADD(c, n) ((void)0)
+#endif
+
+#endif // SPU_TELEMETRY_H
@@ -0,0 +1,250 @@
+/**
+ * SPU Thread Pool - Fixed worker pool for batch kernels
+ */
+
+#include "thread_pool.h"
+#include <algorithm>
+#include <cstdlib>
+
+namespace spu {
+
+static uint64_t pack_run(uint32_t begin, uint32_t end) {
+    return uint64_t(begin) << 32 | end;
+}
+
+// Pool whose chunks this thread is running (a nested parallel_for on it runs inline)
+static thread_local const ThreadPool* t_running_pool = nullptr;
+
+static size_t resolve_thread_count(size_t num_threads) {
+    if (num_threads == 0) {
+        num_threads = std::thread::hardware_concurrency();
+    }
+    return std::max<size_t>(num_threads, 1);
+}
+
+ThreadPool::ThreadPool(size_t num_threads) {
+    size_t workers = resolve_thread_count(num_threads) - 1;
+    runs_.reset(new ChunkRun[workers + 1]);
+    workers_.reserve(workers);
+    for (size_t i = 0; i < workers; i++) {
+        workers_.emplace_back([this, i] { worker_loop(i + 1); });
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    wake_.notify_all();
+    for (std::thread& t : workers_) {
+        t.join();
+    }
+}
+
+void ThreadPool::worker_loop(size_t self) {
+    uint64_t seen = 0;
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            wake_.wait(lock, [&] { return stop_ || generation_ != seen; });
+            if (stop_) {
+                return;
+            }
+            seen = generation_;
+        }
+
+        run_chunks(self);
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (--active_ == 0) {
+            done_.notify_all();
+        }
+    }
+}
+
+bool ThreadPool::steal(size_t self, uint32_t& chunk) {
+    for (;;) {
+        // Victim: the largest remaining run
+        size_t victim = self;
+        uint64_t span = 0;
+        uint32_t largest = 0;
+        for (size_t t = 0; t < num_threads(); t++) {
+            uint64_t s = runs_[t].span.load(std::memory_order_acquire);
+            uint32_t left = uint32_t(s) > uint32_t(s >> 32) ? uint32_t(s) - uint32_t(s >> 32) : 0;
+            if (t != self && left > largest) {
+                victim = t;
+                span = s;
+                largest = left;
+            }
+        }
+        if (victim == self) {
+            return false;
+        }
+
+        // Take [mid, end), leave the victim [begin, mid)
+        uint32_t begin = uint32_t(span >> 32);
+        uint32_t end = uint32_t(span);
+        uint32_t mid = begin + (end - begin) / 2;
+        if (runs_[victim].span.compare_exchange_strong(span, pack_run(begin, mid),
+                                                       std::memory_order_acq_rel)) {
+            chunk = mid;
+            runs_[self].span.store(pack_run(mid + 1, end), std::memory_order_release);
+            return true;
+        }
+    }
+}
+
+void ThreadPool::run_chunks(size_t self) {
+    struct RunningGuard {
+        const ThreadPool* outer;
+        explicit RunningGuard(const ThreadPool* pool) : outer(t_running_pool) {
+            t_running_pool = pool;
+        }
+        ~RunningGuard() { t_running_pool = outer; }
+    } running(this);
+
+    std::atomic<uint64_t>& own = runs_[self].span;
+    for (;;) {
+        uint32_t chunk;
+        uint64_t span = own.load(std::memory_order_acquire);
+        for (;;) {
+            uint32_t begin = uint32_t(span >> 32);
+            uint32_t end = uint32_t(span);
+            if (begin >= end) {
+                if (!steal(self, chunk)) {
+                    return;
+                }
+                break;
+            }
+            if (own.compare_exchange_weak(span, pack_run(begin + 1, end),
+                                          std::memory_order_acq_rel)) {
+                chunk = begin;
+                break;
+            }
+        }
+
+        size_t first = size_t(chunk) * chunk_;
+        try {
+            (*fn_)(first, std::min(n_, first + chunk_));
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!error_) {
+                error_ = std::current_exception();
+            }
+        }
+    }
+}
+
+void ThreadPool::parallel_for(size_t n, size_t grain, const RangeFn& fn) {
+    if (n == 0) {
+        return;
+    }
+    grain = std::max<size_t>(grain, 1);
+    // Nested call from fn: the caller thread may hold job_mutex_ already
+    if (workers_.empty() || n <= grain || t_running_pool == this) {
+        fn(0, n);
+        return;
+    }
+
+    std::unique_lock<std::mutex> job(job_mutex_, std::try_to_lock);
+    if (!job.owns_lock()) {
+        fn(0, n);
+        return;
+    }
+
+    // About four chunks per thread for load balance, rounded to grain
+    size_t target = (n + 4 * num_threads() - 1) / (4 * num_threads());
+    size_t chunk = std::max<size_t>(1, (target + grain - 1) / grain) * grain;
+
+    // Contiguous runs of chunks, one per thread
+    size_t chunks = (n + chunk - 1) / chunk;
+    if (chunks > UINT32_MAX) {
+        chunk = (n + UINT32_MAX - 1) / UINT32_MAX;
+        chunks = (n + chunk - 1) / chunk;
+    }
+    for (size_t t = 0; t < num_threads(); t++) {
+        runs_[t].span.store(pack_run(static_cast<uint32_t>(chunks * t / num_threads()),
+                                     static_cast<uint32_t>(chunks * (t + 1) / num_threads())),
+                            std::memory_order_relaxed);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        fn_ = &fn;
+        n_ = n;
+        chunk_ = chunk;
+        error_ = nullptr;
+        active_ = workers_.size();
+        generation_++;
+    }
+    wake_.notify_all();
+
+    run_chunks(0);
+
+    std::exception_ptr error;
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        done_.wait(lock, [&] { return active_ == 0; });
+        fn_ = nullptr;
+        error = error_;
+        error_ = nullptr;
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+namespace {
+
+size_t default_thread_count() {
+    const char* env = std::getenv("SPU_NUM_THREADS");
+    if (env && *env) {
+        long n = std::strtol(env, nullptr, 10);
+        if (n > 0) {
+            return static_cast<size_t>(n);
+        }
+    }
+    return 0;
+}
+
+std::mutex& default_pool_mutex() {
+    static std::mutex m;
+    return m;
+}
+
+std::shared_ptr<ThreadPool>& default_pool_slot() {
+    static std::shared_ptr<ThreadPool> pool;
+    return pool;
+}
+
+} // namespace
+
+std::shared_ptr<ThreadPool> default_thread_pool() {
+    std::lock_guard<std::mutex> lock(default_pool_mutex());
+    std::shared_ptr<ThreadPool>& pool = default_pool_slot();
+    if (!pool) {
+        pool = std::make_shared<ThreadPool>(default_thread_count());
+    }
+    return pool;
+}
+
+void set_num_threads(size_t num_threads) {
+    std::shared_ptr<ThreadPool> old;
+    {
+        std::lock_guard<std::mutex> lock(default_pool_mutex());
+        std::shared_ptr<ThreadPool>& pool = default_pool_slot();
+        if (pool && pool->num_threads() == resolve_thread_count(num_threads)) {
+            return;
+        }
+        old = std::move(pool);
+        pool = std::make_shared<ThreadPool>(num_threads);
+    }
+    // old joins its workers here (or when its last running job releases it)
+}
+
+size_t num_threads() {
+    return default_thread_pool()->num_threads();
+}
+
+} // namespace spu
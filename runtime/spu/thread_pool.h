@@ -0,0 +1,128 @@
+/**
+ * SPU Thread Pool - Fixed worker pool for batch kernels
+ *
+ * parallel_for() splits an index range into chunks and gives each thread
+ * (workers and the caller) one contiguous run of them. A thread takes
+ * chunks from the front of its own run; once that is empty it steals the
+ * back half of the largest remaining run. Chunk i lands on the same thread
+ * on every call unless it is stolen, so repeated passes over a store stay
+ * in that thread's cache. Kernels write disjoint output ranges, so results
+ * do not depend on the thread count or on which thread ran a chunk.
+ *
+ * The SPU_NUM_THREADS environment variable sets the default pool size
+ * (otherwise std::thread::hardware_concurrency()).
+ */
+
+#ifndef SPU_THREAD_POOL_H
+#define SPU_THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace spu {
+
+class ThreadPool {
+public:
+    /**
+     * Range callback: process indices [begin, end)
+     *
+     * Refers to the callable without owning it: parallel_for() never keeps
+     * it past the call, and unlike std::function a capturing lambda costs
+     * no heap allocation. The callable must outlive the RangeFn.
+     */
+    class RangeFn {
+    public:
+        template <typename Fn, typename = typename std::enable_if<
+                                   !std::is_same<typename std::decay<Fn>::type, RangeFn>::value>::type>
+        RangeFn(Fn&& fn)  // Implicit, like std::function
+            : obj_(const_cast<void*>(static_cast<const void*>(std::addressof(fn)))),
+              call_([](void* obj, size_t begin, size_t end) {
+                  (*static_cast<typename std::remove_reference<Fn>::type*>(obj))(begin, end);
+              }) {}
+
+        void operator()(size_t begin, size_t end) const { call_(obj_, begin, end); }
+
+    private:
+        void* obj_;
+        void (*call_)(void*, size_t, size_t);
+    };
+
+    /**
+     * @param num_threads Threads including the caller (0 = hardware concurrency)
+     */
+    explicit ThreadPool(size_t num_threads = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Threads that run a parallel_for (workers + calling thread)
+    size_t num_threads() const { return workers_.size() + 1; }
+
+    /**
+     * Run fn over [0, n) in chunks that are multiples of grain
+     *
+     * Blocks until every chunk is done. Ranges of at most grain run inline,
+     * as do nested calls from fn on the same pool; if the pool is already
+     * running another job (e.g. from a second Python thread), the range
+     * also runs inline on the caller.
+     *
+     * @throws The first exception thrown by fn
+     */
+    void parallel_for(size_t n, size_t grain, const RangeFn& fn);
+
+private:
+    // Chunks [begin, end) left to one thread, packed begin << 32 | end
+    struct alignas(64) ChunkRun {
+        std::atomic<uint64_t> span{0};
+    };
+
+    void worker_loop(size_t self);
+    void run_chunks(size_t self);
+    bool steal(size_t self, uint32_t& chunk);
+
+    std::vector<std::thread> workers_;
+
+    std::mutex job_mutex_;  // One job at a time
+
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::condition_variable done_;
+    uint64_t generation_ = 0;
+    size_t active_ = 0;     // Workers still in the current job
+    bool stop_ = false;
+
+    // Current job (published under mutex_)
+    const RangeFn* fn_ = nullptr;
+    size_t n_ = 0;
+    size_t chunk_ = 0;
+    std::unique_ptr<ChunkRun[]> runs_;  // Per thread: [0] caller, [i + 1] workers_[i]
+    std::exception_ptr error_;
+};
+
+/**
+ * Process-wide pool used by the Python bindings
+ */
+std::shared_ptr<ThreadPool> default_thread_pool();
+
+/**
+ * Resize the default pool (0 = hardware concurrency)
+ *
+ * Jobs already running keep the old pool until they finish.
+ */
+void set_num_threads(size_t num_threads);
+
+// Size of the default pool
+size_t num_threads();
+
+} // namespace spu
+
+#endif // SPU_THREAD_POOL_H
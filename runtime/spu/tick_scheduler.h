@@ -0,0 +1,81 @@
+/**
+ * SPU Tick Scheduler - Sharded, parallel dynamics ticks
+ *
+ * A tick is one dynamics step (decay, then activation) over every glyph,
+ * followed by a batch of merges that read the post-step store. The step
+ * splits the store into cache-sized shards of consecutive glyphs that run
+ * on the pool's work-stealing threads; the merges run merge_batch() over
+ * the same pool.
+ *
+ * Every glyph's step and every merge result depend only on their own
+ * inputs, and per-shard counts are reduced in shard order, so a tick is
+ * bit-identical to the single-threaded DynamicsEngine::step() + merge()
+ * sequence for any thread count or shard size.
+ */
+
+#ifndef SPU_TICK_SCHEDULER_H
+#define SPU_TICK_SCHEDULER_H
+
+#include "dynamics.h"
+#include "glyph_store.h"
+#include "thread_pool.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace spu {
+
+// Outcome of one tick
+struct TickStats {
+    size_t activated = 0;  // Glyphs at or over the threshold after decay
+    size_t merged = 0;     // Results appended to the merged store
+};
+
+class TickScheduler {
+public:
+    // Glyphs per shard: ~320 KB of hot columns (energy, count, time), sized for L2
+    static constexpr size_t kDefaultShardGlyphs = 16384;
+
+    /**
+     * @param engine Decay / activation rules
+     * @param pool Threads to run on (nullptr = calling thread only)
+     * @param shard_glyphs Glyphs per shard (0 = kDefaultShardGlyphs)
+     */
+    explicit TickScheduler(const DynamicsEngine& engine, ThreadPool* pool = nullptr,
+                           size_t shard_glyphs = kDefaultShardGlyphs);
+
+    size_t shard_glyphs() const { return shard_glyphs_; }
+    size_t num_shards(const GlyphStore& store) const {
+        return (store.size() + shard_glyphs_ - 1) / shard_glyphs_;
+    }
+
+    /**
+     * Step every shard of the store
+     *
+     * @param activated Optional per-glyph output flags (size() entries)
+     * @return Number of glyphs activated
+     */
+    size_t step(GlyphStore& store, uint64_t time_delta = 1, uint8_t* activated = nullptr);
+
+    /**
+     * One tick: step the store, then merge n index pairs of the stepped
+     * store, appending the results to merged
+     *
+     * @param merged Destination store (must not be store)
+     * @throws std::invalid_argument if merged is store
+     * @throws std::out_of_range if a pair indexes past the store
+     */
+    TickStats tick(GlyphStore& store, uint64_t time_delta, const MergePair* pairs, size_t n,
+                   GlyphStore& merged, uint8_t* activated = nullptr);
+
+private:
+    DynamicsEngine engine_;
+    ThreadPool* pool_;
+    size_t shard_glyphs_;
+    std::vector<size_t> shard_activated_;  // Per-shard counts of the last step
+};
+
+} // namespace spu
+
+#endif // SPU_TICK_SCHEDULER_H
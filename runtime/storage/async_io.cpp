@@ -0,0 +1,509 @@
+/**
+ * SPU Storage Async I/O - io_uring write path with a thread-pool fallback
+ */
+
+#include "async_io.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <system_error>
+
+#if defined(__linux__)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#define SPU_HAVE_IO_URING 1
+#endif
+#include <unistd.h>
+
+namespace spu {
+
+struct AsyncIo::Op {
+    std::promise<size_t> promise;
+    std::vector<Write> writes;  // Thread-pool backend only
+    int sync_fd;
+    SyncMode sync;
+    int buffer_index;   // Released on completion (-1 = none)
+    size_t expected;    // Bytes to write
+    size_t bytes;       // Bytes written
+    int error;          // First errno
+    unsigned remaining; // io_uring: CQEs still to reap
+};
+
+#ifdef SPU_HAVE_IO_URING
+
+namespace {
+
+int sys_io_uring_setup(unsigned entries, io_uring_params* p) {
+    return static_cast<int>(syscall(__NR_io_uring_setup, entries, p));
+}
+
+int sys_io_uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags) {
+    return static_cast<int>(
+        syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, nullptr, 0));
+}
+
+int sys_io_uring_register(int fd, unsigned opcode, void* arg, unsigned nr_args) {
+    return static_cast<int>(syscall(__NR_io_uring_register, fd, opcode, arg, nr_args));
+}
+
+} // namespace
+
+struct AsyncIo::Ring {
+    int fd = -1;
+    unsigned sq_entries = 0;
+    unsigned cq_entries = 0;
+
+    void* sq_ptr = nullptr;
+    size_t sq_bytes = 0;
+    void* cq_ptr = nullptr;
+    size_t cq_bytes = 0;
+    io_uring_sqe* sqes = nullptr;
+    size_t sqes_bytes = 0;
+
+    unsigned* sq_head = nullptr;
+    unsigned* sq_tail = nullptr;
+    unsigned* sq_mask = nullptr;
+    unsigned* sq_array = nullptr;
+    unsigned* cq_head = nullptr;
+    unsigned* cq_tail = nullptr;
+    unsigned* cq_mask = nullptr;
+    io_uring_cqe* cqes = nullptr;
+
+    ~Ring() {
+        if (sqes) {
+            munmap(sqes, sqes_bytes);
+        }
+        if (cq_ptr && cq_ptr != sq_ptr) {
+            munmap(cq_ptr, cq_bytes);
+        }
+        if (sq_ptr) {
+            munmap(sq_ptr, sq_bytes);
+        }
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+
+    // Next SQE slot (caller holds the submission lock and has checked space)
+    io_uring_sqe* next_sqe(unsigned& tail) {
+        unsigned idx = tail & *sq_mask;
+        io_uring_sqe* sqe = &sqes[idx];
+        memset(sqe, 0, sizeof(*sqe));
+        sq_array[idx] = idx;
+        tail++;
+        return sqe;
+    }
+
+    // Publish SQEs up to tail and submit them
+    void submit(unsigned tail, unsigned count) {
+        __atomic_store_n(sq_tail, tail, __ATOMIC_RELEASE);
+        while (count > 0) {
+            int n = sys_io_uring_enter(fd, count, 0, 0);
+            if (n < 0) {
+                if (errno == EINTR || errno == EAGAIN) {
+                    continue;
+                }
+                throw std::system_error(errno, std::generic_category(), "io_uring_enter");
+            }
+            count -= static_cast<unsigned>(n);
+        }
+    }
+};
+
+bool AsyncIo::setup_ring() {
+    std::unique_ptr<Ring> r(new Ring());
+    io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    r->fd = sys_io_uring_setup(options_.queue_depth, &p);
+    if (r->fd < 0) {
+        return false;
+    }
+    r->sq_entries = p.sq_entries;
+    r->cq_entries = p.cq_entries;
+
+    r->sq_bytes = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    r->cq_bytes = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+    const bool single_mmap = p.features & IORING_FEAT_SINGLE_MMAP;
+    if (single_mmap) {
+        r->sq_bytes = r->cq_bytes = std::max(r->sq_bytes, r->cq_bytes);
+    }
+    void* sq = mmap(nullptr, r->sq_bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                    r->fd, IORING_OFF_SQ_RING);
+    if (sq == MAP_FAILED) {
+        return false;
+    }
+    r->sq_ptr = sq;
+    if (single_mmap) {
+        r->cq_ptr = sq;
+    } else {
+        void* cq = mmap(nullptr, r->cq_bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                        r->fd, IORING_OFF_CQ_RING);
+        if (cq == MAP_FAILED) {
+            return false;
+        }
+        r->cq_ptr = cq;
+    }
+    r->sqes_bytes = p.sq_entries * sizeof(io_uring_sqe);
+    void* sqes = mmap(nullptr, r->sqes_bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                      r->fd, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED) {
+        return false;
+    }
+    r->sqes = static_cast<io_uring_sqe*>(sqes);
+
+    char* sqb = static_cast<char*>(r->sq_ptr);
+    char* cqb = static_cast<char*>(r->cq_ptr);
+    r->sq_head = reinterpret_cast<unsigned*>(sqb + p.sq_off.head);
+    r->sq_tail = reinterpret_cast<unsigned*>(sqb + p.sq_off.tail);
+    r->sq_mask = reinterpret_cast<unsigned*>(sqb + p.sq_off.ring_mask);
+    r->sq_array = reinterpret_cast<unsigned*>(sqb + p.sq_off.array);
+    r->cq_head = reinterpret_cast<unsigned*>(cqb + p.cq_off.head);
+    r->cq_tail = reinterpret_cast<unsigned*>(cqb + p.cq_off.tail);
+    r->cq_mask = reinterpret_cast<unsigned*>(cqb + p.cq_off.ring_mask);
+    r->cqes = reinterpret_cast<io_uring_cqe*>(cqb + p.cq_off.cqes);
+
+    // Every opcode used here must be supported (IORING_OP_WRITE needs 5.6)
+    const size_t probe_bytes = sizeof(io_uring_probe) + 256 * sizeof(io_uring_probe_op);
+    std::unique_ptr<char[]> probe_buf(new char[probe_bytes]());
+    io_uring_probe* probe = reinterpret_cast<io_uring_probe*>(probe_buf.get());
+    if (sys_io_uring_register(r->fd, IORING_REGISTER_PROBE, probe, 256) < 0) {
+        return false;
+    }
+    for (unsigned op : {IORING_OP_WRITE, IORING_OP_WRITE_FIXED, IORING_OP_FSYNC, IORING_OP_NOP}) {
+        if (op > probe->last_op || !(probe->ops[op].flags & IO_URING_OP_SUPPORTED)) {
+            return false;
+        }
+    }
+
+    if (!buffers_.empty()) {
+        std::vector<iovec> iov(buffers_.size());
+        for (size_t i = 0; i < buffers_.size(); i++) {
+            iov[i].iov_base = buffers_[i];
+            iov[i].iov_len = options_.buffer_size;
+        }
+        // Can fail under RLIMIT_MEMLOCK; fixed writes then use plain writes
+        buffers_registered_ = sys_io_uring_register(r->fd, IORING_REGISTER_BUFFERS, iov.data(),
+                                                    static_cast<unsigned>(iov.size())) == 0;
+    }
+
+    ring_ = std::move(r);
+    return true;
+}
+
+void AsyncIo::reap_loop() {
+    Ring& r = *ring_;
+    for (;;) {
+        unsigned head = *r.cq_head;
+        unsigned tail = __atomic_load_n(r.cq_tail, __ATOMIC_ACQUIRE);
+        if (head == tail) {
+            if (sys_io_uring_enter(r.fd, 0, 1, IORING_ENTER_GETEVENTS) < 0 && errno != EINTR) {
+                // Nothing sensible to do without a working ring; completions are lost
+                return;
+            }
+            continue;
+        }
+
+        bool exit = false;
+        size_t reaped = 0;
+        for (; head != tail; head++) {
+            const io_uring_cqe& cqe = r.cqes[head & *r.cq_mask];
+            uint64_t user_data = cqe.user_data;
+            int res = cqe.res;
+            reaped++;
+            if (user_data == 0) {
+                exit = true;  // Shutdown NOP
+                continue;
+            }
+            Op* op = reinterpret_cast<Op*>(user_data);
+            if (res < 0) {
+                if (op->error == 0) {
+                    op->error = -res;
+                }
+            } else {
+                op->bytes += static_cast<size_t>(res);
+            }
+            if (--op->remaining == 0) {
+                complete(op);
+            }
+        }
+        __atomic_store_n(r.cq_head, head, __ATOMIC_RELEASE);
+
+        {
+            std::lock_guard<std::mutex> lock(mu_);
+            inflight_sqes_ -= reaped;
+        }
+        space_cv_.notify_all();
+        if (exit) {
+            return;
+        }
+    }
+}
+
+#else
+
+struct AsyncIo::Ring {};
+
+bool AsyncIo::setup_ring() {
+    return false;
+}
+
+void AsyncIo::reap_loop() {}
+
+#endif // SPU_HAVE_IO_URING
+
+AsyncIo::AsyncIo(const Options& options)
+    : options_(options),
+      backend_(Backend::kThreadPool),
+      inflight_sqes_(0),
+      inflight_ops_(0),
+      stop_(false),
+      buffers_registered_(false) {
+    for (size_t i = 0; i < options_.buffer_count; i++) {
+        void* p = aligned_alloc(4096, (options_.buffer_size + 4095) / 4096 * 4096);
+        if (!p) {
+            for (char* b : buffers_) {
+                free(b);
+            }
+            throw std::bad_alloc();
+        }
+        buffers_.push_back(static_cast<char*>(p));
+        free_buffers_.push_back(i);
+    }
+
+    if (options_.backend == Backend::kIoUring && setup_ring()) {
+        backend_ = Backend::kIoUring;
+        reaper_ = std::thread([this] { reap_loop(); });
+    } else {
+        for (size_t i = 0; i < std::max<size_t>(options_.fallback_threads, 1); i++) {
+            workers_.emplace_back([this] { worker_loop(); });
+        }
+    }
+}
+
+AsyncIo::~AsyncIo() {
+    std::unique_lock<std::mutex> lock(mu_);
+    space_cv_.wait(lock, [&] { return inflight_ops_ == 0; });
+    stop_ = true;
+
+#ifdef SPU_HAVE_IO_URING
+    if (ring_) {
+        // Wake the reaper with a NOP whose user_data (0) means "exit"
+        unsigned tail = *ring_->sq_tail;
+        io_uring_sqe* sqe = ring_->next_sqe(tail);
+        sqe->opcode = IORING_OP_NOP;
+        sqe->user_data = 0;
+        try {
+            ring_->submit(tail, 1);
+        } catch (...) {
+            lock.unlock();
+            reaper_.detach();
+            return;
+        }
+        lock.unlock();
+        reaper_.join();
+    }
+#endif
+    if (lock.owns_lock()) {
+        lock.unlock();
+    }
+    queue_cv_.notify_all();
+    for (auto& w : workers_) {
+        w.join();
+    }
+    for (char* b : buffers_) {
+        free(b);
+    }
+}
+
+const char* AsyncIo::backend_name() const {
+    return backend_ == Backend::kIoUring ? "io_uring" : "thread_pool";
+}
+
+size_t AsyncIo::in_flight() const {
+    std::lock_guard<std::mutex> lock(mu_);
+    return inflight_ops_;
+}
+
+size_t AsyncIo::acquire_buffer() {
+    if (buffers_.empty()) {
+        throw std::logic_error("AsyncIo has no registered buffers");
+    }
+    std::unique_lock<std::mutex> lock(mu_);
+    space_cv_.wait(lock, [&] { return !free_buffers_.empty(); });
+    size_t index = free_buffers_.back();
+    free_buffers_.pop_back();
+    return index;
+}
+
+void AsyncIo::release_buffer(size_t index) {
+    {
+        std::lock_guard<std::mutex> lock(mu_);
+        free_buffers_.push_back(index);
+    }
+    space_cv_.notify_all();
+}
+
+void AsyncIo::complete(Op* op) {
+    if (op->error == 0 && op->bytes != op->expected) {
+        op->error = EIO;  // Short write
+    }
+    if (op->buffer_index >= 0) {
+        release_buffer(static_cast<size_t>(op->buffer_index));
+    }
+    if (op->error != 0) {
+        op->promise.set_exception(std::make_exception_ptr(
+            std::system_error(op->error, std::generic_category(), "async write")));
+    } else {
+        op->promise.set_value(op->bytes);
+    }
+    delete op;
+
+    {
+        std::lock_guard<std::mutex> lock(mu_);
+        inflight_ops_--;
+    }
+    space_cv_.notify_all();
+}
+
+std::future<size_t> AsyncIo::write_batch(const Write* writes, size_t n, SyncMode sync) {
+    int fd = n > 0 ? writes[n - 1].fd : -1;
+    return submit(writes, n, sync == SyncMode::kNone ? -1 : fd, sync, -1);
+}
+
+std::future<size_t> AsyncIo::sync(int fd, SyncMode mode) {
+    return submit(nullptr, 0, mode == SyncMode::kNone ? -1 : fd, mode, -1);
+}
+
+std::future<size_t> AsyncIo::write_fixed(int fd, size_t index, size_t len, uint64_t offset,
+                                         SyncMode sync) {
+    if (index >= buffers_.size() || len > options_.buffer_size) {
+        throw std::invalid_argument("write_fixed: bad buffer index or length");
+    }
+    Write w{fd, buffers_[index], len, offset};
+    return submit(&w, 1, sync == SyncMode::kNone ? -1 : fd, sync, static_cast<int>(index));
+}
+
+std::future<size_t> AsyncIo::submit(const Write* writes, size_t n, int sync_fd, SyncMode sync,
+                                    int buffer_index) {
+    Op* op = new Op();
+    op->sync_fd = sync_fd;
+    op->sync = sync;
+    op->buffer_index = buffer_index;
+    op->expected = 0;
+    op->bytes = 0;
+    op->error = 0;
+    for (size_t i = 0; i < n; i++) {
+        if (writes[i].len > 0x7ffff000u) {
+            delete op;
+            throw std::invalid_argument("async write larger than 2 GiB");
+        }
+        op->expected += writes[i].len;
+    }
+    const unsigned sqes = static_cast<unsigned>(n) + (sync_fd >= 0 ? 1 : 0);
+    op->remaining = sqes;
+    std::future<size_t> future = op->promise.get_future();
+
+    if (sqes == 0) {
+        op->promise.set_value(0);
+        delete op;
+        return future;
+    }
+
+#ifdef SPU_HAVE_IO_URING
+    if (ring_) {
+        Ring& r = *ring_;
+        if (sqes > r.sq_entries) {
+            delete op;
+            throw std::invalid_argument("async batch larger than the submission queue");
+        }
+        std::unique_lock<std::mutex> lock(mu_);
+        // Never let completions outrun the CQ
+        space_cv_.wait(lock, [&] { return inflight_sqes_ + sqes <= r.cq_entries; });
+
+        unsigned tail = *r.sq_tail;
+        for (size_t i = 0; i < n; i++) {
+            io_uring_sqe* sqe = r.next_sqe(tail);
+            if (buffer_index >= 0 && buffers_registered_) {
+                sqe->opcode = IORING_OP_WRITE_FIXED;
+                sqe->buf_index = static_cast<uint16_t>(buffer_index);
+            } else {
+                sqe->opcode = IORING_OP_WRITE;
+            }
+            sqe->fd = writes[i].fd;
+            sqe->addr = reinterpret_cast<uint64_t>(writes[i].data);
+            sqe->len = static_cast<uint32_t>(writes[i].len);
+            sqe->off = writes[i].offset;
+            sqe->user_data = reinterpret_cast<uint64_t>(op);
+            if (i + 1 < sqes) {
+                sqe->flags = IOSQE_IO_LINK;  // Later SQEs start after this one succeeds
+            }
+        }
+        if (sync_fd >= 0) {
+            io_uring_sqe* sqe = r.next_sqe(tail);
+            sqe->opcode = IORING_OP_FSYNC;
+            sqe->fd = sync_fd;
+            sqe->fsync_flags = sync == SyncMode::kFdatasync ? IORING_FSYNC_DATASYNC : 0;
+            sqe->user_data = reinterpret_cast<uint64_t>(op);
+        }
+        inflight_sqes_ += sqes;
+        inflight_ops_++;
+        r.submit(tail, sqes);
+        return future;
+    }
+#endif
+
+    op->writes.assign(writes, writes + n);
+    {
+        std::lock_guard<std::mutex> lock(mu_);
+        inflight_ops_++;
+        queue_.push_back(op);
+    }
+    queue_cv_.notify_one();
+    return future;
+}
+
+void AsyncIo::worker_loop() {
+    for (;;) {
+        Op* op;
+        {
+            std::unique_lock<std::mutex> lock(mu_);
+            queue_cv_.wait(lock, [&] { return stop_ || !queue_.empty(); });
+            if (queue_.empty()) {
+                return;
+            }
+            op = queue_.front();
+            queue_.pop_front();
+        }
+
+        try {
+            for (const Write& w : op->writes) {
+                const char* p = static_cast<const char*>(w.data);
+                size_t done = 0;
+                while (done < w.len) {
+                    ssize_t k = pwrite(w.fd, p + done, w.len - done,
+                                       static_cast<off_t>(w.offset + done));
+                    if (k < 0) {
+                        if (errno == EINTR) {
+                            continue;
+                        }
+                        throw std::system_error(errno, std::generic_category(), "pwrite");
+                    }
+                    done += static_cast<size_t>(k);
+                }
+                op->bytes += done;
+            }
+            if (op->sync_fd >= 0) {
+                sync_fd(op->sync_fd, op->sync);
+            }
+        } catch (const std::system_error& e) {
+            op->error = e.code().value();
+        }
+        complete(op);
+    }
+}
+
+} // namespace spu
@@ -0,0 +1,106 @@
+/**
+ * SPU Storage CRC32C - Record checksums
+ */
+
+#include "crc32c.h"
+#include <cstring>
+
+#if defined(__x86_64__)
+#include <nmmintrin.h>
+#define SPU_CRC32C_X86 1
+#endif
+
+namespace spu {
+
+namespace {
+
+constexpr uint32_t kPoly = 0x82f63b78u;  // Reflected Castagnoli polynomial
+
+struct Tables {
+    uint32_t t[8][256];
+
+    Tables() {
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; k++) {
+                c = (c >> 1) ^ ((c & 1) ? kPoly : 0);
+            }
+            t[0][i] = c;
+        }
+        for (uint32_t i = 0; i < 256; i++) {
+            for (int s = 1; s < 8; s++) {
+                t[s][i] = (t[s - 1][i] >> 8) ^ t[0][t[s - 1][i] & 0xff];
+            }
+        }
+    }
+};
+
+const Tables& tables() {
+    static const Tables t;
+    return t;
+}
+
+uint32_t crc32c_table(uint32_t crc, const uint8_t* p, size_t len) {
+    const Tables& tb = tables();
+    while (len >= 8) {
+        uint64_t v;
+        memcpy(&v, p, 8);
+        v ^= crc;
+        crc = tb.t[7][v & 0xff] ^ tb.t[6][(v >> 8) & 0xff] ^ tb.t[5][(v >> 16) & 0xff] ^
+              tb.t[4][(v >> 24) & 0xff] ^ tb.t[3][(v >> 32) & 0xff] ^
+              tb.t[2][(v >> 40) & 0xff] ^ tb.t[1][(v >> 48) & 0xff] ^ tb.t[0][v >> 56];
+        p += 8;
+        len -= 8;
+    }
+    while (len--) {
+        crc = (crc >> 8) ^ tb.t[0][(crc ^ *p++) & 0xff];
+    }
+    return crc;
+}
+
+#ifdef SPU_CRC32C_X86
+__attribute__((target("sse4.2")))
+uint32_t crc32c_sse42(uint32_t crc, const uint8_t* p, size_t len) {
+    uint64_t c = crc;
+    while (len >= 8) {
+        uint64_t v;
+        memcpy(&v, p, 8);
+        c = _mm_crc32_u64(c, v);
+        p += 8;
+        len -= 8;
+    }
+    uint32_t c32 = static_cast<uint32_t>(c);
+    while (len--) {
+        c32 = _mm_crc32_u8(c32, *p++);
+    }
+    return c32;
+}
+#endif
+
+bool detect_hardware() {
+#ifdef SPU_CRC32C_X86
+    return __builtin_cpu_supports("sse4.2");
+#else
+    return false;
+#endif
+}
+
+} // namespace
+
+bool crc32c_hardware() {
+    static const bool hw = detect_hardware();
+    return hw;
+}
+
+uint32_t crc32c(uint32_t crc, const void* data, size_t len) {
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+    crc = ~crc;
+#ifdef SPU_CRC32C_X86
+    if (crc32c_hardware()) {
+        return ~crc32c_sse42(crc, p, len);
+    }
+#endif
+    return ~crc32c_table(crc, p, len);
+}
+
+} // namespace spu
@@ -0,0 +1,31 @@
+/**
+ * SPU Storage CRC32C - Record checksums
+ *
+ * CRC-32C (Castagnoli). Uses the SSE4.2 crc32 instruction when the CPU has
+ * it (checked once at startup), otherwise a slice-by-8 table.
+ */
+
+#ifndef SPU_CRC32C_H
+#define SPU_CRC32C_H
+
+#include <cstddef>
+#include <cstdint>
+
+namespace spu {
+
+/**
+ * Extend a CRC-32C over len bytes
+ *
+ * @param crc Running CRC (0 to start)
+ * @param data Input bytes
+ * @param len Number of bytes
+ * @return Updated CRC
+ */
+uint32_t crc32c(uint32_t crc, const void* data, size_t len);
+
+// Whether the hardware path is in use
+bool crc32c_hardware();
+
+} // namespace spu
+
+#endif // SPU_CRC32C_H
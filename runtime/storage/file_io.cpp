@@ -0,0 +1,180 @@
+/**
+ * SPU Storage File I/O - POSIX helpers for the storage engine
+ */
+
+#include "file_io.h"
+#include "telemetry.h"
+#include <cerrno>
+#include <system_error>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace spu {
+
+namespace {
+
+[[noreturn]] void throw_errno(const std::string& what) {
+    throw std::system_error(errno, std::generic_category(), what);
+}
+
+} // namespace
+
+bool parse_sync_mode(const std::string& name, SyncMode& out) {
+    if (name == "full") {
+        out = SyncMode::kFsync;
+    } else if (name == "metadata") {
+        out = SyncMode::kFdatasync;
+    } else if (name == "none") {
+        out = SyncMode::kNone;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+void sync_fd(int fd, SyncMode mode) {
+    if (mode == SyncMode::kNone) {
+        return;
+    }
+    SPU_TELEMETRY_TIMER(kHistFsyncNs);
+    int rc = 0;
+    switch (mode) {
+    case SyncMode::kFsync:
+        rc = fsync(fd);
+        break;
+    case SyncMode::kFdatasync:
+        rc = fdatasync(fd);
+        break;
+    case SyncMode::kNone:
+        break;
+    }
+    if (rc != 0) {
+        throw_errno("fsync");
+    }
+}
+
+void write_all(int fd, const char* data, size_t len) {
+    while (len > 0) {
+        ssize_t n = write(fd, data, len);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw_errno("write");
+        }
+        data += n;
+        len -= static_cast<size_t>(n);
+    }
+}
+
+void pwrite_all(int fd, const char* data, size_t len, uint64_t offset) {
+    while (len > 0) {
+        ssize_t n = pwrite(fd, data, len, static_cast<off_t>(offset));
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw_errno("pwrite");
+        }
+        data += n;
+        len -= static_cast<size_t>(n);
+        offset += static_cast<uint64_t>(n);
+    }
+}
+
+size_t pread_all(int fd, char* data, size_t len, uint64_t offset) {
+    size_t done = 0;
+    while (done < len) {
+        ssize_t n = pread(fd, data + done, len - done, static_cast<off_t>(offset + done));
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw_errno("pread");
+        }
+        if (n == 0) {
+            break;
+        }
+        done += static_cast<size_t>(n);
+    }
+    return done;
+}
+
+std::string read_file(const std::string& path) {
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        throw_errno("open " + path);
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        int err = errno;
+        close(fd);
+        throw std::system_error(err, std::generic_category(), "fstat " + path);
+    }
+    std::string data(static_cast<size_t>(st.st_size), '\0');
+    size_t n;
+    try {
+        n = pread_all(fd, &data[0], data.size(), 0);
+    } catch (...) {
+        close(fd);
+        throw;
+    }
+    close(fd);
+    data.resize(n);
+    return data;
+}
+
+void make_dir(const std::string& dir) {
+    if (mkdir(dir.c_str(), 0755) != 0 && errno != EEXIST) {
+        throw_errno("mkdir " + dir);
+    }
+}
+
+void sync_dir(const std::string& dir, SyncMode mode) {
+    if (mode == SyncMode::kNone) {
+        return;
+    }
+    int fd = open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) {
+        throw_errno("open " + dir);
+    }
+    int rc;
+    int err;
+    {
+        SPU_TELEMETRY_TIMER(kHistFsyncNs);
+        rc = fsync(fd);
+        err = errno;
+    }
+    close(fd);
+    if (rc != 0) {
+        throw std::system_error(err, std::generic_category(), "fsync " + dir);
+    }
+}
+
+std::vector<std::string> list_dir(const std::string& dir) {
+    DIR* d = opendir(dir.c_str());
+    if (!d) {
+        throw_errno("opendir " + dir);
+    }
+    std::vector<std::string> names;
+    while (struct dirent* e = readdir(d)) {
+        std::string name = e->d_name;
+        if (name != "." && name != "..") {
+            names.push_back(name);
+        }
+    }
+    closedir(d);
+    return names;
+}
+
+std::string path_join(const std::string& dir, const std::string& name) {
+    if (dir.empty() || dir.back() == '/') {
+        return dir + name;
+    }
+    return dir + "/" + name;
+}
+
+} // namespace spu
@@ -0,0 +1,57 @@
+/**
+ * SPU Storage File I/O - POSIX helpers for the storage engine
+ *
+ * Thin wrappers that retry on EINTR / short writes and throw
+ * std::system_error (with errno) on failure.
+ */
+
+#ifndef SPU_FILE_IO_H
+#define SPU_FILE_IO_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace spu {
+
+// How writes are made durable
+enum class SyncMode {
+    kFsync,      // fsync(): data and metadata
+    kFdatasync,  // fdatasync(): data and the metadata needed to read it back
+    kNone,       // No sync (testing only: writes are lost on power failure)
+};
+
+// Parse "full" / "metadata" / "none" (PERSISTENCE_FSYNC_MODE names)
+bool parse_sync_mode(const std::string& name, SyncMode& out);
+
+// Make fd's writes durable according to mode
+void sync_fd(int fd, SyncMode mode);
+
+// Write all of len bytes
+void write_all(int fd, const char* data, size_t len);
+
+// Write all of len bytes at offset (does not move the file position)
+void pwrite_all(int fd, const char* data, size_t len, uint64_t offset);
+
+// Read up to len bytes at offset; returns bytes read (short only at EOF)
+size_t pread_all(int fd, char* data, size_t len, uint64_t offset);
+
+// Read a whole file
+std::string read_file(const std::string& path);
+
+// Create dir if missing (parent must exist)
+void make_dir(const std::string& dir);
+
+// fsync a directory so that creates / renames / unlinks in it are durable
+void sync_dir(const std::string& dir, SyncMode mode);
+
+// Names of the entries in dir (no "." / "..")
+std::vector<std::string> list_dir(const std::string& dir);
+
+// Join a directory and a file name
+std::string path_join(const std::string& dir, const std::string& name);
+
+} // namespace spu
+
+#endif // SPU_FILE_IO_H
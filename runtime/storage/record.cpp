@@ -0,0 +1,224 @@
+/**
+ * SPU Storage Records - Binary glyph record encoding
+ */
+
+#include "record.h"
+#include "crc32c.h"
+#include <cstring>
+#include <stdexcept>
+
+namespace spu {
+
+namespace {
+
+constexpr size_t kCrcOffset = offsetof(RecordHeader, crc) + sizeof(uint32_t);
+
+uint32_t record_crc(const char* record, size_t size) {
+    return crc32c(0, record + kCrcOffset, size - kCrcOffset);
+}
+
+} // namespace
+
+void encode_record(const Glyph& g, uint64_t lsn, std::string& out) {
+    if (g.content.size() > UINT32_MAX - kRecordFixedBytes) {
+        throw std::length_error("glyph record exceeds 4 GiB");
+    }
+    const size_t start = out.size();
+    const size_t size = record_size(g);
+    out.resize(start + size);
+    char* p = &out[start];
+
+    RecordHeader h;
+    h.magic = kRecordMagic;
+    h.crc = 0;
+    h.length = static_cast<uint32_t>(kRecordFixedBytes + g.content.size());
+    h.type = kRecordPut;
+    h.lsn = lsn;
+
+    char* b = p + sizeof(RecordHeader);
+    uint32_t content_len = static_cast<uint32_t>(g.content.size());
+    memcpy(b, g.id.bytes, kDigestLen);
+    memcpy(b + kDigestLen, g.parent1_id.bytes, kDigestLen);
+    memcpy(b + 2 * kDigestLen, g.parent2_id.bytes, kDigestLen);
+    memcpy(b + 3 * kDigestLen, &g.energy, 8);
+    memcpy(b + 3 * kDigestLen + 8, &g.last_update_time, 8);
+    memcpy(b + 3 * kDigestLen + 16, &g.activation_count, 4);
+    memcpy(b + 3 * kDigestLen + 20, &content_len, 4);
+    g.content.copy_to(b + kRecordFixedBytes);
+
+    memcpy(p, &h, sizeof(h));
+    h.crc = record_crc(p, size);
+    memcpy(p + offsetof(RecordHeader, crc), &h.crc, sizeof(h.crc));
+}
+
+DecodeStatus check_record(const char* data, size_t avail, uint64_t& lsn, GlyphId& id,
+                          size_t& consumed) {
+    if (avail < sizeof(RecordHeader)) {
+        return DecodeStatus::kTruncated;
+    }
+    RecordHeader h;
+    memcpy(&h, data, sizeof(h));
+    if (h.magic != kRecordMagic || (h.type != kRecordPut && h.type != kRecordDelta) ||
+        h.length < (h.type == kRecordPut ? kRecordFixedBytes : kDeltaFixedBytes)) {
+        return DecodeStatus::kCorrupt;
+    }
+    const size_t size = sizeof(RecordHeader) + h.length;
+    if (avail < size) {
+        return DecodeStatus::kTruncated;
+    }
+
+    const char* b = data + sizeof(RecordHeader);
+    size_t expected;
+    if (h.type == kRecordPut) {
+        uint32_t content_len;
+        memcpy(&content_len, b + 3 * kDigestLen + 20, 4);
+        expected = kRecordFixedBytes + content_len;
+    } else {
+        GlyphDelta d;
+        memcpy(&d.fields, b + kDigestLen, 4);
+        expected = (d.fields != 0 && (d.fields & ~kDeltaAllFields) == 0)
+                       ? delta_record_size(d) - sizeof(RecordHeader)
+                       : 0;
+    }
+    if (expected != h.length || record_crc(data, size) != h.crc) {
+        return DecodeStatus::kCorrupt;
+    }
+
+    lsn = h.lsn;
+    memcpy(id.bytes, b, kDigestLen);
+    consumed = size;
+    return DecodeStatus::kOk;
+}
+
+DecodeStatus decode_record(const char* data, size_t avail, uint64_t& lsn, Glyph& g,
+                           ContentArena& arena, size_t& consumed) {
+    DecodeStatus status = check_record(data, avail, lsn, g.id, consumed);
+    if (status != DecodeStatus::kOk) {
+        return status;
+    }
+    if (record_type(data) != kRecordPut) {
+        return DecodeStatus::kCorrupt;
+    }
+
+    const char* b = data + sizeof(RecordHeader);
+    uint32_t content_len;
+    memcpy(g.parent1_id.bytes, b + kDigestLen, kDigestLen);
+    memcpy(g.parent2_id.bytes, b + 2 * kDigestLen, kDigestLen);
+    memcpy(&g.energy, b + 3 * kDigestLen, 8);
+    memcpy(&g.last_update_time, b + 3 * kDigestLen + 8, 8);
+    memcpy(&g.activation_count, b + 3 * kDigestLen + 16, 4);
+    memcpy(&content_len, b + 3 * kDigestLen + 20, 4);
+    g.content.assign(b + kRecordFixedBytes, content_len, arena);
+    return DecodeStatus::kOk;
+}
+
+GlyphDelta diff_glyph(const Glyph& before, const Glyph& after) {
+    GlyphDelta d;
+    d.id = after.id;
+    if (memcmp(&before.energy, &after.energy, sizeof(double)) != 0) {
+        d.fields |= kDeltaEnergy;
+        d.energy = after.energy;
+    }
+    if (before.activation_count != after.activation_count) {
+        d.fields |= kDeltaActivationCount;
+        d.activation_count = after.activation_count;
+    }
+    if (before.last_update_time != after.last_update_time) {
+        d.fields |= kDeltaLastUpdateTime;
+        d.last_update_time = after.last_update_time;
+    }
+    return d;
+}
+
+void apply_delta(const GlyphDelta& d, Glyph& g) {
+    if (d.fields & kDeltaEnergy) {
+        g.energy = d.energy;
+    }
+    if (d.fields & kDeltaActivationCount) {
+        g.activation_count = d.activation_count;
+    }
+    if (d.fields & kDeltaLastUpdateTime) {
+        g.last_update_time = d.last_update_time;
+    }
+}
+
+void fold_delta(GlyphDelta& older, const GlyphDelta& newer) {
+    if (newer.fields & kDeltaEnergy) {
+        older.energy = newer.energy;
+    }
+    if (newer.fields & kDeltaActivationCount) {
+        older.activation_count = newer.activation_count;
+    }
+    if (newer.fields & kDeltaLastUpdateTime) {
+        older.last_update_time = newer.last_update_time;
+    }
+    older.fields |= newer.fields;
+}
+
+void encode_delta_record(const GlyphDelta& d, uint64_t lsn, std::string& out) {
+    if (d.fields == 0 || (d.fields & ~kDeltaAllFields) != 0) {
+        throw std::invalid_argument("glyph delta needs a non-empty set of known fields");
+    }
+    const size_t start = out.size();
+    const size_t size = delta_record_size(d);
+    out.resize(start + size);
+    char* p = &out[start];
+
+    RecordHeader h;
+    h.magic = kRecordMagic;
+    h.crc = 0;
+    h.length = static_cast<uint32_t>(size - sizeof(RecordHeader));
+    h.type = kRecordDelta;
+    h.lsn = lsn;
+
+    // Present fields only, in bit order
+    char* b = p + sizeof(RecordHeader);
+    memcpy(b, d.id.bytes, kDigestLen);
+    memcpy(b + kDigestLen, &d.fields, 4);
+    b += kDeltaFixedBytes;
+    if (d.fields & kDeltaEnergy) {
+        memcpy(b, &d.energy, 8);
+        b += 8;
+    }
+    if (d.fields & kDeltaActivationCount) {
+        memcpy(b, &d.activation_count, 4);
+        b += 4;
+    }
+    if (d.fields & kDeltaLastUpdateTime) {
+        memcpy(b, &d.last_update_time, 8);
+    }
+
+    memcpy(p, &h, sizeof(h));
+    h.crc = record_crc(p, size);
+    memcpy(p + offsetof(RecordHeader, crc), &h.crc, sizeof(h.crc));
+}
+
+DecodeStatus decode_delta_record(const char* data, size_t avail, uint64_t& lsn, GlyphDelta& d,
+                                 size_t& consumed) {
+    DecodeStatus status = check_record(data, avail, lsn, d.id, consumed);
+    if (status != DecodeStatus::kOk) {
+        return status;
+    }
+    if (record_type(data) != kRecordDelta) {
+        return DecodeStatus::kCorrupt;
+    }
+
+    const char* b = data + sizeof(RecordHeader) + kDigestLen;
+    d = GlyphDelta{d.id};
+    memcpy(&d.fields, b, 4);
+    b += 4;
+    if (d.fields & kDeltaEnergy) {
+        memcpy(&d.energy, b, 8);
+        b += 8;
+    }
+    if (d.fields & kDeltaActivationCount) {
+        memcpy(&d.activation_count, b, 4);
+        b += 4;
+    }
+    if (d.fields & kDeltaLastUpdateTime) {
+        memcpy(&d.last_update_time, b, 8);
+    }
+    return DecodeStatus::kOk;
+}
+
+} // namespace spu
@@ -0,0 +1,153 @@
+/**
+ * SPU Storage Records - Binary glyph record encoding
+ *
+ * One record per glyph write, shared by the write-ahead log and segment
+ * files:
+ *
+ *   put:    RecordHeader (24 bytes) | fixed Glyph fields (120 bytes) | content
+ *   delta:  RecordHeader (24 bytes) | id | field mask | changed fields only
+ *
+ * A delta carries the numeric fields a tick rewrites (energy, activation
+ * count, last update time) for a glyph stored earlier, so a tick that
+ * touches a glyph logs 40 to 56 body bytes instead of the whole glyph.
+ * The header CRC-32C covers everything after the crc field, so a torn or
+ * overwritten record is detected on read. Fields are stored in host byte
+ * order (little-endian on every supported target) and content is always
+ * flat: lazy rope content is materialized on encode.
+ */
+
+#ifndef SPU_RECORD_H
+#define SPU_RECORD_H
+
+#include "merge_ref.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+namespace spu {
+
+constexpr uint32_t kRecordMagic = 0x57555053;  // "SPUW"
+
+enum RecordType : uint32_t {
+    kRecordPut = 1,    // Insert or replace the glyph with this ID
+    kRecordDelta = 2,  // Overwrite numeric fields of the stored glyph with this ID
+};
+
+struct RecordHeader {
+    uint32_t magic;   // kRecordMagic
+    uint32_t crc;     // CRC-32C of the bytes after this field (header tail + body)
+    uint32_t length;  // Body bytes (fixed fields + content)
+    uint32_t type;    // RecordType
+    uint64_t lsn;     // Log sequence number (starts at 1, strictly increasing)
+};
+
+static_assert(sizeof(RecordHeader) == 24, "RecordHeader is written as raw bytes");
+
+// Body bytes before the content
+constexpr size_t kRecordFixedBytes = 3 * kDigestLen + 8 + 8 + 4 + 4;
+
+// Encoded size of g (header + body)
+inline size_t record_size(const Glyph& g) {
+    return sizeof(RecordHeader) + kRecordFixedBytes + g.content.size();
+}
+
+// GlyphDelta::fields bits
+enum DeltaField : uint32_t {
+    kDeltaEnergy = 1u << 0,
+    kDeltaActivationCount = 1u << 1,
+    kDeltaLastUpdateTime = 1u << 2,
+    kDeltaAllFields = kDeltaEnergy | kDeltaActivationCount | kDeltaLastUpdateTime,
+};
+
+// New values for some numeric fields of a stored glyph (unset fields are ignored)
+struct GlyphDelta {
+    GlyphId id;
+    uint32_t fields = 0;  // DeltaField bits
+    double energy = 0.0;
+    uint32_t activation_count = 0;
+    uint64_t last_update_time = 0;
+};
+
+/**
+ * Delta of the numeric fields that differ between two versions of a glyph
+ *
+ * Energies are compared bitwise. fields is 0 if nothing changed.
+ */
+GlyphDelta diff_glyph(const Glyph& before, const Glyph& after);
+
+// Overwrite the fields set in d
+void apply_delta(const GlyphDelta& d, Glyph& g);
+
+// Fold a newer delta into an older one for the same glyph (newer fields win)
+void fold_delta(GlyphDelta& older, const GlyphDelta& newer);
+
+// Body bytes of a delta before its field values
+constexpr size_t kDeltaFixedBytes = kDigestLen + 4;
+
+// Encoded size of d (header + body)
+inline size_t delta_record_size(const GlyphDelta& d) {
+    return sizeof(RecordHeader) + kDeltaFixedBytes + ((d.fields & kDeltaEnergy) ? 8 : 0) +
+           ((d.fields & kDeltaActivationCount) ? 4 : 0) +
+           ((d.fields & kDeltaLastUpdateTime) ? 8 : 0);
+}
+
+/**
+ * Append the record for g to out
+ *
+ * @param g Glyph (any content kind)
+ * @param lsn Log sequence number
+ * @param out Buffer to append to
+ */
+void encode_record(const Glyph& g, uint64_t lsn, std::string& out);
+
+/**
+ * Append the delta record for d to out
+ *
+ * @throws std::invalid_argument if d.fields is 0 or has unknown bits
+ */
+void encode_delta_record(const GlyphDelta& d, uint64_t lsn, std::string& out);
+
+enum class DecodeStatus {
+    kOk,
+    kTruncated,  // Fewer bytes available than the record needs
+    kCorrupt,    // Bad magic, type, length or CRC
+};
+
+/**
+ * Decode the put record at data (a delta record is kCorrupt here)
+ *
+ * @param data Record bytes
+ * @param avail Bytes available at data
+ * @param lsn Output sequence number
+ * @param g Output glyph (content copied into arena)
+ * @param arena Arena for content longer than Content::kInlineCapacity
+ * @param consumed Output encoded size (set on kOk)
+ */
+DecodeStatus decode_record(const char* data, size_t avail, uint64_t& lsn, Glyph& g,
+                           ContentArena& arena, size_t& consumed);
+
+// Decode the delta record at data (a put record is kCorrupt here)
+DecodeStatus decode_delta_record(const char* data, size_t avail, uint64_t& lsn, GlyphDelta& d,
+                                 size_t& consumed);
+
+/**
+ * Validate the record (put or delta) at data without decoding it
+ *
+ * Same checks as decode_record() / decode_delta_record(); on kOk sets lsn,
+ * id and consumed.
+ */
+DecodeStatus check_record(const char* data, size_t avail, uint64_t& lsn, GlyphId& id,
+                          size_t& consumed);
+
+// RecordType of a record that passed check_record()
+inline uint32_t record_type(const char* data) {
+    uint32_t type;
+    memcpy(&type, data + offsetof(RecordHeader, type), sizeof(type));
+    return type;
+}
+
+} // namespace spu
+
+#endif // SPU_RECORD_H
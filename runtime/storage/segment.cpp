@@ -0,0 +1,256 @@
+/**
+ * SPU Storage Segments - Immutable checkpoint files
+ */
+
+#include "segment.h"
+#include "crc32c.h"
+#include "record.h"
+#include <algorithm>
+#include <cerrno>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <system_error>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace spu {
+
+std::string segment_file_name(uint64_t max_lsn) {
+    char buf[32];
+    snprintf(buf, sizeof(buf), "seg-%016" PRIx64 ".seg", max_lsn);
+    return buf;
+}
+
+bool parse_segment_file_name(const std::string& name, uint64_t& max_lsn) {
+    if (name.size() != 24 || name.compare(0, 4, "seg-") != 0 ||
+        name.compare(20, 4, ".seg") != 0) {
+        return false;
+    }
+    char* end = nullptr;
+    max_lsn = strtoull(name.c_str() + 4, &end, 16);
+    return end == name.c_str() + 20;
+}
+
+SegmentWriter::SegmentWriter(const std::string& dir, uint64_t first_lsn, uint64_t max_lsn,
+                             SyncMode sync)
+    : dir_(dir),
+      name_(segment_file_name(max_lsn)),
+      tmp_(path_join(dir, kTempFilePrefix + name_)),
+      sync_(sync),
+      header_{kSegmentMagic, kSegmentVersion, 0, max_lsn, first_lsn},
+      fd_(-1),
+      offset_(0),
+      installed_(false) {
+    fd_ = open(tmp_.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd_ < 0) {
+        throw std::system_error(errno, std::generic_category(), "open " + tmp_);
+    }
+    // Rewritten with the count by finish()
+    buffer_.append(reinterpret_cast<const char*>(&header_), sizeof(header_));
+}
+
+SegmentWriter::~SegmentWriter() {
+    if (fd_ >= 0) {
+        close(fd_);
+    }
+    if (!installed_) {
+        unlink(tmp_.c_str());
+    }
+}
+
+void SegmentWriter::begin_record(const GlyphId& id, uint32_t flags) {
+    if (!index_.empty() && !(index_.back().id < id)) {
+        throw std::invalid_argument("segment records must be added in increasing ID order");
+    }
+    SegmentIndexEntry entry;
+    entry.id = id;
+    entry.offset = bytes();
+    entry.length = 0;
+    entry.flags = flags;
+    index_.push_back(entry);
+}
+
+void SegmentWriter::end_record() {
+    index_.back().length = static_cast<uint32_t>(bytes() - index_.back().offset);
+    if (buffer_.size() >= (1u << 20)) {
+        flush();
+    }
+}
+
+void SegmentWriter::add(const Glyph& g, uint64_t lsn) {
+    begin_record(g.id, 0);
+    encode_record(g, lsn, buffer_);
+    end_record();
+}
+
+void SegmentWriter::add(const GlyphDelta& d, uint64_t lsn) {
+    begin_record(d.id, kSegmentEntryDelta);
+    encode_delta_record(d, lsn, buffer_);
+    end_record();
+}
+
+void SegmentWriter::flush() {
+    write_all(fd_, buffer_.data(), buffer_.size());
+    offset_ += buffer_.size();
+    buffer_.clear();
+}
+
+std::string SegmentWriter::finish() {
+    seal();
+    std::string path = install();
+    sync_dir(dir_, sync_);
+    return path;
+}
+
+void SegmentWriter::seal() {
+    SegmentTrailer trailer;
+    trailer.index_offset = bytes();
+    trailer.count = index_.size();
+    trailer.max_lsn = header_.max_lsn;
+    trailer.index_crc = crc32c(0, index_.data(), index_.size() * sizeof(SegmentIndexEntry));
+    trailer.magic = kSegmentMagic;
+    buffer_.append(reinterpret_cast<const char*>(index_.data()),
+                   index_.size() * sizeof(SegmentIndexEntry));
+    buffer_.append(reinterpret_cast<const char*>(&trailer), sizeof(trailer));
+    header_.count = index_.size();
+    if (offset_ == 0) {
+        memcpy(&buffer_[0], &header_, sizeof(header_));  // Still buffered
+    } else {
+        pwrite_all(fd_, reinterpret_cast<const char*>(&header_), sizeof(header_), 0);
+    }
+    flush();
+
+    // Temp file, sync, rename, sync dir: the segment is complete or absent
+    sync_fd(fd_, sync_);
+    close(fd_);
+    fd_ = -1;
+}
+
+std::string SegmentWriter::install() {
+    std::string path = path_join(dir_, name_);
+    if (rename(tmp_.c_str(), path.c_str()) != 0) {
+        throw std::system_error(errno, std::generic_category(), "rename " + tmp_);
+    }
+    installed_ = true;
+    return path;
+}
+
+std::string write_segment(const std::string& dir, std::vector<SegmentInput>& inputs,
+                          uint64_t first_lsn, uint64_t max_lsn, SyncMode sync) {
+    std::sort(inputs.begin(), inputs.end(), [](const SegmentInput& a, const SegmentInput& b) {
+        return a.id() < b.id();
+    });
+
+    SegmentWriter writer(dir, first_lsn, max_lsn, sync);
+    for (const SegmentInput& in : inputs) {
+        if (in.glyph) {
+            writer.add(*in.glyph, in.lsn);
+        } else {
+            writer.add(*in.delta, in.lsn);
+        }
+    }
+    return writer.finish();
+}
+
+Segment::Segment(const std::string& path)
+    : path_(path), fd_(-1), first_lsn_(0), max_lsn_(0), file_bytes_(0) {
+    fd_ = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd_ < 0) {
+        throw std::system_error(errno, std::generic_category(), "open " + path);
+    }
+    try {
+        struct stat st;
+        if (fstat(fd_, &st) != 0) {
+            throw std::system_error(errno, std::generic_category(), "fstat " + path);
+        }
+        const uint64_t size = static_cast<uint64_t>(st.st_size);
+
+        SegmentHeader header;
+        SegmentTrailer trailer;
+        if (size < sizeof(header) + sizeof(trailer) ||
+            pread_all(fd_, reinterpret_cast<char*>(&header), sizeof(header), 0) != sizeof(header) ||
+            pread_all(fd_, reinterpret_cast<char*>(&trailer), sizeof(trailer),
+                      size - sizeof(trailer)) != sizeof(trailer)) {
+            throw std::runtime_error("truncated segment " + path);
+        }
+        if (header.magic != kSegmentMagic || (header.version != 1 && header.version != kSegmentVersion) ||
+            trailer.magic != kSegmentMagic || trailer.count != header.count ||
+            trailer.max_lsn != header.max_lsn ||
+            trailer.index_offset + trailer.count * sizeof(SegmentIndexEntry) !=
+                size - sizeof(trailer)) {
+            throw std::runtime_error("invalid segment " + path);
+        }
+
+        index_.resize(trailer.count);
+        size_t index_bytes = index_.size() * sizeof(SegmentIndexEntry);
+        if (pread_all(fd_, reinterpret_cast<char*>(index_.data()), index_bytes,
+                      trailer.index_offset) != index_bytes ||
+            crc32c(0, index_.data(), index_bytes) != trailer.index_crc) {
+            throw std::runtime_error("corrupt segment index " + path);
+        }
+        max_lsn_ = header.max_lsn;
+        // A version 1 checkpoint claims no range, so it never looks covered by another
+        first_lsn_ = header.version == 1 ? header.max_lsn : header.first_lsn;
+        file_bytes_ = size;
+    } catch (...) {
+        close(fd_);
+        throw;
+    }
+}
+
+Segment::~Segment() {
+    close(fd_);
+}
+
+const SegmentIndexEntry* Segment::find(const GlyphId& id) const {
+    auto it = std::lower_bound(index_.begin(), index_.end(), id,
+                               [](const SegmentIndexEntry& e, const GlyphId& k) {
+                                   return e.id < k;
+                               });
+    if (it == index_.end() || it->id != id) {
+        return nullptr;
+    }
+    return &*it;
+}
+
+bool Segment::contains(const GlyphId& id) const {
+    return find(id) != nullptr;
+}
+
+void Segment::read(const SegmentIndexEntry& entry, Glyph& out, ContentArena& arena,
+                   uint64_t& lsn) const {
+    std::string buf(entry.length, '\0');
+    size_t consumed;
+    if (entry.is_delta() || pread_all(fd_, &buf[0], buf.size(), entry.offset) != buf.size() ||
+        decode_record(buf.data(), buf.size(), lsn, out, arena, consumed) != DecodeStatus::kOk ||
+        out.id != entry.id) {
+        throw std::runtime_error("corrupt record in segment " + path_);
+    }
+}
+
+void Segment::read_delta(const SegmentIndexEntry& entry, GlyphDelta& out, uint64_t& lsn) const {
+    char buf[sizeof(RecordHeader) + kDeltaFixedBytes + 20];
+    size_t consumed;
+    if (!entry.is_delta() || entry.length > sizeof(buf) ||
+        pread_all(fd_, buf, entry.length, entry.offset) != entry.length ||
+        decode_delta_record(buf, entry.length, lsn, out, consumed) != DecodeStatus::kOk ||
+        out.id != entry.id) {
+        throw std::runtime_error("corrupt delta record in segment " + path_);
+    }
+}
+
+bool Segment::get(const GlyphId& id, Glyph& out, ContentArena& arena) const {
+    const SegmentIndexEntry* entry = find(id);
+    if (!entry || entry->is_delta()) {
+        return false;
+    }
+    uint64_t lsn;
+    read(*entry, out, arena, lsn);
+    return true;
+}
+
+} // namespace spu
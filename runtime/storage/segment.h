@@ -0,0 +1,223 @@
+/**
+ * SPU Storage Segments - Immutable checkpoint files
+ *
+ * A checkpoint writes every glyph logged since the previous checkpoint to
+ * seg-<max lsn>.seg:
+ *
+ *   SegmentHeader | records (record.h encoding) | index | SegmentTrailer
+ *
+ * The index lists (id, offset, length, flags) sorted by ID, so opening a
+ * segment reads only the index and a lookup is a binary search plus one
+ * pread. A record is a full glyph (put) or a delta over an older segment's
+ * version of it. The file is written under a temporary name, synced and
+ * renamed into place, so a segment is either complete or absent.
+ *
+ * Every segment covers the LSN range [first_lsn, max_lsn]. Checkpoint
+ * ranges are disjoint; a compaction output covers the ranges of the
+ * segments it replaced, which is how recovery recognizes inputs left behind
+ * by a crash mid-compaction. Version 1 segments (no deltas, no first_lsn)
+ * are still read.
+ */
+
+#ifndef SPU_SEGMENT_H
+#define SPU_SEGMENT_H
+
+#include "file_io.h"
+#include "merge_ref.h"
+#include "record.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace spu {
+
+constexpr uint32_t kSegmentMagic = 0x53555053;  // "SPUS"
+constexpr uint32_t kSegmentVersion = 2;
+
+// Prefix of files that are still being written (removed at startup)
+constexpr const char* kTempFilePrefix = ".tmp-";
+
+struct SegmentHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t count;    // Records
+    uint64_t max_lsn;    // Highest LSN covered by this checkpoint
+    uint64_t first_lsn;  // Lowest LSN covered (version 1: 0, i.e. unknown)
+};
+
+// SegmentIndexEntry::flags bits (version 1 entries are all 0: puts)
+constexpr uint32_t kSegmentEntryDelta = 1;  // The record is a delta (kRecordDelta)
+
+struct SegmentIndexEntry {
+    GlyphId id;
+    uint64_t offset;  // Record offset in the file
+    uint32_t length;  // Encoded record size
+    uint32_t flags;
+
+    bool is_delta() const { return (flags & kSegmentEntryDelta) != 0; }
+};
+
+struct SegmentTrailer {
+    uint64_t index_offset;
+    uint64_t count;
+    uint64_t max_lsn;
+    uint32_t index_crc;  // CRC-32C of the index entries
+    uint32_t magic;
+};
+
+static_assert(sizeof(SegmentHeader) == 32, "SegmentHeader is written as raw bytes");
+static_assert(sizeof(SegmentIndexEntry) == 48, "SegmentIndexEntry is written as raw bytes");
+static_assert(sizeof(SegmentTrailer) == 32, "SegmentTrailer is written as raw bytes");
+
+// "seg-<16 hex digits>.seg"
+std::string segment_file_name(uint64_t max_lsn);
+bool parse_segment_file_name(const std::string& name, uint64_t& max_lsn);
+
+// One glyph or delta to write and the LSN of the write that produced it
+struct SegmentInput {
+    const Glyph* glyph;               // nullptr for a delta
+    uint64_t lsn;
+    const GlyphDelta* delta = nullptr;
+
+    const GlyphId& id() const { return glyph ? glyph->id : delta->id; }
+};
+
+/**
+ * Streams records into a new segment
+ *
+ * Records must be added in strictly increasing ID order; they are written
+ * out in chunks, so memory holds only the index (48 bytes per record). The
+ * segment appears under its final name at finish(); a writer destroyed
+ * before that removes its temporary file.
+ */
+class SegmentWriter {
+public:
+    /**
+     * @param dir Storage directory
+     * @param first_lsn Lowest LSN the segment covers
+     * @param max_lsn Highest LSN the segment covers (names the file)
+     * @param sync How to make the file and rename durable
+     */
+    SegmentWriter(const std::string& dir, uint64_t first_lsn, uint64_t max_lsn, SyncMode sync);
+    ~SegmentWriter();
+
+    SegmentWriter(const SegmentWriter&) = delete;
+    SegmentWriter& operator=(const SegmentWriter&) = delete;
+
+    /**
+     * Append a put or a delta record
+     *
+     * @throws std::invalid_argument if the ID is not greater than the previous one
+     */
+    void add(const Glyph& g, uint64_t lsn);
+    void add(const GlyphDelta& d, uint64_t lsn);
+
+    /**
+     * Write the index and trailer, sync, rename into place, sync the directory
+     *
+     * Replaces an existing segment of the same name atomically.
+     *
+     * @return Path of the new segment
+     */
+    std::string finish();
+
+    /**
+     * finish() in two steps: seal() writes and syncs the temporary file,
+     * install() renames it into place without syncing the directory, so a
+     * caller can decide under its own lock whether to install at all.
+     * A sealed segment that is never installed is removed by the destructor.
+     */
+    void seal();
+    std::string install();
+
+    size_t count() const { return index_.size(); }
+    uint64_t bytes() const { return offset_ + buffer_.size(); }  // Written so far
+
+private:
+    void begin_record(const GlyphId& id, uint32_t flags);
+    void end_record();
+    void flush();
+
+    std::string dir_;
+    std::string name_;
+    std::string tmp_;
+    SyncMode sync_;
+    SegmentHeader header_;
+    int fd_;
+    uint64_t offset_;  // File bytes before buffer_
+    bool installed_;
+    std::string buffer_;
+    std::vector<SegmentIndexEntry> index_;
+};
+
+/**
+ * Write a segment (IDs must be unique)
+ *
+ * @param dir Storage directory
+ * @param inputs Glyphs and deltas to write (reordered by ID)
+ * @param first_lsn Lowest LSN the segment covers
+ * @param max_lsn Highest LSN the segment covers
+ * @param sync How to make the file and rename durable
+ * @return Path of the new segment
+ */
+std::string write_segment(const std::string& dir, std::vector<SegmentInput>& inputs,
+                          uint64_t first_lsn, uint64_t max_lsn, SyncMode sync);
+
+class Segment {
+public:
+    /**
+     * Open a segment and load its index
+     *
+     * @throws std::runtime_error if the header, trailer or index is invalid
+     */
+    explicit Segment(const std::string& path);
+    ~Segment();
+
+    Segment(const Segment&) = delete;
+    Segment& operator=(const Segment&) = delete;
+
+    /**
+     * Look up a full glyph by ID (thread-safe)
+     *
+     * @return false if the ID is not in this segment or its record is a delta
+     * @throws std::runtime_error if the stored record fails its CRC
+     */
+    bool get(const GlyphId& id, Glyph& out, ContentArena& arena) const;
+
+    // Whether the ID has a record (put or delta) in this segment
+    bool contains(const GlyphId& id) const;
+
+    // Index entry for an ID (nullptr if absent)
+    const SegmentIndexEntry* find(const GlyphId& id) const;
+
+    size_t size() const { return index_.size(); }
+    uint64_t first_lsn() const { return first_lsn_; }  // Version 1: max_lsn()
+    uint64_t max_lsn() const { return max_lsn_; }
+    uint64_t file_bytes() const { return file_bytes_; }
+    const std::string& path() const { return path_; }
+    const std::vector<SegmentIndexEntry>& index() const { return index_; }
+
+    /**
+     * Read the record for an index entry
+     *
+     * @param lsn Output LSN of the record
+     * @throws std::runtime_error if the record fails its CRC or is of the other kind
+     */
+    void read(const SegmentIndexEntry& entry, Glyph& out, ContentArena& arena,
+              uint64_t& lsn) const;
+    void read_delta(const SegmentIndexEntry& entry, GlyphDelta& out, uint64_t& lsn) const;
+
+private:
+    std::string path_;
+    int fd_;
+    uint64_t first_lsn_;
+    uint64_t max_lsn_;
+    uint64_t file_bytes_;
+    std::vector<SegmentIndexEntry> index_;
+};
+
+} // namespace spu
+
+#endif // SPU_SEGMENT_H
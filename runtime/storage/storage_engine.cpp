@@ -0,0 +1,620 @@
+/**
+ * SPU Storage Engine - Durable glyph store
+ */
+
+#include "storage_engine.h"
+#include "record.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <functional>
+#include <queue>
+#include <stdexcept>
+#include <system_error>
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <unistd.h>
+
+namespace spu {
+
+StorageEngine::StorageEngine(const std::string& dir, const StorageOptions& options)
+    : dir_(dir),
+      options_(options),
+      lock_fd_(-1),
+      wal_bytes_(0),
+      checkpoint_lsn_(0),
+      checkpoint_bytes_written_(0),
+      compaction_bytes_written_(0),
+      compactions_(0),
+      glyphs_collected_(0),
+      compact_requested_(false),
+      compact_stop_(false),
+      recovery_{0, 0, 0, 0, 0, 0} {
+    make_dir(dir_);
+
+    // One process per directory; the lock goes away with the process
+    std::string lock_path = path_join(dir_, "LOCK");
+    lock_fd_ = open(lock_path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (lock_fd_ < 0) {
+        throw std::system_error(errno, std::generic_category(), "open " + lock_path);
+    }
+    if (flock(lock_fd_, LOCK_EX | LOCK_NB) != 0) {
+        int err = errno;
+        close(lock_fd_);
+        throw std::system_error(err, std::generic_category(), "lock " + lock_path);
+    }
+
+    try {
+        recover();
+    } catch (...) {
+        close(lock_fd_);
+        throw;
+    }
+    if (options_.compaction.background && options_.compaction.max_segments > 0) {
+        compact_thread_ = std::thread([this] { compaction_loop(); });
+        schedule_compaction();  // Segments may have piled up before a crash
+    }
+}
+
+StorageEngine::~StorageEngine() {
+    if (compact_thread_.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(compact_wake_mu_);
+            compact_stop_ = true;
+        }
+        compact_cv_.notify_all();
+        compact_thread_.join();  // A compaction in progress is abandoned
+    }
+    wal_.reset();  // Drains and syncs pending records
+    close(lock_fd_);
+}
+
+void StorageEngine::recover() {
+    std::vector<uint64_t> segment_lsns;
+    for (const std::string& name : list_dir(dir_)) {
+        uint64_t lsn;
+        if (name.compare(0, strlen(kTempFilePrefix), kTempFilePrefix) == 0) {
+            // Checkpoint interrupted before its rename: the log still has the data
+            std::string path = path_join(dir_, name);
+            if (unlink(path.c_str()) != 0 && errno != ENOENT) {
+                throw std::system_error(errno, std::generic_category(), "unlink " + path);
+            }
+            recovery_.temp_files_removed++;
+        } else if (parse_segment_file_name(name, lsn)) {
+            segment_lsns.push_back(lsn);
+        }
+    }
+
+    std::sort(segment_lsns.begin(), segment_lsns.end(), std::greater<uint64_t>());
+    std::vector<std::shared_ptr<Segment>> opened;
+    for (uint64_t lsn : segment_lsns) {
+        opened.push_back(std::make_shared<Segment>(path_join(dir_, segment_file_name(lsn))));
+    }
+    // A compaction that crashed after its rename leaves inputs inside its range
+    for (const auto& s : opened) {
+        bool covered = std::any_of(opened.begin(), opened.end(), [&](const auto& t) {
+            return t != s && t->first_lsn() <= s->first_lsn() && s->max_lsn() <= t->max_lsn();
+        });
+        if (!covered) {
+            segments_.push_back(s);
+        } else if (unlink(s->path().c_str()) != 0 && errno != ENOENT) {
+            throw std::system_error(errno, std::generic_category(), "unlink " + s->path());
+        } else {
+            recovery_.segments_superseded++;
+        }
+    }
+    if (recovery_.temp_files_removed > 0 || recovery_.segments_superseded > 0) {
+        sync_dir(dir_, options_.wal.sync);
+    }
+    checkpoint_lsn_ = segment_lsns.empty() ? 0 : segment_lsns.front();
+    recovery_.segments = segments_.size();
+
+    WalReplayResult replay = replay_wal(
+        dir_, checkpoint_lsn_, options_.wal.sync,
+        [&](uint64_t lsn, const Glyph& g) {
+            insert_mem(g, lsn);
+            wal_bytes_ += record_size(g);
+        },
+        [&](uint64_t lsn, const GlyphDelta& d) {
+            apply_mem(d, lsn);
+            wal_bytes_ += delta_record_size(d);
+        });
+    recovery_.wal_files = replay.files.size();
+    recovery_.records_replayed = replay.records;
+    recovery_.bytes_truncated = replay.truncated_bytes;
+
+    uint64_t next_lsn = std::max(replay.last_lsn, checkpoint_lsn_) + 1;
+    wal_.reset(new WalWriter(dir_, replay.next_file, next_lsn, options_.wal,
+                             std::move(replay.files)));
+}
+
+void StorageEngine::insert_mem(const Glyph& g, uint64_t lsn) {
+    MemEntry& e = memtable_[g.id];
+    e.glyph = g;
+    e.glyph.content = Content();
+    char* dst = e.glyph.content.prepare(g.content.size(), mem_arena_);
+    g.content.copy_to(dst);
+    e.lsn = lsn;
+    deltas_.erase(g.id);  // Superseded by the full glyph
+}
+
+void StorageEngine::apply_mem(const GlyphDelta& d, uint64_t lsn) {
+    auto it = memtable_.find(d.id);
+    if (it != memtable_.end()) {
+        apply_delta(d, it->second.glyph);
+        it->second.lsn = lsn;
+        return;
+    }
+    auto inserted = deltas_.emplace(d.id, DeltaEntry{d, lsn});
+    if (!inserted.second) {
+        fold_delta(inserted.first->second.delta, d);
+        inserted.first->second.lsn = lsn;
+    }
+}
+
+uint64_t StorageEngine::append_locked(const Glyph* glyphs, size_t n, bool& want_checkpoint) {
+    uint64_t last = wal_->append_batch(glyphs, n);
+    uint64_t lsn = last - n + 1;
+    for (size_t i = 0; i < n; i++) {
+        insert_mem(glyphs[i], lsn++);
+        wal_bytes_ += record_size(glyphs[i]);
+    }
+    want_checkpoint = options_.checkpoint_bytes > 0 && wal_bytes_ >= options_.checkpoint_bytes;
+    return last;
+}
+
+uint64_t StorageEngine::put(const Glyph& g) {
+    return put_batch(&g, 1);
+}
+
+uint64_t StorageEngine::put_batch(const Glyph* glyphs, size_t n) {
+    if (n == 0) {
+        return wal_->last_lsn();
+    }
+    bool want_checkpoint;
+    uint64_t last;
+    {
+        std::unique_lock<std::shared_mutex> lock(mu_);
+        last = append_locked(glyphs, n, want_checkpoint);
+    }
+    // Wait outside the lock so other writers can join the same commit
+    wal_->wait_durable(last);
+    if (want_checkpoint) {
+        maybe_checkpoint();
+    }
+    return last;
+}
+
+uint64_t StorageEngine::put_async(const Glyph& g) {
+    bool want_checkpoint;
+    uint64_t lsn;
+    {
+        std::unique_lock<std::shared_mutex> lock(mu_);
+        lsn = append_locked(&g, 1, want_checkpoint);
+    }
+    if (want_checkpoint) {
+        maybe_checkpoint();
+    }
+    return lsn;
+}
+
+uint64_t StorageEngine::update(const GlyphDelta& d) {
+    return update_batch(&d, 1);
+}
+
+uint64_t StorageEngine::update_batch(const GlyphDelta* deltas, size_t n) {
+    if (n == 0) {
+        return wal_->last_lsn();
+    }
+    bool want_checkpoint;
+    uint64_t last;
+    {
+        std::unique_lock<std::shared_mutex> lock(mu_);
+        for (size_t i = 0; i < n; i++) {
+            if (!deltas_.count(deltas[i].id) && !contains_locked(deltas[i].id)) {
+                throw std::invalid_argument("update of a glyph that is not stored");
+            }
+        }
+        last = wal_->append_deltas(deltas, n);
+        uint64_t lsn = last - n + 1;
+        for (size_t i = 0; i < n; i++) {
+            apply_mem(deltas[i], lsn++);
+            wal_bytes_ += delta_record_size(deltas[i]);
+        }
+        want_checkpoint = options_.checkpoint_bytes > 0 && wal_bytes_ >= options_.checkpoint_bytes;
+    }
+    wal_->wait_durable(last);
+    if (want_checkpoint) {
+        maybe_checkpoint();
+    }
+    return last;
+}
+
+void StorageEngine::wait_durable(uint64_t lsn) {
+    wal_->wait_durable(lsn);
+}
+
+bool StorageEngine::get(const GlyphId& id, Glyph& out, ContentArena& arena) const {
+    std::shared_lock<std::shared_mutex> lock(mu_);
+    auto it = memtable_.find(id);
+    if (it != memtable_.end()) {
+        const Glyph& g = it->second.glyph;
+        out = g;
+        out.content = Content();
+        out.content.assign(g.content.data(), g.content.size(), arena);
+        return true;
+    }
+
+    // Newest first: fold deltas until the full version they apply to
+    GlyphDelta newer;
+    auto d = deltas_.find(id);
+    if (d != deltas_.end()) {
+        newer = d->second.delta;
+    }
+    for (const auto& segment : segments_) {
+        const SegmentIndexEntry* entry = segment->find(id);
+        if (!entry) {
+            continue;
+        }
+        uint64_t lsn;
+        if (entry->is_delta()) {
+            GlyphDelta older;
+            segment->read_delta(*entry, older, lsn);
+            fold_delta(older, newer);
+            newer = older;
+            continue;
+        }
+        segment->read(*entry, out, arena, lsn);
+        apply_delta(newer, out);
+        return true;
+    }
+    return false;  // Never stored, or collected with deltas still pending
+}
+
+bool StorageEngine::contains(const GlyphId& id) const {
+    std::shared_lock<std::shared_mutex> lock(mu_);
+    return contains_locked(id);
+}
+
+bool StorageEngine::contains_locked(const GlyphId& id) const {
+    if (memtable_.count(id)) {
+        return true;
+    }
+    for (const auto& segment : segments_) {
+        const SegmentIndexEntry* entry = segment->find(id);
+        if (entry && !entry->is_delta()) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void StorageEngine::checkpoint() {
+    {
+        std::unique_lock<std::shared_mutex> lock(mu_);
+        checkpoint_locked();
+    }
+    schedule_compaction();
+}
+
+void StorageEngine::maybe_checkpoint() {
+    {
+        std::unique_lock<std::shared_mutex> lock(mu_);
+        // Several writers can cross the threshold together; only the first checkpoints
+        if (wal_bytes_ < options_.checkpoint_bytes) {
+            return;
+        }
+        checkpoint_locked();
+    }
+    schedule_compaction();
+}
+
+void StorageEngine::schedule_compaction() {
+    {
+        std::shared_lock<std::shared_mutex> lock(mu_);
+        if (!want_compaction()) {
+            return;
+        }
+    }
+    if (compact_thread_.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(compact_wake_mu_);
+            compact_requested_ = true;
+        }
+        compact_cv_.notify_one();
+    } else if (!options_.compaction.background) {
+        compact_run(false);
+    }
+}
+
+void StorageEngine::checkpoint_locked() {
+    if (memtable_.empty() && deltas_.empty()) {
+        return;
+    }
+
+    // Writers are blocked: everything logged so far is in the memtable
+    const uint64_t first_lsn = checkpoint_lsn_ + 1;
+    uint64_t lsn = wal_->roll();
+
+    std::vector<SegmentInput> inputs;
+    inputs.reserve(memtable_.size() + deltas_.size());
+    for (const auto& kv : memtable_) {
+        inputs.push_back(SegmentInput{&kv.second.glyph, kv.second.lsn});
+    }
+    for (const auto& kv : deltas_) {
+        inputs.push_back(SegmentInput{nullptr, kv.second.lsn, &kv.second.delta});
+    }
+    std::string path = write_segment(dir_, inputs, first_lsn, lsn, options_.wal.sync);
+    segments_.insert(segments_.begin(), std::make_shared<Segment>(path));
+    checkpoint_lsn_ = lsn;
+    checkpoint_bytes_written_ += segments_.front()->file_bytes();
+
+    // Only now is the log redundant
+    wal_->remove_through(lsn);
+    memtable_.clear();
+    deltas_.clear();
+    mem_arena_.reset();
+    wal_bytes_ = 0;
+}
+
+bool StorageEngine::want_compaction() const {
+    return options_.compaction.max_segments > 0 &&
+           segments_.size() > options_.compaction.max_segments;
+}
+
+void StorageEngine::compact() {
+    {
+        std::lock_guard<std::mutex> lock(compact_wake_mu_);
+        if (compact_error_) {
+            std::rethrow_exception(compact_error_);
+        }
+    }
+    compact_run(true);
+}
+
+void StorageEngine::compaction_loop() {
+    std::unique_lock<std::mutex> lock(compact_wake_mu_);
+    for (;;) {
+        compact_cv_.wait(lock, [&] { return compact_stop_ || compact_requested_; });
+        if (compact_stop_) {
+            return;
+        }
+        compact_requested_ = false;
+        lock.unlock();
+        try {
+            compact_run(false);
+        } catch (...) {
+            lock.lock();
+            compact_error_ = std::current_exception();
+            return;
+        }
+        lock.lock();
+    }
+}
+
+/**
+ * Merge a run of the newest segments (every segment if full) into one
+ *
+ * The run is read through shared_ptr copies without holding mu_. The
+ * output covers the run's LSN range; under the exclusive lock, the glyphs
+ * it leaves out for collect are checked against the writes made since, and
+ * it is renamed over the run's newest file and swapped in. Only after that
+ * are the older inputs unlinked.
+ */
+void StorageEngine::compact_run(bool full) {
+    std::lock_guard<std::mutex> serial(compact_mu_);
+    std::vector<std::shared_ptr<Segment>> all;
+    {
+        std::shared_lock<std::shared_mutex> lock(mu_);
+        if (!full && !want_compaction()) {
+            return;
+        }
+        all = segments_;
+    }
+
+    size_t k = all.size();
+    if (!full) {
+        // At least enough to get back under max_segments, then while sizes are comparable
+        k = all.size() - options_.compaction.max_segments + 1;
+        uint64_t run_bytes = 0;
+        for (size_t i = 0; i < k; i++) {
+            run_bytes += all[i]->file_bytes();
+        }
+        while (k < all.size() &&
+               static_cast<double>(all[k]->file_bytes()) <=
+                   options_.compaction.size_ratio * static_cast<double>(run_bytes)) {
+            run_bytes += all[k++]->file_bytes();
+        }
+    }
+    if (k == 0) {
+        return;
+    }
+    const std::vector<std::shared_ptr<Segment>> run(all.begin(), all.begin() + k);
+    const std::vector<std::shared_ptr<Segment>> older(all.begin() + k, all.end());
+    const bool bottom = older.empty();  // Nothing older: unresolved deltas are orphans
+
+    SegmentWriter writer(dir_, run.back()->first_lsn(), run.front()->max_lsn(),
+                         options_.wal.sync);
+    std::vector<Glyph> collected;
+    ContentArena collected_arena;
+    // Segments newer than the run (mu_ held): checkpoints since the copy only prepend
+    auto find_run = [&] {
+        return static_cast<size_t>(std::find(segments_.begin(), segments_.end(), run.front()) -
+                                   segments_.begin());
+    };
+
+    // K-way merge of the sorted indexes; ties go to the newer segment first
+    using Cursor = std::pair<size_t, size_t>;  // (run index, index entry)
+    auto later = [&](const Cursor& a, const Cursor& b) {
+        const GlyphId& ia = run[a.first]->index()[a.second].id;
+        const GlyphId& ib = run[b.first]->index()[b.second].id;
+        return ib < ia || (ia == ib && a.first > b.first);
+    };
+    std::priority_queue<Cursor, std::vector<Cursor>, decltype(later)> heap(later);
+    for (size_t i = 0; i < k; i++) {
+        if (!run[i]->index().empty()) {
+            heap.push(Cursor{i, 0});
+        }
+    }
+
+    ContentArena arena;
+    Glyph g;
+    for (size_t merged = 0; !heap.empty(); merged++) {
+        if (merged % 4096 == 0 && compact_stop_.load(std::memory_order_relaxed)) {
+            return;  // Closing: the writer removes its temp file
+        }
+        const GlyphId id = run[heap.top().first]->index()[heap.top().second].id;
+        GlyphDelta newer;
+        uint64_t newest_lsn = 0;
+        bool have_put = false;
+        while (!heap.empty() && run[heap.top().first]->index()[heap.top().second].id == id) {
+            Cursor c = heap.top();
+            heap.pop();
+            const Segment& segment = *run[c.first];
+            const SegmentIndexEntry& entry = segment.index()[c.second];
+            if (!have_put) {
+                uint64_t lsn;
+                if (entry.is_delta()) {
+                    GlyphDelta older_delta;
+                    segment.read_delta(entry, older_delta, lsn);
+                    fold_delta(older_delta, newer);
+                    newer = older_delta;
+                } else {
+                    segment.read(entry, g, arena, lsn);
+                    apply_delta(newer, g);
+                    have_put = true;
+                }
+                newest_lsn = std::max(newest_lsn, lsn);
+            }
+            if (c.second + 1 < segment.index().size()) {
+                heap.push(Cursor{c.first, c.second + 1});
+            }
+        }
+
+        if (have_put) {
+            // An older version outside the run would reappear if this one went
+            bool collect = options_.compaction.collect && options_.compaction.collect(g) &&
+                           std::none_of(older.begin(), older.end(),
+                                        [&](const auto& s) { return s->contains(id); });
+            if (collect) {
+                std::shared_lock<std::shared_mutex> lock(mu_);
+                Glyph folded;
+                collect = collectable_locked(g, find_run(), folded);
+            }
+            if (collect) {
+                // Checked again at the swap, when a newer write may have revived it
+                Glyph kept = g;
+                kept.content = Content();
+                kept.content.assign(g.content.data(), g.content.size(), collected_arena);
+                collected.push_back(kept);
+            } else {
+                writer.add(g, newest_lsn);
+            }
+        } else if (!bottom) {
+            writer.add(newer, newest_lsn);  // Still applies to an older segment
+        }
+        arena.reset();
+    }
+
+    writer.seal();
+    std::shared_ptr<Segment> output;
+    size_t dropped = 0;
+    {
+        std::unique_lock<std::shared_mutex> lock(mu_);
+        // Writes since the first check: a glyph collect no longer selects is
+        // logged again as a put, durable before the rename drops its old version
+        std::vector<Glyph> revived;
+        const size_t start = find_run();
+        for (const Glyph& c : collected) {
+            Glyph folded;
+            if (collectable_locked(c, start, folded)) {
+                deltas_.erase(c.id);
+                dropped++;
+            } else {
+                revived.push_back(folded);
+            }
+        }
+        if (!revived.empty()) {
+            bool want_checkpoint;  // Left to the next writer: this thread holds compact_mu_
+            wal_->wait_durable(append_locked(revived.data(), revived.size(), want_checkpoint));
+        }
+
+        // Renames over the newest input: from here on recovery drops the others
+        output = std::make_shared<Segment>(writer.install());
+        // Checkpoints only prepend, so the run is still contiguous
+        auto first = segments_.begin() + start;
+        *first = output;
+        segments_.erase(first + 1, first + k);
+        compaction_bytes_written_ += output->file_bytes();
+        compactions_++;
+        glyphs_collected_ += dropped;
+    }
+    sync_dir(dir_, options_.wal.sync);
+    for (size_t i = 1; i < k; i++) {
+        if (unlink(run[i]->path().c_str()) != 0 && errno != ENOENT) {
+            throw std::system_error(errno, std::generic_category(), "unlink " + run[i]->path());
+        }
+    }
+    sync_dir(dir_, options_.wal.sync);
+}
+
+/**
+ * Whether compaction may drop g, the version of its ID folded from the run
+ * that starts at segments_[first]
+ *
+ * Only called once collect selected g. A full version in the memtable or a
+ * newer segment replaces g anyway; otherwise the newer deltas are folded
+ * into folded and collect decides on the result.
+ */
+bool StorageEngine::collectable_locked(const Glyph& g, size_t first, Glyph& folded) const {
+    folded = g;
+    if (memtable_.count(g.id)) {
+        return true;
+    }
+    GlyphDelta newer;
+    auto d = deltas_.find(g.id);
+    if (d != deltas_.end()) {
+        newer = d->second.delta;
+    }
+    for (size_t i = 0; i < first; i++) {
+        const SegmentIndexEntry* entry = segments_[i]->find(g.id);
+        if (!entry) {
+            continue;
+        }
+        if (!entry->is_delta()) {
+            return true;
+        }
+        GlyphDelta older;
+        uint64_t lsn;
+        segments_[i]->read_delta(*entry, older, lsn);
+        fold_delta(older, newer);
+        newer = older;
+    }
+    if (newer.fields == 0) {
+        return true;
+    }
+    apply_delta(newer, folded);
+    return options_.compaction.collect(folded);
+}
+
+StorageEngine::Stats StorageEngine::stats() const {
+    std::shared_lock<std::shared_mutex> lock(mu_);
+    Stats s;
+    s.last_lsn = wal_->last_lsn();
+    s.durable_lsn = wal_->durable_lsn();
+    s.checkpoint_lsn = checkpoint_lsn_;
+    s.memtable_glyphs = memtable_.size();
+    s.memtable_deltas = deltas_.size();
+    s.segments = segments_.size();
+    WalWriter::Stats wal = wal_->stats();
+    s.commits = wal.commits;
+    s.log_bytes = wal.bytes;
+    s.checkpoint_bytes = checkpoint_bytes_written_;
+    s.compaction_bytes = compaction_bytes_written_;
+    s.compactions = compactions_;
+    s.glyphs_collected = glyphs_collected_;
+    return s;
+}
+
+} // namespace spu
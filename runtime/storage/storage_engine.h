@@ -0,0 +1,248 @@
+/**
+ * SPU Storage Engine - Durable glyph store
+ *
+ * Native replacement for the one-JSON-file-per-glyph persistence layer
+ * (docs/persistence_tuning.md). Every put appends a binary glyph record to
+ * the write-ahead log (wal.h) and returns once a group commit has synced
+ * it; concurrent writers share syncs, and put_batch() / put_async() let a
+ * single thread amortize one sync over many glyphs.
+ *
+ * Recent writes live in an in-memory table. checkpoint() writes that table
+ * to an immutable segment file (segment.h) and deletes the log files it
+ * covers. At startup the engine removes leftover temporary files, opens
+ * the segments and replays the log past the newest segment, truncating a
+ * torn tail left by a crash.
+ *
+ * update() logs only the numeric fields a tick changed (record.h deltas);
+ * checkpoints write the folded deltas as delta records, and reads fold them
+ * over the newest full version. Compaction merges runs of segments off the
+ * lock, folding deltas into full records and dropping glyphs that
+ * CompactionOptions::collect selects, so log, checkpoint and recovery cost
+ * follow the rate of change rather than the number of glyphs stored.
+ *
+ * Guarantees: a write is durable once put() / wait_durable() returns;
+ * after a crash, every acknowledged write is readable with its exact
+ * content, and no partial record or temporary file is ever visible.
+ * Writes that were not yet acknowledged may or may not survive.
+ */
+
+#ifndef SPU_STORAGE_ENGINE_H
+#define SPU_STORAGE_ENGINE_H
+
+#include "merge_ref.h"
+#include "segment.h"
+#include "wal.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace spu {
+
+struct CompactionOptions {
+    // Compact once there are more segments than this (0 = only explicit compact() calls)
+    size_t max_segments = 8;
+
+    // A run of the newest segments takes in the next older segment while that
+    // one is at most size_ratio times the run's bytes, so each glyph is
+    // rewritten a logarithmic number of times instead of at every compaction
+    double size_ratio = 4.0;
+
+    // Compact on a background thread (false: in the writer that checkpointed)
+    bool background = true;
+
+    /**
+     * Glyphs to delete at compaction, e.g. energy decayed to zero (empty = keep all)
+     *
+     * Called on the glyph folded from the compacted segments. A glyph is
+     * dropped only once no older segment holds a version of it, and only if
+     * collect also selects it with every newer write up to the swap (pending
+     * deltas included) folded in; otherwise it is kept. Once dropped, get()
+     * returns false and update() throws until it is put() again.
+     */
+    std::function<bool(const Glyph&)> collect;
+};
+
+struct StorageOptions {
+    WalOptions wal;
+
+    // Checkpoint automatically once this many log bytes accumulate (0 = only
+    // explicit checkpoint() calls)
+    size_t checkpoint_bytes = 64 * 1024 * 1024;
+
+    CompactionOptions compaction;
+};
+
+class StorageEngine {
+public:
+    struct RecoveryStats {
+        size_t segments;             // Segment files opened
+        size_t wal_files;            // Log files found
+        uint64_t records_replayed;   // Log records newer than the last checkpoint
+        uint64_t bytes_truncated;    // Torn log tail removed
+        size_t temp_files_removed;   // Interrupted checkpoint files removed
+        size_t segments_superseded;  // Compaction inputs left by a crash, removed
+    };
+
+    struct Stats {
+        uint64_t last_lsn;
+        uint64_t durable_lsn;
+        uint64_t checkpoint_lsn;  // Highest LSN stored in a segment
+        size_t memtable_glyphs;
+        size_t memtable_deltas;   // Glyphs whose unflushed writes are deltas only
+        size_t segments;
+        uint64_t commits;         // Log syncs since open
+        // Bytes written since open (write amplification = their sum / bytes changed)
+        uint64_t log_bytes;
+        uint64_t checkpoint_bytes;
+        uint64_t compaction_bytes;
+        uint64_t compactions;
+        uint64_t glyphs_collected;  // Dropped by CompactionOptions::collect
+    };
+
+    /**
+     * Open (creating if needed) the store in dir and recover it
+     *
+     * @throws std::system_error on I/O errors or if another process has dir open
+     * @throws std::runtime_error on corruption
+     */
+    explicit StorageEngine(const std::string& dir, const StorageOptions& options = StorageOptions());
+
+    // Stops background compaction and syncs outstanding writes; does not checkpoint
+    ~StorageEngine();
+
+    StorageEngine(const StorageEngine&) = delete;
+    StorageEngine& operator=(const StorageEngine&) = delete;
+
+    /**
+     * Store a glyph (replacing any glyph with the same ID); durable on return
+     *
+     * @return LSN of the write
+     */
+    uint64_t put(const Glyph& g);
+
+    // Store n glyphs with one group commit; returns the last LSN
+    uint64_t put_batch(const Glyph* glyphs, size_t n);
+
+    /**
+     * Store a glyph without waiting for the sync
+     *
+     * Visible to get() immediately; durable after wait_durable(lsn).
+     */
+    uint64_t put_async(const Glyph& g);
+
+    /**
+     * Overwrite numeric fields of stored glyphs; durable on return
+     *
+     * Logs only the fields set in each delta (64 to 80 bytes per glyph).
+     *
+     * @return LSN of the last delta
+     * @throws std::invalid_argument if an ID is not stored or a delta has no
+     *         fields (checked before anything is logged)
+     */
+    uint64_t update_batch(const GlyphDelta* deltas, size_t n);
+    uint64_t update(const GlyphDelta& d);
+
+    void wait_durable(uint64_t lsn);
+
+    /**
+     * Look up a glyph by ID
+     *
+     * @param out Output glyph
+     * @param arena Arena receiving a copy of the content
+     * @return false if no glyph has this ID
+     */
+    bool get(const GlyphId& id, Glyph& out, ContentArena& arena) const;
+
+    bool contains(const GlyphId& id) const;
+
+    /**
+     * Write the in-memory table to a segment and drop the log it covers
+     *
+     * Blocks writers while the segment is written.
+     */
+    void checkpoint();
+
+    /**
+     * Merge every segment into one (folding deltas, applying collect)
+     *
+     * Readers and writers continue meanwhile; they are blocked only while
+     * the new segment replaces its inputs. A crash at any point leaves
+     * either the inputs or the output (recovery removes whichever inputs
+     * remain).
+     *
+     * @throws The error that stopped background compaction, if any
+     */
+    void compact();
+
+    const RecoveryStats& recovery() const { return recovery_; }
+    Stats stats() const;
+
+    const std::string& dir() const { return dir_; }
+
+private:
+    struct MemEntry {
+        Glyph glyph;
+        uint64_t lsn;
+    };
+
+    struct DeltaEntry {
+        GlyphDelta delta;  // Every delta since the last checkpoint, folded
+        uint64_t lsn;
+    };
+
+    void recover();
+    void insert_mem(const Glyph& g, uint64_t lsn);
+    void apply_mem(const GlyphDelta& d, uint64_t lsn);
+    bool contains_locked(const GlyphId& id) const;
+    bool collectable_locked(const Glyph& g, size_t first, Glyph& folded) const;
+    uint64_t append_locked(const Glyph* glyphs, size_t n, bool& want_checkpoint);
+    void maybe_checkpoint();
+    void checkpoint_locked();
+    bool want_compaction() const;
+    void schedule_compaction();
+    void compact_run(bool full);
+    void compaction_loop();
+
+    std::string dir_;
+    StorageOptions options_;
+    int lock_fd_;
+
+    mutable std::shared_mutex mu_;
+    std::unordered_map<GlyphId, MemEntry, GlyphIdHash> memtable_;
+    std::unordered_map<GlyphId, DeltaEntry, GlyphIdHash> deltas_;  // IDs not in memtable_
+    ContentArena mem_arena_;
+    size_t wal_bytes_;  // Logged since the last checkpoint
+    // Newest first; compaction reads a copy of the list without holding mu_
+    std::vector<std::shared_ptr<Segment>> segments_;
+    uint64_t checkpoint_lsn_;
+    std::unique_ptr<WalWriter> wal_;
+    uint64_t checkpoint_bytes_written_;
+    uint64_t compaction_bytes_written_;
+    uint64_t compactions_;
+    uint64_t glyphs_collected_;
+
+    std::mutex compact_mu_;  // One compaction at a time
+    std::mutex compact_wake_mu_;
+    std::condition_variable compact_cv_;
+    bool compact_requested_;
+    std::atomic<bool> compact_stop_;  // Also polled by a running compaction
+    std::exception_ptr compact_error_;  // Stopped background compaction
+    std::thread compact_thread_;
+
+    RecoveryStats recovery_;
+};
+
+} // namespace spu
+
+#endif // SPU_STORAGE_ENGINE_H
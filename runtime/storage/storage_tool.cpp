@@ -0,0 +1,839 @@
+/**
+ * SPU Storage Tool - Durable write benchmark, crash and compaction tests
+ *
+ * Build (from runtime/storage):
+ *   g++ -O3 -std=c++17 -pthread -I. -I../spu storage_tool.cpp storage_engine.cpp wal.cpp \
+ *       segment.cpp record.cpp crc32c.cpp file_io.cpp async_io.cpp ../spu/merge_ref.cpp \
+ *       ../spu/content.cpp ../spu/hash.cpp ../spu/sha256_x86.cpp ../spu/perf_counters.cpp \
+ *       ../spu/telemetry.cpp -o storage_tool
+ *
+ * Usage:
+ *   ./storage_tool bench --dir /tmp/spu_store --count 100000 --threads 8 --batch 1
+ *   ./storage_tool crash-test --dir /tmp/spu_crash --rounds 20
+ *   ./storage_tool tick-bench --dir /tmp/spu_ticks --count 2000 --batch 256 --io uring
+ *   ./storage_tool delta-bench --dir /tmp/spu_delta --count 100000 --rounds 200 --changed 1
+ *   ./storage_tool compaction-test --dir /tmp/spu_compact --count 20000
+ *
+ * bench prints a JSON summary (durable writes/sec, commit count, put
+ * latency percentiles). crash-test repeatedly SIGKILLs a writer process at
+ * a random point, reopens the store and checks every acknowledged write,
+ * in the format of benchmarks/persistence_crash_report.txt. tick-bench
+ * runs a merge tick loop that logs each tick's results, once with an
+ * inline write + sync and once through AsyncIo, and prints tick latency
+ * percentiles for both. delta-bench stores a pool of --count glyphs, then
+ * runs --rounds decay ticks that each change --changed percent of them,
+ * once logging full glyphs (put_batch) and once logging deltas
+ * (update_batch, compaction collecting glyphs decayed to zero), and prints
+ * bytes written per update and recovery time for both. compaction-test
+ * checks that compacting with a collect policy keeps every acknowledged
+ * update, including updates racing the compaction.
+ *
+ * --io selects how WAL commits are written: sync (write + sync calls on the
+ * flusher thread), uring (linked io_uring write + fsync) or pool
+ * (AsyncIo thread-pool backend). --metrics FILE writes the run's telemetry
+ * (fsync and WAL commit latency histograms) in OpenMetrics text format.
+ */
+
+#include "async_io.h"
+#include "record.h"
+#include "storage_engine.h"
+#include "telemetry.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <future>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace {
+
+struct Args {
+    std::string command;
+    std::string dir = "/tmp/spu_store";
+    size_t count = 100000;
+    size_t threads = 1;
+    size_t batch = 1;
+    uint32_t window_us = 0;
+    size_t rounds = 20;
+    std::string fsync = "metadata";
+    std::string io = "sync";
+    double changed = 1.0;  // delta-bench: percent of the pool changed per tick
+    std::string metrics;   // OpenMetrics output file ("" = none)
+};
+
+void usage() {
+    fprintf(stderr,
+            "usage: storage_tool bench|crash-test|tick-bench|delta-bench|compaction-test\n"
+            "                    [--dir D] [--count N]\n"
+            "                    [--threads T] [--batch B] [--window-us W] [--rounds R]\n"
+            "                    [--fsync full|metadata|none] [--io sync|uring|pool]\n"
+            "                    [--changed PERCENT] [--metrics FILE]\n");
+    exit(2);
+}
+
+Args parse_args(int argc, char** argv) {
+    if (argc < 2) {
+        usage();
+    }
+    Args a;
+    a.command = argv[1];
+    for (int i = 2; i < argc; i++) {
+        std::string flag = argv[i];
+        if (i + 1 >= argc) {
+            usage();
+        }
+        const char* v = argv[++i];
+        if (flag == "--dir") a.dir = v;
+        else if (flag == "--count") a.count = strtoull(v, nullptr, 10);
+        else if (flag == "--threads") a.threads = std::max<size_t>(1, strtoull(v, nullptr, 10));
+        else if (flag == "--batch") a.batch = std::max<size_t>(1, strtoull(v, nullptr, 10));
+        else if (flag == "--window-us") a.window_us = static_cast<uint32_t>(strtoul(v, nullptr, 10));
+        else if (flag == "--rounds") a.rounds = strtoull(v, nullptr, 10);
+        else if (flag == "--fsync") a.fsync = v;
+        else if (flag == "--io") a.io = v;
+        else if (flag == "--changed") a.changed = strtod(v, nullptr);
+        else if (flag == "--metrics") a.metrics = v;
+        else usage();
+    }
+    return a;
+}
+
+spu::StorageOptions make_options(const Args& a) {
+    spu::StorageOptions options;
+    if (!spu::parse_sync_mode(a.fsync, options.wal.sync)) {
+        usage();
+    }
+    options.wal.group_commit_us = a.window_us;
+    return options;
+}
+
+// AsyncIo for --io (nullptr for sync)
+std::unique_ptr<spu::AsyncIo> make_io(const Args& a) {
+    spu::AsyncIo::Options options;
+    if (a.io == "uring") {
+        options.backend = spu::AsyncIo::Backend::kIoUring;
+    } else if (a.io == "pool") {
+        options.backend = spu::AsyncIo::Backend::kThreadPool;
+    } else if (a.io == "sync") {
+        return nullptr;
+    } else {
+        usage();
+    }
+    options.buffer_count = 0;
+    return std::unique_ptr<spu::AsyncIo>(new spu::AsyncIo(options));
+}
+
+// Deterministic glyph for sequence number seq (inline and arena lengths)
+void make_glyph(uint64_t seq, spu::Glyph& g, spu::ContentArena& arena) {
+    std::string content = "Crash test glyph " + std::to_string(seq);
+    content.append(seq % 97, 'x');
+    g = spu::Glyph();
+    g.content.assign(content.data(), content.size(), arena);
+    spu::content_hash(content.data(), content.size(), g.id);
+    g.energy = static_cast<double>(seq % 1000) * 0.5 + 1.0;
+    g.activation_count = static_cast<uint32_t>(seq % 7);
+    g.last_update_time = seq;
+}
+
+double now_s() {
+    return std::chrono::duration<double>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+int run_bench(const Args& a) {
+    std::unique_ptr<spu::AsyncIo> io = make_io(a);
+    spu::StorageOptions options = make_options(a);
+    options.wal.io = io.get();
+    spu::StorageEngine engine(a.dir, options);
+    const uint64_t base = engine.stats().last_lsn;
+
+    std::atomic<size_t> next(0);
+    std::vector<std::vector<double>> latencies(a.threads);
+    auto worker = [&](size_t t) {
+        spu::ContentArena arena;
+        std::vector<spu::Glyph> batch(a.batch);
+        for (;;) {
+            size_t start = next.fetch_add(a.batch);
+            if (start >= a.count) {
+                break;
+            }
+            size_t n = std::min(a.batch, a.count - start);
+            for (size_t i = 0; i < n; i++) {
+                make_glyph(base + start + i, batch[i], arena);
+            }
+            double t0 = now_s();
+            engine.put_batch(batch.data(), n);
+            latencies[t].push_back((now_s() - t0) * 1e3);
+            arena.reset();
+        }
+    };
+
+    double t0 = now_s();
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < a.threads; t++) {
+        threads.emplace_back(worker, t);
+    }
+    for (auto& th : threads) {
+        th.join();
+    }
+    double seconds = now_s() - t0;
+
+    std::vector<double> all;
+    for (const auto& l : latencies) {
+        all.insert(all.end(), l.begin(), l.end());
+    }
+    std::sort(all.begin(), all.end());
+    auto pct = [&](double p) {
+        return all.empty() ? 0.0 : all[std::min(all.size() - 1, static_cast<size_t>(p * all.size()))];
+    };
+    spu::StorageEngine::Stats s = engine.stats();
+
+    printf("{\n");
+    printf("  \"engine\": \"spu_storage\",\n");
+    printf("  \"count\": %zu,\n", a.count);
+    printf("  \"threads\": %zu,\n", a.threads);
+    printf("  \"batch\": %zu,\n", a.batch);
+    printf("  \"group_commit_us\": %u,\n", a.window_us);
+    printf("  \"fsync_mode\": \"%s\",\n", a.fsync.c_str());
+    printf("  \"io\": \"%s\",\n", io ? io->backend_name() : "sync");
+    printf("  \"seconds\": %.3f,\n", seconds);
+    printf("  \"durable_writes_per_sec\": %.0f,\n", a.count / seconds);
+    printf("  \"commits\": %llu,\n", static_cast<unsigned long long>(s.commits));
+    printf("  \"writes_per_commit\": %.1f,\n", s.commits ? double(a.count) / s.commits : 0.0);
+    printf("  \"put_latency_ms\": {\"median\": %.3f, \"p95\": %.3f, \"p99\": %.3f, \"max\": %.3f}\n",
+           pct(0.50), pct(0.95), pct(0.99), all.empty() ? 0.0 : all.back());
+    printf("}\n");
+    return 0;
+}
+
+// Remove the files of a previous run (dir holds no subdirectories)
+void clear_dir(const std::string& dir) {
+    spu::make_dir(dir);
+    for (const std::string& name : spu::list_dir(dir)) {
+        std::string path = spu::path_join(dir, name);
+        if (unlink(path.c_str()) != 0) {
+            throw std::system_error(errno, std::generic_category(), "unlink " + path);
+        }
+    }
+}
+
+// Child: write until killed, reporting each acknowledged [begin, end) on fd
+[[noreturn]] void crash_writer(const Args& a, uint64_t first_seq, int fd) {
+    std::unique_ptr<spu::AsyncIo> io = make_io(a);
+    spu::StorageOptions options = make_options(a);
+    options.wal.io = io.get();
+    options.checkpoint_bytes = 256 * 1024;  // Crash inside checkpoints too
+    spu::StorageEngine engine(a.dir, options);
+
+    std::atomic<uint64_t> next(first_seq);
+    auto worker = [&] {
+        spu::ContentArena arena;
+        std::vector<spu::Glyph> batch(a.batch);
+        for (;;) {
+            uint64_t start = next.fetch_add(a.batch);
+            for (size_t i = 0; i < a.batch; i++) {
+                make_glyph(start + i, batch[i], arena);
+            }
+            engine.put_batch(batch.data(), a.batch);
+            uint64_t range[2] = {start, start + a.batch};
+            if (write(fd, range, sizeof(range)) != sizeof(range)) {
+                _exit(1);
+            }
+            arena.reset();
+        }
+    };
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < a.threads; t++) {
+        threads.emplace_back(worker);
+    }
+    for (auto& th : threads) {
+        th.join();
+    }
+    _exit(0);
+}
+
+// Newest log file in dir ("" if none)
+std::string newest_wal(const std::string& dir) {
+    std::string newest;
+    for (const std::string& name : spu::list_dir(dir)) {
+        uint64_t number;
+        if (spu::parse_wal_file_name(name, number) && name > newest) {
+            newest = name;
+        }
+    }
+    return newest.empty() ? newest : spu::path_join(dir, newest);
+}
+
+// Simulate a write torn by power loss: a partial record at the end of the log
+void append_torn_record(const std::string& dir, std::mt19937_64& rng) {
+    const std::string newest = newest_wal(dir);
+    if (newest.empty()) {
+        return;
+    }
+    spu::Glyph g;
+    spu::ContentArena arena;
+    make_glyph(rng(), g, arena);
+    std::string record;
+    spu::encode_record(g, 1, record);
+    record.resize(1 + rng() % (record.size() - 1));
+
+    FILE* f = fopen(newest.c_str(), "ab");
+    if (f) {
+        fwrite(record.data(), 1, record.size(), f);
+        fclose(f);
+    }
+}
+
+/**
+ * Flip a byte inside a record in the middle of the newest log, with
+ * acknowledged records after it: recovery must refuse to open rather than
+ * truncate them away as a torn tail
+ */
+bool check_mid_log_corruption(const Args& a) {
+    const std::string dir = a.dir + "-corrupt";
+    const uint64_t records = 16;
+    clear_dir(dir);
+    {
+        spu::StorageEngine engine(dir, make_options(a));
+        spu::ContentArena arena;
+        spu::Glyph g;
+        for (uint64_t seq = 0; seq < records; seq++) {
+            make_glyph(seq, g, arena);
+            engine.put(g);
+            arena.reset();
+        }
+    }
+
+    const std::string path = newest_wal(dir);
+    std::string data = path.empty() ? std::string() : spu::read_file(path);
+    size_t off = 0;
+    for (uint64_t k = 0; k < records / 2; k++) {
+        uint64_t lsn;
+        spu::GlyphId id;
+        size_t consumed;
+        if (spu::check_record(data.data() + off, data.size() - off, lsn, id, consumed) !=
+            spu::DecodeStatus::kOk) {
+            fprintf(stderr, "mid-log corruption: %s does not hold %llu records\n", path.c_str(),
+                    static_cast<unsigned long long>(records));
+            return false;
+        }
+        off += consumed;
+    }
+    // A payload byte: the header still parses, the CRC does not match
+    off += sizeof(spu::RecordHeader) + 40;
+    FILE* f = fopen(path.c_str(), "r+b");
+    if (!f || fseek(f, static_cast<long>(off), SEEK_SET) != 0 ||
+        fputc(static_cast<unsigned char>(data[off] ^ 0x5a), f) == EOF || fclose(f) != 0) {
+        perror(path.c_str());
+        return false;
+    }
+
+    try {
+        spu::StorageEngine engine(dir, make_options(a));
+        fprintf(stderr, "mid-log corruption: recovery opened the store (%llu torn bytes)\n",
+                static_cast<unsigned long long>(engine.recovery().bytes_truncated));
+        return false;
+    } catch (const std::runtime_error& e) {
+        printf("  mid-log corruption refused: %s\n", e.what());
+        return true;
+    }
+}
+
+int run_crash_test(const Args& a) {
+    std::mt19937_64 rng(12345);
+    std::vector<std::pair<uint64_t, uint64_t>> acked;
+    uint64_t next_seq = 0;
+    uint64_t total = 0, missing = 0, corrupted = 0, truncated_bytes = 0, temp_removed = 0;
+    uint64_t superseded = 0;
+    size_t temp_remaining = 0;
+    bool ok = true;
+
+    for (size_t round = 0; round < a.rounds; round++) {
+        int fds[2];
+        if (pipe(fds) != 0) {
+            perror("pipe");
+            return 1;
+        }
+        pid_t pid = fork();
+        if (pid == 0) {
+            close(fds[0]);
+            crash_writer(a, next_seq, fds[1]);
+        }
+        close(fds[1]);
+
+        usleep(static_cast<useconds_t>(5000 + rng() % 45000));
+        kill(pid, SIGKILL);
+        int status;
+        waitpid(pid, &status, 0);
+        if (!WIFSIGNALED(status)) {
+            fprintf(stderr, "round %zu: writer exited early (status %d)\n", round, status);
+            ok = false;
+        }
+
+        uint64_t range[2];
+        while (read(fds[0], range, sizeof(range)) == sizeof(range)) {
+            acked.emplace_back(range[0], range[1]);
+            total += range[1] - range[0];
+            next_seq = std::max(next_seq, range[1]);
+        }
+        close(fds[0]);
+        next_seq += 1u << 20;  // Unacknowledged writes of this round stay out of later rounds
+
+        if (round % 2 == 1) {
+            append_torn_record(a.dir, rng);
+        }
+
+        // Recover and verify every write acknowledged so far
+        spu::StorageEngine engine(a.dir, make_options(a));
+        truncated_bytes += engine.recovery().bytes_truncated;
+        temp_removed += engine.recovery().temp_files_removed;
+        superseded += engine.recovery().segments_superseded;
+        spu::ContentArena arena, got_arena;
+        for (const auto& r : acked) {
+            for (uint64_t seq = r.first; seq < r.second; seq++) {
+                spu::Glyph want, got;
+                make_glyph(seq, want, arena);
+                if (!engine.get(want.id, got, got_arena)) {
+                    missing++;
+                } else if (got.content.str() != want.content.str() || got.energy != want.energy ||
+                           got.last_update_time != want.last_update_time) {
+                    corrupted++;
+                }
+                arena.reset();
+                got_arena.reset();
+            }
+        }
+        for (const std::string& name : spu::list_dir(a.dir)) {
+            if (name.compare(0, strlen(spu::kTempFilePrefix), spu::kTempFilePrefix) == 0) {
+                temp_remaining++;
+            }
+        }
+        printf("  round %zu: %zu acknowledged batches, %llu glyphs stored, %llu torn bytes\n",
+               round, acked.size(), static_cast<unsigned long long>(total),
+               static_cast<unsigned long long>(engine.recovery().bytes_truncated));
+    }
+
+    const bool mid_log_refused = check_mid_log_corruption(a);
+    const bool pass = ok && missing == 0 && corrupted == 0 && temp_remaining == 0 &&
+                      mid_log_refused;
+    printf("\nNative Storage Crash Safety Test Report\n");
+    printf("=======================================\n\n");
+    printf("Rounds (SIGKILL mid-write): %zu\n", a.rounds);
+    printf("Writer threads: %zu, batch: %zu\n\n", a.threads, a.batch);
+    printf("Results:\n--------\n");
+    printf("Acknowledged writes: %llu\n", static_cast<unsigned long long>(total));
+    printf("Missing after recovery: %llu\n", static_cast<unsigned long long>(missing));
+    printf("Corrupted records: %llu\n", static_cast<unsigned long long>(corrupted));
+    printf("Torn WAL bytes truncated: %llu\n", static_cast<unsigned long long>(truncated_bytes));
+    printf("Interrupted checkpoints cleaned: %llu\n", static_cast<unsigned long long>(temp_removed));
+    printf("Compaction inputs removed: %llu\n", static_cast<unsigned long long>(superseded));
+    printf("Temp files remaining: %zu\n", temp_remaining);
+    printf("Mid-log corruption refused: %s\n\n", mid_log_refused ? "yes" : "no");
+    printf("OVERALL: %s\n", pass ? "PASS" : "FAIL");
+    return pass ? 0 : 1;
+}
+
+// Tick latency percentiles in ms
+struct TickResult {
+    double p50, p99, max, seconds;
+};
+
+/**
+ * Merge loop that logs each tick's results to fd
+ *
+ * io == nullptr: write + sync inline, so each tick pays the sync. Otherwise
+ * a tick's records are queued from a registered buffer and the tick only
+ * waits for the previous tick's write, which overlaps this tick's merges.
+ */
+TickResult run_ticks(const Args& a, int fd, spu::AsyncIo* io, spu::SyncMode sync) {
+    spu::ContentArena pool_arena;
+    std::vector<spu::Glyph> left(a.batch), right(a.batch), out(a.batch);
+    for (size_t i = 0; i < a.batch; i++) {
+        make_glyph(2 * i, left[i], pool_arena);
+        make_glyph(2 * i + 1, right[i], pool_arena);
+    }
+
+    spu::ContentArena arena;
+    std::string records;
+    std::future<size_t> previous;
+    uint64_t offset = 0;
+    uint64_t lsn = 1;
+    std::vector<double> ticks;
+    ticks.reserve(a.count);
+
+    double start = now_s();
+    for (size_t t = 0; t < a.count; t++) {
+        double t0 = now_s();
+        spu::merge_batch(left.data(), right.data(), out.data(), a.batch, arena);
+        records.clear();
+        for (size_t i = 0; i < a.batch; i++) {
+            out[i].last_update_time = t;
+            spu::encode_record(out[i], lsn++, records);
+        }
+
+        if (!io) {
+            spu::write_all(fd, records.data(), records.size());
+            spu::sync_fd(fd, sync);
+        } else {
+            if (records.size() > io->buffer_size()) {
+                throw std::runtime_error("tick records exceed the AsyncIo buffer; lower --batch");
+            }
+            size_t buf = io->acquire_buffer();
+            memcpy(io->buffer(buf), records.data(), records.size());
+            if (previous.valid()) {
+                previous.get();  // At most one tick of results not yet durable
+            }
+            previous = io->write_fixed(fd, buf, records.size(), offset, sync);
+        }
+        offset += records.size();
+        arena.reset();
+        ticks.push_back((now_s() - t0) * 1e3);
+    }
+    if (previous.valid()) {
+        previous.get();
+    }
+    double seconds = now_s() - start;
+
+    std::sort(ticks.begin(), ticks.end());
+    auto pct = [&](double p) {
+        return ticks.empty() ? 0.0
+                             : ticks[std::min(ticks.size() - 1, static_cast<size_t>(p * ticks.size()))];
+    };
+    return TickResult{pct(0.50), pct(0.99), ticks.empty() ? 0.0 : ticks.back(), seconds};
+}
+
+int run_tick_bench(const Args& a) {
+    spu::SyncMode sync;
+    if (!spu::parse_sync_mode(a.fsync, sync)) {
+        usage();
+    }
+    spu::make_dir(a.dir);
+    Args async_args = a;
+    if (async_args.io == "sync") {
+        async_args.io = "uring";
+    }
+    spu::AsyncIo::Options options;
+    options.backend = async_args.io == "pool" ? spu::AsyncIo::Backend::kThreadPool
+                                             : spu::AsyncIo::Backend::kIoUring;
+    options.buffer_count = 2;
+    spu::AsyncIo io(options);
+
+    auto run = [&](const char* name, spu::AsyncIo* aio) {
+        std::string path = spu::path_join(a.dir, name);
+        int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd < 0) {
+            throw std::system_error(errno, std::generic_category(), "open " + path);
+        }
+        TickResult r;
+        try {
+            r = run_ticks(a, fd, aio, sync);
+        } catch (...) {
+            close(fd);
+            throw;
+        }
+        close(fd);
+        unlink(path.c_str());
+        return r;
+    };
+    TickResult blocking = run("ticks-blocking.log", nullptr);
+    TickResult async = run("ticks-async.log", &io);
+
+    printf("{\n");
+    printf("  \"ticks\": %zu,\n", a.count);
+    printf("  \"merges_per_tick\": %zu,\n", a.batch);
+    printf("  \"fsync_mode\": \"%s\",\n", a.fsync.c_str());
+    printf("  \"async_backend\": \"%s\",\n", io.backend_name());
+    printf("  \"blocking\": {\"seconds\": %.3f, \"tick_ms\": {\"median\": %.3f, \"p99\": %.3f, "
+           "\"max\": %.3f}},\n",
+           blocking.seconds, blocking.p50, blocking.p99, blocking.max);
+    printf("  \"async\": {\"seconds\": %.3f, \"tick_ms\": {\"median\": %.3f, \"p99\": %.3f, "
+           "\"max\": %.3f}}\n",
+           async.seconds, async.p50, async.p99, async.max);
+    printf("}\n");
+    return 0;
+}
+
+struct DeltaBenchResult {
+    double seconds;
+    uint64_t updates;
+    spu::StorageEngine::Stats stats;
+    double recovery_ms;
+    spu::StorageEngine::RecoveryStats recovery;
+    size_t live;
+};
+
+/**
+ * Decay ticks over a stored pool, logged as full glyphs or as deltas
+ *
+ * Every tick halves the energy of a random changed% of the live glyphs,
+ * bumps their activation count and update time, and sets energy under 1.0
+ * to zero; dead glyphs are no longer touched. With deltas, compaction
+ * collects the dead ones. Afterwards the store is reopened and timed.
+ */
+DeltaBenchResult run_delta_ticks(const Args& a, const std::string& dir, bool deltas) {
+    clear_dir(dir);
+    spu::StorageOptions options = make_options(a);
+    options.checkpoint_bytes = 4 * 1024 * 1024;
+    if (deltas) {
+        options.compaction.collect = [](const spu::Glyph& g) { return g.energy == 0.0; };
+    }
+
+    spu::ContentArena arena;
+    std::vector<spu::Glyph> pool(a.count);
+    for (size_t i = 0; i < a.count; i++) {
+        make_glyph(i, pool[i], arena);
+        pool[i].energy = static_cast<double>(2u << (i % 8));  // Dies after 1 to 8 changes
+    }
+
+    DeltaBenchResult r{};
+    std::mt19937_64 rng(42);
+    const size_t per_tick = std::max<size_t>(1, static_cast<size_t>(a.count * a.changed / 100.0));
+    {
+        spu::StorageEngine engine(dir, options);
+        for (size_t i = 0; i < a.count; i += 1024) {
+            engine.put_batch(pool.data() + i, std::min<size_t>(1024, a.count - i));
+        }
+        spu::StorageEngine::Stats loaded = engine.stats();
+
+        std::vector<spu::Glyph> changed;
+        std::vector<spu::GlyphDelta> changes;
+        double t0 = now_s();
+        for (size_t tick = 1; tick <= a.rounds; tick++) {
+            changed.clear();
+            changes.clear();
+            for (size_t k = 0; k < per_tick; k++) {
+                spu::Glyph& g = pool[rng() % a.count];
+                if (g.energy == 0.0 || g.last_update_time == tick + a.count) {
+                    continue;  // Dead, or already changed this tick
+                }
+                spu::Glyph before = g;
+                g.energy = g.energy < 2.0 ? 0.0 : g.energy * 0.5;
+                g.activation_count++;
+                g.last_update_time = tick + a.count;
+                changed.push_back(g);
+                changes.push_back(spu::diff_glyph(before, g));
+            }
+            if (deltas) {
+                engine.update_batch(changes.data(), changes.size());
+            } else {
+                engine.put_batch(changed.data(), changed.size());
+            }
+            r.updates += changes.size();
+        }
+        r.seconds = now_s() - t0;
+        r.stats = engine.stats();
+        // Count only what the ticks wrote
+        r.stats.log_bytes -= loaded.log_bytes;
+        r.stats.checkpoint_bytes -= loaded.checkpoint_bytes;
+        r.stats.compaction_bytes -= loaded.compaction_bytes;
+    }
+
+    double t0 = now_s();
+    spu::StorageEngine engine(dir, options);
+    r.recovery_ms = (now_s() - t0) * 1e3;
+    r.recovery = engine.recovery();
+    for (const spu::Glyph& g : pool) {
+        r.live += engine.contains(g.id);
+    }
+    return r;
+}
+
+int run_delta_bench(const Args& a) {
+    DeltaBenchResult puts = run_delta_ticks(a, a.dir + "-puts", false);
+    DeltaBenchResult deltas = run_delta_ticks(a, a.dir + "-deltas", true);
+
+    printf("{\n");
+    printf("  \"pool\": %zu,\n", a.count);
+    printf("  \"ticks\": %zu,\n", a.rounds);
+    printf("  \"changed_percent\": %.2f,\n", a.changed);
+    printf("  \"fsync_mode\": \"%s\",\n", a.fsync.c_str());
+    auto print = [](const char* name, const DeltaBenchResult& r, bool last) {
+        const spu::StorageEngine::Stats& s = r.stats;
+        uint64_t written = s.log_bytes + s.checkpoint_bytes + s.compaction_bytes;
+        printf("  \"%s\": {\"updates\": %llu, \"updates_per_sec\": %.0f, "
+               "\"bytes_per_update\": %.1f, \"log_bytes\": %llu, \"checkpoint_bytes\": %llu, "
+               "\"compaction_bytes\": %llu, \"compactions\": %llu, \"collected\": %llu,\n",
+               name, static_cast<unsigned long long>(r.updates),
+               r.seconds > 0 ? r.updates / r.seconds : 0.0,
+               r.updates ? double(written) / r.updates : 0.0,
+               static_cast<unsigned long long>(s.log_bytes),
+               static_cast<unsigned long long>(s.checkpoint_bytes),
+               static_cast<unsigned long long>(s.compaction_bytes),
+               static_cast<unsigned long long>(s.compactions),
+               static_cast<unsigned long long>(s.glyphs_collected));
+        printf("    \"recovery_ms\": %.1f, \"records_replayed\": %llu, \"segments\": %zu, "
+               "\"live_glyphs\": %zu}%s\n",
+               r.recovery_ms, static_cast<unsigned long long>(r.recovery.records_replayed),
+               r.recovery.segments, r.live, last ? "" : ",");
+    };
+    print("puts", puts, false);
+    print("deltas", deltas, true);
+    printf("}\n");
+    return 0;
+}
+
+/**
+ * Compaction with collect must never drop an acknowledged write
+ *
+ * Sequential cases (each checked before and after reopening the store):
+ * a delta reviving a glyph stored with zero energy, in the delta table or
+ * in a newer segment, and a delta killing one. Then a writer thread updates
+ * a pool of zero-energy glyphs while the main thread checkpoints and
+ * compacts: every update that was acknowledged must be readable, and every
+ * update that was refused (the glyph already collected) must stay absent.
+ */
+int run_compaction_test(const Args& a) {
+    spu::StorageOptions options = make_options(a);
+    options.checkpoint_bytes = 0;
+    options.compaction.max_segments = 0;
+    options.compaction.collect = [](const spu::Glyph& g) { return g.energy == 0.0; };
+    spu::ContentArena arena, got_arena;
+    uint64_t failures = 0;
+
+    auto energy_of = [&](spu::StorageEngine& engine, const spu::Glyph& g) {
+        spu::Glyph got;
+        bool found = engine.get(g.id, got, got_arena);
+        got_arena.reset();
+        return found ? got.energy : -1.0;  // -1: not stored
+    };
+    auto expect = [&](const char* name, double got, double want) {
+        bool ok = got == want;
+        failures += !ok;
+        printf("  %-40s energy %6.1f, expected %6.1f  %s\n", name, got, want, ok ? "ok" : "FAIL");
+    };
+
+    struct Case {
+        const char* name;
+        double stored, updated;
+        bool checkpoint_delta;  // Delta in a segment rather than the delta table
+    };
+    const Case cases[] = {
+        {"revived by a pending delta", 0.0, 5.0, false},
+        {"revived by a checkpointed delta", 0.0, 5.0, true},
+        {"killed by a checkpointed delta", 5.0, 0.0, true},
+    };
+    printf("Sequential cases:\n");
+    uint64_t seq = 0;
+    for (const Case& c : cases) {
+        clear_dir(a.dir);
+        spu::Glyph g;
+        make_glyph(seq++, g, arena);
+        g.energy = c.stored;
+        const double want = c.updated == 0.0 ? -1.0 : c.updated;
+        {
+            spu::StorageEngine engine(a.dir, options);
+            engine.put(g);
+            engine.checkpoint();
+            spu::Glyph after = g;
+            after.energy = c.updated;
+            engine.update(spu::diff_glyph(g, after));
+            if (c.checkpoint_delta) {
+                engine.checkpoint();
+            }
+            engine.compact();
+            expect(c.name, energy_of(engine, g), want);
+        }
+        spu::StorageEngine engine(a.dir, options);
+        expect("  after reopen", energy_of(engine, g), want);
+    }
+
+    // Writer racing checkpoints and compactions
+    clear_dir(a.dir);
+    std::vector<spu::Glyph> pool(a.count);
+    for (size_t i = 0; i < a.count; i++) {
+        make_glyph(seq + i, pool[i], arena);
+        pool[i].energy = 0.0;
+    }
+    std::vector<double> want(a.count, -1.0);
+    uint64_t acked = 0, refused = 0, wrong = 0, reopen_wrong = 0;
+    {
+        spu::StorageEngine engine(a.dir, options);
+        engine.put_batch(pool.data(), pool.size());
+        engine.checkpoint();
+
+        std::atomic<bool> done(false);
+        std::thread writer([&] {
+            for (size_t i = 0; i < a.count; i++) {
+                spu::Glyph after = pool[i];
+                after.energy = static_cast<double>(i + 1);
+                try {
+                    engine.update(spu::diff_glyph(pool[i], after));
+                    want[i] = after.energy;
+                    acked++;
+                } catch (const std::invalid_argument&) {
+                    refused++;  // Collected before this update
+                }
+            }
+            done = true;
+        });
+        size_t compactions = 0;
+        while (!done) {
+            engine.checkpoint();
+            engine.compact();
+            compactions++;
+        }
+        writer.join();
+        engine.compact();
+        for (size_t i = 0; i < a.count; i++) {
+            wrong += energy_of(engine, pool[i]) != want[i];
+        }
+        printf("\nConcurrent updates: %llu acknowledged, %llu refused, %zu compactions\n",
+               static_cast<unsigned long long>(acked), static_cast<unsigned long long>(refused),
+               compactions + 1);
+    }
+    spu::StorageEngine engine(a.dir, options);
+    for (size_t i = 0; i < a.count; i++) {
+        reopen_wrong += energy_of(engine, pool[i]) != want[i];
+    }
+    printf("  wrong after compaction: %llu, after reopen: %llu\n",
+           static_cast<unsigned long long>(wrong), static_cast<unsigned long long>(reopen_wrong));
+    failures += wrong + reopen_wrong;
+
+    printf("\nOVERALL: %s\n", failures == 0 ? "PASS" : "FAIL");
+    return failures == 0 ? 0 : 1;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Args a = parse_args(argc, argv);
+    int (*run)(const Args&) = nullptr;
+    if (a.command == "bench") {
+        run = run_bench;
+    } else if (a.command == "crash-test") {
+        run = run_crash_test;
+    } else if (a.command == "tick-bench") {
+        run = run_tick_bench;
+    } else if (a.command == "delta-bench") {
+        run = run_delta_bench;
+    } else if (a.command == "compaction-test") {
+        run = run_compaction_test;
+    } else {
+        usage();
+    }
+    try {
+        int rc = run(a);
+        if (!a.metrics.empty()) {
+            spu::telemetry_write(a.metrics);
+        }
+        return rc;
+    } catch (const std::exception& e) {
+        fprintf(stderr, "storage_tool: %s\n", e.what());
+        return 1;
+    }
+}
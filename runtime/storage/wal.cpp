@@ -0,0 +1,332 @@
+/**
+ * SPU Storage WAL - Write-ahead log with group commit
+ */
+
+#include "wal.h"
+#include "async_io.h"
+#include "record.h"
+#include "telemetry.h"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <stdexcept>
+#include <system_error>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace spu {
+
+namespace {
+
+// Whether a complete record with a valid CRC starts anywhere after off
+bool valid_record_after(const std::string& data, size_t off) {
+    for (size_t at = off + 1; data.size() - at >= sizeof(RecordHeader); at++) {
+        uint64_t lsn;
+        GlyphId id;
+        size_t consumed;
+        if (check_record(data.data() + at, data.size() - at, lsn, id, consumed) ==
+            DecodeStatus::kOk) {
+            return true;
+        }
+    }
+    return false;
+}
+
+} // namespace
+
+std::string wal_file_name(uint64_t number) {
+    char buf[32];
+    snprintf(buf, sizeof(buf), "wal-%016" PRIx64 ".log", number);
+    return buf;
+}
+
+bool parse_wal_file_name(const std::string& name, uint64_t& number) {
+    if (name.size() != 24 || name.compare(0, 4, "wal-") != 0 ||
+        name.compare(20, 4, ".log") != 0) {
+        return false;
+    }
+    char* end = nullptr;
+    number = strtoull(name.c_str() + 4, &end, 16);
+    return end == name.c_str() + 20;
+}
+
+WalWriter::WalWriter(const std::string& dir, uint64_t file_number, uint64_t next_lsn,
+                     const WalOptions& options, std::vector<WalFile> existing)
+    : dir_(dir),
+      options_(options),
+      next_lsn_(next_lsn),
+      durable_lsn_(next_lsn - 1),
+      stop_(false),
+      stats_{0, 0, 0},
+      fd_(-1),
+      file_number_(file_number),
+      file_size_(0),
+      written_lsn_(next_lsn - 1),
+      closed_(std::move(existing)) {
+    open_file(file_number);
+    flusher_ = std::thread([this] { flush_loop(); });
+}
+
+WalWriter::~WalWriter() {
+    {
+        std::lock_guard<std::mutex> lock(mu_);
+        stop_ = true;
+    }
+    work_cv_.notify_all();
+    flusher_.join();
+    if (fd_ >= 0) {
+        close(fd_);
+    }
+}
+
+void WalWriter::open_file(uint64_t number) {
+    std::string path = path_join(dir_, wal_file_name(number));
+    int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_APPEND | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        throw std::system_error(errno, std::generic_category(), "open " + path);
+    }
+    // The new name must be durable before records in it are acknowledged
+    sync_dir(dir_, options_.sync);
+    if (fd_ >= 0) {
+        close(fd_);
+    }
+    fd_ = fd;
+    file_number_ = number;
+    file_size_ = 0;
+}
+
+uint64_t WalWriter::append(const Glyph& g) {
+    return append_batch(&g, 1);
+}
+
+uint64_t WalWriter::append_batch(const Glyph* glyphs, size_t n) {
+    return append_records(n, [&](size_t i, uint64_t lsn, std::string& out) {
+        encode_record(glyphs[i], lsn, out);
+    });
+}
+
+uint64_t WalWriter::append_deltas(const GlyphDelta* deltas, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        if (deltas[i].fields == 0 || (deltas[i].fields & ~kDeltaAllFields) != 0) {
+            throw std::invalid_argument("glyph delta needs a non-empty set of known fields");
+        }
+    }
+    return append_records(n, [&](size_t i, uint64_t lsn, std::string& out) {
+        encode_delta_record(deltas[i], lsn, out);
+    });
+}
+
+template <typename Encode>
+uint64_t WalWriter::append_records(size_t n, Encode encode) {
+    std::unique_lock<std::mutex> lock(mu_);
+    space_cv_.wait(lock, [&] {
+        return error_ || pending_.size() < options_.max_pending_bytes;
+    });
+    if (error_) {
+        std::rethrow_exception(error_);
+    }
+
+    // LSNs are assigned in buffer order, so the log is always in LSN order
+    bool was_empty = pending_.empty();
+    for (size_t i = 0; i < n; i++) {
+        encode(i, next_lsn_++, pending_);
+    }
+    stats_.records += n;
+    uint64_t last = next_lsn_ - 1;
+    lock.unlock();
+
+    if (was_empty) {
+        work_cv_.notify_one();
+    }
+    return last;
+}
+
+void WalWriter::wait_durable(uint64_t lsn) {
+    std::unique_lock<std::mutex> lock(mu_);
+    durable_cv_.wait(lock, [&] { return error_ || durable_lsn_ >= lsn; });
+    if (durable_lsn_ < lsn) {
+        std::rethrow_exception(error_);
+    }
+}
+
+uint64_t WalWriter::durable_lsn() const {
+    std::lock_guard<std::mutex> lock(mu_);
+    return durable_lsn_;
+}
+
+uint64_t WalWriter::last_lsn() const {
+    std::lock_guard<std::mutex> lock(mu_);
+    return next_lsn_ - 1;
+}
+
+WalWriter::Stats WalWriter::stats() const {
+    std::lock_guard<std::mutex> lock(mu_);
+    return stats_;
+}
+
+void WalWriter::flush_loop() {
+    std::string batch;
+    std::unique_lock<std::mutex> lock(mu_);
+    for (;;) {
+        work_cv_.wait(lock, [&] { return stop_ || !pending_.empty(); });
+        if (pending_.empty()) {
+            return;  // Stopped and drained
+        }
+        if (options_.group_commit_us > 0 && !stop_) {
+            // Let more writers join this commit
+            work_cv_.wait_for(lock, std::chrono::microseconds(options_.group_commit_us),
+                              [&] { return stop_; });
+        }
+        batch.swap(pending_);
+        uint64_t last = next_lsn_ - 1;
+        lock.unlock();
+        space_cv_.notify_all();
+
+        std::exception_ptr error;
+        try {
+            std::lock_guard<std::mutex> io(io_mu_);
+            SPU_TELEMETRY_TIMER(kHistWalCommitNs);
+            if (options_.io) {
+                options_.io->write(fd_, batch.data(), batch.size(), file_size_, options_.sync).get();
+            } else {
+                write_all(fd_, batch.data(), batch.size());
+                sync_fd(fd_, options_.sync);
+            }
+            file_size_ += batch.size();
+            written_lsn_ = last;
+            if (file_size_ >= options_.file_bytes) {
+                closed_.push_back(WalFile{file_number_, last});
+                open_file(file_number_ + 1);
+            }
+        } catch (...) {
+            error = std::current_exception();
+        }
+
+        lock.lock();
+        if (error) {
+            // The file position is unknown after a failed write: stop accepting
+            error_ = error;
+            durable_cv_.notify_all();
+            space_cv_.notify_all();
+            return;
+        }
+        durable_lsn_ = last;
+        stats_.commits++;
+        stats_.bytes += batch.size();
+        batch.clear();
+        durable_cv_.notify_all();
+    }
+}
+
+uint64_t WalWriter::roll() {
+    wait_durable(last_lsn());
+
+    std::lock_guard<std::mutex> io(io_mu_);
+    if (file_size_ == 0) {
+        return written_lsn_;
+    }
+    // written_lsn_ (not durable_lsn_) is exact: it is updated under io_mu_
+    closed_.push_back(WalFile{file_number_, written_lsn_});
+    open_file(file_number_ + 1);
+    return written_lsn_;
+}
+
+void WalWriter::remove_through(uint64_t lsn) {
+    std::lock_guard<std::mutex> io(io_mu_);
+    auto keep = std::partition(closed_.begin(), closed_.end(),
+                               [&](const WalFile& f) { return f.last_lsn > lsn; });
+    if (keep == closed_.end()) {
+        return;
+    }
+    for (auto it = keep; it != closed_.end(); ++it) {
+        std::string path = path_join(dir_, wal_file_name(it->number));
+        if (unlink(path.c_str()) != 0 && errno != ENOENT) {
+            throw std::system_error(errno, std::generic_category(), "unlink " + path);
+        }
+    }
+    closed_.erase(keep, closed_.end());
+    sync_dir(dir_, options_.sync);
+}
+
+WalReplayResult replay_wal(const std::string& dir, uint64_t after_lsn, SyncMode sync,
+                           const std::function<void(uint64_t, const Glyph&)>& fn,
+                           const std::function<void(uint64_t, const GlyphDelta&)>& delta_fn) {
+    WalReplayResult result{{}, 0, 1, 0, 0};
+
+    std::vector<uint64_t> numbers;
+    for (const std::string& name : list_dir(dir)) {
+        uint64_t number;
+        if (parse_wal_file_name(name, number)) {
+            numbers.push_back(number);
+        }
+    }
+    std::sort(numbers.begin(), numbers.end());
+
+    ContentArena arena;
+    for (size_t f = 0; f < numbers.size(); f++) {
+        const bool last_file = f + 1 == numbers.size();
+        std::string path = path_join(dir, wal_file_name(numbers[f]));
+        std::string data = read_file(path);
+
+        WalFile file{numbers[f], 0};
+        size_t off = 0;
+        while (off < data.size()) {
+            const char* p = data.data() + off;
+            uint64_t lsn;
+            Glyph g;
+            GlyphDelta delta;
+            size_t consumed;
+            // The decoders check the type, so a damaged header is still kCorrupt
+            const bool is_delta =
+                data.size() - off >= sizeof(RecordHeader) && record_type(p) == kRecordDelta;
+            DecodeStatus status =
+                is_delta ? decode_delta_record(p, data.size() - off, lsn, delta, consumed)
+                         : decode_record(p, data.size() - off, lsn, g, arena, consumed);
+            const bool out_of_sequence = status == DecodeStatus::kOk && result.last_lsn != 0 &&
+                                         lsn != result.last_lsn + 1;
+            if (status != DecodeStatus::kOk || out_of_sequence) {
+                // A torn write only damages the end of the file being written
+                // at the crash; a bad record with valid ones after it (or a
+                // valid one out of sequence) would lose acknowledged writes
+                if (!last_file || out_of_sequence || valid_record_after(data, off)) {
+                    throw std::runtime_error("corrupt WAL record in " + path + " at offset " +
+                                             std::to_string(off));
+                }
+                // Torn tail of the file being written at the crash: never acknowledged
+                if (truncate(path.c_str(), static_cast<off_t>(off)) != 0) {
+                    throw std::system_error(errno, std::generic_category(), "truncate " + path);
+                }
+                int fd = open(path.c_str(), O_WRONLY | O_CLOEXEC);
+                if (fd >= 0) {
+                    sync_fd(fd, sync);
+                    close(fd);
+                }
+                result.truncated_bytes = data.size() - off;
+                break;
+            }
+
+            if (lsn > after_lsn) {
+                if (!is_delta) {
+                    fn(lsn, g);
+                } else if (delta_fn) {
+                    delta_fn(lsn, delta);
+                } else {
+                    throw std::runtime_error("delta record in " + path + " with no delta handler");
+                }
+                result.records++;
+            }
+            arena.reset();
+            file.last_lsn = lsn;
+            result.last_lsn = lsn;
+            off += consumed;
+        }
+        result.files.push_back(file);
+        result.next_file = numbers[f] + 1;
+    }
+    return result;
+}
+
+} // namespace spu
@@ -0,0 +1,180 @@
+/**
+ * SPU Storage WAL - Write-ahead log with group commit
+ *
+ * Writers append encoded glyph records to an in-memory pending buffer and
+ * get an LSN back. A single flusher thread writes the whole pending buffer
+ * with one write() and makes it durable with one fsync / fdatasync, then
+ * wakes every writer whose LSN it covered. While one sync is in flight the
+ * next batch accumulates, so the number of syncs per second stays bounded
+ * by the device and every concurrent writer shares them.
+ *
+ * The log is a sequence of files wal-<number>.log, started afresh when a
+ * file passes WalOptions::file_bytes and at every checkpoint (roll()).
+ */
+
+#ifndef SPU_WAL_H
+#define SPU_WAL_H
+
+#include "file_io.h"
+#include "merge_ref.h"
+#include "record.h"
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace spu {
+
+class AsyncIo;
+
+struct WalOptions {
+    size_t file_bytes = 64 * 1024 * 1024;       // Start a new log file past this size
+    size_t max_pending_bytes = 64 * 1024 * 1024;  // Block writers while this much is unsynced
+    uint32_t group_commit_us = 0;  // Extra wait for more writers before each sync (0 = none)
+    SyncMode sync = SyncMode::kFdatasync;
+    AsyncIo* io = nullptr;  // Submit each commit as one linked write + sync (nullptr = blocking)
+};
+
+// A log file and the last LSN it holds (0 if empty)
+struct WalFile {
+    uint64_t number;
+    uint64_t last_lsn;
+};
+
+// "wal-<16 hex digits>.log"
+std::string wal_file_name(uint64_t number);
+bool parse_wal_file_name(const std::string& name, uint64_t& number);
+
+class WalWriter {
+public:
+    struct Stats {
+        uint64_t records;  // Records appended
+        uint64_t commits;  // write + sync rounds
+        uint64_t bytes;    // Bytes written
+    };
+
+    /**
+     * Start a new log file
+     *
+     * @param dir Log directory
+     * @param file_number Number of the new file (must not exist)
+     * @param next_lsn LSN of the first record appended
+     * @param options Rotation, group commit and sync settings
+     * @param existing Older log files still on disk (removed by remove_through())
+     */
+    WalWriter(const std::string& dir, uint64_t file_number, uint64_t next_lsn,
+              const WalOptions& options, std::vector<WalFile> existing = {});
+
+    // Flushes and syncs everything appended
+    ~WalWriter();
+
+    WalWriter(const WalWriter&) = delete;
+    WalWriter& operator=(const WalWriter&) = delete;
+
+    /**
+     * Append one record (not yet durable)
+     *
+     * @return Its LSN; durable once wait_durable(lsn) returns
+     * @throws std::system_error if an earlier write or sync failed
+     */
+    uint64_t append(const Glyph& g);
+
+    // Append n records as one contiguous run; returns the last LSN
+    uint64_t append_batch(const Glyph* glyphs, size_t n);
+
+    /**
+     * Append n delta records as one contiguous run; returns the last LSN
+     *
+     * @throws std::invalid_argument if a delta has no fields (nothing is appended)
+     */
+    uint64_t append_deltas(const GlyphDelta* deltas, size_t n);
+
+    /**
+     * Block until every record up to lsn is durable
+     *
+     * @throws std::system_error if the write or sync failed
+     */
+    void wait_durable(uint64_t lsn);
+
+    uint64_t durable_lsn() const;
+    uint64_t last_lsn() const;
+
+    /**
+     * Make everything durable and continue in a new file
+     *
+     * Afterwards every older file holds only LSNs <= the returned LSN.
+     *
+     * @return Last LSN in the closed files
+     */
+    uint64_t roll();
+
+    // Delete closed files whose records are all <= lsn (covered by a checkpoint)
+    void remove_through(uint64_t lsn);
+
+    Stats stats() const;
+
+private:
+    template <typename Encode>
+    uint64_t append_records(size_t n, Encode encode);
+    void flush_loop();
+    void open_file(uint64_t number);
+
+    std::string dir_;
+    WalOptions options_;
+
+    // Guarded by mu_
+    mutable std::mutex mu_;
+    std::condition_variable work_cv_;     // Flusher: pending data or stop
+    std::condition_variable durable_cv_;  // Writers: durable_lsn_ advanced or error
+    std::condition_variable space_cv_;    // Writers: pending buffer drained
+    std::string pending_;
+    uint64_t next_lsn_;
+    uint64_t durable_lsn_;
+    std::exception_ptr error_;
+    bool stop_;
+    Stats stats_;
+
+    // Guarded by io_mu_ (the file being written)
+    std::mutex io_mu_;
+    int fd_;
+    uint64_t file_number_;
+    size_t file_size_;
+    uint64_t written_lsn_;
+    std::vector<WalFile> closed_;
+
+    std::thread flusher_;
+};
+
+struct WalReplayResult {
+    std::vector<WalFile> files;  // Every log file found, in order
+    uint64_t last_lsn;           // Last valid LSN (0 if none)
+    uint64_t next_file;          // Number for the next log file
+    uint64_t records;            // Records passed to the callbacks
+    uint64_t truncated_bytes;    // Torn tail removed from the last file
+};
+
+/**
+ * Replay the log in dir
+ *
+ * Calls fn(lsn, glyph) for every put record and delta_fn(lsn, delta) for
+ * every delta record with lsn > after_lsn, in LSN order (glyph content is
+ * only valid during the call). A torn or partial record at the end of the
+ * last file, with no valid record after it, is a crash mid-write: it is
+ * truncated away. Anything else that fails its CRC, or is out of LSN
+ * sequence, is corruption.
+ *
+ * @throws std::runtime_error on corruption, or on a delta record without delta_fn
+ */
+WalReplayResult replay_wal(const std::string& dir, uint64_t after_lsn, SyncMode sync,
+                           const std::function<void(uint64_t, const Glyph&)>& fn,
+                           const std::function<void(uint64_t, const GlyphDelta&)>& delta_fn = nullptr);
+
+} // namespace spu
+
+#endif // SPU_WAL_H
@@ -0,0 +1,213 @@
+#!/usr/bin/env python3
+"""
+Tests for the GlyphArray batch binding
+
+Checks the native batch path (merge_batch, step) against the per-glyph
+Python reference implementations, and LazyDecay against eager steps. Skipped when the pybind11 module has not
+been built (cd runtime/spu && python3 setup.py build_ext --inplace).
+"""
+
+import hashlib
+import unittest
+import sys
+from pathlib import Path
+
+# Add runtime modules to path
+sys.path.insert(0, str(Path(__file__).parent / ".."))
+sys.path.insert(0, str(Path(__file__).parent / ".." / "spu"))
+
+try:
+    import numpy as np
+    import spu_merge
+
+    HAVE_BINDING = True
+except ImportError:
+    HAVE_BINDING = False
+
+from dynamics.engine import Glyph, DynamicsEngine
+
+
+def make_glyph(content, energy, activation_count=0, last_update_time=0):
+    g = spu_merge.Glyph()
+    g.id = hashlib.sha256(content.encode()).hexdigest()
+    g.content = content
+    g.energy = energy
+    g.activation_count = activation_count
+    g.last_update_time = last_update_time
+    return g
+
+
+@unittest.skipUnless(HAVE_BINDING, "spu_merge binding not built")
+class TestGlyphArray(unittest.TestCase):
+    """GlyphArray matches the per-glyph reference"""
+
+    def setUp(self):
+        self.glyphs = [
+            make_glyph("alpha", 2.0, 5, 100),
+            make_glyph("beta", 3.0, 3, 200),
+            make_glyph("gamma", 3.0, 1, 50),
+        ]
+        self.array = spu_merge.GlyphArray(self.glyphs)
+
+    def test_columns_are_views(self):
+        self.assertEqual(len(self.array), 3)
+        energy = self.array.energy
+        self.assertEqual(list(energy), [2.0, 3.0, 3.0])
+        energy[0] = 7.5
+        self.assertEqual(self.array[0].energy, 7.5)
+
+    def test_merge_batch_matches_merge(self):
+        pairs = np.array([[0, 1], [1, 2], [2, 1]], dtype=np.uint32)
+        out = spu_merge.merge_batch(self.array, pairs)
+        self.assertEqual(len(out), 3)
+        for k, (a, b) in enumerate(pairs):
+            expected = spu_merge.merge(self.glyphs[a], self.glyphs[b])
+            got = out[k]
+            self.assertEqual(got.id, expected.id)
+            self.assertEqual(got.content, expected.content)
+            self.assertEqual(got.energy, expected.energy)
+            self.assertEqual(got.activation_count, expected.activation_count)
+            self.assertEqual(got.last_update_time, expected.last_update_time)
+            self.assertEqual(got.parent1_id, expected.parent1_id)
+            self.assertEqual(got.parent2_id, expected.parent2_id)
+        self.assertEqual(out.id(0), hashlib.sha256(b"beta + alpha").hexdigest())
+
+    def test_merge_batch_rejects_bad_pairs(self):
+        with self.assertRaises(IndexError):
+            spu_merge.merge_batch(self.array, np.array([[0, 3]], dtype=np.uint32))
+        with self.assertRaises(ValueError):
+            spu_merge.merge_batch(self.array, np.array([0, 1], dtype=np.uint32))
+
+    def test_step_matches_python_engine(self):
+        engine = DynamicsEngine(activation_threshold=1.0, decay_rate=0.1)
+        expected = []
+        for g in self.glyphs:
+            ref = Glyph(g.id, g.content, {"energy": g.energy,
+                                          "activation_count": g.activation_count})
+            ref, info = engine.step(ref, time_delta=4)
+            expected.append(ref)
+
+        activated = spu_merge.step(self.array, 4)
+        for k, ref in enumerate(expected):
+            self.assertEqual(self.array.energy[k], ref.energy)
+            self.assertEqual(self.array.activation_count[k], ref.activation_count)
+        self.assertEqual(list(activated), [True, True, True])
+
+    def test_step_per_glyph_delta(self):
+        deltas = np.array([0, 10, 100], dtype=np.uint64)
+        spu_merge.step(self.array, deltas)
+        self.assertEqual(self.array.energy[0], 2.0)
+        self.assertGreater(self.array.energy[1], self.array.energy[2])
+
+    def test_tick_matches_step_then_merge_batch(self):
+        pairs = np.array([[0, 1], [2, 0]], dtype=np.uint32)
+        reference = spu_merge.GlyphArray(self.glyphs)
+        ref_activated = spu_merge.step(reference, 3)
+        ref_merged = spu_merge.merge_batch(reference, pairs)
+
+        merged, activated = spu_merge.tick(self.array, pairs, 3)
+        self.assertEqual(list(activated), list(ref_activated))
+        self.assertEqual(list(self.array.energy), list(reference.energy))
+        self.assertEqual(len(merged), 2)
+        for k in range(2):
+            self.assertEqual(merged.id(k), ref_merged.id(k))
+            self.assertEqual(merged[k].energy, ref_merged[k].energy)
+        with self.assertRaises(IndexError):
+            spu_merge.tick(self.array, np.array([[0, 3]], dtype=np.uint32))
+
+    def test_telemetry_records_merge_batches(self):
+        spu_merge.telemetry_reset()
+        spu_merge.merge_batch(self.array, np.array([[0, 1], [2, 0]], dtype=np.uint32))
+        stats = spu_merge.telemetry_stats()
+        self.assertEqual(stats["merge_batch_seconds"]["count"], 1)
+        self.assertEqual(stats["merge_batch_pairs"]["sum"], 2)
+        self.assertEqual(stats["merge_batch_pairs"]["p99"], 2)
+
+        text = spu_merge.telemetry_openmetrics()
+        self.assertIn('spu_merge_batch_pairs_bucket{le="2"} 1', text)
+        self.assertIn("spu_merge_batch_seconds_count 1", text)
+        self.assertTrue(text.endswith("# EOF\n"))
+
+
+@unittest.skipUnless(HAVE_BINDING, "spu_merge binding not built")
+class TestLazyDecay(unittest.TestCase):
+    """LazyDecay matches eager step() tick by tick"""
+
+    def make_array(self, n=200, seed=7):
+        # Energies spread over [0.5, 4.5) so crossings fall on many different ticks
+        glyphs = [make_glyph(f"lazy {seed} {i}", 0.5 + ((i * 7919 + seed) % 4000) / 1000.0)
+                  for i in range(n)]
+        return spu_merge.GlyphArray(glyphs)
+
+    def assert_matches(self, lazy, eager):
+        energy = eager.energy
+        active = set(lazy.active())
+        for i in range(len(eager)):
+            self.assertAlmostEqual(lazy.energy(i), energy[i], delta=1e-12 * energy[i])
+            # The eager engine compounds per tick: a crossing can move by one tick
+            self.assertLessEqual(abs(lazy.activation_count(i) - int(eager.activation_count[i])), 1)
+            if abs(energy[i] - 1.0) > 1e-9:
+                self.assertEqual(i in active, energy[i] >= 1.0)
+
+    def test_ticks_match_step(self):
+        for rate, tick_delta in [(0.1, 1), (0.01, 1), (0.001, 1), (0.05, 3)]:
+            with self.subTest(rate=rate, tick_delta=tick_delta):
+                eager, attached = self.make_array(), self.make_array()
+                lazy = spu_merge.LazyDecay(attached, decay_rate=rate, tick_delta=tick_delta)
+                for _ in range(300):
+                    spu_merge.step(eager, tick_delta, decay_rate=rate)
+                    lazy.tick()
+                self.assert_matches(lazy, eager)
+
+                lazy.materialize()
+                self.assertEqual(list(attached.last_update_time), list(eager.last_update_time))
+                for i in range(len(eager)):
+                    self.assertEqual(attached.energy[i], lazy.energy(i))
+
+    def test_very_small_rates(self):
+        # Crossings trillions of ticks away, or never (1 - rate rounds to 1)
+        for rate in [1e-9, 1e-11, 1e-13, 1e-15, 1e-16, 1e-17, 0.0]:
+            with self.subTest(rate=rate):
+                eager, attached = self.make_array(), self.make_array()
+                lazy = spu_merge.LazyDecay(attached, decay_rate=rate)
+                ticks = int(1.25 / rate) if rate > 1e-16 else 10**6
+                lazy.tick(ticks)
+                spu_merge.step(eager, ticks, decay_rate=rate)
+                self.assertEqual([lazy.energy(i) for i in range(len(eager))], list(eager.energy))
+                self.assertEqual(lazy.active(),
+                                 [i for i in range(len(eager)) if eager.energy[i] >= 1.0])
+
+    def test_set_energy_matches_step(self):
+        eager, attached = self.make_array(), self.make_array()
+        lazy = spu_merge.LazyDecay(attached, decay_rate=0.02)
+        for t in range(200):
+            spu_merge.step(eager, 1, decay_rate=0.02)
+            lazy.tick()
+            if t % 50 == 10:
+                for i in range(t % 7, len(eager), 9):
+                    eager.energy[i] = 3.0
+                    lazy.set_energy(i, 3.0)
+        self.assert_matches(lazy, eager)
+        with self.assertRaises(IndexError):
+            lazy.set_energy(len(eager), 1.0)
+
+    def test_merge_batch_matches_step_then_merge_batch(self):
+        eager, attached = self.make_array(), self.make_array()
+        lazy = spu_merge.LazyDecay(attached, decay_rate=0.05)
+        for _ in range(25):
+            spu_merge.step(eager, 1, decay_rate=0.05)
+            lazy.tick()
+        pairs = np.array([[i, i + 1] for i in range(0, len(eager) - 1, 2)], dtype=np.uint32)
+        want = spu_merge.merge_batch(eager, pairs)
+        got = lazy.merge_batch(pairs)
+        self.assertEqual(len(got), len(want))
+        for k in range(len(want)):
+            self.assertEqual(got.id(k), want.id(k))
+            self.assertAlmostEqual(got[k].energy, want[k].energy, delta=1e-12 * want[k].energy)
+            self.assertEqual(got[k].last_update_time, want[k].last_update_time)
+        with self.assertRaises(IndexError):
+            lazy.merge_batch(np.array([[0, len(eager)]], dtype=np.uint32))
+
+
+if __name__ == "__main__":
+    unittest.main()
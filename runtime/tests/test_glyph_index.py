@@ -0,0 +1,143 @@
+#!/usr/bin/env python3
+"""
+Unit tests for glyph_index (ID prefix and content-token index files)
+"""
+
+import os
+import shutil
+import sys
+import tempfile
+import unittest
+from pathlib import Path
+
+# Add runtime/cli to path
+sys.path.insert(0, str(Path(__file__).parent / ".." / "cli"))
+
+import create_glyph
+import glyph_index
+import glyph_snapshot
+import query_glyph
+
+
+class TestGlyphIndex(unittest.TestCase):
+    """Index persisted glyphs and compare queries with a directory scan"""
+
+    def setUp(self):
+        self.test_dir = tempfile.mkdtemp()
+        self.persistence = Path(self.test_dir) / "persistence"
+        self.persistence.mkdir()
+        self.index_path = Path(self.test_dir) / "glyphs.spui"
+        self.original_create_path = create_glyph.get_persistence_path
+        self.original_query_path = query_glyph.get_persistence_path
+        create_glyph.get_persistence_path = lambda: self.persistence
+        query_glyph.get_persistence_path = lambda: self.persistence
+        self.original_env = os.environ.pop("GLYPH_INDEX", None)
+
+    def tearDown(self):
+        create_glyph.get_persistence_path = self.original_create_path
+        query_glyph.get_persistence_path = self.original_query_path
+        os.environ.pop("GLYPH_INDEX", None)
+        if self.original_env is not None:
+            os.environ["GLYPH_INDEX"] = self.original_env
+        for index in query_glyph._indexes.values():
+            index.close()
+        query_glyph._indexes.clear()
+        shutil.rmtree(self.test_dir)
+
+    def _create(self, count, start=0):
+        ids = []
+        colors = ["red", "green", "blue"]
+        for i in range(start, start + count):
+            glyph_id, data = create_glyph.create_glyph(
+                f"Glyph {i}: {colors[i % 3]} shape{i % 5}, Größe {i % 2}")
+            create_glyph.save_glyph(glyph_id, data)
+            ids.append(glyph_id)
+        return ids
+
+    def test_tokenize(self):
+        """Lowercased ASCII words and non-ASCII runs, deduplicated"""
+        self.assertEqual(glyph_index.tokenize("Hello, WORLD! héllo hello"),
+                         [b"hello", "héllo".encode("utf-8"), b"world"])
+        self.assertEqual(glyph_index.tokenize("a" * 70), [b"a" * 6, b"a" * 64])
+        self.assertEqual(glyph_index.tokenize(" ,.; "), [])
+
+    def test_prefix_and_token_match_scan(self):
+        """Indexed queries return exactly what a directory scan finds"""
+        ids = self._create(60)
+        self.assertEqual(glyph_index.build_index([self.persistence], self.index_path), 60)
+
+        for glyph_id in ids[:10]:
+            for n in (1, 2, 3, 8, 64):
+                prefix = glyph_id[:n]
+                self.assertEqual(query_glyph.find_prefix(prefix, index=self.index_path, limit=1000),
+                                 query_glyph.find_prefix(prefix, limit=1000))
+            self.assertIn(glyph_id, query_glyph.find_prefix(glyph_id[:8], index=self.index_path))
+
+        for query in (["red"], ["RED", "shape2"], ["größe"], ["blue shape4"], ["missing"]):
+            expected = query_glyph.find_tokens(query, limit=1000)
+            self.assertEqual(query_glyph.find_tokens(query, index=self.index_path, limit=1000),
+                             expected)
+        self.assertEqual(len(query_glyph.find_tokens(["red"], index=self.index_path, limit=1000)),
+                         20)
+        self.assertEqual(len(query_glyph.find_tokens(["red"], index=self.index_path, limit=5)), 5)
+
+        with glyph_index.GlyphIndex(self.index_path) as index:
+            self.assertEqual(len(index), 60)
+            self.assertTrue(index.contains(ids[0]))
+            self.assertFalse(index.contains("0" * 64))
+            with self.assertRaises(ValueError):
+                index.prefix("xyz")
+
+    def test_persist_appends_to_log_and_compact(self):
+        """save_glyph with $GLYPH_INDEX keeps the index current; compact folds the log in"""
+        ids = self._create(10)
+        glyph_index.build_index([self.persistence], self.index_path)
+
+        os.environ["GLYPH_INDEX"] = str(self.index_path)
+        new_ids = self._create(5, start=100)
+        del os.environ["GLYPH_INDEX"]
+        self.assertTrue(glyph_index.delta_path(self.index_path).exists())
+
+        with glyph_index.GlyphIndex(self.index_path) as index:
+            self.assertEqual(len(index), 15)
+            for glyph_id in new_ids:
+                self.assertTrue(index.contains(glyph_id))
+                self.assertEqual(index.prefix(glyph_id[:8]), [glyph_id])
+            self.assertEqual(index.tokens("Glyph 101"), [new_ids[1]])
+            self.assertEqual(sorted(index.tokens("green", limit=100)),
+                             query_glyph.find_tokens("green"))
+
+        self.assertEqual(glyph_index.compact(self.index_path), 15)
+        self.assertFalse(glyph_index.delta_path(self.index_path).exists())
+        with glyph_index.GlyphIndex(self.index_path) as index:
+            self.assertEqual(index.count, 15)
+            self.assertEqual(index.prefix(ids[0][:64]), [ids[0]])
+            self.assertEqual(index.tokens("Glyph 101"), [new_ids[1]])
+
+    def test_build_from_snapshot(self):
+        """Snapshots index the same as the JSON files they came from"""
+        self._create(20)
+        snapshot = Path(self.test_dir) / "glyphs.spus"
+        glyph_snapshot.build_snapshot([self.persistence], snapshot)
+        glyph_index.build_index([snapshot], self.index_path)
+        from_json = Path(self.test_dir) / "json.spui"
+        glyph_index.build_index([self.persistence], from_json)
+        self.assertEqual(self.index_path.read_bytes(), from_json.read_bytes())
+
+    def test_rejects_bad_files(self):
+        """Non-index files and unknown versions are refused"""
+        self.index_path.write_bytes(b"\0" * 128)
+        with self.assertRaises(ValueError):
+            glyph_index.GlyphIndex(self.index_path)
+
+        self._create(1)
+        glyph_index.build_index([self.persistence], self.index_path)
+        data = bytearray(self.index_path.read_bytes())
+        data[8] = 99  # version
+        self.index_path.write_bytes(bytes(data))
+        with self.assertRaises(ValueError):
+            glyph_index.GlyphIndex(self.index_path)
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,146 @@
+#!/usr/bin/env python3
+"""
+Tests for the ProvenanceGraph binding
+
+Checks lineage queries and the bit-parallel batched counts against a
+single-source BFS over the same random merge DAG, with children in the
+linked lists, in CSR after compact(), and in both. Skipped when the
+pybind11 module has not been built (cd runtime/spu && python3 setup.py
+build_ext --inplace).
+"""
+
+import hashlib
+import random
+import unittest
+import sys
+from collections import deque
+from pathlib import Path
+
+sys.path.insert(0, str(Path(__file__).parent / ".." / "spu"))
+
+try:
+    import spu_merge
+
+    HAVE_BINDING = True
+except ImportError:
+    HAVE_BINDING = False
+
+
+def node_id(i):
+    return hashlib.sha256(f"provenance node {i}".encode()).hexdigest()
+
+
+@unittest.skipUnless(HAVE_BINDING, "spu_merge binding not built")
+class TestProvenanceGraph(unittest.TestCase):
+    """ProvenanceGraph matches a per-source BFS"""
+
+    def setUp(self):
+        self.rng = random.Random(5)
+        self.graph = spu_merge.ProvenanceGraph()
+        self.parents = {}  # node -> distinct parent nodes
+        self.children = {}
+
+    def add(self, i, window):
+        """Add node i with up to two parents among the previous window nodes"""
+        p1 = p2 = None
+        if i >= 8:
+            p1 = self.rng.randrange(max(0, i - window), i)
+            roll = self.rng.random()
+            p2 = p1 if roll < 0.2 else None if roll < 0.35 else self.rng.randrange(max(0, i - window), i)
+        self.graph.add(node_id(i), "" if p1 is None else node_id(p1),
+                       "" if p2 is None else node_id(p2))
+        self.children.setdefault(i, [])
+        for p in (p1, p2):
+            if p is not None and p not in self.parents.setdefault(i, []):
+                self.parents[i].append(p)
+                self.children.setdefault(p, []).append(i)
+
+    def distances(self, source, down, max_depth=None):
+        """Generation distance of every node reachable from source (source at 0)"""
+        edges = self.children if down else self.parents
+        dist = {source: 0}
+        queue = deque([source])
+        while queue:
+            u = queue.popleft()
+            if max_depth is not None and dist[u] >= max_depth:
+                continue
+            for v in edges.get(u, []):
+                if v not in dist:
+                    dist[v] = dist[u] + 1
+                    queue.append(v)
+        return dist
+
+    def check(self, n):
+        g = self.graph
+        handle = [g.find(node_id(i)) for i in range(n)]
+        node = {h: i for i, h in enumerate(handle)}
+        for i in range(n):
+            self.assertEqual(g.id(handle[i]), node_id(i))
+            self.assertEqual(sorted(node[c] for c in g.children(handle[i])),
+                             sorted(self.children[i]))
+            self.assertEqual(sorted(node[p] for p in g.parents(handle[i])),
+                             sorted(self.parents.get(i, [])))
+            for down in (False, True):
+                for max_depth in (1, 2, None):
+                    dist = self.distances(i, down, max_depth)
+                    query = g.descendants if down else g.ancestors
+                    got = (query(handle[i]) if max_depth is None
+                           else query(handle[i], max_depth))
+                    nodes = [node[h] for h in got]
+                    self.assertEqual(sorted(nodes), sorted(j for j in dist if j != i))
+                    # Breadth-first: generations never decrease along the list
+                    levels = [dist[j] for j in nodes]
+                    self.assertEqual(levels, sorted(levels))
+
+        for t in range(200):
+            a = self.rng.randrange(n)
+            b = a if t % 10 == 0 else self.rng.randrange(n)
+            da, db = self.distances(a, False), self.distances(b, False)
+            want = sorted((max(da[x], db[x]), handle[x]) for x in da
+                          if x in db and not (a == b and x == a))
+            self.assertEqual(g.common_ancestors(handle[a], handle[b]), [h for _, h in want])
+
+        # More than one 64-lane batch, with repeats
+        sources = [handle[self.rng.randrange(n)] for _ in range(150)] + [handle[0], handle[3]]
+        self.assertEqual(g.ancestor_counts(sources),
+                         [len(self.distances(node[h], False)) - 1 for h in sources])
+        self.assertEqual(g.descendant_counts(sources),
+                         [len(self.distances(node[h], True)) - 1 for h in sources])
+
+    def test_queries_match_bfs_before_and_after_compact(self):
+        n = 240
+        for i in range(n // 2):
+            self.add(i, 30)
+        # Seen before its parents: interned parentless, filled in when re-added
+        self.graph.add(node_id(n // 2))
+        self.check(n // 2)
+        self.graph.compact()
+        self.check(n // 2)
+
+        for i in range(n // 2, n):
+            self.add(i, 60)
+        self.check(n)  # CSR plus linked edges
+        self.graph.compact()
+        self.check(n)
+        self.assertEqual(len(self.graph), n)
+
+    def test_add_glyph_array_and_bad_handles(self):
+        parents = [spu_merge.Glyph() for _ in range(2)]
+        for k, g in enumerate(parents):
+            g.content = f"parent {k}"
+            g.id = hashlib.sha256(g.content.encode()).hexdigest()
+        child = spu_merge.merge(parents[0], parents[1])
+        self.graph.add(spu_merge.GlyphArray(parents + [child]))
+
+        h = self.graph.find(child.id)
+        self.assertEqual(sorted(self.graph.id(p) for p in self.graph.ancestors(h)),
+                         sorted(g.id for g in parents))
+        self.assertIsNone(self.graph.find(node_id(-1)))
+        with self.assertRaises(IndexError):
+            self.graph.ancestors(len(self.graph))
+        with self.assertRaises(IndexError):
+            self.graph.ancestor_counts([0, len(self.graph)])
+
+
+if __name__ == "__main__":
+    unittest.main()
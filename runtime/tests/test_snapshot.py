@@ -0,0 +1,238 @@
+#!/usr/bin/env python3
+"""
+Unit tests for glyph_snapshot (memory-mapped snapshot format)
+
+TestNativeSnapshot checks that spu::Snapshot (spu_merge.Snapshot) and the
+Python reader agree on the same files; it is skipped when the pybind11
+module has not been built.
+"""
+
+import hashlib
+import json
+import shutil
+import sys
+import tempfile
+import unittest
+from pathlib import Path
+
+# Add runtime/cli to path
+sys.path.insert(0, str(Path(__file__).parent / ".." / "cli"))
+sys.path.insert(0, str(Path(__file__).parent / ".." / "spu"))
+
+import create_glyph
+import glyph_snapshot
+import query_glyph
+
+try:
+    import spu_merge
+
+    HAVE_BINDING = True
+except ImportError:
+    HAVE_BINDING = False
+
+SPEC_EXAMPLE = Path(__file__).parent / ".." / ".." / "spec" / "examples" / "glyph_example.json"
+
+
+class TestSnapshot(unittest.TestCase):
+    """Build snapshots from JSON persistence and read them back"""
+
+    def setUp(self):
+        self.test_dir = tempfile.mkdtemp()
+        self.persistence = Path(self.test_dir) / "persistence"
+        self.persistence.mkdir()
+        self.snapshot_path = Path(self.test_dir) / "glyphs.spus"
+        self.original_persistence_path = create_glyph.get_persistence_path
+        create_glyph.get_persistence_path = lambda: self.persistence
+
+    def tearDown(self):
+        create_glyph.get_persistence_path = self.original_persistence_path
+        query_glyph._snapshots.clear()
+        shutil.rmtree(self.test_dir)
+
+    def _create(self, count):
+        glyphs = []
+        for i in range(count):
+            glyph_id, data = create_glyph.create_glyph(
+                f"snapshot glyph {i}" + "x" * (i % 40),
+                {"energy": i * 0.25, "activation_count": i % 4, "last_update_time": 10 * i})
+            create_glyph.save_glyph(glyph_id, data)
+            glyphs.append((glyph_id, data))
+        return glyphs
+
+    def test_roundtrip_documents_and_columns(self):
+        """Every glyph is found with its document and native columns"""
+        glyphs = self._create(50)
+        n = glyph_snapshot.build_snapshot([self.persistence], self.snapshot_path)
+        self.assertEqual(n, 50)
+
+        with glyph_snapshot.Snapshot(self.snapshot_path) as snap:
+            self.assertEqual(len(snap), 50)
+            ids = [snap.id(i) for i in range(len(snap))]
+            self.assertEqual(ids, sorted(ids))
+
+            for glyph_id, data in glyphs:
+                self.assertEqual(snap.get(glyph_id), data)
+                record = snap.record(snap.find(glyph_id))
+                self.assertEqual(record["content"], data["content"])
+                self.assertEqual(record["energy"], data["metadata"]["energy"])
+                self.assertEqual(record["activation_count"], data["metadata"]["activation_count"])
+                self.assertEqual(record["last_update_time"], data["metadata"]["last_update_time"])
+
+            self.assertIsNone(snap.get("0" * 64))
+            self.assertIsNone(snap.get("not-an-id"))
+
+    def test_columns_are_page_aligned(self):
+        """Columns start on 4096-byte boundaries (mmap-friendly)"""
+        self._create(10)
+        glyph_snapshot.build_snapshot([self.persistence], self.snapshot_path)
+        with glyph_snapshot.Snapshot(self.snapshot_path) as snap:
+            for name, (offset, _) in snap._columns.items():
+                self.assertEqual(offset % glyph_snapshot.ALIGN, 0, name)
+
+    def test_spec_example(self):
+        """Spec-style documents map state and identity onto the columns"""
+        glyph_snapshot.build_snapshot([SPEC_EXAMPLE], self.snapshot_path)
+        with open(SPEC_EXAMPLE) as f:
+            doc = json.load(f)
+
+        with glyph_snapshot.Snapshot(self.snapshot_path) as snap:
+            self.assertEqual(snap.get(doc["id"]), doc)
+            record = snap.record(snap.find(doc["id"]))
+            self.assertEqual(record["energy"], doc["state"]["energy"])
+            self.assertEqual(record["activation_count"], 1)
+            self.assertGreater(record["last_update_time"], 0)
+
+    def test_query_glyph_uses_snapshot(self):
+        """query_glyph serves from the snapshot, falling back to JSON files"""
+        glyphs = self._create(5)
+        glyph_snapshot.build_snapshot([self.persistence], self.snapshot_path)
+        shutil.rmtree(self.persistence)
+
+        glyph_id, data = glyphs[3]
+        self.assertEqual(query_glyph.query_glyph(glyph_id, snapshot=self.snapshot_path), data)
+        self.assertIsNone(query_glyph.query_glyph("f" * 64, snapshot=self.snapshot_path))
+
+    def test_rejects_bad_files(self):
+        """Non-snapshots and unknown versions are refused"""
+        self.snapshot_path.write_bytes(b"\0" * 8192)
+        with self.assertRaises(ValueError):
+            glyph_snapshot.Snapshot(self.snapshot_path)
+
+        self._create(1)
+        glyph_snapshot.build_snapshot([self.persistence], self.snapshot_path)
+        data = bytearray(self.snapshot_path.read_bytes())
+        data[8] = 99  # version
+        self.snapshot_path.write_bytes(bytes(data))
+        with self.assertRaises(ValueError):
+            glyph_snapshot.Snapshot(self.snapshot_path)
+
+    def test_rejects_overflowing_count(self):
+        """A glyph count whose columns would not fit in the file is refused"""
+        self._create(1)
+        glyph_snapshot.build_snapshot([self.persistence], self.snapshot_path)
+        data = bytearray(self.snapshot_path.read_bytes())
+        data[16:24] = (1 << 59).to_bytes(8, "little")  # count: 32 * count wraps 2^64
+        self.snapshot_path.write_bytes(bytes(data))
+        with self.assertRaises(ValueError):
+            glyph_snapshot.Snapshot(self.snapshot_path)
+
+
+@unittest.skipUnless(HAVE_BINDING, "spu_merge binding not built")
+class TestNativeSnapshot(unittest.TestCase):
+    """spu::Snapshot reads what glyph_snapshot.py writes, and vice versa"""
+
+    def setUp(self):
+        self.test_dir = tempfile.mkdtemp()
+        self.persistence = Path(self.test_dir) / "persistence"
+        self.persistence.mkdir()
+        self.snapshot_path = Path(self.test_dir) / "glyphs.spus"
+        self.original_persistence_path = create_glyph.get_persistence_path
+        create_glyph.get_persistence_path = lambda: self.persistence
+
+    def tearDown(self):
+        create_glyph.get_persistence_path = self.original_persistence_path
+        shutil.rmtree(self.test_dir)
+
+    def _build(self, count):
+        glyphs = []
+        for i in range(count):
+            glyph_id, data = create_glyph.create_glyph(
+                f"native snapshot glyph {i}" + "y" * (i % 50),
+                {"energy": i * 0.5, "activation_count": i % 5, "last_update_time": 7 * i})
+            create_glyph.save_glyph(glyph_id, data)
+            glyphs.append((glyph_id, data))
+        glyph_snapshot.build_snapshot([self.persistence], self.snapshot_path)
+        return glyphs
+
+    def test_reads_python_snapshot(self):
+        glyphs = self._build(40)
+        snap = spu_merge.Snapshot(str(self.snapshot_path))
+        self.assertEqual(len(snap), 40)
+        with glyph_snapshot.Snapshot(self.snapshot_path) as ref:
+            for glyph_id, data in glyphs:
+                i = snap.find(glyph_id)
+                self.assertEqual(i, ref.find(glyph_id))
+                record = ref.record(i)
+                g = snap.load(i)
+                self.assertEqual(g.id, glyph_id)
+                self.assertEqual(g.content, record["content"])
+                self.assertEqual(g.energy, record["energy"])
+                self.assertEqual(g.activation_count, record["activation_count"])
+                self.assertEqual(g.last_update_time, record["last_update_time"])
+                self.assertEqual(json.loads(snap.document(i)), data)
+        self.assertIsNone(snap.find("0" * 64))
+        self.assertIsNone(snap.find("not-an-id"))
+        with self.assertRaises(IndexError):
+            snap.load(len(snap))
+
+        array = snap.to_store()
+        self.assertEqual(len(array), 40)
+        self.assertEqual([array.id(i) for i in range(40)], [snap.id(i) for i in range(40)])
+
+    def test_python_reads_native_snapshot(self):
+        glyphs = []
+        for i in range(30):
+            g = spu_merge.Glyph()
+            g.content = f"native {i}" + "z" * i
+            g.id = hashlib.sha256(g.content.encode()).hexdigest()
+            g.energy = i * 0.125
+            g.activation_count = i
+            g.last_update_time = 1000 + i
+            glyphs.append(g)
+        spu_merge.write_snapshot(spu_merge.GlyphArray(glyphs), str(self.snapshot_path))
+        self.assertFalse(Path(str(self.snapshot_path) + ".tmp").exists())
+
+        with glyph_snapshot.Snapshot(self.snapshot_path) as ref:
+            self.assertEqual(len(ref), 30)
+            for g in glyphs:
+                record = ref.record(ref.find(g.id))
+                self.assertEqual(record["content"], g.content)
+                self.assertEqual(record["energy"], g.energy)
+                self.assertEqual(record["activation_count"], g.activation_count)
+                self.assertEqual(record["last_update_time"], g.last_update_time)
+        with self.assertRaises(ValueError):
+            spu_merge.write_snapshot(spu_merge.GlyphArray(glyphs[:2] + glyphs[:1]),
+                                     str(self.snapshot_path))
+
+    def test_rejects_the_same_bad_files(self):
+        self._build(1)
+        good = self.snapshot_path.read_bytes()
+        bad = {"zeros": b"\0" * 8192, "truncated": good[:1000]}
+        for name, offset, value in [("version", 8, 99), ("count", 16, 1 << 59),
+                                    ("file_size", 32, len(good) + 4096)]:
+            data = bytearray(good)
+            data[offset:offset + (4 if name == "version" else 8)] = value.to_bytes(
+                4 if name == "version" else 8, "little")
+            bad[name] = bytes(data)
+
+        for name, data in bad.items():
+            with self.subTest(name):
+                self.snapshot_path.write_bytes(data)
+                with self.assertRaises(ValueError):
+                    glyph_snapshot.Snapshot(self.snapshot_path)
+                with self.assertRaises(RuntimeError):
+                    spu_merge.Snapshot(str(self.snapshot_path))
+
+
+if __name__ == "__main__":
+    unittest.main()